@@ -2,6 +2,7 @@
 
 // per-chunk info
 layout(location = 0) in ivec3 u_pos; // (per instance)
+layout(location = 1) in uint u_lod; // (per instance) LOD level. 0 for chunks, whose cells are single blocks
 
 // global info
 layout(location = 0) uniform mat4 u_viewProj;
@@ -10,11 +11,14 @@ layout(location = 1) uniform vec3 u_viewPos;
 // How is this buffer laid out?
 //
 // uint 1 holds the following info per quad
-// 0 - 14              15 - 17      18 - 27        28 - 31
-// block position      face         material ID    unused(4)
+// 0 - 14              15 - 17      18 - 27        28        29 - 31
+// block position      face         material ID    shift     unused(3)
 // block position = x, y, z in [0, 31] (15 bits)
 // face = face index in [0, 5] (3 bits)
 // material ID = currently, texture array index. Later, material array index (10 bits)
+// shift = draw the quad one cell further along -normal, for LOD skirts (1 bit)
+//
+// Blocks of LOD meshes are cells 2^u_lod blocks wide.
 //
 // Vertex position is derived from block position, face, and VS built-in inputs.
 // UV is derived from face and built-in inputs.
@@ -137,8 +141,10 @@ void main()
   uint face;
   uint texIdx;
   DecodeQuad(quadData[0], blockPos, face, texIdx);
-  vec3 blockPosWorldSpace = blockPos + u_pos + 0.5;
-  vec3 vertPos = blockPosWorldSpace + ObjSpaceVertexPos(vertexIndex, face);
+  vec3 cellPos = blockPos + 0.5 + ObjSpaceVertexPos(vertexIndex, face);
+  if ((quadData[0] & (1u << 28)) != 0)
+    cellPos -= normals[face];
+  vec3 vertPos = u_pos + cellPos * float(1u << u_lod);
   vs_out.posViewSpace = vertPos - u_viewPos;
   vs_out.texCoord = vec3(tex_corners[vertexIndex], texIdx);
 
@@ -35,6 +35,7 @@ void main()
   vID = gl_InstanceID; // index of chunk being drawn
   uint aOffset = drawCommands[vID].baseInstance * 2; // ratio between vertex size and int
   vec3 cPos = { vbo[aOffset], vbo[aOffset+1], vbo[aOffset+2] };
-  vec3 vPos = cPos + (aPos * 1.001 + .5) * (u_chunk_size); // add tiny constant to ensure occlusion volume exceeds that of the chunk
+  uint lod = uint(vbo[aOffset+3]); // LOD nodes span 2^lod chunks
+  vec3 vPos = cPos + (aPos * 1.001 + .5) * float(u_chunk_size << lod); // add tiny constant to ensure occlusion volume exceeds that of the chunk
   gl_Position = u_viewProj * vec4(vPos, 1.0);
 }
\ No newline at end of file
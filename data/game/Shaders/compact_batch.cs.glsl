@@ -1,23 +1,10 @@
 #version 450 core
 
-#define VISIBILITY_NONE    0
-#define VISIBILITY_PARTIAL 1
-#define VISIBILITY_FULL    2
-
 #include "indirect.h.glsl"
+#include "cull.h.glsl"
 
-// only first 5 of 6 planes used- don't set 6th plane uniform
-struct Frustum
-{
-  float data_[6][4];
-};
-
-struct AABB16
-{
-  vec4 min;
-  vec4 max;
-  // renderdoc thinks 8 xints of padding is here- that is not the case
-};
+// second phase of hierarchical culling: one workgroup per sector that survived cull_sectors.cs
+// chunks in sectors that were fully inside a view's frustum skip the frustum test for that view
 
 struct VerticesDrawInfo
 {
@@ -34,168 +21,152 @@ layout(std430, binding = 0) readonly restrict buffer ssbo_0
   VerticesDrawInfo inDrawData[];
 };
 
+// one draw list per view, each u_commandsPerView long
 layout(std430, binding = 1) writeonly restrict buffer dib_3
 {
   DrawArraysCommand outDrawCommands[];
 };
 
-// parameter buffer style
+// parameter buffer style, one draw count per view
 layout(std430, binding = 2) coherent restrict buffer parameterBuffer_4
 {
-  uint nextIdx;
+  uint nextIdx[];
 };
 
-layout(location = 0) uniform vec3 u_viewpos;
-layout(location = 2) uniform uint u_quadSize = 8; // size of vertex in bytes
-layout(location = 3) uniform float u_cullMinDist;
-layout(location = 4) uniform float u_cullMaxDist;
-layout(location = 5) uniform uint u_reservedBytes; // amt of reserved space (in vertices) before vertices for instanced attributes
-layout(location = 6) uniform bool u_disableOcclusionCulling = false;
-layout(location = 7) uniform float u_lowQualityCullDistance;
-layout(location = 8) uniform Frustum u_viewfrustum;
-
-float GetDistance(in AABB16 box, in vec3 pos);
-bool CullDistance(float dist, float minDist, float maxDist);
-int CullFrustum(in AABB16 box, in Frustum frustum);
-
-layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
-void main()
+layout(std430, binding = 3) readonly restrict buffer views_5
 {
-  if (gl_GlobalInvocationID.x >= inDrawData.length())
-    return;
-
-  VerticesDrawInfo verticesAlloc = inDrawData[gl_GlobalInvocationID.x];
-#if 0
-  bool condition = verticesAlloc.data01.xy != uvec2(0);
-#else
-  float dist = GetDistance(verticesAlloc.box, u_viewpos);
-  bool shouldDrawChunk = 
-    verticesAlloc.data01.xy != uvec2(0) &&
-    CullDistance(dist, u_cullMinDist, u_cullMaxDist) &&
-    CullFrustum(verticesAlloc.box, u_viewfrustum) >= VISIBILITY_PARTIAL &&
-    verticesAlloc.size > u_quadSize * u_reservedBytes;
-#endif
-
-  if (u_disableOcclusionCulling && dist > u_lowQualityCullDistance)
-    shouldDrawChunk = false;
-
-  if (shouldDrawChunk)
-  {
-    // start of chunk data, in quads (8 bytes each)
-    uint startChunkAlloc = verticesAlloc.offset / u_quadSize;
-    DrawArraysCommand cmd;
+  CullView inViews[];
+};
 
-    // number of quads times 6
-    cmd.count = 6 * ((verticesAlloc.size - u_reservedBytes) / u_quadSize);
+layout(std430, binding = 4) readonly restrict buffer sectors_6
+{
+  Sector inSectors[];
+};
 
-    // the instance count will be set to 1 if not culled by occlusion culling, or if too close for occlusion culling to work, or if occlusion culling is disabled
-    cmd.instanceCount = 0;
-    if (dist < 32 || u_disableOcclusionCulling)
-    {
-      cmd.instanceCount = 1;
-    }
+// x: sector index, y: mask of views that may see the sector, z: mask of views that fully contain it
+layout(std430, binding = 5) readonly restrict buffer visibleSectors_7
+{
+  uvec4 dispatchArgs;
+  uvec4 visibleSectors[];
+};
 
-    // beginning of actual quad data, past the reserved bytes
-    cmd.first = 6 * (u_reservedBytes / u_quadSize + startChunkAlloc);
+// chunk (allocation) indices, grouped by sector
+layout(std430, binding = 6) readonly restrict buffer sectorChunks_8
+{
+  uint sectorChunks[];
+};
 
-    // used to increment the chunk position instance attribute index
-    cmd.baseInstance = startChunkAlloc;
+// per allocation, a mask of the views it passed CPU culling (connectivity and occlusion) in. only read for views with cpuVisibility set
+layout(std430, binding = 7) readonly restrict buffer softwareVisibility_9
+{
+  uint softwareVisibility[];
+};
 
-    uint insert = atomicAdd(nextIdx, 1);
-    outDrawCommands[insert] = cmd;
-  }
-}
+layout(location = 2) uniform uint u_quadSize = 8; // size of vertex in bytes
+layout(location = 5) uniform uint u_reservedBytes; // amt of reserved space (in vertices) before vertices for instanced attributes
+layout(location = 10) uniform uint u_commandsPerView;
+layout(location = 11) uniform float u_lodDistance; // where level 1 starts. 0 draws only chunks
+layout(location = 12) uniform uint u_maxLod;
+layout(location = 13) uniform uint u_chunkSize;
 
+// bits of a mesh's box.max.w, set by ChunkRenderer
+#define LOD_SELF_READY   1u
+#define LOD_PARENT_READY 2u
 
-float GetDistance(in AABB16 box, in vec3 pos)
+float LodDistance(uint lod)
 {
-  vec3 bp = (box.max.xyz + box.min.xyz) / 2.0;
-  float dist = distance(bp, pos);
-  return dist;
+  return u_lodDistance * float(1u << (lod - 1));
 }
 
-
-bool CullDistance(float dist, float minDist, float maxDist)
+// Each place in the world has a mesh at every level (chunks are level 0), and exactly one of them is drawn.
+// A level k mesh is drawn once its node is far enough away to swap in, but its parent isn't.
+// Parent and child measure to the same point (the parent's center), so they never overlap or leave holes.
+// A node is ready once it and every node below it have been built. Until then it isn't drawn, and its
+// children keep drawing in its place however far away they are.
+bool SelectLod(in AABB16 box, in vec3 viewPos)
 {
-  return dist >= minDist && dist <= maxDist;
+  uint lod = uint(box.min.w);
+  uint ready = uint(box.max.w);
+  if (u_lodDistance <= 0)
+    return lod == 0;
+  if ((ready & LOD_SELF_READY) == 0)
+    return false;
+
+  float nodeSize = float(u_chunkSize << lod);
+  bool farEnough = lod == 0 || distance(box.min.xyz + nodeSize / 2.0, viewPos) >= LodDistance(lod);
+  if (lod >= u_maxLod)
+    return lod == u_maxLod && farEnough;
+
+  vec3 parentMin = floor(box.min.xyz / (nodeSize * 2.0)) * (nodeSize * 2.0);
+  bool parentTooClose = distance(parentMin + nodeSize, viewPos) < LodDistance(lod + 1);
+  return farEnough && (parentTooClose || (ready & LOD_PARENT_READY) == 0);
 }
 
-
-vec4 GetPlane(int plane, in Frustum frustum)
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+void main()
 {
-  return vec4(frustum.data_[plane][0], frustum.data_[plane][1],
-    frustum.data_[plane][2], frustum.data_[plane][3]);
-}
+  uvec4 visibleSector = visibleSectors[gl_WorkGroupID.x];
+  Sector sector = inSectors[visibleSector.x];
+  if (gl_LocalInvocationID.x >= sector.chunkCount)
+    return;
 
+  uint allocIndex = sectorChunks[sector.firstChunk + gl_LocalInvocationID.x];
+  VerticesDrawInfo verticesAlloc = inDrawData[allocIndex];
+  if (verticesAlloc.data01.xy == uvec2(0) || verticesAlloc.size <= u_quadSize * u_reservedBytes)
+    return;
 
-int GetVisibility(in vec4 clip, in AABB16 box)
-{
-  float x0 = box.min.x * clip.x;
-  float x1 = box.max.x * clip.x;
-  float y0 = box.min.y * clip.y;
-  float y1 = box.max.y * clip.y;
-  float z0 = box.min.z * clip.z + clip.w;
-  float z1 = box.max.z * clip.z + clip.w;
-  float p1 = x0 + y0 + z0;
-  float p2 = x1 + y0 + z0;
-  float p3 = x1 + y1 + z0;
-  float p4 = x0 + y1 + z0;
-  float p5 = x0 + y0 + z1;
-  float p6 = x1 + y0 + z1;
-  float p7 = x1 + y1 + z1;
-  float p8 = x0 + y1 + z1;
-
-  if (p1 <= 0 && p2 <= 0 && p3 <= 0 && p4 <= 0 && p5 <= 0 && p6 <= 0 && p7 <= 0 && p8 <= 0)
-  {
-    return VISIBILITY_NONE;
-  }
-  if (p1 > 0 && p2 > 0 && p3 > 0 && p4 > 0 && p5 > 0 && p6 > 0 && p7 > 0 && p8 > 0)
+  // only test against the views that can see the sector
+  uint visibleMask = 0;
+  uint candidates = visibleSector.y;
+  while (candidates != 0)
   {
-    return VISIBILITY_FULL;
-  }
+    uint v = findLSB(candidates);
+    candidates &= candidates - 1;
 
-  return VISIBILITY_PARTIAL;
-}
+    float dist = GetDistance(verticesAlloc.box, inViews[v].position.xyz);
+    if (!CullDistance(dist, inViews[v].minDistance, inViews[v].maxDistance))
+      continue;
 
+    if (!SelectLod(verticesAlloc.box, inViews[v].position.xyz))
+      continue;
 
-int CullFrustum(in AABB16 box, in Frustum frustum)
-{
-  int v0 = GetVisibility(GetPlane(0, frustum), box);
-  if (v0 == VISIBILITY_NONE)
-  {
-    return VISIBILITY_NONE;
-  }
+    if (inViews[v].cpuVisibility != 0 && (softwareVisibility[allocIndex] & (1u << v)) == 0)
+      continue;
 
-  int v1 = GetVisibility(GetPlane(1, frustum), box);
-  if (v1 == VISIBILITY_NONE)
-  {
-    return VISIBILITY_NONE;
+    if ((visibleSector.z & (1u << v)) != 0 || CullFrustum(verticesAlloc.box, inViews[v]) >= VISIBILITY_PARTIAL)
+    {
+      visibleMask |= 1u << v;
+    }
   }
 
-  int v2 = GetVisibility(GetPlane(2, frustum), box);
-  if (v2 == VISIBILITY_NONE)
-  {
-    return VISIBILITY_NONE;
-  }
+  // start of chunk data, in quads (8 bytes each)
+  uint startChunkAlloc = verticesAlloc.offset / u_quadSize;
+  DrawArraysCommand cmd;
 
-  int v3 = GetVisibility(GetPlane(3, frustum), box);
-  if (v3 == VISIBILITY_NONE)
-  {
-    return VISIBILITY_NONE;
-  }
+  // number of quads times 6
+  cmd.count = 6 * ((verticesAlloc.size - u_reservedBytes) / u_quadSize);
 
-  int v4 = GetVisibility(GetPlane(4, frustum), box);
-  if (v4 == VISIBILITY_NONE)
-  {
-    return VISIBILITY_NONE;
-  }
+  // beginning of actual quad data, past the reserved bytes
+  cmd.first = 6 * (u_reservedBytes / u_quadSize + startChunkAlloc);
 
-  if (v0 == VISIBILITY_FULL && v1 == VISIBILITY_FULL &&
-    v2 == VISIBILITY_FULL && v3 == VISIBILITY_FULL &&
-    v4 == VISIBILITY_FULL)
+  // used to increment the chunk position instance attribute index
+  cmd.baseInstance = startChunkAlloc;
+
+  while (visibleMask != 0)
   {
-    return VISIBILITY_FULL;
-  }
+    uint v = findLSB(visibleMask);
+    visibleMask &= visibleMask - 1;
 
-  return VISIBILITY_PARTIAL;
-}
\ No newline at end of file
+    // the instance count will be set to 1 if not culled by occlusion culling, or if too close for occlusion culling to work, or if occlusion culling is disabled
+    // chunks that passed CPU occlusion culling are already known to be visible
+    float dist = GetDistance(verticesAlloc.box, inViews[v].position.xyz);
+    cmd.instanceCount = 0;
+    if (dist < 32 || inViews[v].disableOcclusionCulling != 0 || inViews[v].softwareOcclusion != 0)
+    {
+      cmd.instanceCount = 1;
+    }
+
+    uint insert = atomicAdd(nextIdx[v], 1);
+    outDrawCommands[v * u_commandsPerView + insert] = cmd;
+  }
+}
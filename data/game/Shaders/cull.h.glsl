@@ -0,0 +1,102 @@
+#ifndef CULL_H
+#define CULL_H
+
+#define VISIBILITY_NONE    0
+#define VISIBILITY_PARTIAL 1
+#define VISIBILITY_FULL    2
+
+#define MAX_VIEWS 32
+
+// only first 5 of 6 planes used (near plane is ignored)
+struct CullView
+{
+  vec4 planes[5];
+  vec4 position;
+  float minDistance;
+  float maxDistance;
+  uint disableOcclusionCulling;
+  uint softwareOcclusion; // chunks were occlusion culled on the CPU this frame
+  uint cpuVisibility;     // chunks were culled on the CPU this frame (see softwareVisibility in compact_batch.cs)
+  uint _pad01;
+  uint _pad02;
+  uint _pad03;
+};
+
+struct AABB16
+{
+  vec4 min;
+  vec4 max;
+  // renderdoc thinks 8 xints of padding is here- that is not the case
+};
+
+// a group of chunks (SECTOR_SIZE^3) with an AABB enclosing all of them
+struct Sector
+{
+  AABB16 box;
+  uint firstChunk; // index into the sector chunk list
+  uint chunkCount;
+  uint _pad00;
+  uint _pad01;
+};
+
+float GetDistance(in AABB16 box, in vec3 pos)
+{
+  vec3 bp = (box.max.xyz + box.min.xyz) / 2.0;
+  float dist = distance(bp, pos);
+  return dist;
+}
+
+
+bool CullDistance(float dist, float minDist, float maxDist)
+{
+  return dist >= minDist && dist <= maxDist;
+}
+
+
+int GetVisibility(in vec4 clip, in AABB16 box)
+{
+  float x0 = box.min.x * clip.x;
+  float x1 = box.max.x * clip.x;
+  float y0 = box.min.y * clip.y;
+  float y1 = box.max.y * clip.y;
+  float z0 = box.min.z * clip.z + clip.w;
+  float z1 = box.max.z * clip.z + clip.w;
+  float p1 = x0 + y0 + z0;
+  float p2 = x1 + y0 + z0;
+  float p3 = x1 + y1 + z0;
+  float p4 = x0 + y1 + z0;
+  float p5 = x0 + y0 + z1;
+  float p6 = x1 + y0 + z1;
+  float p7 = x1 + y1 + z1;
+  float p8 = x0 + y1 + z1;
+
+  if (p1 <= 0 && p2 <= 0 && p3 <= 0 && p4 <= 0 && p5 <= 0 && p6 <= 0 && p7 <= 0 && p8 <= 0)
+  {
+    return VISIBILITY_NONE;
+  }
+  if (p1 > 0 && p2 > 0 && p3 > 0 && p4 > 0 && p5 > 0 && p6 > 0 && p7 > 0 && p8 > 0)
+  {
+    return VISIBILITY_FULL;
+  }
+
+  return VISIBILITY_PARTIAL;
+}
+
+
+int CullFrustum(in AABB16 box, in CullView view)
+{
+  bool full = true;
+  for (int i = 0; i < 5; i++)
+  {
+    int v = GetVisibility(view.planes[i], box);
+    if (v == VISIBILITY_NONE)
+    {
+      return VISIBILITY_NONE;
+    }
+    full = full && v == VISIBILITY_FULL;
+  }
+
+  return full ? VISIBILITY_FULL : VISIBILITY_PARTIAL;
+}
+
+#endif // CULL_H
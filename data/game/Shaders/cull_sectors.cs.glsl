@@ -0,0 +1,63 @@
+#version 450 core
+
+#include "cull.h.glsl"
+
+// first phase of hierarchical culling: tests whole sectors against every view
+// surviving sectors are appended to a list that doubles as the indirect dispatch for compact_batch.cs
+
+layout(std430, binding = 3) readonly restrict buffer views_5
+{
+  CullView inViews[];
+};
+
+layout(std430, binding = 4) readonly restrict buffer sectors_6
+{
+  Sector inSectors[];
+};
+
+// dispatchArgs.x is the number of visible sectors (must be cleared to 0, with y and z set to 1)
+layout(std430, binding = 5) coherent restrict buffer visibleSectors_7
+{
+  uvec4 dispatchArgs;
+  uvec4 visibleSectors[];
+};
+
+layout(location = 9) uniform uint u_viewCount;
+layout(location = 11) uniform uint u_sectorCount;
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+void main()
+{
+  if (gl_GlobalInvocationID.x >= u_sectorCount)
+    return;
+
+  Sector sector = inSectors[gl_GlobalInvocationID.x];
+
+  uint visibleMask = 0;
+  uint fullMask = 0;
+  for (uint v = 0; v < u_viewCount; v++)
+  {
+    // conservative: chunk distance is measured from chunk centers, which are all inside the sector
+    vec3 pos = inViews[v].position.xyz;
+    float nearDist = distance(clamp(pos, sector.box.min.xyz, sector.box.max.xyz), pos);
+    float farDist = length(max(abs(sector.box.min.xyz - pos), abs(sector.box.max.xyz - pos)));
+    if (nearDist > inViews[v].maxDistance || farDist < inViews[v].minDistance)
+      continue;
+
+    int visibility = CullFrustum(sector.box, inViews[v]);
+    if (visibility == VISIBILITY_NONE)
+      continue;
+
+    visibleMask |= 1u << v;
+    if (visibility == VISIBILITY_FULL)
+    {
+      fullMask |= 1u << v;
+    }
+  }
+
+  if (visibleMask != 0)
+  {
+    uint insert = atomicAdd(dispatchArgs.x, 1);
+    visibleSectors[insert] = uvec4(gl_GlobalInvocationID.x, visibleMask, fullMask, 0);
+  }
+}
@@ -82,7 +82,7 @@ void Application::Start()
   //TestParse("{1.123 a  5]");
 
   ASSERT(start);
-  engine_ = new Engine();
+  engine_ = new Engine(headless_);
   engine_->AddScene(new Scene("default scene", engine_));
   engine_->SetActiveScene(0);
   engine_->InitScenes();
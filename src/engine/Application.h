@@ -14,6 +14,9 @@ public:
   static void UnloadScene(const char* name) { ASSERT(unloadSceneStr); unloadSceneStr(name); }
   static void UnloadScene(unsigned index) { ASSERT(unloadSceneIndex); unloadSceneIndex(index); }
   static bool IsPlaying() { return isPlaying_; }
+
+  // starts the engine without a window or GL context. call before Start
+  static void SetHeadless(bool headless) { headless_ = headless; }
   static void Start();
   static void Shutdown();
   static void Quit();
@@ -40,6 +43,7 @@ private:
   static inline void(*drawInterfacePostPostProcessingCallback)(Scene*, Timestep) = nullptr;
 
   static inline bool isPlaying_ = false;
+  static inline bool headless_ = false;
 
   static inline Engine* engine_ = nullptr;
 };
\ No newline at end of file
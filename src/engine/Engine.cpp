@@ -12,6 +12,14 @@
 #include "ecs/system/ScriptSystem.h"
 #include "ecs/system/ParticleSystem.h"
 #include "ecs/system/LifetimeSystem.h"
+#include "ecs/CommandBuffer.h"
+#include "ecs/SystemScheduler.h"
+#include "core/JobSystem.h"
+#include "core/Profiler.h"
+#include "ecs/component/Core.h"
+#include "ecs/component/ParticleEmitter.h"
+#include "ecs/component/Physics.h"
+#include "ecs/component/Transform.h"
 
 #include "Console.h"
 #include "CVar.h"
@@ -19,18 +27,30 @@
 
 DECLARE_FLOAT_STAT(MainLoop, CPU)
 
-Engine::Engine()
+Engine::Engine(bool headless)
+  : headless_(headless)
 {
+  // the profiler outlives the job system, whose workers record to it
+  engine::Core::Profiler::Get()->SetThreadName("Main");
+
+  // the job system's main thread is the one that first uses it
+  engine::Core::JobSystem::Get()->SetTraceHook(&engine::Core::Profiler::TraceJob);
+
   graphicsSystem = std::make_unique<GraphicsSystem>();
   debugSystem = std::make_unique<DebugSystem>();
   physicsSystem = std::make_unique<PhysicsSystem>();
   scriptSystem = std::make_unique<ScriptSystem>();
   particleSystem = std::make_unique<ParticleSystem>();
   lifetimeSystem = std::make_unique<LifetimeSystem>();
+  scheduler = std::make_unique<SystemScheduler>();
+  registerSystems();
 
-  graphicsSystem->Init();
-  debugSystem->Init(graphicsSystem->GetWindow());
-  Input::init_glfw_input_cbs(graphicsSystem->GetWindow());
+  if (!headless_)
+  {
+    graphicsSystem->Init();
+    debugSystem->Init(graphicsSystem->GetWindow());
+    Input::init_glfw_input_cbs(graphicsSystem->GetWindow());
+  }
 
   auto exitFunc = [this](const char*)
   {
@@ -81,6 +101,53 @@ Engine::~Engine()
   physicsSystem.reset();
 }
 
+void Engine::registerSystems()
+{
+  using namespace Component;
+
+  // idk when this should be called tbh
+  scheduler->AddSystem("ScriptSystem", SystemPhase::PRE_UPDATE, SystemAccess().Exclusive().MainThread(),
+    [this](Scene& scene, Timestep timestep) { scriptSystem->Update(scene, timestep); });
+
+  scheduler->AddSystem("LifetimeSystem", SystemPhase::PRE_UPDATE, SystemAccess().Write<Lifetime>(),
+    [this](Scene& scene, Timestep timestep) { lifetimeSystem->Update(scene, timestep); });
+
+  // apply entity changes recorded by scripts and systems since the last flush
+  scheduler->AddSystem("CommandFlush", SystemPhase::PRE_UPDATE, SystemAccess().Exclusive(),
+    [](Scene& scene, Timestep) { scene.GetCommandBuffer().Flush(); });
+
+  scheduler->AddSystem("UpdateCallback", SystemPhase::PRE_UPDATE, SystemAccess().Exclusive().MainThread(),
+    [this](Scene&, Timestep timestep)
+    {
+      if (updateCallback != nullptr)
+      {
+        updateCallback(timestep);
+      }
+    });
+
+  // particles are simulated on the GPU
+  if (!headless_)
+  {
+    scheduler->AddSystem("ParticleSystem", SystemPhase::UPDATE,
+      SystemAccess().Write<ParticleEmitter>().Read<Transform>().MainThread(),
+      [this](Scene& scene, Timestep timestep) { particleSystem->Update(scene, timestep); });
+  }
+
+  scheduler->AddSystem("PhysicsSystem", SystemPhase::UPDATE,
+    SystemAccess()
+      .Write<Transform, LocalTransform, Model, InterpolatedPhysics>()
+      .Write<DynamicPhysics, StaticPhysics, CharacterController>()
+      .Read<Parent, Children>(),
+    [this](Scene& scene, Timestep timestep) { physicsSystem->Update(scene, timestep); });
+
+  // only touches ImGui, so it overlaps physics
+  if (!headless_)
+  {
+    scheduler->AddSystem("DebugSystem", SystemPhase::UPDATE, SystemAccess().MainThread(),
+      [this](Scene& scene, Timestep timestep) { debugSystem->Update(scene, timestep); });
+  }
+}
+
 void Engine::InitScenes()
 {
   for (auto& scene : scenes_)
@@ -107,50 +174,56 @@ void Engine::Run()
 
     if (paused_) timestep.dt_effective = 0;
 
-    Input::Update();
-    debugSystem->StartFrame(*activeScene_);
-
-    // idk when this should be called tbh
-    scriptSystem->Update(*activeScene_, timestep);
+    RunFrame(timestep);
+  }
 
-    lifetimeSystem->Update(*activeScene_, timestep);
+  if (!headless_)
+  {
+    graphicsSystem->Shutdown();
+  }
+}
 
-    if (updateCallback != nullptr)
-    {
-      updateCallback(timestep);
-    }
+void Engine::RunFrame(Timestep timestep)
+{
+  engine::Core::Profiler::Get()->MarkFrame();
 
-    particleSystem->Update(*activeScene_, timestep);
+  if (!headless_)
+  {
+    Input::Update();
+    debugSystem->StartFrame(*activeScene_);
+  }
 
-    physicsSystem->Update(*activeScene_, timestep);
-    debugSystem->Update(*activeScene_, timestep);
+  scheduler->Run(*activeScene_, timestep);
+  engine::Core::JobSystem::Get()->RunMainThreadJobs();
 
-    graphicsSystem->StartFrame(*activeScene_);
-    graphicsSystem->DrawOpaque(*activeScene_);
-    if (drawOpaqueCallback)
-    {
-      drawOpaqueCallback(activeScene_, timestep);
-    }
-    graphicsSystem->DrawSky(*activeScene_);
-    graphicsSystem->DrawEarlyFog(*activeScene_);
-    graphicsSystem->DrawShading(*activeScene_);
-    graphicsSystem->DrawFog(*activeScene_);
-    graphicsSystem->DrawTransparent(*activeScene_);
-    if (drawInterfacePrePostProcessingCallback)
-    {
-      drawInterfacePrePostProcessingCallback(activeScene_, timestep);
-    }
-    graphicsSystem->Bloom();
-    if (drawInterfacePostPostProcessingCallback)
-    {
-      drawInterfacePostPostProcessingCallback(activeScene_, timestep);
-    }
-    graphicsSystem->EndFrame(timestep);
-    debugSystem->EndFrame(*activeScene_); // render UI on top of everything else
-    graphicsSystem->SwapBuffers();
+  if (headless_)
+  {
+    return;
   }
 
-  graphicsSystem->Shutdown();
+  graphicsSystem->StartFrame(*activeScene_);
+  graphicsSystem->DrawOpaque(*activeScene_);
+  if (drawOpaqueCallback)
+  {
+    drawOpaqueCallback(activeScene_, timestep);
+  }
+  graphicsSystem->DrawSky(*activeScene_);
+  graphicsSystem->DrawEarlyFog(*activeScene_);
+  graphicsSystem->DrawShading(*activeScene_);
+  graphicsSystem->DrawFog(*activeScene_);
+  graphicsSystem->DrawTransparent(*activeScene_);
+  if (drawInterfacePrePostProcessingCallback)
+  {
+    drawInterfacePrePostProcessingCallback(activeScene_, timestep);
+  }
+  graphicsSystem->Bloom();
+  if (drawInterfacePostPostProcessingCallback)
+  {
+    drawInterfacePostPostProcessingCallback(activeScene_, timestep);
+  }
+  graphicsSystem->EndFrame(timestep);
+  debugSystem->EndFrame(*activeScene_); // render UI on top of everything else
+  graphicsSystem->SwapBuffers();
 }
 
 Scene* Engine::GetScene(std::string_view name)
@@ -9,6 +9,7 @@ class PhysicsSystem;
 class ScriptSystem;
 class ParticleSystem;
 class LifetimeSystem;
+class SystemScheduler;
 
 class Engine
 {
@@ -18,6 +19,9 @@ public:
   void InitScenes();
   void Run();
 
+  // updates the active scene once, and draws it unless headless
+  void RunFrame(Timestep timestep);
+
   Scene* GetScene(std::string_view name);
   Scene* GetScene(unsigned index);
   void AddScene(Scene* scene);
@@ -31,9 +35,14 @@ public:
   void SetTimescale(float ts) { timescale_ = ts; }
   float GetTimescale() const { return timescale_; }
 
+  // a headless engine has no window or GL context, so nothing is drawn
+  bool IsHeadless() const { return headless_; }
+
 private:
   friend class Application;
-  Engine();
+  Engine(bool headless);
+
+  const bool headless_;
 
   double timescale_{ 1.0f };
   std::vector<std::unique_ptr<Scene>> scenes_;
@@ -54,4 +63,8 @@ private:
   std::unique_ptr<ScriptSystem> scriptSystem;
   std::unique_ptr<ParticleSystem> particleSystem;
   std::unique_ptr<LifetimeSystem> lifetimeSystem;
+
+  // runs the systems that update the scene each frame
+  std::unique_ptr<SystemScheduler> scheduler;
+  void registerSystems();
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <engine/ecs/Entity.h>
 #include <engine/ecs/component/Transform.h>
 #include <engine/ecs/component/Physics.h>
+#include <engine/core/JobSystem.h>
 
 #include <glm/gtx/quaternion.hpp>
 
@@ -118,6 +119,25 @@ namespace
     }
   };
 
+  // runs PhysX's tasks on the engine's workers instead of threads of its own
+  class JobDispatcher : public PxCpuDispatcher
+  {
+  public:
+    void submitTask(PxBaseTask& task) override
+    {
+      engine::Core::JobSystem::Get()->Submit([&task]
+        {
+          task.run();
+          task.release();
+        }, nullptr, engine::Core::JobPriority::HIGH, task.getName());
+    }
+
+    uint32_t getWorkerCount() const override
+    {
+      return engine::Core::JobSystem::Get()->GetWorkerCount();
+    }
+  };
+
   static PxDefaultAllocator gAllocator;
   static ErrorCallback gErrorCallback;
 }
@@ -167,7 +187,7 @@ void Physics::PhysicsManager::Init()
   gPhysics = PxCreatePhysics(PX_PHYSICS_VERSION, *gFoundation, tolerances, true, gPvd);
   gCooking = PxCreateCooking(PX_PHYSICS_VERSION, *gFoundation, PxCookingParams(tolerances));
   PxInitExtensions(*gPhysics, gPvd);
-  gDispatcher = PxDefaultCpuDispatcherCreate(0);
+  gDispatcher = new JobDispatcher;
 
 
   PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
@@ -209,7 +229,8 @@ void Physics::PhysicsManager::Shutdown()
   gScene->unlockWrite();
   PX_RELEASE(gScene);
   PX_RELEASE(gCudaContextManager);
-  PX_RELEASE(gDispatcher);
+  delete gDispatcher;
+  gDispatcher = nullptr;
   PxCloseExtensions();
   PX_RELEASE(gCooking);
   PX_RELEASE(gPhysics);
@@ -420,20 +441,39 @@ physx::PxRigidStatic* Physics::PhysicsManager::AddStaticActorGeneric(MaterialTyp
   PxTriangleMeshGeometry geom(aTriangleMesh);
   PxRigidStatic* pStatic = PxCreateStatic(*gPhysics, PxTransform(toPxMat4(transform)), geom, *gMaterials[(int)material]);
 
-  gGenericActors.insert(pStatic);
+  // generic actors are added and removed from several threads, so the scene lock also guards the set
   PxLockWrite lkw(gScene);
+  gGenericActors.insert(pStatic);
   gScene->addActor(*pStatic);
   aTriangleMesh->release();
   return pStatic;
 }
 
+physx::PxRigidStatic* Physics::PhysicsManager::AddStaticActorGeneric(MaterialType material, const BoxCompoundCollider& collider, const glm::mat4& transform)
+{
+  if (collider.boxes.empty())
+    return nullptr;
+
+  PxRigidStatic* pStatic = gPhysics->createRigidStatic(PxTransform(toPxMat4(transform)));
+  for (const auto& box : collider.boxes)
+  {
+    PxShape* shape = PxRigidActorExt::createExclusiveShape(*pStatic, PxBoxGeometry(toPxVec3(box.halfExtents)), *gMaterials[(int)material]);
+    shape->setLocalPose(PxTransform(toPxVec3(box.center)));
+  }
+
+  PxLockWrite lkw(gScene);
+  gGenericActors.insert(pStatic);
+  gScene->addActor(*pStatic);
+  return pStatic;
+}
+
 void Physics::PhysicsManager::RemoveActorGeneric(physx::PxRigidActor* actor)
 {
   if (actor)
   {
     // TODO: figure out how to actually free the thingy because this makes a memory leak
-    gGenericActors.erase(actor);
     PxLockWrite lkw(gScene);
+    gGenericActors.erase(actor);
     gScene->removeActor(*actor);
     PX_RELEASE(actor);
   }
@@ -471,6 +511,24 @@ void Physics::PhysicsManager::RemoveCharacterControllerEntity(physx::PxControlle
   }
 }
 
+void Physics::PhysicsManager::GetDynamicBounds(std::vector<AABB>& bounds)
+{
+  auto toAABB = [](const PxBounds3& b) { return AABB(toGlmVec3(b.minimum), toGlmVec3(b.maximum)); };
+
+  PxLockRead lkr(gScene);
+  for (const auto& [actor, entity] : gEntityActors)
+  {
+    if (actor->is<PxRigidDynamic>())
+    {
+      bounds.push_back(toAABB(actor->getWorldBounds()));
+    }
+  }
+  for (const auto& [controller, entity] : gEntityControllers)
+  {
+    bounds.push_back(toAABB(controller->getActor()->getWorldBounds()));
+  }
+}
+
 void Physics::DynamicActorInterface::AddForce(const glm::vec3& force, ForceMode mode)
 {
   PxLockWrite lkw(actor->getScene());
@@ -5,6 +5,7 @@
 #include <memory>
 #include <utility/Flags.h>
 #include <engine/Timestep.h>
+#include <engine/Shapes.h>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -12,7 +13,7 @@ namespace physx
 {
   class PxFoundation;
   class PxPhysics;
-  class PxDefaultCpuDispatcher;
+  class PxCpuDispatcher;
   class PxScene;
   class PxMaterial;
   class PxPvd;
@@ -51,6 +52,16 @@ namespace Physics
     std::vector<glm::vec3> vertices;
     std::vector<uint32_t> indices;
   };
+  // many boxes attached to one actor. unlike MeshCollider, this does not require cooking
+  struct BoxCompoundCollider
+  {
+    struct Box
+    {
+      glm::vec3 center;
+      glm::vec3 halfExtents;
+    };
+    std::vector<Box> boxes;
+  };
 
   enum class MaterialType
   {
@@ -150,18 +161,22 @@ namespace Physics
     static void RemoveActorEntity(physx::PxRigidActor* actor);
 
     static physx::PxRigidStatic* AddStaticActorGeneric(MaterialType material, const MeshCollider& collider, const glm::mat4& transform);
+    static physx::PxRigidStatic* AddStaticActorGeneric(MaterialType material, const BoxCompoundCollider& collider, const glm::mat4& transform);
     static void RemoveActorGeneric(physx::PxRigidActor* actor);
 
     static physx::PxController* AddCharacterControllerEntity(Entity entity, MaterialType material, CapsuleCollider collider);
     static void RemoveCharacterControllerEntity(physx::PxController* controller);
 
+    // appends the world bounds of every dynamic actor and character controller
+    static void GetDynamicBounds(std::vector<AABB>& bounds);
+
   private:
     static inline physx::PxFoundation* gFoundation = nullptr;
     static inline physx::PxPhysics* gPhysics = nullptr;
 
     static inline ContactReportCallback* gContactReportCallback;
 
-    static inline physx::PxDefaultCpuDispatcher* gDispatcher = nullptr;
+    static inline physx::PxCpuDispatcher* gDispatcher = nullptr;
     static inline physx::PxScene* gScene = nullptr;
     static inline std::vector<physx::PxMaterial*> gMaterials;
     static inline physx::PxPvd* gPvd = nullptr;
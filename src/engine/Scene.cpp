@@ -5,6 +5,8 @@
 #include "ecs/Entity.h"
 #include "ecs/component/Core.h"
 #include "ecs/component/Transform.h"
+#include "ecs/TransformHierarchy.h"
+#include "ecs/CommandBuffer.h"
 #include <engine/gfx/Renderer.h>
 #include <engine/gfx/RenderView.h>
 
@@ -26,15 +28,19 @@ struct string_hash
 
 struct SceneStorage
 {
+  SceneStorage(Scene& scene) : commandBuffer_(scene) {}
+
   entt::registry registry_{};  // all the entities in this scene
   Engine* engine_{};           // non-owning
   std::string name_;           // the name of this scene
   std::unordered_map<std::string, GFX::RenderView*, string_hash, MyEqual> renderViews_;
+  TransformHierarchy transformHierarchy_{ registry_ }; // entities with parents, by depth
+  CommandBuffer commandBuffer_;  // flushed by the engine once per frame
 };
 
 Scene::Scene(std::string_view name, Engine* engine)
 {
-  data_ = new SceneStorage;
+  data_ = new SceneStorage(*this);
   data_->name_ = name;
   data_->engine_ = engine;
 
@@ -129,3 +135,13 @@ entt::registry& Scene::GetRegistry()
 {
   return data_->registry_;
 }
+
+TransformHierarchy& Scene::GetTransformHierarchy()
+{
+  return data_->transformHierarchy_;
+}
+
+CommandBuffer& Scene::GetCommandBuffer()
+{
+  return data_->commandBuffer_;
+}
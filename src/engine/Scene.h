@@ -6,6 +6,8 @@
 
 class Entity;
 class Engine;
+class TransformHierarchy;
+class CommandBuffer;
 
 namespace GFX
 {
@@ -40,6 +42,10 @@ public:
   Engine* GetEngine();
   std::string_view GetName();
   entt::registry& GetRegistry();
+  TransformHierarchy& GetTransformHierarchy();
+
+  // for changing entities from other threads or while iterating them
+  CommandBuffer& GetCommandBuffer();
 
 private:
   struct SceneStorage* data_; // PIMPL
@@ -14,7 +14,7 @@ struct AABB
 };
 
 // vecs are 16-byte aligned for GPU usage
-// the .w system is unused
+// .w is unused, except by ChunkRenderer, which keeps a mesh's LOD level in min.w and its LOD ready flags in max.w
 struct AABB16
 {
   AABB16() = default;
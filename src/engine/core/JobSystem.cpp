@@ -0,0 +1,410 @@
+#include "../PCH.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace engine::Core
+{
+  namespace
+  {
+    constexpr size_t PRIORITY_COUNT = static_cast<size_t>(JobPriority::COUNT);
+
+    // times Wait yields with nothing to run before it sleeps. a counter is usually close to done by then
+    constexpr uint32_t WAIT_SPIN_COUNT = 64;
+
+    struct Job
+    {
+      std::function<void()> fn;
+      JobCounter* counter{};
+      JobPriority priority{};
+      const char* name{};
+    };
+
+    struct alignas(64) JobQueue
+    {
+      std::mutex mutex;
+      std::deque<Job> jobs[PRIORITY_COUNT];
+    };
+
+    // the worker running on this thread, or -1 for threads that aren't workers
+    thread_local int tWorkerIndex = -1;
+  }
+
+  struct JobSystemData
+  {
+    std::vector<std::thread> workers;
+    std::unique_ptr<JobQueue[]> workerQueues;
+    JobQueue sharedQueue;
+    std::atomic_uint32_t queued[PRIORITY_COUNT]{};
+
+    std::atomic_uint32_t lowRunning{ 0 };
+    uint32_t maxLowRunning{};
+
+    std::mutex mainMutex;
+    std::vector<Job> mainJobs;
+    std::atomic_bool hasMainJobs{ false };
+    std::thread::id mainThread;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // threads sleeping in Wait. they're woken by any new job they could run, or by a counter reaching zero
+    std::condition_variable waiterWake;
+    uint32_t sleepingWaiters = 0;
+
+    std::atomic<JobTraceHook> traceHook{ nullptr };
+
+    void Push(Job job)
+    {
+      const auto priority = static_cast<size_t>(job.priority);
+      JobQueue& queue = tWorkerIndex >= 0 ? workerQueues[tWorkerIndex] : sharedQueue;
+      {
+        std::lock_guard lck(queue.mutex);
+        queue.jobs[priority].push_back(std::move(job));
+      }
+      queued[priority].fetch_add(1, std::memory_order_release);
+      Wake();
+    }
+
+    void Wake()
+    {
+      bool waiters;
+      {
+        std::lock_guard lck(sleepMutex);
+        waiters = sleepingWaiters > 0;
+      }
+      wake.notify_one();
+      if (waiters)
+      {
+        waiterWake.notify_all();
+      }
+    }
+
+    void WakeWaiters()
+    {
+      bool waiters;
+      {
+        std::lock_guard lck(sleepMutex);
+        waiters = sleepingWaiters > 0;
+      }
+      if (waiters)
+      {
+        waiterWake.notify_all();
+      }
+    }
+
+    bool HasRunnable() const
+    {
+      return HasUrgent() ||
+        (queued[2].load(std::memory_order_acquire) > 0 && lowRunning.load(std::memory_order_acquire) < maxLowRunning);
+    }
+
+    // jobs that a waiting thread may run
+    bool HasUrgent() const
+    {
+      return queued[0].load(std::memory_order_acquire) + queued[1].load(std::memory_order_acquire) > 0;
+    }
+
+    // a worker's own jobs are taken newest first, everyone else's oldest first
+    bool TryPop(size_t priority, Job& job)
+    {
+      if (queued[priority].load(std::memory_order_acquire) == 0)
+      {
+        return false;
+      }
+
+      auto take = [&](JobQueue& queue, bool back)
+      {
+        std::lock_guard lck(queue.mutex);
+        auto& jobs = queue.jobs[priority];
+        if (jobs.empty())
+        {
+          return false;
+        }
+        if (back)
+        {
+          job = std::move(jobs.back());
+          jobs.pop_back();
+        }
+        else
+        {
+          job = std::move(jobs.front());
+          jobs.pop_front();
+        }
+        queued[priority].fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      };
+
+      const int self = tWorkerIndex;
+      if (self >= 0 && take(workerQueues[self], true))
+      {
+        return true;
+      }
+      if (take(sharedQueue, false))
+      {
+        return true;
+      }
+      for (size_t i = 1; i <= workers.size(); i++)
+      {
+        size_t victim = (self + i) % workers.size();
+        if (static_cast<int>(victim) != self && take(workerQueues[victim], false))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    bool TryRunOne(bool allowLow)
+    {
+      Job job;
+      for (size_t priority = 0; priority < PRIORITY_COUNT; priority++)
+      {
+        const bool low = priority == static_cast<size_t>(JobPriority::LOW);
+        if (low)
+        {
+          // reserve a slot first so the cap can't be overshot
+          if (!allowLow || lowRunning.fetch_add(1, std::memory_order_acq_rel) >= maxLowRunning)
+          {
+            if (allowLow)
+            {
+              lowRunning.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            return false;
+          }
+        }
+
+        if (TryPop(priority, job))
+        {
+          Execute(job);
+          if (low)
+          {
+            lowRunning.fetch_sub(1, std::memory_order_acq_rel);
+            Wake();
+          }
+          return true;
+        }
+
+        if (low)
+        {
+          lowRunning.fetch_sub(1, std::memory_order_acq_rel);
+        }
+      }
+      return false;
+    }
+
+    bool RunMainJobs()
+    {
+      std::vector<Job> jobs;
+      {
+        std::lock_guard lck(mainMutex);
+        std::swap(jobs, mainJobs);
+        hasMainJobs.store(false, std::memory_order_relaxed);
+      }
+      for (auto& job : jobs)
+      {
+        Execute(job);
+      }
+      return !jobs.empty();
+    }
+
+    void Execute(Job& job)
+    {
+      auto hook = traceHook.load(std::memory_order_relaxed);
+      if (hook)
+      {
+        hook(job.name, true);
+      }
+      job.fn();
+      if (hook)
+      {
+        hook(job.name, false);
+      }
+      Finish(job.counter);
+    }
+
+    void Finish(JobCounter* counter);
+
+    void WorkerLoop(int index)
+    {
+      tWorkerIndex = index;
+      Profiler::Get()->SetThreadName(fmt::format("Worker {}", index));
+      while (true)
+      {
+        if (TryRunOne(true))
+        {
+          continue;
+        }
+
+        std::unique_lock lck(sleepMutex);
+        wake.wait(lck, [this] { return stopping || HasRunnable(); });
+        if (stopping)
+        {
+          return;
+        }
+      }
+    }
+  };
+
+  JobSystem* JobSystem::Get()
+  {
+    static JobSystem jobSystem;
+    return &jobSystem;
+  }
+
+  JobSystem::JobSystem()
+  {
+    data = new JobSystemData;
+    data->mainThread = std::this_thread::get_id();
+
+    // the main thread is the remaining core, and helps whenever it waits
+    // hardware_concurrency() may return 0 if it can't tell
+    // LOW jobs must leave a worker free, so machines with fewer than 3 cores get an extra worker
+    const uint32_t workerCount = std::max(3u, std::thread::hardware_concurrency()) - 1;
+    data->maxLowRunning = workerCount - 1;
+    data->workerQueues = std::make_unique<JobQueue[]>(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+      data->workers.emplace_back([this, i] { data->WorkerLoop(static_cast<int>(i)); });
+    }
+  }
+
+  JobSystem::~JobSystem()
+  {
+    {
+      std::lock_guard lck(data->sleepMutex);
+      data->stopping = true;
+    }
+    data->wake.notify_all();
+    for (auto& worker : data->workers)
+    {
+      worker.join();
+    }
+    delete data;
+  }
+
+  void JobSystemData::Finish(JobCounter* counter)
+  {
+    if (!counter)
+    {
+      return;
+    }
+
+    // decremented under the lock so a waiter can't destroy the counter while it's still in use here
+    std::vector<JobCounter::Continuation> continuations;
+    {
+      std::lock_guard lck(counter->mutex_);
+      if (counter->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      {
+        return;
+      }
+      std::swap(continuations, counter->continuations_);
+    }
+
+    for (auto& continuation : continuations)
+    {
+      Push({ std::move(continuation.job), continuation.counter, continuation.priority, continuation.name });
+    }
+    WakeWaiters();
+  }
+
+  void JobSystem::Submit(std::function<void()> job, JobCounter* counter, JobPriority priority, const char* name)
+  {
+    if (counter)
+    {
+      counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    data->Push({ std::move(job), counter, priority, name });
+  }
+
+  void JobSystem::SubmitMainThread(std::function<void()> job, JobCounter* counter, const char* name)
+  {
+    if (counter)
+    {
+      counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+      std::lock_guard lck(data->mainMutex);
+      data->mainJobs.push_back({ std::move(job), counter, JobPriority::HIGH, name });
+      data->hasMainJobs.store(true, std::memory_order_relaxed);
+    }
+    data->WakeWaiters();
+  }
+
+  void JobSystem::Continue(JobCounter& dependency, std::function<void()> job, JobCounter* counter, JobPriority priority, const char* name)
+  {
+    if (counter)
+    {
+      counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+      std::lock_guard lck(dependency.mutex_);
+      if (!dependency.IsDone())
+      {
+        dependency.continuations_.push_back({ std::move(job), counter, priority, name });
+        return;
+      }
+    }
+    data->Push({ std::move(job), counter, priority, name });
+  }
+
+  void JobSystem::Wait(JobCounter& counter)
+  {
+    const bool mainThread = IsMainThread();
+    uint32_t idle = 0;
+    while (!counter.IsDone())
+    {
+      // long background jobs are left to the workers so waiting never takes longer than it has to
+      if (data->TryRunOne(false) || (mainThread && data->RunMainJobs()))
+      {
+        idle = 0;
+        continue;
+      }
+
+      if (++idle < WAIT_SPIN_COUNT)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+
+      // the remaining jobs are running elsewhere, so sleep instead of taking a core from them
+      std::unique_lock lck(data->sleepMutex);
+      data->sleepingWaiters++;
+      data->waiterWake.wait(lck, [&]
+        {
+          return counter.IsDone() || data->HasUrgent() || (mainThread && data->hasMainJobs.load(std::memory_order_relaxed));
+        });
+      data->sleepingWaiters--;
+      idle = 0;
+    }
+
+    // the last job to finish may still hold the lock
+    std::lock_guard lck(counter.mutex_);
+  }
+
+  void JobSystem::RunMainThreadJobs()
+  {
+    ASSERT(IsMainThread());
+    data->RunMainJobs();
+  }
+
+  uint32_t JobSystem::GetWorkerCount() const
+  {
+    return static_cast<uint32_t>(data->workers.size());
+  }
+
+  bool JobSystem::IsMainThread() const
+  {
+    return std::this_thread::get_id() == data->mainThread;
+  }
+
+  void JobSystem::SetTraceHook(JobTraceHook hook)
+  {
+    data->traceHook.store(hook, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace engine::Core
+{
+  // higher priority jobs are always taken first. LOW is for long running background work (meshing,
+  // collider cooking, pathfinding), which never runs on a thread that is waiting on a counter and is
+  // kept off at least one worker so frame work is never stuck behind it
+  enum class JobPriority : uint8_t
+  {
+    HIGH,
+    NORMAL,
+    LOW,
+
+    COUNT
+  };
+
+  // counts unfinished jobs. continuations attached with JobSystem::Continue are submitted once it reaches zero
+  class JobCounter
+  {
+  public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool IsDone() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+    friend struct JobSystemData;
+
+    struct Continuation
+    {
+      std::function<void()> job;
+      JobCounter* counter;
+      JobPriority priority;
+      const char* name;
+    };
+
+    std::atomic_uint32_t pending_{ 0 };
+    std::mutex mutex_;
+    std::vector<Continuation> continuations_;
+  };
+
+  // called when a job starts and finishes, on the thread running it
+  using JobTraceHook = void(*)(const char* name, bool begin);
+
+  // One worker per core, minus the main thread, but at least two. Each worker has a deque per priority that
+  // it pushes to and pops from the back of, while idle workers steal from the front. Jobs submitted from
+  // threads that aren't workers go to a shared queue.
+  // Waiting on a counter runs other jobs until it reaches zero, so jobs may wait on jobs they submit.
+  // When there is nothing it can run, it yields briefly and then sleeps until the counter or a new job wakes it.
+  class JobSystem
+  {
+  public:
+    static JobSystem* Get();
+
+    void Submit(std::function<void()> job, JobCounter* counter = nullptr, JobPriority priority = JobPriority::NORMAL, const char* name = "Job");
+
+    // for jobs that use the GL context or ImGui. they run in RunMainThreadJobs, or while the main thread waits
+    void SubmitMainThread(std::function<void()> job, JobCounter* counter = nullptr, const char* name = "Job");
+
+    // submits job once every job counted by dependency has finished
+    void Continue(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr, JobPriority priority = JobPriority::NORMAL, const char* name = "Job");
+
+    void Wait(JobCounter& counter);
+    void RunMainThreadJobs();
+
+    // calls fn on every element of [first, last), split into jobs of at least grain elements, and waits for them
+    template<typename It, typename Fn>
+    void ForEach(It first, It last, Fn&& fn, size_t grain = 0);
+
+    uint32_t GetWorkerCount() const;
+    bool IsMainThread() const;
+
+    void SetTraceHook(JobTraceHook hook);
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem(JobSystem&&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    JobSystem& operator=(JobSystem&&) = delete;
+
+  private:
+    JobSystem();
+    ~JobSystem();
+
+    struct JobSystemData* data{};
+  };
+
+  template<typename It, typename Fn>
+  void JobSystem::ForEach(It first, It last, Fn&& fn, size_t grain)
+  {
+    const size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count == 0)
+    {
+      return;
+    }
+
+    // a few jobs per thread evens out uneven elements
+    if (grain == 0)
+    {
+      grain = std::max<size_t>(1, count / ((GetWorkerCount() + 1) * 4));
+    }
+
+    if (count <= grain)
+    {
+      for (; first != last; ++first)
+      {
+        fn(*first);
+      }
+      return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+      const size_t n = std::min(grain, count - begin);
+      Submit([&fn, it = first, n]() mutable
+        {
+          for (size_t i = 0; i < n; i++, ++it)
+          {
+            fn(*it);
+          }
+        }, &counter, JobPriority::HIGH, "ForEach");
+      std::advance(first, n);
+    }
+    Wait(counter);
+  }
+}
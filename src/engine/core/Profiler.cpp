@@ -0,0 +1,348 @@
+#include "../PCH.h"
+#include "Profiler.h"
+#include "../Console.h"
+#include "../Parser.h"
+
+#include <spdlog/fmt/chrono.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+namespace engine::Core
+{
+  namespace
+  {
+    // per thread. must be a power of two
+    constexpr uint64_t EVENT_CAPACITY = 1 << 16;
+
+    // when a buffer has wrapped, its oldest slots may be mid-write by a zone that ended while the capture stopped
+    constexpr uint64_t WRAP_SLACK = 256;
+
+    constexpr uint32_t MAX_ZONE_DEPTH = 64;
+
+    // a zone that outlives this many frames after the capture stops is not waited for. each thread
+    // can then still push one event per open zone, plus a counter, which the slack makes room for
+    constexpr uint32_t SAVE_WAIT_FRAMES = 30;
+    static_assert(WRAP_SLACK > MAX_ZONE_DEPTH + 1);
+
+    enum class EventType : uint8_t
+    {
+      ZONE,
+      COUNTER,
+      FRAME,
+    };
+
+    struct Event
+    {
+      const char* name;
+      uint64_t start_ns;
+      uint64_t duration_ns;
+      double value;
+      EventType type;
+    };
+
+    // written only by its thread, read by the main thread once the capture has stopped and its zones have ended
+    struct ThreadBuffer
+    {
+      uint32_t id{};
+      std::string name;
+      std::unique_ptr<Event[]> events;
+      std::atomic_uint64_t head{ 0 };
+    };
+
+    struct OpenZone
+    {
+      const char* name;
+      uint64_t start_ns;
+      bool recorded;
+    };
+
+    struct ZoneStack
+    {
+      OpenZone zones[MAX_ZONE_DEPTH];
+      uint32_t depth = 0;
+    };
+
+    thread_local ThreadBuffer* tBuffer = nullptr;
+    thread_local ZoneStack tZones;
+
+    const auto gEpoch = std::chrono::steady_clock::now();
+
+    uint64_t Now()
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gEpoch).count();
+    }
+
+    // names are usually identifiers, but the output must stay valid json either way
+    void AppendEscaped(std::string& out, const char* str)
+    {
+      for (; *str; str++)
+      {
+        if (*str == '"' || *str == '\\')
+        {
+          out += '\\';
+        }
+        if (static_cast<unsigned char>(*str) >= 0x20)
+        {
+          out += *str;
+        }
+      }
+    }
+  }
+
+  struct ProfilerData
+  {
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads;
+
+    // a capture starts on the frame after it is requested
+    uint32_t requestedFrames = 0;
+    uint32_t framesLeft = 0;
+    uint64_t captureStart_ns = 0;
+    std::string path;
+
+    // recorded zones that haven't ended. the capture is saved once this reaches zero
+    std::atomic_uint32_t openZones{ 0 };
+    bool savePending = false;
+    uint32_t saveWaitFrames = 0;
+
+    ThreadBuffer& GetThreadBuffer()
+    {
+      if (!tBuffer)
+      {
+        std::lock_guard lck(threadsMutex);
+        auto& buffer = threads.emplace_back(std::make_unique<ThreadBuffer>());
+        buffer->id = static_cast<uint32_t>(threads.size());
+        buffer->name = fmt::format("Thread {}", buffer->id);
+        tBuffer = buffer.get();
+      }
+      return *tBuffer;
+    }
+
+    void Push(const Event& event)
+    {
+      auto& buffer = GetThreadBuffer();
+      if (!buffer.events)
+      {
+        buffer.events = std::make_unique<Event[]>(EVENT_CAPACITY);
+      }
+
+      const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+      buffer.events[head & (EVENT_CAPACITY - 1)] = event;
+      buffer.head.store(head + 1, std::memory_order_release);
+    }
+  };
+
+  Profiler* Profiler::Get()
+  {
+    static Profiler profiler;
+    return &profiler;
+  }
+
+  Profiler::Profiler()
+  {
+    data = new ProfilerData;
+
+    Console::Get()->RegisterCommand("profile",
+      "- Records frames and saves them as a Chrome trace. Usage: profile <frames = 60> <path>",
+      [this](const char* args)
+      {
+        CmdParser parser(args);
+        uint32_t frames = 60;
+        std::string path = fmt::format("logs/Profile {:%Y-%m-%d %H-%M-%S}.json", std::chrono::system_clock::now());
+        if (parser.Valid())
+        {
+          auto atom = parser.NextAtom();
+          if (cvar_float* val = std::get_if<cvar_float>(&atom); val && *val >= 1)
+          {
+            frames = static_cast<uint32_t>(*val);
+          }
+          else
+          {
+            Console::Get()->Log("Usage: profile <frames = 60> <path>");
+            return;
+          }
+        }
+        if (parser.Valid())
+        {
+          auto atom = parser.NextAtom();
+          if (auto* str = std::get_if<std::string>(&atom))
+            path = *str;
+          else if (auto* identifier = std::get_if<Identifier>(&atom))
+            path = identifier->name;
+        }
+        Capture(frames, std::move(path));
+      });
+  }
+
+  Profiler::~Profiler()
+  {
+    detail::gProfilerRecording.store(false, std::memory_order_relaxed);
+    delete data;
+  }
+
+  void Profiler::Capture(uint32_t frames, std::string path)
+  {
+    ASSERT(frames > 0);
+    if (IsRecording() || data->requestedFrames > 0 || data->savePending)
+    {
+      spdlog::warn("A profile is already being captured");
+      return;
+    }
+
+    data->requestedFrames = frames;
+    data->path = std::move(path);
+  }
+
+  void Profiler::MarkFrame()
+  {
+    if (IsRecording())
+    {
+      data->Push({ .name = "Frame", .start_ns = Now(), .type = EventType::FRAME });
+      if (--data->framesLeft == 0)
+      {
+        // seq_cst pairs with BeginZone, so a zone either sees the capture stopped or is counted here
+        detail::gProfilerRecording.store(false, std::memory_order_seq_cst);
+        data->savePending = true;
+        data->saveWaitFrames = SAVE_WAIT_FRAMES;
+      }
+    }
+    else if (data->requestedFrames > 0)
+    {
+      data->framesLeft = std::exchange(data->requestedFrames, 0);
+      data->captureStart_ns = Now();
+      detail::gProfilerRecording.store(true, std::memory_order_relaxed);
+      data->Push({ .name = "Frame", .start_ns = data->captureStart_ns, .type = EventType::FRAME });
+    }
+
+    // zones still open on other threads would push while the buffers are read
+    if (data->savePending && (data->openZones.load(std::memory_order_seq_cst) == 0 || --data->saveWaitFrames == 0))
+    {
+      data->savePending = false;
+      save();
+    }
+  }
+
+  void Profiler::SetThreadName(std::string name)
+  {
+    auto& buffer = data->GetThreadBuffer();
+    std::lock_guard lck(data->threadsMutex);
+    buffer.name = std::move(name);
+  }
+
+  void Profiler::BeginZone(const char* name)
+  {
+    auto& stack = tZones;
+    ASSERT_MSG(stack.depth < MAX_ZONE_DEPTH, "Profiler zones are nested too deeply");
+    bool recorded = IsRecording();
+    if (recorded)
+    {
+      data->openZones.fetch_add(1, std::memory_order_seq_cst);
+      if (!detail::gProfilerRecording.load(std::memory_order_seq_cst))
+      {
+        data->openZones.fetch_sub(1, std::memory_order_relaxed);
+        recorded = false;
+      }
+    }
+    stack.zones[stack.depth++] = { name, recorded ? Now() : 0, recorded };
+  }
+
+  void Profiler::EndZone()
+  {
+    auto& stack = tZones;
+    ASSERT_MSG(stack.depth > 0, "Profiler zone ended without beginning");
+    const auto& zone = stack.zones[--stack.depth];
+    if (zone.recorded)
+    {
+      data->Push({ .name = zone.name, .start_ns = zone.start_ns, .duration_ns = Now() - zone.start_ns, .type = EventType::ZONE });
+      data->openZones.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void Profiler::Counter(const char* name, double value)
+  {
+    if (IsRecording())
+    {
+      data->Push({ .name = name, .start_ns = Now(), .value = value, .type = EventType::COUNTER });
+    }
+  }
+
+  void Profiler::TraceJob(const char* name, bool begin)
+  {
+    // balanced even when a capture starts or stops while the job runs
+    if (begin)
+      Get()->BeginZone(name);
+    else
+      Get()->EndZone();
+  }
+
+  void Profiler::save()
+  {
+    std::string out;
+    out.reserve(1 << 20);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"VoxelEngine\"}}";
+
+    size_t eventCount = 0;
+    size_t lostThreads = 0;
+    std::lock_guard lck(data->threadsMutex);
+    for (const auto& buffer : data->threads)
+    {
+      out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+      out += fmt::format("{},\"args\":{{\"name\":\"", buffer->id);
+      AppendEscaped(out, buffer->name.c_str());
+      out += "\"}}";
+
+      const uint64_t head = buffer->head.load(std::memory_order_acquire);
+      uint64_t first = 0;
+      if (head > EVENT_CAPACITY)
+      {
+        first = head - EVENT_CAPACITY + WRAP_SLACK;
+      }
+
+      bool lost = first > 0;
+      for (uint64_t i = first; i < head; i++)
+      {
+        const Event& event = buffer->events[i & (EVENT_CAPACITY - 1)];
+        if (event.start_ns < data->captureStart_ns)
+        {
+          lost = false;
+          continue;
+        }
+
+        const double ts = (event.start_ns - data->captureStart_ns) / 1000.0;
+        out += ",\n{\"name\":\"";
+        AppendEscaped(out, event.name);
+        switch (event.type)
+        {
+        case EventType::ZONE:
+          out += fmt::format("\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}", ts, event.duration_ns / 1000.0, buffer->id);
+          break;
+        case EventType::COUNTER:
+          out += fmt::format("\",\"ph\":\"C\",\"ts\":{:.3f},\"pid\":1,\"tid\":{},\"args\":{{\"value\":{}}}}}", ts, buffer->id, event.value);
+          break;
+        case EventType::FRAME:
+          out += fmt::format("\",\"ph\":\"i\",\"s\":\"g\",\"ts\":{:.3f},\"pid\":1,\"tid\":{}}}", ts, buffer->id);
+          break;
+        }
+        eventCount++;
+      }
+      lostThreads += lost;
+    }
+    out += "\n]}\n";
+
+    std::ofstream file(data->path, std::ios::binary);
+    if (!file)
+    {
+      spdlog::error("Failed to open {} to save the profile", data->path);
+      return;
+    }
+    file.write(out.data(), out.size());
+
+    spdlog::info("Saved {} profiler events to {}", eventCount, data->path);
+    if (lostThreads > 0)
+    {
+      spdlog::warn("{} threads recorded more than {} events, so the start of the profile is missing for them", lostThreads, EVENT_CAPACITY);
+    }
+  }
+}
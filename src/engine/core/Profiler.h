@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace engine::Core
+{
+  namespace detail
+  {
+    // checked by every zone before it does any work
+    inline std::atomic_bool gProfilerRecording{ false };
+  }
+
+  // Records zones, counters and frame markers while a capture is running, then saves them as a Chrome trace
+  // (open in chrome://tracing or ui.perfetto.dev).
+  // Each thread writes to its own ring buffer, so recording never locks. When a capture outlives a
+  // thread's buffer, the oldest events of that thread are lost.
+  // Once the last frame is recorded, saving waits for zones that are still open on other threads to end,
+  // so they don't write to a buffer while it is read. A zone that is still open after a few frames is not
+  // waited for, and is missing from the trace.
+  // Names must be string literals (or otherwise outlive the capture), as only the pointer is stored.
+  class Profiler
+  {
+  public:
+    static Profiler* Get();
+
+    // records the next frames, then writes them to path
+    void Capture(uint32_t frames, std::string path);
+    bool IsRecording() const { return detail::gProfilerRecording.load(std::memory_order_relaxed); }
+
+    // called by the main thread at the start of every frame
+    void MarkFrame();
+
+    // the name the calling thread is shown under
+    void SetThreadName(std::string name);
+
+    // zones on a thread must end in the opposite order they began
+    void BeginZone(const char* name);
+    void EndZone();
+    void Counter(const char* name, double value);
+
+    // matches JobTraceHook, so that every job shows up as a zone
+    static void TraceJob(const char* name, bool begin);
+
+    Profiler(const Profiler&) = delete;
+    Profiler(Profiler&&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+    Profiler& operator=(Profiler&&) = delete;
+
+  private:
+    Profiler();
+    ~Profiler();
+
+    void save();
+
+    struct ProfilerData* data{};
+  };
+
+  class ProfileZone
+  {
+  public:
+    ProfileZone(const char* name)
+    {
+      if (detail::gProfilerRecording.load(std::memory_order_relaxed))
+      {
+        Profiler::Get()->BeginZone(name);
+        began_ = true;
+      }
+    }
+
+    ~ProfileZone()
+    {
+      if (began_)
+      {
+        Profiler::Get()->EndZone();
+      }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+  private:
+    bool began_ = false;
+  };
+}
+
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CONCAT_INNER(a, b) a ## b
+
+#define PROFILE_SCOPE(name) \
+  engine::Core::ProfileZone PROFILE_CONCAT(profile_zone, __LINE__)(name)
+
+#define PROFILE_COUNTER(name, value) \
+  do \
+  { \
+    if (engine::Core::detail::gProfilerRecording.load(std::memory_order_relaxed)) \
+      engine::Core::Profiler::Get()->Counter(name, static_cast<double>(value)); \
+  } while(0)
@@ -1,18 +1,31 @@
 #pragma once
 #include <engine/gfx/api/Fence.h>
 #include <engine/core/Statistics.h>
+#include <engine/core/Profiler.h>
 #include <utility/Timer.h>
 #include <utility/Defer.h>
 
 #define SM_CONCAT(a, b) SM_CONCAT_INNER(a, b)
 #define SM_CONCAT_INNER(a, b) a ## b
 
+// declares a handle named sm_stat_<statID>, which the other macros in the same file use
 #define DECLARE_FLOAT_STAT(statID, statGroup) \
-  static void* SM_CONCAT(sm_float_stat_helper, __LINE__) = []() \
-  { \
-    engine::Core::StatisticsManager::Get()->RegisterFloatStat(#statID, #statGroup); \
-    return nullptr; \
-  }();
+  static const engine::Core::StatHandle SM_CONCAT(sm_stat_, statID) = \
+    engine::Core::StatisticsManager::Get()->RegisterFloatStat(#statID, #statGroup);
+
+#define DECLARE_COUNTER_STAT(statID, statGroup) \
+  static const engine::Core::StatHandle SM_CONCAT(sm_stat_, statID) = \
+    engine::Core::StatisticsManager::Get()->RegisterCounter(#statID, #statGroup);
+
+#define DECLARE_GAUGE_STAT(statID, statGroup) \
+  static const engine::Core::StatHandle SM_CONCAT(sm_stat_, statID) = \
+    engine::Core::StatisticsManager::Get()->RegisterGauge(#statID, #statGroup);
+
+#define ADD_COUNTER_STAT(statID, delta) \
+  engine::Core::StatisticsManager::Get()->AddCounter(SM_CONCAT(sm_stat_, statID), static_cast<int64_t>(delta))
+
+#define SET_GAUGE_STAT(statID, val) \
+  engine::Core::StatisticsManager::Get()->SetGauge(SM_CONCAT(sm_stat_, statID), static_cast<int64_t>(val))
 
 #define MEASURE_GPU_TIMER_STAT(name) \
   static GFX::TimerQueryAsync SM_CONCAT(sm_timer, __LINE__) (5); \
@@ -23,7 +36,7 @@
       if (SM_CONCAT(sm_result, __LINE__)) \
       { \
         double SM_CONCAT(sm_time, __LINE__) = (double)*SM_CONCAT(sm_result, __LINE__) / 1000000.0; \
-        engine::Core::StatisticsManager::Get()->PushFloatStatValue(#name, SM_CONCAT(sm_time, __LINE__)); \
+        engine::Core::StatisticsManager::Get()->PushFloatStatValue(SM_CONCAT(sm_stat_, name), SM_CONCAT(sm_time, __LINE__)); \
         /*printf(#name ": %f\n", SM_CONCAT(sm_time, __LINE__));*/ \
       } \
   } while(0)
@@ -33,14 +46,14 @@
   Defer SM_CONCAT(sm_defer, __LINE__)([&SM_CONCAT(sm_timer, __LINE__)]() \
   { \
     double SM_CONCAT(sm_time, __LINE__) = (double)SM_CONCAT(sm_timer, __LINE__).Elapsed_ns() / 1000000.0; \
-    engine::Core::StatisticsManager::Get()->PushFloatStatValue(#name, SM_CONCAT(sm_time, __LINE__)); \
+    engine::Core::StatisticsManager::Get()->PushFloatStatValue(SM_CONCAT(sm_stat_, name), SM_CONCAT(sm_time, __LINE__)); \
     /*printf(#name ": %f\n", SM_CONCAT(sm_time, __LINE__));*/ \
   })
 
 #define MEASURE_CPU_TIMER_STAT(name) \
-  static Timer SM_CONCAT(sm_timer, __LINE__); \
-  SM_CONCAT(sm_timer, __LINE__).Reset(); \
-  Defer SM_CONCAT(sm_defer, __LINE__)([]() \
+  engine::Core::ProfileZone SM_CONCAT(sm_zone, __LINE__)(#name); \
+  Timer SM_CONCAT(sm_timer, __LINE__); \
+  Defer SM_CONCAT(sm_defer, __LINE__)([&SM_CONCAT(sm_timer, __LINE__)]() \
   { \
-    engine::Core::StatisticsManager::Get()->PushFloatStatValue(#name, SM_CONCAT(sm_timer, __LINE__).Elapsed_ms()); \
+    engine::Core::StatisticsManager::Get()->PushFloatStatValue(SM_CONCAT(sm_stat_, name), SM_CONCAT(sm_timer, __LINE__).Elapsed_ms()); \
   })
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "../PCH.h"
 #include "Statistics.h"
 #include "StatMacros.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
 #include <unordered_map>
 #include <imgui/imgui.h>
 
@@ -8,11 +12,147 @@ DECLARE_FLOAT_STAT(DrawStatisticsUI, CPU)
 
 namespace engine::Core
 {
-  using FloatStatPayload = std::pair<hashed_string, StatBuffer<float, STATISTICS_BUFFER_SIZE>>;
+  namespace
+  {
+    // log-linear buckets: each power of two from 2^MIN_EXPONENT up to 2^MAX_EXPONENT is split into
+    // SUB_BUCKETS equal parts. bucket 0 holds everything smaller, and the last bucket everything bigger
+    constexpr int MIN_EXPONENT = -15;
+    constexpr int MAX_EXPONENT = 32;
+    constexpr int SUB_BUCKETS = 8;
+    constexpr size_t BUCKET_COUNT = 1 + (MAX_EXPONENT - MIN_EXPONENT + 1) * SUB_BUCKETS;
+
+    size_t BucketIndex(float val)
+    {
+      int exponent;
+      const double mantissa = std::frexp(static_cast<double>(val), &exponent); // val = mantissa * 2^exponent, mantissa in [0.5, 1)
+      if (!(val > 0) || exponent < MIN_EXPONENT)
+      {
+        return 0;
+      }
+      if (exponent > MAX_EXPONENT)
+      {
+        return BUCKET_COUNT - 1;
+      }
+      const int sub = std::min(static_cast<int>((mantissa - 0.5) * 2 * SUB_BUCKETS), SUB_BUCKETS - 1);
+      return 1 + static_cast<size_t>(exponent - MIN_EXPONENT) * SUB_BUCKETS + sub;
+    }
+
+    double BucketUpperBound(size_t index)
+    {
+      if (index == 0)
+      {
+        return std::ldexp(0.5, MIN_EXPONENT);
+      }
+      const int exponent = static_cast<int>((index - 1) / SUB_BUCKETS) + MIN_EXPONENT;
+      const int sub = static_cast<int>((index - 1) % SUB_BUCKETS);
+      return std::ldexp(0.5 + 0.5 * (sub + 1) / SUB_BUCKETS, exponent);
+    }
+
+    struct StatSlot
+    {
+      hashed_string name;
+      hashed_string group;
+      StatKind kind{};
+
+      std::atomic_uint64_t count{ 0 };
+      std::atomic<double> sum{ 0 };
+      std::atomic<float> max{ 0 };
+      std::atomic<float> windowMax{ 0 }; // reset by the UI every window
+      std::atomic_int64_t value{ 0 };
+      std::atomic_uint32_t buckets[BUCKET_COUNT]{};
+    };
+
+    // what the UI last saw of a stat. only touched by the thread drawing it
+    struct StatWindow
+    {
+      uint32_t buckets[BUCKET_COUNT]{};
+      uint64_t count{};
+      double sum{};
+      int64_t value{};
+
+      StatSummary summary{};
+      double rate{}; // counter change per second
+    };
+
+    void AtomicMax(std::atomic<float>& max, float val)
+    {
+      float prev = max.load(std::memory_order_relaxed);
+      while (val > prev && !max.compare_exchange_weak(prev, val, std::memory_order_relaxed))
+      {
+      }
+    }
+
+    template<typename Bucket>
+    StatSummary Summarize(const Bucket* buckets, uint64_t count, double sum, double max)
+    {
+      StatSummary summary{ .count = count, .max = max };
+      if (count == 0)
+      {
+        return summary;
+      }
+
+      summary.mean = sum / count;
+      const uint64_t ranks[] = { (count + 1) / 2, (count * 95 + 99) / 100, (count * 99 + 99) / 100 };
+      double* percentiles[] = { &summary.p50, &summary.p95, &summary.p99 };
+
+      uint64_t seen = 0;
+      size_t next = 0;
+      for (size_t i = 0; i < BUCKET_COUNT && next < std::size(ranks); i++)
+      {
+        seen += buckets[i];
+        while (next < std::size(ranks) && seen >= ranks[next])
+        {
+          *percentiles[next++] = std::min(BucketUpperBound(i), max);
+        }
+      }
+      return summary;
+    }
+  }
 
   struct StatisticsManagerData
   {
-    std::unordered_map<hashed_string, FloatStatPayload> floatStats;
+    std::unique_ptr<StatSlot[]> slots = std::make_unique<StatSlot[]>(MAX_STATS);
+    std::atomic_uint32_t slotCount{ 0 };
+
+    std::mutex registerMutex;
+    std::unordered_map<hashed_string, uint32_t> indices;
+
+    std::unique_ptr<StatWindow[]> windows = std::make_unique<StatWindow[]>(MAX_STATS);
+    Timer windowTimer;
+
+    StatSlot& Slot(StatHandle stat)
+    {
+      ASSERT_MSG(stat.index < slotCount.load(std::memory_order_relaxed), "Invalid stat handle");
+      return slots[stat.index];
+    }
+
+    void RollWindow(double seconds)
+    {
+      const uint32_t count = slotCount.load(std::memory_order_acquire);
+      for (uint32_t i = 0; i < count; i++)
+      {
+        StatSlot& slot = slots[i];
+        StatWindow& window = windows[i];
+
+        // samples pushed while this runs land in this window or the next, but are never lost
+        const uint64_t totalCount = slot.count.load(std::memory_order_relaxed);
+        const double totalSum = slot.sum.load(std::memory_order_relaxed);
+        const int64_t totalValue = slot.value.load(std::memory_order_relaxed);
+        uint32_t buckets[BUCKET_COUNT];
+        for (size_t b = 0; b < BUCKET_COUNT; b++)
+        {
+          const uint32_t total = slot.buckets[b].load(std::memory_order_relaxed);
+          buckets[b] = total - window.buckets[b];
+          window.buckets[b] = total;
+        }
+
+        window.summary = Summarize(buckets, totalCount - window.count, totalSum - window.sum, slot.windowMax.exchange(0, std::memory_order_relaxed));
+        window.rate = (totalValue - window.value) / seconds;
+        window.count = totalCount;
+        window.sum = totalSum;
+        window.value = totalValue;
+      }
+    }
   };
 
   StatisticsManager* StatisticsManager::Get()
@@ -31,70 +171,149 @@ namespace engine::Core
     delete data;
   }
 
-  void StatisticsManager::RegisterFloatStat(hashed_string statName, hashed_string groupName)
+  StatHandle StatisticsManager::RegisterFloatStat(hashed_string statName, hashed_string groupName)
+  {
+    return registerStat(statName, groupName, StatKind::FLOAT);
+  }
+
+  StatHandle StatisticsManager::RegisterCounter(hashed_string statName, hashed_string groupName)
   {
-    ASSERT(!data->floatStats.contains(statName));
-    data->floatStats[statName] = std::make_pair(groupName, StatBuffer<float, STATISTICS_BUFFER_SIZE>());
+    return registerStat(statName, groupName, StatKind::COUNTER);
   }
 
-  void StatisticsManager::PushFloatStatValue(hashed_string statName, float val)
+  StatHandle StatisticsManager::RegisterGauge(hashed_string statName, hashed_string groupName)
   {
-    ASSERT(data->floatStats.contains(statName));
-    data->floatStats[statName].second.Push(val);
+    return registerStat(statName, groupName, StatKind::GAUGE);
   }
 
-  const StatBuffer<float, STATISTICS_BUFFER_SIZE>& StatisticsManager::GetFloatStat(hashed_string statName)
+  StatHandle StatisticsManager::registerStat(hashed_string statName, hashed_string groupName, StatKind kind)
   {
-    ASSERT(data->floatStats.contains(statName));
-    return data->floatStats[statName].second;
+    std::lock_guard lck(data->registerMutex);
+    ASSERT(!data->indices.contains(statName));
+    const uint32_t index = data->slotCount.load(std::memory_order_relaxed);
+    ASSERT_MSG(index < MAX_STATS, "Too many stats have been registered");
+
+    StatSlot& slot = data->slots[index];
+    slot.name = statName;
+    slot.group = groupName;
+    slot.kind = kind;
+    data->indices[statName] = index;
+    data->slotCount.store(index + 1, std::memory_order_release);
+    return { index };
+  }
+
+  StatHandle StatisticsManager::FindStat(hashed_string statName)
+  {
+    std::lock_guard lck(data->registerMutex);
+    if (auto it = data->indices.find(statName); it != data->indices.end())
+    {
+      return { it->second };
+    }
+    return {};
+  }
+
+  void StatisticsManager::PushFloatStatValue(StatHandle stat, float val)
+  {
+    StatSlot& slot = data->Slot(stat);
+    ASSERT(slot.kind == StatKind::FLOAT);
+    slot.buckets[BucketIndex(val)].fetch_add(1, std::memory_order_relaxed);
+    slot.sum.fetch_add(val, std::memory_order_relaxed);
+    slot.count.fetch_add(1, std::memory_order_relaxed);
+    AtomicMax(slot.max, val);
+    AtomicMax(slot.windowMax, val);
+  }
+
+  void StatisticsManager::AddCounter(StatHandle stat, int64_t delta)
+  {
+    StatSlot& slot = data->Slot(stat);
+    ASSERT(slot.kind == StatKind::COUNTER);
+    slot.value.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  void StatisticsManager::SetGauge(StatHandle stat, int64_t val)
+  {
+    StatSlot& slot = data->Slot(stat);
+    ASSERT(slot.kind == StatKind::GAUGE);
+    slot.value.store(val, std::memory_order_relaxed);
+    AtomicMax(slot.windowMax, static_cast<float>(val));
+  }
+
+  StatSummary StatisticsManager::GetFloatStat(StatHandle stat)
+  {
+    StatSlot& slot = data->Slot(stat);
+    ASSERT(slot.kind == StatKind::FLOAT);
+    uint32_t buckets[BUCKET_COUNT];
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+      buckets[i] = slot.buckets[i].load(std::memory_order_relaxed);
+    }
+    return Summarize(buckets, slot.count.load(std::memory_order_relaxed), slot.sum.load(std::memory_order_relaxed), slot.max.load(std::memory_order_relaxed));
+  }
+
+  int64_t StatisticsManager::GetValue(StatHandle stat)
+  {
+    return data->Slot(stat).value.load(std::memory_order_relaxed);
   }
 
   void StatisticsManager::DrawUI()
   {
     MEASURE_CPU_TIMER_STAT(DrawStatisticsUI);
 
+    if (const double seconds = data->windowTimer.Elapsed(); seconds >= STATISTICS_WINDOW_SECONDS)
+    {
+      data->RollWindow(seconds);
+      data->windowTimer.Reset();
+    }
+
     if (!ImGui::Begin("Statistics"))
     {
       ImGui::End();
       return;
     }
 
+    ImGui::Text("Over the last %.0f seconds", STATISTICS_WINDOW_SECONDS);
     ImGui::Indent();
-    ImGui::Text("%-20s: %-10s%-10s%-10s%-10s", "Stat Name", "Average", "Variance", "Min", "Max");
+    ImGui::Text("%-20s: %-10s%-10s%-10s%-10s%-10s", "Stat Name", "Mean", "p50", "p95", "p99", "Max");
     ImGui::Unindent();
 
     // key: group name
-    // value: pair containing <stat name, pointer to stat buffer>
-    // IMPORTANT: the group name and stat names are swapped compared to that in `floatStats`
-    struct StatBufValues
-    {
-      double mean{};
-      double variance{};
-      double min{};
-      double max{};
-    };
-
-    std::unordered_map<hashed_string, std::vector<std::pair<hashed_string, StatBufValues>>> groupNameToFloatStat;
-    for (auto& [statName, pair] : data->floatStats)
+    // value: indices of the group's stats
+    std::unordered_map<hashed_string, std::vector<uint32_t>> groups;
+    const uint32_t count = data->slotCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++)
     {
-      StatBufValues vals
-      {
-        .mean = pair.second.Mean(),
-        .variance = pair.second.Variance(),
-        .min = pair.second.Min(),
-        .max = pair.second.Max()
-      };
-      groupNameToFloatStat[pair.first].emplace_back(statName, vals);
+      groups[data->slots[i].group].push_back(i);
     }
 
-    for (auto& [groupName, vec] : groupNameToFloatStat)
+    for (auto& [groupName, indices] : groups)
     {
-      std::sort(vec.begin(), vec.end(), [](const auto& a, const auto& b) { return a.second.max > b.second.max; });
+      // worst offenders first
+      std::sort(indices.begin(), indices.end(), [this](uint32_t a, uint32_t b)
+        {
+          return data->windows[a].summary.p99 > data->windows[b].summary.p99;
+        });
+
       if (ImGui::TreeNode(groupName.data()))
       {
-        for (const auto& [statName, statVals] : vec)
+        for (uint32_t i : indices)
         {
-          ImGui::Text("%-20s: %-10f%-10f%-10f%-10f", statName.data(), statVals.mean, statVals.variance, statVals.min, statVals.max);
+          const StatSlot& slot = data->slots[i];
+          const StatWindow& window = data->windows[i];
+          switch (slot.kind)
+          {
+          case StatKind::FLOAT:
+            ImGui::Text("%-20s: %-10f%-10f%-10f%-10f%-10f", slot.name.data(),
+              window.summary.mean, window.summary.p50, window.summary.p95, window.summary.p99, window.summary.max);
+            break;
+          case StatKind::COUNTER:
+            ImGui::Text("%-20s: %lld total, %.1f/s", slot.name.data(),
+              static_cast<long long>(slot.value.load(std::memory_order_relaxed)), window.rate);
+            break;
+          case StatKind::GAUGE:
+            ImGui::Text("%-20s: %lld now, %.0f max", slot.name.data(),
+              static_cast<long long>(slot.value.load(std::memory_order_relaxed)), window.summary.max);
+            break;
+          }
           ImGui::Separator();
         }
         ImGui::TreePop();
@@ -102,4 +321,4 @@ namespace engine::Core
     }
     ImGui::End();
   }
-}
\ No newline at end of file
+}
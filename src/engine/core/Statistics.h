@@ -1,92 +1,61 @@
 #pragma once
-#include <concepts>
-#include <array>
+#include <cstdint>
+#include <limits>
 #include <utility/HashedString.h>
 
 namespace engine::Core
 {
-  template<typename T>
-  concept Numeric =
-    std::integral<T> ||
-    std::floating_point<T>;
-
-  // records statistics about the most recent N elements pushed to it
-  template<Numeric T, size_t N>
-  class StatBuffer
+  enum class StatKind : uint8_t
   {
-  public:
-    void Push(T val)
-    {
-      auto prev = std::exchange(buffer_[next_], val);
-      next_ = (next_ + 1) % N;
-
-      if (count_ < N)
-        count_++;
-
-      sum_ += val - prev;
-    }
-
-    double Sum() const
-    {
-      //double sum = 0;
-      //for (size_t i = 0; i < count_; i++)
-      //  sum += buffer_[i];
-      //return sum;
-      return sum_;
-    }
-
-    double Mean() const
-    {
-      return Sum() / count_;
-    }
-
-    double Variance() const
-    {
-      const auto mean = Mean();
-      double numerator = 0;
-      for (size_t i = 0; i < count_; i++)
-        numerator += (buffer_[i] - mean) * (buffer_[i] - mean);
-      return numerator / count_;
-    }
-
-    double StandardDeviation() const
-    {
-      return sqrt(Variance());
-    }
-
-    T Min() const
-    {
-      auto min = buffer_[0];
-      for (size_t i = 1; i < count_; i++)
-        if (buffer_[i] < min) min = buffer_[i];
-      return min;
-    }
-
-    T Max() const
-    {
-      auto max = buffer_[0];
-      for (size_t i = 1; i < count_; i++)
-        if (buffer_[i] > max) max = buffer_[i];
-      return max;
-    }
+    FLOAT,   // samples, such as timings in ms
+    COUNTER, // a running total, such as bytes uploaded
+    GAUGE,   // a current value, such as chunks queued
+  };
 
-  private:
-    std::array<T, N> buffer_{};
-    size_t next_{};
-    size_t count_{};
-    double sum_{};
+  // index of a registered stat. resolve it once, then every push is a few relaxed atomics
+  struct StatHandle
+  {
+    uint32_t index = std::numeric_limits<uint32_t>::max();
+
+    bool IsValid() const { return index != std::numeric_limits<uint32_t>::max(); }
   };
 
-  constexpr size_t STATISTICS_BUFFER_SIZE = 500;
+  // percentiles are accurate to within a histogram bucket (1/8th of a power of two)
+  struct StatSummary
+  {
+    uint64_t count{};
+    double mean{};
+    double p50{};
+    double p95{};
+    double p99{};
+    double max{};
+  };
 
+  // Stats live in slots that are allocated when they're registered, so pushing to one from any thread
+  // never locks. Float stats go into a log-linear histogram, which is where their percentiles come from.
+  // The UI shows each stat over the last complete window of STATISTICS_WINDOW_SECONDS.
   class StatisticsManager
   {
   public:
     static StatisticsManager* Get();
 
-    void RegisterFloatStat(hashed_string statName, hashed_string groupName);
-    void PushFloatStatValue(hashed_string statName, float val);
-    const StatBuffer<float, STATISTICS_BUFFER_SIZE>& GetFloatStat(hashed_string statName);
+    // names must outlive the manager
+    StatHandle RegisterFloatStat(hashed_string statName, hashed_string groupName);
+    StatHandle RegisterCounter(hashed_string statName, hashed_string groupName);
+    StatHandle RegisterGauge(hashed_string statName, hashed_string groupName);
+
+    // returns an invalid handle if no stat has that name
+    StatHandle FindStat(hashed_string statName);
+
+    void PushFloatStatValue(StatHandle stat, float val);
+    void AddCounter(StatHandle stat, int64_t delta = 1);
+    void SetGauge(StatHandle stat, int64_t val);
+
+    // every sample pushed to a float stat since it was registered
+    StatSummary GetFloatStat(StatHandle stat);
+
+    // the total of a counter or the current value of a gauge
+    int64_t GetValue(StatHandle stat);
 
     // solemnly promise that you'll only call this in one place at most
     void DrawUI();
@@ -100,6 +69,11 @@ namespace engine::Core
     StatisticsManager();
     ~StatisticsManager();
 
+    StatHandle registerStat(hashed_string statName, hashed_string groupName, StatKind kind);
+
     struct StatisticsManagerData* data{};
   };
-}
\ No newline at end of file
+
+  constexpr uint32_t MAX_STATS = 256;
+  constexpr double STATISTICS_WINDOW_SECONDS = 2.0;
+}
@@ -0,0 +1,135 @@
+#include "../PCH.h"
+#include "CommandBuffer.h"
+#include "Entity.h"
+#include "component/Transform.h"
+
+#include <algorithm>
+
+CommandBuffer::CommandBuffer(Scene& scene)
+  : scene_(scene)
+{
+}
+
+CommandBuffer::~CommandBuffer() = default;
+
+void CommandBuffer::Create(std::function<void(Entity)> init, std::string_view name)
+{
+  Record([init = std::move(init), name = std::string(name)](Scene& scene)
+    {
+      init(scene.CreateEntity(name));
+    });
+}
+
+void CommandBuffer::Destroy(entt::entity entity)
+{
+  destroys_.Push(entity);
+}
+
+void CommandBuffer::Record(Command command)
+{
+  auto index = detail::GetThreadIndex();
+  if (index >= detail::MAX_BUFFER_THREADS)
+  {
+    std::lock_guard lck(overflowMutex_);
+    overflow_.commands.push_back(std::move(command));
+    return;
+  }
+
+  auto& slot = commands_[index];
+  if (!slot)
+  {
+    slot = std::make_unique<ThreadCommands>();
+  }
+  slot->commands.push_back(std::move(command));
+}
+
+void CommandBuffer::Flush()
+{
+  // commands may record more commands, which are applied in the same flush
+  while (applyCommands())
+  {
+  }
+  applyDestroys();
+}
+
+entt::registry& CommandBuffer::registryOf(Scene& scene)
+{
+  return scene.GetRegistry();
+}
+
+bool CommandBuffer::applyCommands()
+{
+  bool applied = false;
+  for (auto& slot : commands_)
+  {
+    if (slot)
+    {
+      applied |= applyCommands(*slot);
+    }
+  }
+  applied |= applyCommands(overflow_);
+  applying_.clear();
+  return applied;
+}
+
+bool CommandBuffer::applyCommands(ThreadCommands& slot)
+{
+  if (slot.commands.empty())
+  {
+    return false;
+  }
+
+  // swapped out first, in case a command records to this thread's buffer
+  applying_.clear();
+  std::swap(applying_, slot.commands);
+  for (auto& command : applying_)
+  {
+    command(scene_);
+  }
+  return true;
+}
+
+void CommandBuffer::applyDestroys()
+{
+  destroys_.MergeInto(doomed_);
+  destroys_.Clear();
+  if (doomed_.empty())
+  {
+    return;
+  }
+
+  auto& registry = scene_.GetRegistry();
+  std::erase_if(doomed_, [&registry](entt::entity entity) { return !registry.valid(entity); });
+
+  // children are destroyed with their parents
+  for (size_t i = 0; i < doomed_.size(); i++)
+  {
+    if (const auto* children = registry.try_get<Component::Children>(doomed_[i]))
+    {
+      for (const auto& child : children->GetChildren())
+      {
+        doomed_.push_back(child);
+      }
+    }
+  }
+
+  // an entity may have been destroyed more than once, or along with an ancestor
+  std::sort(doomed_.begin(), doomed_.end());
+  doomed_.erase(std::unique(doomed_.begin(), doomed_.end()), doomed_.end());
+
+  // detach subtree roots from parents that survive
+  for (auto entity : doomed_)
+  {
+    if (const auto* parent = registry.try_get<Component::Parent>(entity))
+    {
+      entt::entity parentEntity = parent->entity;
+      if (!std::binary_search(doomed_.begin(), doomed_.end(), parentEntity))
+      {
+        registry.get<Component::Children>(parentEntity).RemoveChild(Entity(entity, &scene_));
+      }
+    }
+  }
+
+  registry.destroy(doomed_.begin(), doomed_.end());
+  doomed_.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <entt/entity/registry.hpp>
+#include <utility/PerThreadBuffer.h>
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Scene;
+class Entity;
+
+// Records changes to a scene's entities so they can be applied later, at a sync point where nothing
+// is iterating the registry. Any number of threads may record at once without locking, as each
+// thread records into its own buffer. Threads beyond the first MAX_BUFFER_THREADS share one
+// mutex-guarded buffer.
+// Commands from one thread are applied in the order they were recorded. The order between threads
+// is unspecified. Destruction happens after every other command, so an entity can be destroyed
+// and still receive commands in the same flush.
+class CommandBuffer
+{
+public:
+  using Command = std::function<void(Scene&)>;
+
+  CommandBuffer(Scene& scene);
+  ~CommandBuffer();
+
+  CommandBuffer(const CommandBuffer&) = delete;
+  CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+  // creates an entity at the next flush and passes it to init
+  void Create(std::function<void(Entity)> init, std::string_view name = "");
+
+  // destroys the entity and all of its descendants at the next flush
+  void Destroy(entt::entity entity);
+
+  template<typename T, typename... Args>
+  void Emplace(entt::entity entity, Args&&... args)
+  {
+    Record([entity, ...args = std::forward<Args>(args)](Scene& scene) mutable
+      {
+        registryOf(scene).emplace_or_replace<T>(entity, std::move(args)...);
+      });
+  }
+
+  template<typename T>
+  void Remove(entt::entity entity)
+  {
+    Record([entity](Scene& scene)
+      {
+        registryOf(scene).remove_if_exists<T>(entity);
+      });
+  }
+
+  // for anything else
+  void Record(Command command);
+
+  // applies everything that was recorded. call on the main thread while no other thread is recording
+  void Flush();
+
+private:
+  static entt::registry& registryOf(Scene& scene);
+  struct alignas(detail::CACHE_LINE_SIZE) ThreadCommands
+  {
+    std::vector<Command> commands;
+  };
+
+  bool applyCommands();
+  bool applyCommands(ThreadCommands& slot);
+  void applyDestroys();
+
+  Scene& scene_;
+  std::array<std::unique_ptr<ThreadCommands>, detail::MAX_BUFFER_THREADS> commands_;
+  std::mutex overflowMutex_;
+  ThreadCommands overflow_;
+  PerThreadBuffer<entt::entity> destroys_;
+
+  // only touched while flushing
+  std::vector<Command> applying_;
+  std::vector<entt::entity> doomed_;
+};
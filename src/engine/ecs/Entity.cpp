@@ -2,20 +2,15 @@
 #include "Entity.h"
 #include "component/Transform.h"
 #include "component/Core.h"
+#include "TransformHierarchy.h"
+#include "CommandBuffer.h"
 
 
 
 void Entity::Destroy()
 {
   ASSERT_MSG(*this, "Cannot delete invalid entity!");
-
-  // remove self from any existing parent
-  if (auto parent = TryGetComponent<Component::Parent>())
-  {
-    parent->entity.GetComponent<Component::Children>().RemoveChild(*this);
-  }
-
-  GetOrAddComponent<Component::ScheduledDeletion>();
+  scene_->GetCommandBuffer().Destroy(entityHandle_);
 }
 
 void Entity::SetParent(Entity parent)
@@ -61,6 +56,8 @@ void Entity::SetParent(Entity parent)
       ASSERT_MSG(cParent != *this, "Parenting creates a cycle!");
     }
   }
+
+  scene_->GetTransformHierarchy().SetParent(*this, parent);
 }
 
 void Entity::AddChild(Entity child)
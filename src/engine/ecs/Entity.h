@@ -16,6 +16,7 @@ public:
 
   Entity(const Entity& other) = default;
 
+  // destroys this entity and its children when the scene's command buffer is next flushed. thread-safe
   void Destroy();
 
   template<typename T, typename... Args>
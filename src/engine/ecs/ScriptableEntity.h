@@ -34,6 +34,12 @@ public:
 		return entity_.scene_->CreateEntity(name);
 	}
 
+	// for changes to other entities that shouldn't happen while scripts are being updated
+	CommandBuffer& GetCommandBuffer()
+	{
+		return entity_.scene_->GetCommandBuffer();
+	}
+
 protected:
 	virtual void OnCreate() {}
 	virtual void OnDestroy() {}
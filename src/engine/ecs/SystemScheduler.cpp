@@ -0,0 +1,128 @@
+#include "../PCH.h"
+#include "SystemScheduler.h"
+#include <engine/core/JobSystem.h>
+#include <engine/core/Statistics.h>
+#include <utility/Timer.h>
+
+#include <algorithm>
+
+namespace
+{
+  bool intersects(const std::vector<entt::id_type>& a, const std::vector<entt::id_type>& b)
+  {
+    return std::any_of(a.begin(), a.end(), [&b](entt::id_type id) { return std::find(b.begin(), b.end(), id) != b.end(); });
+  }
+}
+
+bool SystemAccess::ConflictsWith(const SystemAccess& other) const
+{
+  return exclusive || other.exclusive ||
+    intersects(writes, other.reads) ||
+    intersects(writes, other.writes) ||
+    intersects(reads, other.writes);
+}
+
+void SystemScheduler::AddSystem(const char* name, SystemPhase phase, SystemAccess access, SystemFn system)
+{
+  auto stat = engine::Core::StatisticsManager::Get()->RegisterFloatStat(hashed_string(name), "Systems");
+
+  auto it = std::upper_bound(nodes_.begin(), nodes_.end(), phase, [](SystemPhase p, const Node& node) { return p < node.phase; });
+  nodes_.insert(it, Node{ .name = name, .stat = stat, .phase = phase, .access = std::move(access), .system = std::move(system) });
+  built_ = false;
+}
+
+void SystemScheduler::Run(Scene& scene, Timestep timestep)
+{
+  if (!built_)
+  {
+    build();
+  }
+
+  for (size_t first = 0; first < nodes_.size();)
+  {
+    size_t last = first;
+    while (last < nodes_.size() && nodes_[last].phase == nodes_[first].phase)
+    {
+      last++;
+    }
+    runPhase(first, last, scene, timestep);
+    first = last;
+  }
+}
+
+void SystemScheduler::build()
+{
+  for (auto& node : nodes_)
+  {
+    node.dependents.clear();
+    node.dependencyCount = 0;
+  }
+
+  for (uint32_t i = 0; i < nodes_.size(); i++)
+  {
+    for (uint32_t j = i + 1; j < nodes_.size() && nodes_[j].phase == nodes_[i].phase; j++)
+    {
+      if (nodes_[i].access.ConflictsWith(nodes_[j].access))
+      {
+        nodes_[i].dependents.push_back(j);
+        nodes_[j].dependencyCount++;
+      }
+    }
+  }
+
+  remaining_ = std::make_unique<std::atomic_uint32_t[]>(nodes_.size());
+  built_ = true;
+}
+
+void SystemScheduler::runPhase(size_t first, size_t last, Scene& scene, Timestep timestep)
+{
+  for (size_t i = first; i < last; i++)
+  {
+    remaining_[i].store(nodes_[i].dependencyCount, std::memory_order_relaxed);
+  }
+
+  engine::Core::JobCounter phase;
+  for (size_t i = first; i < last; i++)
+  {
+    if (nodes_[i].dependencyCount == 0)
+    {
+      dispatch(static_cast<uint32_t>(i), scene, timestep, phase);
+    }
+  }
+
+  // runs main thread systems as they become ready
+  engine::Core::JobSystem::Get()->Wait(phase);
+}
+
+void SystemScheduler::runNode(uint32_t index, Scene& scene, Timestep timestep, engine::Core::JobCounter& phase)
+{
+  Node& node = nodes_[index];
+  Timer timer;
+  node.system(scene, timestep);
+  engine::Core::StatisticsManager::Get()->PushFloatStatValue(node.stat, static_cast<float>(timer.Elapsed_ms()));
+
+  for (uint32_t dependent : node.dependents)
+  {
+    if (remaining_[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      dispatch(dependent, scene, timestep, phase);
+    }
+  }
+}
+
+void SystemScheduler::dispatch(uint32_t index, Scene& scene, Timestep timestep, engine::Core::JobCounter& phase)
+{
+  auto job = [this, index, &scene, timestep, &phase]
+  {
+    runNode(index, scene, timestep, phase);
+  };
+
+  if (nodes_[index].access.mainThread)
+  {
+    engine::Core::JobSystem::Get()->SubmitMainThread(job, &phase, nodes_[index].name);
+  }
+  else
+  {
+    engine::Core::JobSystem::Get()->Submit(job, &phase, engine::Core::JobPriority::HIGH, nodes_[index].name);
+  }
+}
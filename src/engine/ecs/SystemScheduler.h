@@ -0,0 +1,100 @@
+#pragma once
+#include "../Timestep.h"
+#include "../core/Statistics.h"
+#include <entt/core/type_info.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Scene;
+
+namespace engine::Core
+{
+  class JobCounter;
+}
+
+// systems in one phase all finish before any system in the next phase starts
+enum class SystemPhase
+{
+  PRE_UPDATE,
+  UPDATE,
+};
+
+// the components a system touches, which decides what it may run alongside
+struct SystemAccess
+{
+  template<typename... Ts>
+  SystemAccess& Read()
+  {
+    (reads.push_back(entt::type_info<Ts>::id()), ...);
+    return *this;
+  }
+
+  template<typename... Ts>
+  SystemAccess& Write()
+  {
+    (writes.push_back(entt::type_info<Ts>::id()), ...);
+    return *this;
+  }
+
+  // the system touches state that isn't described by components (scripts, callbacks, structural changes)
+  SystemAccess& Exclusive()
+  {
+    exclusive = true;
+    return *this;
+  }
+
+  // the system uses the GL context or ImGui
+  SystemAccess& MainThread()
+  {
+    mainThread = true;
+    return *this;
+  }
+
+  bool ConflictsWith(const SystemAccess& other) const;
+
+  std::vector<entt::id_type> reads;
+  std::vector<entt::id_type> writes;
+  bool exclusive = false;
+  bool mainThread = false;
+};
+
+// Runs a frame's systems as a dependency graph. A system depends on every earlier system in its
+// phase whose access conflicts with its own, so systems that conflict keep the order they were added
+// in and the rest run concurrently on the job system. Main thread systems run on the thread that calls Run.
+// Each system's time is pushed to the "Systems" stat group under its name.
+class SystemScheduler
+{
+public:
+  using SystemFn = std::function<void(Scene&, Timestep)>;
+
+  // name must outlive the scheduler, as it is used for the system's stat
+  void AddSystem(const char* name, SystemPhase phase, SystemAccess access, SystemFn system);
+
+  void Run(Scene& scene, Timestep timestep);
+
+private:
+  struct Node
+  {
+    const char* name;
+    engine::Core::StatHandle stat;
+    SystemPhase phase;
+    SystemAccess access;
+    SystemFn system;
+    std::vector<uint32_t> dependents;
+    uint32_t dependencyCount{};
+  };
+
+  void build();
+  void runPhase(size_t first, size_t last, Scene& scene, Timestep timestep);
+  void runNode(uint32_t index, Scene& scene, Timestep timestep, engine::Core::JobCounter& phase);
+  void dispatch(uint32_t index, Scene& scene, Timestep timestep, engine::Core::JobCounter& phase);
+
+  // sorted by phase, then by the order they were added in
+  std::vector<Node> nodes_;
+  bool built_ = false;
+
+  // dependencies each system is still waiting on during a run
+  std::unique_ptr<std::atomic_uint32_t[]> remaining_;
+};
@@ -0,0 +1,123 @@
+#include "../PCH.h"
+#include "TransformBatch.h"
+#include <engine/core/JobSystem.h>
+
+#include <algorithm>
+
+namespace
+{
+  // transforms composed by one task when composing in parallel. a multiple of BATCH_SIZE
+  constexpr size_t TASK_SIZE = 1024;
+}
+
+void TransformBatch::Clear()
+{
+  Resize(0);
+}
+
+void TransformBatch::Resize(size_t size)
+{
+  size_ = size;
+  const size_t padded = (size + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+  for (auto* lane : { &tx_, &ty_, &tz_, &qx_, &qy_, &qz_ })
+  {
+    lane->resize(padded, 0.0f);
+  }
+  for (auto* lane : { &qw_, &sx_, &sy_, &sz_ })
+  {
+    lane->resize(padded, 1.0f);
+  }
+}
+
+void TransformBatch::Push(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+  if (size_ == tx_.size())
+  {
+    Resize(size_ + 1);
+  }
+  else
+  {
+    size_++;
+  }
+  Set(size_ - 1, translation, rotation, scale);
+}
+
+void TransformBatch::Set(size_t index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+  ASSERT(index < size_);
+  tx_[index] = translation.x;
+  ty_[index] = translation.y;
+  tz_[index] = translation.z;
+  qx_[index] = rotation.x;
+  qy_[index] = rotation.y;
+  qz_[index] = rotation.z;
+  qw_[index] = rotation.w;
+  sx_[index] = scale.x;
+  sy_[index] = scale.y;
+  sz_[index] = scale.z;
+}
+
+void TransformBatch::Compose(std::span<glm::mat4> out) const
+{
+  ASSERT(out.size() == size_);
+  if (size_ <= TASK_SIZE)
+  {
+    composeRange(0, size_, out.data());
+    return;
+  }
+
+  std::vector<size_t> tasks((size_ + TASK_SIZE - 1) / TASK_SIZE);
+  for (size_t i = 0; i < tasks.size(); i++)
+  {
+    tasks[i] = i * TASK_SIZE;
+  }
+  engine::Core::JobSystem::Get()->ForEach(tasks.begin(), tasks.end(), [this, out](size_t first)
+    {
+      composeRange(first, std::min(first + TASK_SIZE, size_), out.data());
+    });
+}
+
+// first must be a multiple of BATCH_SIZE
+void TransformBatch::composeRange(size_t first, size_t last, glm::mat4* out) const
+{
+  for (size_t base = first; base < last; base += BATCH_SIZE)
+  {
+    const float* qx = &qx_[base];
+    const float* qy = &qy_[base];
+    const float* qz = &qz_[base];
+    const float* qw = &qw_[base];
+    const float* sx = &sx_[base];
+    const float* sy = &sy_[base];
+    const float* sz = &sz_[base];
+
+    // the upper 3x3 of each matrix (rotation times scale), column-major. the padding
+    // means every lane is valid, so this loop always covers the whole batch
+    alignas(32) float m[9][BATCH_SIZE];
+    for (size_t l = 0; l < BATCH_SIZE; l++)
+    {
+      const float xx = qx[l] * qx[l], yy = qy[l] * qy[l], zz = qz[l] * qz[l];
+      const float xy = qx[l] * qy[l], xz = qx[l] * qz[l], yz = qy[l] * qz[l];
+      const float wx = qw[l] * qx[l], wy = qw[l] * qy[l], wz = qw[l] * qz[l];
+
+      m[0][l] = (1.0f - 2.0f * (yy + zz)) * sx[l];
+      m[1][l] = 2.0f * (xy + wz) * sx[l];
+      m[2][l] = 2.0f * (xz - wy) * sx[l];
+      m[3][l] = 2.0f * (xy - wz) * sy[l];
+      m[4][l] = (1.0f - 2.0f * (xx + zz)) * sy[l];
+      m[5][l] = 2.0f * (yz + wx) * sy[l];
+      m[6][l] = 2.0f * (xz + wy) * sz[l];
+      m[7][l] = 2.0f * (yz - wx) * sz[l];
+      m[8][l] = (1.0f - 2.0f * (xx + yy)) * sz[l];
+    }
+
+    const size_t count = std::min(BATCH_SIZE, last - base);
+    for (size_t l = 0; l < count; l++)
+    {
+      glm::mat4& model = out[base + l];
+      model[0] = { m[0][l], m[1][l], m[2][l], 0.0f };
+      model[1] = { m[3][l], m[4][l], m[5][l], 0.0f };
+      model[2] = { m[6][l], m[7][l], m[8][l], 0.0f };
+      model[3] = { tx_[base + l], ty_[base + l], tz_[base + l], 1.0f };
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <span>
+#include <vector>
+
+// Transforms stored as one array per scalar component, for composing many model matrices at once.
+// Compose works on BATCH_SIZE transforms per step, and each step's loops run across the batch with
+// no dependencies between iterations, so they are vectorized.
+class TransformBatch
+{
+public:
+  static constexpr size_t BATCH_SIZE = 8;
+
+  void Clear();
+  void Resize(size_t size);
+  size_t Size() const { return size_; }
+
+  void Push(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+  void Set(size_t index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+
+  // out[i] = translate(translation[i]) * mat4_cast(rotation[i]) * scale(scale[i])
+  // out must be the same size as the batch
+  void Compose(std::span<glm::mat4> out) const;
+
+private:
+  void composeRange(size_t first, size_t last, glm::mat4* out) const;
+
+  size_t size_{};
+
+  // padded to a multiple of BATCH_SIZE so every batch is full. results for the padding are discarded
+  std::vector<float> tx_, ty_, tz_;
+  std::vector<float> qx_, qy_, qz_, qw_;
+  std::vector<float> sx_, sy_, sz_;
+};
@@ -0,0 +1,190 @@
+#include "../PCH.h"
+#include "TransformHierarchy.h"
+#include "component/Transform.h"
+#include <engine/core/JobSystem.h>
+
+TransformHierarchy::TransformHierarchy(entt::registry& registry)
+  : registry_(registry)
+{
+  registry_.on_destroy<Component::Parent>()
+    .connect<&TransformHierarchy::onParentDestroy>(*this);
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+  registry_.on_destroy<Component::Parent>()
+    .disconnect<&TransformHierarchy::onParentDestroy>(*this);
+}
+
+void TransformHierarchy::SetParent(entt::entity child, entt::entity parent)
+{
+  // reparenting within the same level doesn't move anything
+  if (auto it = slots_.find(child); it != slots_.end())
+  {
+    auto parentIt = slots_.find(parent);
+    uint32_t newLevel = parentIt != slots_.end() ? parentIt->second.level + 1 : 0;
+    if (newLevel == it->second.level)
+    {
+      Level& level = levels_[newLevel];
+      level.parents[it->second.index] = parent;
+      level.parentIndices[it->second.index] = parentIt != slots_.end() ? parentIt->second.index : ROOT;
+      level.dirty[it->second.index] = 1;
+      return;
+    }
+  }
+
+  // otherwise the child's whole subtree changes depth
+  std::vector<entt::entity> subtree;
+  collectSubtree(child, subtree);
+  for (auto entity : subtree)
+  {
+    remove(entity);
+  }
+
+  insert(child, parent);
+  for (size_t i = 1; i < subtree.size(); i++)
+  {
+    insert(subtree[i], registry_.get<Component::Parent>(subtree[i]).entity);
+  }
+}
+
+void TransformHierarchy::Update()
+{
+  using namespace Component;
+
+  // resolved here because looking up a pool from a worker can create it, which isn't thread safe
+  auto transforms = registry_.view<Transform>();
+  auto locals = registry_.view<LocalTransform>();
+  for (size_t levelIndex = 0; levelIndex < levels_.size(); levelIndex++)
+  {
+    Level& level = levels_[levelIndex];
+    const Level* above = levelIndex > 0 ? &levels_[levelIndex - 1] : nullptr;
+
+    engine::Core::JobSystem::Get()->ForEach(level.entities.begin(), level.entities.end(), [&](const entt::entity& entity)
+      {
+        const size_t i = &entity - level.entities.data();
+        auto* worldTransform = transforms.contains(entity) ? &transforms.get(entity) : nullptr;
+        auto* localTransform = locals.contains(entity) ? &locals.get(entity) : nullptr;
+        if (!worldTransform || !localTransform)
+        {
+          level.dirty[i] = worldTransform && worldTransform->IsDirty();
+          return;
+        }
+
+        auto& ltransform = localTransform->transform;
+        bool localDirty = ltransform.IsDirty();
+        if (localDirty)
+        {
+          ltransform.SetModel();
+        }
+
+        bool parentDirty = level.parentIndices[i] == ROOT
+          ? transforms.get(level.parents[i]).IsDirty()
+          : above->dirty[level.parentIndices[i]];
+        if (parentDirty || localDirty)
+        {
+          const auto& parentTransform = transforms.get(level.parents[i]);
+          worldTransform->SetTranslation(parentTransform.GetTranslation() + ltransform.GetTranslation() * parentTransform.GetScale());
+
+          worldTransform->SetScale(ltransform.GetScale() * parentTransform.GetScale());
+
+          worldTransform->SetTranslation(worldTransform->GetTranslation() - parentTransform.GetTranslation());
+          worldTransform->SetTranslation(glm::mat3(glm::mat4_cast(parentTransform.GetRotation())) * worldTransform->GetTranslation());
+          worldTransform->SetTranslation(worldTransform->GetTranslation() + parentTransform.GetTranslation());
+
+          worldTransform->SetRotation(ltransform.GetRotation() * parentTransform.GetRotation());
+        }
+
+        level.dirty[i] = worldTransform->IsDirty();
+      });
+  }
+}
+
+// breadth-first, so parents come before their children
+void TransformHierarchy::collectSubtree(entt::entity entity, std::vector<entt::entity>& subtree) const
+{
+  subtree.push_back(entity);
+  for (size_t i = subtree.size() - 1; i < subtree.size(); i++)
+  {
+    if (auto* children = registry_.try_get<Component::Children>(subtree[i]))
+    {
+      for (const auto& child : children->GetChildren())
+      {
+        subtree.push_back(child);
+      }
+    }
+  }
+}
+
+void TransformHierarchy::insert(entt::entity entity, entt::entity parent)
+{
+  uint32_t levelIndex = 0;
+  uint32_t parentIndex = ROOT;
+  if (auto it = slots_.find(parent); it != slots_.end())
+  {
+    levelIndex = it->second.level + 1;
+    parentIndex = it->second.index;
+  }
+
+  if (levels_.size() <= levelIndex)
+  {
+    levels_.resize(levelIndex + 1);
+  }
+
+  Level& level = levels_[levelIndex];
+  slots_[entity] = { levelIndex, static_cast<uint32_t>(level.entities.size()) };
+  level.entities.push_back(entity);
+  level.parents.push_back(parent);
+  level.parentIndices.push_back(parentIndex);
+  level.dirty.push_back(1);
+}
+
+void TransformHierarchy::remove(entt::entity entity)
+{
+  auto it = slots_.find(entity);
+  if (it == slots_.end())
+  {
+    return;
+  }
+  const auto [levelIndex, index] = it->second;
+  slots_.erase(it);
+
+  // swap with the last entity in the level, then fix up that entity's children, who refer to it by index
+  Level& level = levels_[levelIndex];
+  const uint32_t last = static_cast<uint32_t>(level.entities.size() - 1);
+  if (index != last)
+  {
+    entt::entity moved = level.entities[last];
+    level.entities[index] = moved;
+    level.parents[index] = level.parents[last];
+    level.parentIndices[index] = level.parentIndices[last];
+    level.dirty[index] = level.dirty[last];
+    slots_[moved].index = index;
+
+    if (auto* children = registry_.try_get<Component::Children>(moved))
+    {
+      for (const auto& child : children->GetChildren())
+      {
+        if (auto childIt = slots_.find(child); childIt != slots_.end() && childIt->second.level == levelIndex + 1)
+        {
+          levels_[levelIndex + 1].parentIndices[childIt->second.index] = index;
+        }
+      }
+    }
+  }
+
+  level.entities.pop_back();
+  level.parents.pop_back();
+  level.parentIndices.pop_back();
+  level.dirty.pop_back();
+
+  while (!levels_.empty() && levels_.back().entities.empty())
+  {
+    levels_.pop_back();
+  }
+}
+
+void TransformHierarchy::onParentDestroy([[maybe_unused]] entt::registry& registry, entt::entity entity)
+{
+  remove(entity);
+}
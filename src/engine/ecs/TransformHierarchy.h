@@ -0,0 +1,54 @@
+#pragma once
+#include <entt/entity/registry.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Stores every entity that has a parent in arrays ordered by depth, so world transforms
+// can be propagated one level at a time. A level only reads the level above it, so each
+// level is updated in parallel. An entity whose local transform and parent are both
+// unchanged is skipped, and so its children only check a flag to find out they can skip too.
+// Kept up to date by Entity::SetParent and by destroying entities.
+class TransformHierarchy
+{
+public:
+  TransformHierarchy(entt::registry& registry);
+  ~TransformHierarchy();
+
+  TransformHierarchy(const TransformHierarchy&) = delete;
+  TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+  // call after the child's Parent component and the parent's Children component have been updated
+  void SetParent(entt::entity child, entt::entity parent);
+
+  // recomputes world transforms of entities whose local transform or parent's world transform is dirty
+  void Update();
+
+  size_t GetDepth() const { return levels_.size(); }
+
+private:
+  static constexpr uint32_t ROOT = UINT32_MAX;
+
+  struct Slot
+  {
+    uint32_t level;
+    uint32_t index;
+  };
+
+  struct Level
+  {
+    std::vector<entt::entity> entities;
+    std::vector<entt::entity> parents;
+    std::vector<uint32_t> parentIndices; // index of the parent in the level above, or ROOT if the parent has no parent
+    std::vector<uint8_t> dirty; // whether the world transform was dirty after the last update
+  };
+
+  void collectSubtree(entt::entity entity, std::vector<entt::entity>& subtree) const;
+  void insert(entt::entity entity, entt::entity parent);
+  void remove(entt::entity entity);
+  void onParentDestroy(entt::registry& registry, entt::entity entity);
+
+  entt::registry& registry_;
+  std::vector<Level> levels_;
+  std::unordered_map<entt::entity, Slot> slots_;
+};
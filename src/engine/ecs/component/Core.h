@@ -18,11 +18,4 @@ namespace Component
     float remainingSeconds{};
     bool active{};
   };
-
-  // The entity will be deleted at the beginning of the next update tick.
-  // Do not add this component yourself unless you know what you are doing!
-  struct ScheduledDeletion
-  {
-    [[no_unique_address]] char8_t dummy;
-  };
 }
\ No newline at end of file
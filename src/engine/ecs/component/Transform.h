@@ -14,10 +14,15 @@ namespace Component
     const auto& GetTranslation() const { return translation; }
     const auto& GetRotation() const { return rotation; }
     const auto& GetScale() const { return scale; }
+    // equivalent to translate * mat4_cast(rotation) * scale, without the matrix products
     auto GetModel() const
     {
-      /*return model;*/
-      return glm::translate(glm::mat4(1), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1), scale);
+      glm::mat4 model = glm::mat4_cast(rotation);
+      model[0] *= scale.x;
+      model[1] *= scale.y;
+      model[2] *= scale.z;
+      model[3] = glm::vec4(translation, 1.0f);
+      return model;
     }
 
     auto IsDirty() const { return isDirty; }
@@ -65,7 +70,7 @@ namespace Component
       std::erase(children, child);
     }
 
-    const std::vector<Entity> GetChildren() const { return children; }
+    const std::vector<Entity>& GetChildren() const { return children; }
 
     size_t size() const { return children.size(); }
 
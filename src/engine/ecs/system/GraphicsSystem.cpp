@@ -11,7 +11,7 @@
 #include <engine/gfx/Camera.h>
 #include <engine/core/Statistics.h>
 #include <engine/core/StatMacros.h>
-#include <execution>
+#include <engine/core/JobSystem.h>
 #include <glm/gtx/norm.hpp>
 #include <entt/entity/registry.hpp>
 
@@ -54,9 +54,9 @@ void GraphicsSystem::DrawOpaque(Scene& scene)
   // draw batched objects in the scene
   using namespace Component;
   auto group = scene.GetRegistry().group<BatchedMesh>(entt::get<Model, Material>);
-  GFX::Renderer::BeginObjects(group.size());
+  GFX::Renderer::BeginObjects();
 
-  std::for_each(std::execution::par, group.begin(), group.end(),
+  engine::Core::JobSystem::Get()->ForEach(group.begin(), group.end(),
     [&group](entt::entity entity)
     {
       auto [mesh, model, material] = group.get<BatchedMesh, Model, Material>(entity);
@@ -98,14 +98,18 @@ void GraphicsSystem::DrawTransparent(Scene& scene)
   auto renderViews = scene.GetRenderViews();
 
   using namespace Component;
-  auto view = scene.GetRegistry().view<ParticleEmitter, Transform>();
-  GFX::Renderer::BeginEmitters(view.size_hint()); // multi-component views only know the maximum possible size
-
-  std::for_each(std::execution::par, view.begin(), view.end(),
-    [&view](entt::entity entity)
+  auto& registry = scene.GetRegistry();
+  auto view = registry.view<ParticleEmitter, Transform>();
+  GFX::Renderer::BeginEmitters();
+
+  // use the cached model matrix if the emitter has one. the view is taken here because
+  // looking up a pool from a worker can create it
+  auto models = registry.view<Model>();
+  engine::Core::JobSystem::Get()->ForEach(view.begin(), view.end(),
+    [&view, &models](entt::entity entity)
     {
       auto [emitter, transform] = view.get<ParticleEmitter, Transform>(entity);
-      GFX::Renderer::SubmitEmitter(emitter, transform);
+      GFX::Renderer::SubmitEmitter(emitter, models.contains(entity) ? models.get(entity).matrix : transform.GetModel());
     });
 
   GFX::Renderer::RenderEmitters(renderViews);
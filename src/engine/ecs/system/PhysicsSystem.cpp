@@ -1,21 +1,44 @@
 #include "../../PCH.h"
 #include "PhysicsSystem.h"
-#include <entt/core/algorithm.hpp>
 #include <engine/Physics.h>
 #include <glm/gtx/compatibility.hpp>
-#include <execution>
 #include <engine/core/StatMacros.h>
+#include <engine/core/JobSystem.h>
 
 #include "../Entity.h"
+#include "../TransformHierarchy.h"
 #include "../component/Physics.h"
 #include "../component/Transform.h"
 
 DECLARE_FLOAT_STAT(TransformUpdate, CPU)
 DECLARE_FLOAT_STAT(PhysicsSimulate, CPU)
 
+// the entities of the view that pass the filter, in view order
+// the filter runs on the job system, so only the list of entities is walked serially.
+// it may be called concurrently, so it must only read components
+template<typename View, typename Filter>
+static void GatherEntities(const View& view, Filter&& filter, std::vector<entt::entity>& candidates, std::vector<uint8_t>& keep, std::vector<entt::entity>& out)
+{
+  candidates.assign(view.begin(), view.end());
+  keep.resize(candidates.size());
+  engine::Core::JobSystem::Get()->ForEach(candidates.begin(), candidates.end(), [&](const entt::entity& entity)
+    {
+      keep[&entity - candidates.data()] = filter(entity);
+    });
+
+  out.clear();
+  for (size_t i = 0; i < candidates.size(); i++)
+  {
+    if (keep[i])
+    {
+      out.push_back(candidates[i]);
+    }
+  }
+}
+
 static void OnDynamicPhysicsDelete(entt::basic_registry<entt::entity>& registry, entt::entity entity)
 {
-  printf("Deleted dynamic physics on entity %d\n", entity);
+  spdlog::trace("Deleted dynamic physics on entity {}", entt::to_integral(entity));
 
   auto* physics = registry.get<Component::DynamicPhysics>(entity).internalActor;
   Physics::PhysicsManager::RemoveActorEntity(reinterpret_cast<physx::PxRigidActor*>(physics));
@@ -23,7 +46,7 @@ static void OnDynamicPhysicsDelete(entt::basic_registry<entt::entity>& registry,
 
 static void OnStaticPhysicsDelete(entt::basic_registry<entt::entity>& registry, entt::entity entity)
 {
-  printf("Deleted static physics on entity %d\n", entity);
+  spdlog::trace("Deleted static physics on entity {}", entt::to_integral(entity));
 
   auto* physics = registry.get<Component::StaticPhysics>(entity).internalActor;
   Physics::PhysicsManager::RemoveActorEntity(reinterpret_cast<physx::PxRigidActor*>(physics));
@@ -31,7 +54,7 @@ static void OnStaticPhysicsDelete(entt::basic_registry<entt::entity>& registry,
 
 static void OnCharacterControllerDelete(entt::basic_registry<entt::entity>& registry, entt::entity entity)
 {
-  printf("Deleted character controller on entity %d\n", entity);
+  spdlog::trace("Deleted character controller on entity {}", entt::to_integral(entity));
 
   auto* controller = registry.get<Component::CharacterController>(entity).internalController;
   Physics::PhysicsManager::RemoveCharacterControllerEntity(controller);
@@ -62,82 +85,62 @@ void PhysicsSystem::Update(Scene& scene, Timestep timestep)
   {
     MEASURE_CPU_TIMER_STAT(TransformUpdate);
 
-    // update local transforms
-    {
-      using namespace Component;
-      // create a PARTIALLY OWNING group, OWNING TRANSFORM
-      auto group = scene.GetRegistry().group<Transform>(entt::get<LocalTransform, Parent>);
-      group.sort(
-        [&scene](const entt::entity lhs, const entt::entity rhs)
-        {
-          return Entity(lhs, &scene).GetHierarchyHeight() > Entity(rhs, &scene).GetHierarchyHeight();
-        }, entt::insertion_sort()); // insertion sort optimal for nearly-sorted containers
-
-      for (auto entity : group)
-      {
-        auto [worldTransform, localTransform, parent] = group.get<Transform, LocalTransform, Parent>(entity);
-        auto& ltransform = localTransform.transform;
-        bool localDirty = ltransform.IsDirty();
-        if (ltransform.IsDirty())
-        {
-          //model.matrix = worldTransform.GetModel();
-          ltransform.SetModel();
-        }
-
-        const auto& parentTransform = parent.entity.GetComponent<Transform>();
-        if (parentTransform.IsDirty() || localDirty)
-        {
-          worldTransform.SetTranslation(parentTransform.GetTranslation() + ltransform.GetTranslation() * parentTransform.GetScale());
-
-          worldTransform.SetScale(ltransform.GetScale() * parentTransform.GetScale());
-
-          worldTransform.SetTranslation(worldTransform.GetTranslation() - parentTransform.GetTranslation());
-          worldTransform.SetTranslation(glm::mat3(glm::mat4_cast(parentTransform.GetRotation())) * worldTransform.GetTranslation());
-          worldTransform.SetTranslation(worldTransform.GetTranslation() + parentTransform.GetTranslation());
+    // update world transforms of entities with parents
+    scene.GetTransformHierarchy().Update();
 
-          worldTransform.SetRotation(ltransform.GetRotation() * parentTransform.GetRotation());
-        }
-      }
-    }
+    auto& registry = scene.GetRegistry();
 
     // update model matrices after potential changes
     {
-      auto view = scene.GetRegistry().view<Component::Transform, Component::Model>(entt::exclude<Component::InterpolatedPhysics>);
-      std::for_each(std::execution::par_unseq, view.begin(), view.end(), [&view](auto entity)
-        //for (auto entity : view)
+      using namespace Component;
+      auto view = registry.view<Transform, Model>(entt::exclude<InterpolatedPhysics>);
+      GatherEntities(view, [&view](entt::entity entity) { return view.get<Transform>(entity).IsDirty(); },
+        candidateEntities_, keepEntities_, modelEntities_);
+
+      transformBatch_.Resize(modelEntities_.size());
+      engine::Core::JobSystem::Get()->ForEach(modelEntities_.begin(), modelEntities_.end(), [&](const entt::entity& entity)
         {
-          auto [transform, model] = view.get<Component::Transform, Component::Model>(entity);
-          if (transform.IsDirty())
-          {
-            model.matrix = transform.GetModel();
-            transform.SetModel();
-          }
+          auto& transform = view.get<Transform>(entity);
+          transformBatch_.Set(&entity - modelEntities_.data(), transform.GetTranslation(), transform.GetRotation(), transform.GetScale());
+          transform.SetModel();
         });
+      writeModels(registry);
     }
 
     {
       using namespace Component;
-      auto view = scene.GetRegistry().view<Model, Transform, InterpolatedPhysics>();
-      std::for_each(std::execution::par_unseq, view.begin(), view.end(), [timestep, &view](auto entity)
-        //for (auto entity : view)
+      auto view = registry.view<Model, Transform, InterpolatedPhysics>();
+      GatherEntities(view, [&view](entt::entity entity)
         {
-          auto [model, transform, interp] = view.get<Model, Transform, InterpolatedPhysics>(entity);
-          transform.SetModel();
+          const auto& interp = view.get<InterpolatedPhysics>(entity);
+          return interp.timeSinceUpdate >= 0 || interp.timeSinceUpdate == -1;
+        }, candidateEntities_, keepEntities_, modelEntities_);
+
+      // every interpolated transform is consumed this frame, including those that keep their old model
+      engine::Core::JobSystem::Get()->ForEach(candidateEntities_.begin(), candidateEntities_.end(), [&view](const entt::entity& entity)
+        {
+          view.get<Transform>(entity).SetModel();
+        });
+
+      transformBatch_.Resize(modelEntities_.size());
+      const float step = (float)::Physics::PhysicsManager::GetStep();
+      engine::Core::JobSystem::Get()->ForEach(modelEntities_.begin(), modelEntities_.end(), [&](const entt::entity& entity)
+        {
+          const size_t i = &entity - modelEntities_.data();
+          auto [transform, interp] = view.get<Transform, InterpolatedPhysics>(entity);
           if (interp.timeSinceUpdate < 0)
           {
-            if (interp.timeSinceUpdate == -1)
-              model.matrix = transform.GetModel();
-            //continue;
+            transformBatch_.Set(i, transform.GetTranslation(), transform.GetRotation(), transform.GetScale());
             return;
           }
-          float lerpAmt = glm::clamp(interp.timeSinceUpdate / (float)::Physics::PhysicsManager::GetStep(), 0.0f, 1.0f);
-          Transform trinterp;
-          trinterp.SetTranslation(glm::lerp(interp.prevPos, transform.GetTranslation(), lerpAmt));
-          trinterp.SetRotation(glm::slerp(interp.prevRot, transform.GetRotation(), lerpAmt));
-          trinterp.SetScale(transform.GetScale());
-          model.matrix = trinterp.GetModel();
+          float lerpAmt = glm::clamp(interp.timeSinceUpdate / step, 0.0f, 1.0f);
+          transformBatch_.Set(i,
+            glm::lerp(interp.prevPos, transform.GetTranslation(), lerpAmt),
+            glm::slerp(interp.prevRot, transform.GetRotation(), lerpAmt),
+            transform.GetScale());
           interp.timeSinceUpdate += timestep.dt_effective;
         });
+      writeModels(registry);
     }
   }
 
@@ -146,3 +149,16 @@ void PhysicsSystem::Update(Scene& scene, Timestep timestep)
     Physics::PhysicsManager::Simulate(timestep);
   }
 }
+
+void PhysicsSystem::writeModels(entt::registry& registry)
+{
+  models_.resize(modelEntities_.size());
+  transformBatch_.Compose(models_);
+
+  // looking up through a view doesn't touch the registry, so it's safe from several threads
+  auto view = registry.view<Component::Model>();
+  engine::Core::JobSystem::Get()->ForEach(modelEntities_.begin(), modelEntities_.end(), [&](const entt::entity& entity)
+    {
+      view.get<Component::Model>(entity).matrix = models_[&entity - modelEntities_.data()];
+    });
+}
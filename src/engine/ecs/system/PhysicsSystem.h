@@ -1,6 +1,9 @@
 #pragma once
 #include "../../Scene.h"
 #include "../../Timestep.h"
+#include "../TransformBatch.h"
+#include <glm/mat4x4.hpp>
+#include <vector>
 
 class PhysicsSystem
 {
@@ -11,4 +14,13 @@ public:
   void Update(Scene& scene, Timestep timestep);
 
 private:
+  // composes transformBatch_ and writes the results to the Model components of modelEntities_
+  void writeModels(entt::registry& registry);
+
+  // scratch space for model updates
+  std::vector<entt::entity> candidateEntities_;
+  std::vector<uint8_t> keepEntities_;
+  std::vector<entt::entity> modelEntities_;
+  TransformBatch transformBatch_;
+  std::vector<glm::mat4> models_;
 };
\ No newline at end of file
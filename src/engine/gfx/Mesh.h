@@ -13,6 +13,24 @@ namespace GFX
 		glm::vec2 texCoord;
 	};
 
+	// what a Vertex is uploaded as when the renderer is packing vertices (20 bytes instead of 32)
+	struct PackedVertex
+	{
+		glm::vec3 position;
+		uint32_t normal;   // snorm 10:10:10:2
+		uint32_t texCoord; // two halfs
+	};
+
+	constexpr uint32_t MAX_MESH_LODS = 5;
+
+	// a range of a mesh's indices. LODs of a mesh share its vertices
+	struct MeshLod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error; // how far the surface may be from the original, in object units
+	};
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices;
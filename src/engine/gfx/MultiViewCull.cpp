@@ -0,0 +1,138 @@
+#include "../PCH.h"
+#include "MultiViewCull.h"
+#include <algorithm>
+#include <bit>
+#include <glm/vector_relational.hpp>
+
+namespace GFX
+{
+  namespace
+  {
+    // same as CullFrustum in cull.h.glsl
+    Frustum::Visibility TestFrustum(const CullView& view, const AABB& box)
+    {
+      // same plane order as the shader, minus the near plane
+      constexpr Frustum::Plane planes[] = { Frustum::Right, Frustum::Left, Frustum::Bottom, Frustum::Top, Frustum::Front };
+
+      bool full = true;
+      for (auto plane : planes)
+      {
+        // the positive vertex is the corner farthest in front of the plane, the negative vertex the one farthest behind it
+        const glm::vec4 p = view.frustum.GetPlane(plane);
+        const glm::bvec3 positiveAxes = glm::greaterThan(glm::vec3(p), glm::vec3(0));
+        const glm::vec3 positive = glm::mix(box.min, box.max, positiveAxes);
+        const glm::vec3 negative = glm::mix(box.max, box.min, positiveAxes);
+        if (glm::dot(glm::vec3(p), positive) + p.w <= 0)
+        {
+          return Frustum::Visibility::Invisible;
+        }
+        full = full && glm::dot(glm::vec3(p), negative) + p.w > 0;
+      }
+
+      return full ? Frustum::Visibility::Full : Frustum::Visibility::Partial;
+    }
+
+    bool TestDistance(const CullView& view, const AABB& box)
+    {
+      const float dist = glm::distance((box.min + box.max) / 2.0f, view.position);
+      return dist >= view.minDistance && dist <= view.maxDistance;
+    }
+  }
+
+  void CullMultiView(std::span<const AABB> boxes, std::span<const CullView> views, std::span<ViewVisibilityMask> outMasks)
+  {
+    ASSERT(views.size() <= MAX_CULL_VIEWS);
+    ASSERT(outMasks.size() >= boxes.size());
+
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+      ViewVisibilityMask mask = 0;
+      for (size_t v = 0; v < views.size(); v++)
+      {
+        if (TestDistance(views[v], boxes[i]) && TestFrustum(views[v], boxes[i]) != Frustum::Visibility::Invisible)
+        {
+          mask |= 1u << v;
+        }
+      }
+      outMasks[i] = mask;
+    }
+  }
+
+  void CullMultiViewHierarchical(std::span<const CullSector> sectors, std::span<const uint32_t> sectorChunks,
+    std::span<const AABB> boxes, std::span<const CullView> views, std::span<ViewVisibilityMask> outMasks)
+  {
+    ASSERT(views.size() <= MAX_CULL_VIEWS);
+    ASSERT(outMasks.size() >= boxes.size());
+    std::fill(outMasks.begin(), outMasks.begin() + boxes.size(), 0);
+
+    for (const auto& sector : sectors)
+    {
+      // phase 1: find the views that may see anything in the sector
+      ViewVisibilityMask visibleMask = 0;
+      ViewVisibilityMask fullMask = 0;
+      for (size_t v = 0; v < views.size(); v++)
+      {
+        // conservative: box distance is measured from box centers, which are all inside the sector
+        const auto& pos = views[v].position;
+        const float nearDist = glm::distance(glm::clamp(pos, sector.box.min, sector.box.max), pos);
+        const float farDist = glm::length(glm::max(glm::abs(sector.box.min - pos), glm::abs(sector.box.max - pos)));
+        if (nearDist > views[v].maxDistance || farDist < views[v].minDistance)
+          continue;
+
+        const auto visibility = TestFrustum(views[v], sector.box);
+        if (visibility == Frustum::Visibility::Invisible)
+          continue;
+
+        visibleMask |= 1u << v;
+        if (visibility == Frustum::Visibility::Full)
+        {
+          fullMask |= 1u << v;
+        }
+      }
+
+      if (visibleMask == 0)
+        continue;
+
+      // phase 2: test the sector's boxes against only those views
+      for (uint32_t c = 0; c < sector.chunkCount; c++)
+      {
+        const uint32_t index = sectorChunks[sector.firstChunk + c];
+        ViewVisibilityMask mask = 0;
+        for (ViewVisibilityMask candidates = visibleMask; candidates != 0; candidates &= candidates - 1)
+        {
+          const auto v = static_cast<uint32_t>(std::countr_zero(candidates));
+          if (!TestDistance(views[v], boxes[index]))
+            continue;
+
+          if ((fullMask & (1u << v)) || TestFrustum(views[v], boxes[index]) != Frustum::Visibility::Invisible)
+          {
+            mask |= 1u << v;
+          }
+        }
+        outMasks[index] = mask;
+      }
+    }
+  }
+
+  std::vector<ViewGroup> GroupViewsByMask(std::span<RenderView*> renderViews, RenderMask required)
+  {
+    std::vector<ViewGroup> groups;
+    for (auto* renderView : renderViews)
+    {
+      if ((renderView->mask & required) != required)
+        continue;
+
+      auto it = std::find_if(groups.begin(), groups.end(), [renderView](const ViewGroup& group)
+        {
+          return group.mask == renderView->mask && group.views.size() < MAX_CULL_VIEWS;
+        });
+      if (it == groups.end())
+      {
+        groups.push_back({ .mask = renderView->mask });
+        it = groups.end() - 1;
+      }
+      it->views.push_back(renderView);
+    }
+    return groups;
+  }
+}
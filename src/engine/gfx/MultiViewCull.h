@@ -0,0 +1,53 @@
+#pragma once
+#include "Frustum.h"
+#include "RenderView.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace GFX
+{
+  // one bit per view, so a single culling pass can handle at most this many views
+  inline constexpr uint32_t MAX_CULL_VIEWS = 32;
+  using ViewVisibilityMask = uint32_t;
+
+  struct CullView
+  {
+    Frustum frustum;
+    glm::vec3 position{};
+    float minDistance{};
+    float maxDistance{};
+  };
+
+  // CPU reference of the multi-view culling shader (compact_batch.cs)
+  // writes a mask of the views each box is visible in
+  // like the shader, the near plane is ignored and distance is measured from the center of the box
+  void CullMultiView(std::span<const AABB> boxes, std::span<const CullView> views, std::span<ViewVisibilityMask> outMasks);
+
+  // a group of neighboring boxes with an AABB enclosing all of them
+  struct CullSector
+  {
+    AABB box;
+    uint32_t firstChunk{}; // index into the sector chunk list
+    uint32_t chunkCount{};
+  };
+
+  // CPU reference of hierarchical culling (cull_sectors.cs, then compact_batch.cs)
+  // sectors are tested first, then only the boxes in surviving sectors are tested against the views that can see the sector
+  // sectorChunks holds indices into boxes, grouped by sector. boxes that are in no sector are not visible
+  // produces the same masks as CullMultiView when every box is in a sector
+  void CullMultiViewHierarchical(std::span<const CullSector> sectors, std::span<const uint32_t> sectorChunks,
+    std::span<const AABB> boxes, std::span<const CullView> views, std::span<ViewVisibilityMask> outMasks);
+
+  // views with identical render masks are culled in the same pass and share one draw list buffer
+  struct ViewGroup
+  {
+    RenderMask mask{};
+    std::vector<RenderView*> views;
+  };
+
+  // views without all of the required bits are skipped
+  // groups and the views inside them are in the order they first appear
+  // a group is split if it would contain more than MAX_CULL_VIEWS views
+  [[nodiscard]] std::vector<ViewGroup> GroupViewsByMask(std::span<RenderView*> renderViews, RenderMask required);
+}
@@ -0,0 +1,138 @@
+#include "../PCH.h"
+#include "ProbeScheduler.h"
+#include <algorithm>
+#include <glm/vector_relational.hpp>
+
+namespace GFX
+{
+  namespace
+  {
+    // same order as the probe cube faces: +x, -x, +y, -y, +z, -z
+    constexpr glm::vec3 faceDirs[ProbeScheduler::FACE_COUNT] =
+    {
+      { 1, 0, 0 },
+      { -1, 0, 0 },
+      { 0, 1, 0 },
+      { 0, -1, 0 },
+      { 0, 0, 1 },
+      { 0, 0, -1 },
+    };
+
+    // returns true if any part of the box (relative to the probe) is inside the 90 degree pyramid of a face
+    bool FaceCanSee(uint32_t face, const glm::vec3& boxMin, const glm::vec3& boxMax)
+    {
+      const glm::vec3 dir = faceDirs[face];
+      const glm::vec3 u = glm::vec3(dir.z != 0, dir.x != 0, dir.y != 0); // any axis perpendicular to dir
+      const glm::vec3 v = glm::cross(dir, u);
+      const glm::vec3 normals[4] = { dir + u, dir - u, dir + v, dir - v };
+
+      for (const auto& n : normals)
+      {
+        // the box is outside a side plane if its most positive corner is behind it
+        const glm::vec3 positive = glm::mix(boxMin, boxMax, glm::greaterThan(n, glm::vec3(0)));
+        if (glm::dot(n, positive) < 0)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+
+  void ProbeScheduler::SetEnabled(bool enabled)
+  {
+    if (enabled && !enabled_)
+    {
+      for (auto& face : faces_)
+      {
+        face.scenePriority = std::max(face.scenePriority, 1.0f);
+      }
+    }
+    enabled_ = enabled;
+  }
+
+  void ProbeScheduler::NotifySceneChange(const AABB& box)
+  {
+    const glm::vec3 boxMin = box.min - position_;
+    const glm::vec3 boxMax = box.max - position_;
+    const glm::vec3 closest = glm::clamp(glm::vec3(0), boxMin, boxMax);
+    if (glm::length(closest) > settings_.sceneChangeRadius)
+    {
+      return;
+    }
+
+    for (uint32_t i = 0; i < FACE_COUNT; i++)
+    {
+      if (FaceCanSee(i, boxMin, boxMax))
+      {
+        faces_[i].scenePriority += 1.0f;
+      }
+    }
+  }
+
+  float ProbeScheduler::GetPriority(uint32_t face) const
+  {
+    ASSERT(face < FACE_COUNT);
+    const auto& state = faces_[face];
+    float priority = state.scenePriority;
+
+    const float moved = glm::distance(position_, state.renderedPosition);
+    if (moved >= settings_.moveThreshold)
+    {
+      priority += moved / std::max(settings_.moveThreshold, 1e-4f);
+    }
+
+    if (settings_.maxStaleFrames > 0 && state.framesSinceUpdate >= settings_.maxStaleFrames)
+    {
+      priority += 1.0f;
+    }
+
+    return priority;
+  }
+
+  ProbeScheduler::FaceMask ProbeScheduler::Schedule()
+  {
+    for (auto& face : faces_)
+    {
+      face.framesSinceUpdate++;
+    }
+
+    if (!enabled_)
+    {
+      return 0;
+    }
+
+    // highest priority first, then stalest, then lowest index so the result is deterministic
+    std::array<uint32_t, FACE_COUNT> order{};
+    std::array<float, FACE_COUNT> priorities{};
+    for (uint32_t i = 0; i < FACE_COUNT; i++)
+    {
+      order[i] = i;
+      priorities[i] = GetPriority(i);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+      {
+        if (priorities[a] != priorities[b])
+          return priorities[a] > priorities[b];
+        if (faces_[a].framesSinceUpdate != faces_[b].framesSinceUpdate)
+          return faces_[a].framesSinceUpdate > faces_[b].framesSinceUpdate;
+        return a < b;
+      });
+
+    FaceMask mask = 0;
+    const uint32_t budget = std::min(settings_.facesPerFrame, FACE_COUNT);
+    for (uint32_t i = 0; i < budget; i++)
+    {
+      const uint32_t face = order[i];
+      if (priorities[face] <= 0)
+        break;
+
+      mask |= 1u << face;
+      faces_[face].renderedPosition = position_;
+      faces_[face].scenePriority = 0;
+      faces_[face].framesSinceUpdate = 0;
+    }
+
+    return mask;
+  }
+}
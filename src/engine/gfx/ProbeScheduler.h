@@ -0,0 +1,62 @@
+#pragma once
+#include <engine/Shapes.h>
+#include <glm/vec3.hpp>
+#include <array>
+#include <cstdint>
+
+namespace GFX
+{
+  // Decides which faces of a cube probe get re-rendered each frame.
+  // Faces accumulate priority when the probe moves away from where the face was last rendered
+  // or when the scene changes in the part of the world the face covers.
+  // At most facesPerFrame faces with nonzero priority are picked per frame- every other face keeps its previous contents.
+  // Contains no API calls, so it can be driven and inspected on the CPU alone.
+  class ProbeScheduler
+  {
+  public:
+    static constexpr uint32_t FACE_COUNT = 6;
+    using FaceMask = uint32_t; // bit i set = face i should be rendered
+
+    struct Settings
+    {
+      uint32_t facesPerFrame = 1;
+      float moveThreshold = 0.5f;      // distance the probe must move for a face to need an update
+      float sceneChangeRadius = 100.0f; // changes farther than this from the probe are ignored
+      uint32_t maxStaleFrames = 0;     // if nonzero, faces are refreshed at least this often
+    };
+
+    void SetSettings(const Settings& settings) { settings_ = settings; }
+    [[nodiscard]] const Settings& GetSettings() const { return settings_; }
+
+    // disabled schedulers never schedule faces. enabling makes every face dirty
+    void SetEnabled(bool enabled);
+    [[nodiscard]] bool GetEnabled() const { return enabled_; }
+
+    void SetPosition(glm::vec3 position) { position_ = position; }
+    [[nodiscard]] glm::vec3 GetPosition() const { return position_; }
+
+    // marks the faces that can see the box as dirty
+    void NotifySceneChange(const AABB& box);
+
+    // call once per frame. returns the faces to render this frame, which are then considered up-to-date
+    [[nodiscard]] FaceMask Schedule();
+
+    [[nodiscard]] float GetPriority(uint32_t face) const;
+
+    // the position each face was last rendered from
+    [[nodiscard]] glm::vec3 GetFacePosition(uint32_t face) const { return faces_[face].renderedPosition; }
+
+  private:
+    struct FaceState
+    {
+      glm::vec3 renderedPosition{};
+      float scenePriority{};
+      uint32_t framesSinceUpdate{};
+    };
+
+    Settings settings_{};
+    bool enabled_{ false };
+    glm::vec3 position_{};
+    std::array<FaceState, FACE_COUNT> faces_{};
+  };
+}
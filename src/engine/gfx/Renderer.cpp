@@ -2,11 +2,13 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtx/norm.hpp>
+#include <glm/gtc/packing.hpp>
 #include "Renderer.h"
 
 #include "resource/ShaderManager.h"
 #include "resource/MaterialManager.h"
 #include "Mesh.h"
+#include <engine/Shapes.h>
 #include "api/DebugMarker.h"
 
 #include <engine/ecs/system/ParticleSystem.h>
@@ -19,23 +21,28 @@
 #include "TextureLoader.h"
 #include "api/Fence.h"
 
-#include <execution>
 #include <iostream>
 #include <vector>
 #include <array>
 #include <map>
+#include <unordered_map>
 
 #include "../CVar.h"
 #include "../Console.h"
 #include "../Parser.h"
 #include <engine/core/StatMacros.h>
+#include <engine/core/JobSystem.h>
 #include "../../utility/MathExtensions.h"
+#include "../../utility/PerThreadBuffer.h"
 #include "api/Texture.h"
 #include "api/Framebuffer.h"
 #include "api/LinearBufferAllocator.h"
+#include "api/FrameArena.h"
 #include "api/Indirect.h"
 
 #include "RenderView.h"
+#include "Frustum.h"
+#include "ProbeScheduler.h"
 
 #include "fx/FXAA.h"
 #include "fx/Bloom.h"
@@ -125,14 +132,20 @@ namespace GFX
 
   void setReflectionsModeCallback(const char*, cvar_float scale)
   {
-    Renderer::SetUpdateProbes(scale < Renderer::REFLECTION_MODE_CUBE_THRESHOLD);
+    Renderer::SetUpdateProbes(scale >= Renderer::REFLECTION_MODE_CUBE_THRESHOLD);
   }
 
   AutoCVar<cvar_float> vsyncCvar("r.vsync", "- Whether vertical sync is enabled", 0, 0, 1, CVarFlag::NONE, vsyncCallback);
   AutoCVar<cvar_float> renderScaleCvar("r.scale", "- Internal rendering resolution scale", 1.0, 0.1, 2.0, CVarFlag::NONE, setRenderScale);
   AutoCVar<cvar_float> reflectionsScaleCvar("r.reflections.scale", "- Internal reflections resolution scale", 1.0, 0.1, 1.0, CVarFlag::NONE, setReflectionScale);
-  AutoCVar<cvar_float> reflectionsModeCvar("r.reflections.mode", "- Reflections mode. 0: skybox, 1: probe, 2: parallax correct probe", 2.0, 0.0, 2.0);
+  AutoCVar<cvar_float> reflectionsModeCvar("r.reflections.mode", "- Reflections mode. 0: skybox, 1: probe, 2: parallax correct probe", 2.0, 0.0, 2.0, CVarFlag::NONE, setReflectionsModeCallback);
   AutoCVar<cvar_float> reflectionsDenoiseEnableCvar("r.reflections.denoiseEnable", "- If true, reflections will receive spatial denoising", 1.0, 0.0, 1.0);
+  AutoCVar<cvar_float> probeFacesPerFrameCvar("r.probes.facesPerFrame", "- Maximum number of probe faces to re-render each frame", 1, 1, 6);
+  AutoCVar<cvar_float> probeMoveThresholdCvar("r.probes.moveThreshold", "- Distance the probe must move before its faces are re-rendered", 0.5, 0, 100);
+  AutoCVar<cvar_float> probeSceneRadiusCvar("r.probes.sceneChangeRadius", "- Scene changes farther than this from the probe do not cause re-renders", 100, 0, 10000);
+  AutoCVar<cvar_float> lodErrorPixelsCvar("r.meshes.lodErrorPixels", "- Batched meshes use the coarsest LOD whose error covers at most this many pixels. 0 disables LODs", 1.0, 0, 100);
+  AutoCVar<cvar_float> packVerticesCvar("r.meshes.packVertices", "- If true, batched meshes are uploaded with packed normals and texture coordinates. Read at startup", 1, 0, 1, CVarFlag::INIT);
+  AutoCVar<cvar_float> probeMaxStaleFramesCvar("r.probes.maxStaleFrames", "- If nonzero, probe faces are re-rendered at least this often (in frames)", 30, 0, 1000);
   //AutoCVar<cvar_float> fullscreenCvar("r.fullscreen", "- Whether the window is fullscreen", 0, 0, 1, CVarFlag::NONE, fullscreenCallback);
 
   static void GLAPIENTRY GLerrorCB(
@@ -209,6 +222,11 @@ namespace GFX
 
       std::vector<std::string> openglExtensions;
 
+      // merges each thread's submissions on the job system
+      constexpr auto ParallelForEach = [](auto first, auto last, auto&& fn)
+      {
+        engine::Core::JobSystem::Get()->ForEach(first, last, fn);
+      };
 
       // particle rendering
       struct EmitterDrawCommand
@@ -216,7 +234,7 @@ namespace GFX
         const Component::ParticleEmitter* emitter;
         glm::mat4 modelUniform;
       };
-      std::atomic_uint32_t emitterDrawIndex = 0;
+      PerThreadBuffer<EmitterDrawCommand> emitterSubmissions;
       std::vector<EmitterDrawCommand> emitterDrawCommands;
 
       // std140
@@ -231,21 +249,46 @@ namespace GFX
       std::optional<LinearBufferAllocator> vertexBufferAlloc;
       std::optional<LinearBufferAllocator> indexBufferAlloc;
 
+      // transient per-frame data (batch uniforms, draw commands)
+      std::optional<FrameArena> frameArena;
+      size_t ssboOffsetAlignment{ 256 };
+
       // per-vertex layout
       uint32_t batchVAO{};
+      bool packBatchVertices{}; // fixed for the lifetime of vertexBuffer
 
-      // maps handles to VERTEX and INDEX information in the respective dynamic buffers
+      // maps handles and LODs to VERTEX and INDEX information in the respective dynamic buffers
       // used to retrieve important offset and size info for meshes
-      std::map<MeshID, DrawElementsIndirectCommand> meshBufferInfo;
+      std::map<std::pair<MeshID, uint32_t>, DrawElementsIndirectCommand> meshBufferInfo;
+
+      // what SubmitObject needs to pick a LOD. read-only while objects are being submitted
+      struct BatchedMeshLods
+      {
+        glm::vec3 center{};
+        float radius{};
+        uint32_t lodCount{};
+        float errors[MAX_MESH_LODS]{};
+      };
+      std::unordered_map<MeshID, BatchedMeshLods> meshLods;
+
+      // the main view, as seen by LOD selection. set by BeginObjects
+      struct LodView
+      {
+        glm::vec3 position{};
+        float nearPlane{};
+        float pixelsPerUnit{}; // pixels covered by an object space unit one unit in front of the camera
+        float maxErrorPixels{};
+      }lodView;
 
       struct BatchDrawCommand
       {
         MeshID mesh;
+        uint32_t lod;
         MaterialID material;
         glm::mat4 modelUniform;
       };
+      PerThreadBuffer<BatchDrawCommand> userSubmissions;
       std::vector<BatchDrawCommand> userCommands;
-      std::atomic_uint32_t cmdIndex{ 0 };
 
       uint32_t emptyVao{};
 
@@ -326,6 +369,8 @@ namespace GFX
         Format depthFormat = Format::D16_UNORM;
         Format distanceFormat = Format::R16_FLOAT;
         Extent2D imageSize{ 512, 512 };
+        RenderMask renderMask{}; // applied to faces that are scheduled to render this frame
+        ProbeScheduler scheduler;
       }probeData;
 
       struct Composited_t
@@ -518,18 +563,48 @@ namespace GFX
       gBuffer.fbo->Bind();
     }
 
-    void AddBatchedMesh(MeshID id, const std::vector<Vertex>& vertices, const std::vector<Index>& indices)
+    void AddBatchedMesh(MeshID id, std::span<const Vertex> vertices, std::span<const Index> indices,
+      std::span<const MeshLod> lods, const AABB& bounds)
     {
-      auto vOffset = vertexBufferAlloc->Allocate(std::span(vertices), sizeof(Vertex));
-      auto iOffset = indexBufferAlloc->Allocate(std::span(indices), sizeof(Index));
-      // generate an indirect draw command with most of the info needed to draw this mesh
-      DrawElementsIndirectCommand cmd{};
-      cmd.baseVertex = vOffset / sizeof(Vertex);
-      cmd.instanceCount = 0;
-      cmd.count = static_cast<uint32_t>(indices.size());
-      cmd.firstIndex = iOffset / sizeof(Index);
-      //cmd.baseInstance = ?; // only knowable after all user draw calls are submitted
-      meshBufferInfo[id] = cmd;
+      ASSERT(!lods.empty() && lods.size() <= MAX_MESH_LODS);
+      size_t vertexStride = sizeof(Vertex);
+      size_t vOffset{};
+      if (packBatchVertices)
+      {
+        std::vector<PackedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+          packed[i].position = vertices[i].position;
+          packed[i].normal = glm::packSnorm3x10_1x2(glm::vec4(vertices[i].normal, 0));
+          packed[i].texCoord = glm::packHalf2x16(vertices[i].texCoord);
+        }
+        vertexStride = sizeof(PackedVertex);
+        vOffset = vertexBufferAlloc->Allocate(std::span(packed), vertexStride);
+      }
+      else
+      {
+        vOffset = vertexBufferAlloc->Allocate(vertices, vertexStride);
+      }
+      auto iOffset = indexBufferAlloc->Allocate(indices, sizeof(Index));
+
+      BatchedMeshLods& lodInfo = meshLods[id];
+      lodInfo.center = (bounds.min + bounds.max) / 2.0f;
+      lodInfo.radius = glm::distance(bounds.min, bounds.max) / 2.0f;
+      lodInfo.lodCount = static_cast<uint32_t>(lods.size());
+
+      // generate an indirect draw command with most of the info needed to draw each LOD of this mesh
+      for (uint32_t i = 0; i < lods.size(); i++)
+      {
+        ASSERT(lods[i].firstIndex + lods[i].indexCount <= indices.size());
+        DrawElementsIndirectCommand cmd{};
+        cmd.baseVertex = vOffset / vertexStride;
+        cmd.instanceCount = 0;
+        cmd.count = lods[i].indexCount;
+        cmd.firstIndex = static_cast<uint32_t>(iOffset / sizeof(Index)) + lods[i].firstIndex;
+        //cmd.baseInstance = ?; // only knowable after all user draw calls are submitted
+        meshBufferInfo[{ id, i }] = cmd;
+        lodInfo.errors[i] = lods[i].error;
+      }
     }
 
     float GetWindowAspectRatio()
@@ -557,54 +632,81 @@ namespace GFX
       return isFullscreen;
     }
 
-    void BeginObjects(size_t maxDraws)
+    void BeginObjects()
     {
-      cmdIndex = 0;
-      userCommands.resize(maxDraws);
+      userSubmissions.Clear();
+
+      // every view draws the LODs picked for the main view
+      lodView = {};
+      if (const Camera* camera = gBuffer.renderView.camera)
+      {
+        lodView.position = camera->viewInfo.position;
+        lodView.nearPlane = camera->projInfo.info.nearPlane;
+        lodView.pixelsPerUnit = renderHeight / (2.0f * glm::tan(camera->projInfo.info.fovyRadians / 2.0f));
+        lodView.maxErrorPixels = static_cast<float>(lodErrorPixelsCvar.Get());
+      }
+    }
+
+    uint32_t SelectLod(MeshID mesh, const glm::mat4& model)
+    {
+      auto it = meshLods.find(mesh);
+      if (it == meshLods.end() || it->second.lodCount <= 1 || lodView.maxErrorPixels <= 0)
+      {
+        return 0;
+      }
+
+      const BatchedMeshLods& info = it->second;
+      const float scale = glm::sqrt(glm::max(glm::length2(glm::vec3(model[0])), glm::max(glm::length2(glm::vec3(model[1])), glm::length2(glm::vec3(model[2])))));
+      const glm::vec3 center = model * glm::vec4(info.center, 1.0f);
+
+      // measured to the nearest point of the bounding sphere, so that big meshes don't coarsen up close
+      const float distance = glm::max(glm::distance(center, lodView.position) - info.radius * scale, lodView.nearPlane);
+      const float pixelsPerUnit = lodView.pixelsPerUnit * scale / distance;
+
+      uint32_t lod = 0;
+      while (lod + 1 < info.lodCount && info.errors[lod + 1] * pixelsPerUnit <= lodView.maxErrorPixels)
+      {
+        lod++;
+      }
+      return lod;
     }
 
     void SubmitObject(const Component::Model& model, const Component::BatchedMesh& mesh, const Component::Material& mat)
     {
-      auto index = cmdIndex.fetch_add(1, std::memory_order::memory_order_acq_rel);
-      userCommands[index] = BatchDrawCommand{ .mesh = mesh.handle, .material = mat.handle, .modelUniform = model.matrix };
+      userSubmissions.Push(BatchDrawCommand{ .mesh = mesh.handle, .lod = SelectLod(mesh.handle, model.matrix), .material = mat.handle, .modelUniform = model.matrix });
     }
 
-    void RenderBatchHelper(std::span<RenderView*> renderViews, MaterialID mat, const std::vector<UniformData>& uniforms)
+    // same planes as chunk culling, which ignores the near plane
+    bool IsSphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius)
+    {
+      for (int p = 0; p < 5; p++)
+      {
+        const glm::vec4 plane = frustum.GetPlane(static_cast<Frustum::Plane>(p));
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // draws must be sorted by mesh, then LOD
+    void RenderBatchHelper(std::span<RenderView*> renderViews, MaterialID mat, std::span<const BatchDrawCommand> draws)
     {
       //ASSERT(MaterialManager::Get()->materials_.contains(mat));
       auto material = *MaterialManager::GetMaterialInfo(mat);
       DebugMarker marker(("Batch: " + std::string(material.shaderID)).c_str());
 
-      // generate SSBO w/ uniforms
-      //Buffer uniformBuffer = Buffer(uniforms.data(), uniforms.size() * sizeof(UniformData));
-      auto uniformBuffer = Buffer::Create(std::span(uniforms));
-      uniformBuffer->Bind<Target::SHADER_STORAGE_BUFFER>(0);
-
-      // generate DIB (one indirect command per mesh)
-      std::vector<DrawElementsIndirectCommand> commands;
-      GLuint baseInstance = 0;
-      std::for_each(meshBufferInfo.begin(), meshBufferInfo.end(),
-        [&commands, &baseInstance](auto& cmd)
-        {
-          if (cmd.second.instanceCount != 0)
-          {
-            cmd.second.baseInstance = baseInstance;
-            //cmd.second.instanceCount += baseInstance;
-            commands.push_back(cmd.second);
-            baseInstance += cmd.second.instanceCount;
-          }
-        });
-      //Buffer dib(commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
-      auto drawIndirectBuffer = Buffer::Create(std::span(commands));
-      drawIndirectBuffer->Bind<Target::DRAW_INDIRECT_BUFFER>();
-
-      // clear instance count for next GL draw command
-      for (auto& info : meshBufferInfo)
+      // bounding spheres in world space, shared by every view
+      std::vector<glm::vec4> spheres(draws.size());
+      for (size_t i = 0; i < draws.size(); i++)
       {
-        info.second.instanceCount = 0;
+        const BatchedMeshLods& info = meshLods[draws[i].mesh];
+        const glm::mat4& model = draws[i].modelUniform;
+        const float scale = glm::sqrt(glm::max(glm::length2(glm::vec3(model[0])), glm::max(glm::length2(glm::vec3(model[1])), glm::length2(glm::vec3(model[2])))));
+        spheres[i] = glm::vec4(glm::vec3(model * glm::vec4(info.center, 1.0f)), info.radius * scale);
       }
 
-      // do the actual draw
       auto shader = ShaderManager::GetShader(material.shaderID);
       shader->Bind();
 
@@ -621,26 +723,63 @@ namespace GFX
         BindTextureView(i++, view, sampler);
       }
 
-      // TODO: perform GPU culling somewhere around here
-
       auto framebuffer = Framebuffer::Create();
       framebuffer->Bind();
+      glBindVertexArray(batchVAO);
 
+      // each view draws only the instances in its frustum, so each gets its own uniforms and commands
+      std::vector<UniformData> uniforms;
+      std::vector<DrawElementsIndirectCommand> commands;
       for (auto& renderView : renderViews)
       {
         if (!(renderView->mask & RenderMaskBit::RenderObjects))
           continue;
 
+        const Camera& camera = *renderView->camera;
+        const Frustum frustum(camera.projInfo.GetProjMatrix(), camera.viewInfo.GetViewMatrix());
+
+        // one indirect command per mesh and LOD with visible instances
+        uniforms.clear();
+        commands.clear();
+        const BatchDrawCommand* lastVisible = nullptr;
+        for (size_t i = 0; i < draws.size(); i++)
+        {
+          if (!IsSphereInFrustum(frustum, glm::vec3(spheres[i]), spheres[i].w))
+            continue;
+
+          const auto& draw = draws[i];
+          if (!lastVisible || lastVisible->mesh != draw.mesh || lastVisible->lod != draw.lod)
+          {
+            DrawElementsIndirectCommand cmd = meshBufferInfo[{ draw.mesh, draw.lod }];
+            cmd.instanceCount = 0;
+            cmd.baseInstance = static_cast<GLuint>(uniforms.size());
+            commands.push_back(cmd);
+          }
+          commands.back().instanceCount++;
+          uniforms.push_back(UniformData{ .model = draw.modelUniform });
+          lastVisible = &draw;
+        }
+
+        if (commands.empty())
+          continue;
+
+        // upload to this frame's arena region. views that don't fit are skipped
+        auto uniformAlloc = frameArena->Allocate(std::span(uniforms), ssboOffsetAlignment);
+        auto commandAlloc = uniformAlloc ? frameArena->Allocate(std::span(commands), sizeof(GLuint)) : std::nullopt;
+        if (!commandAlloc)
+          continue;
+        frameArena->BindRange<Target::SHADER_STORAGE_BUFFER>(0, *uniformAlloc);
+        frameArena->Bind<Target::DRAW_INDIRECT_BUFFER>();
+
         SetFramebufferDrawBuffersAuto(*framebuffer, renderView->renderInfo, 3);
 
         ASSERT(renderView->renderInfo.depthAttachment.has_value());
         framebuffer->SetAttachment(Attachment::DEPTH, *renderView->renderInfo.depthAttachment->textureView, 0);
 
-        shader->SetMat4("u_viewProj", renderView->camera->GetViewProj());
+        shader->SetMat4("u_viewProj", camera.GetViewProj());
 
         SetViewport(renderView->renderInfo);
-        glBindVertexArray(batchVAO);
-        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, static_cast<GLsizei>(commands.size()), 0);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void*>(commandAlloc->offset), static_cast<GLsizei>(commands.size()), 0);
       }
 
       for (int i = 0; auto & [view, sampler] : material.viewSamplers)
@@ -653,7 +792,13 @@ namespace GFX
     {
       DebugMarker marker("Draw batched objects");
 
-      userCommands.resize(cmdIndex);
+      userSubmissions.MergeInto(userCommands, ParallelForEach);
+      if (!frameArena)
+      {
+        // the uniforms and commands have nowhere to go
+        userCommands.clear();
+        return;
+      }
       if (userCommands.empty())
       {
         return;
@@ -666,51 +811,37 @@ namespace GFX
       glCullFace(GL_BACK);
       glFrontFace(GL_CCW);
 
-      // NOTE: mesh order MUST match meshBufferInfo's
-      std::sort(std::execution::par, userCommands.begin(), userCommands.end(),
+      // instances of the same mesh and LOD end up next to each other, so they share an indirect command
+      std::sort(userCommands.begin(), userCommands.end(),
         [](const auto& lhs, const auto& rhs)
         {
           if (lhs.material != rhs.material)
             return lhs.material < rhs.material;
-          else
+          else if (lhs.mesh != rhs.mesh)
             return lhs.mesh < rhs.mesh;
+          else
+            return lhs.lod < rhs.lod;
         });
 
-      // accumulate per-material draws and uniforms
-      std::vector<UniformData> uniforms;
-      uniforms.reserve(userCommands.size());
-      MaterialID curMat = userCommands[0].material;
-      for (size_t i = 0; i < userCommands.size(); i++)
+      // one batch per material
+      for (auto first = userCommands.begin(); first != userCommands.end();)
       {
-        const auto& draw = userCommands[i];
-        if (draw.material != curMat)
-        {
-          RenderBatchHelper(renderViews, curMat, uniforms); // submit draw when material is done
-          curMat = draw.material;
-          uniforms.clear();
-        }
-
-        meshBufferInfo[draw.mesh].instanceCount++;
-        uniforms.push_back(UniformData{ .model = draw.modelUniform });
-      }
-      if (uniforms.size() > 0)
-      {
-        RenderBatchHelper(renderViews, curMat, uniforms);
+        auto last = std::find_if(first, userCommands.end(), [&](const auto& draw) { return draw.material != first->material; });
+        RenderBatchHelper(renderViews, first->material, std::span(first, last));
+        first = last;
       }
 
       userCommands.clear();
     }
 
-    void BeginEmitters(size_t maxDraws)
+    void BeginEmitters()
     {
-      emitterDrawIndex = 0;
-      emitterDrawCommands.resize(maxDraws);
+      emitterSubmissions.Clear();
     }
 
-    void SubmitEmitter(const Component::ParticleEmitter& emitter, const Component::Transform& model)
+    void SubmitEmitter(const Component::ParticleEmitter& emitter, const glm::mat4& model)
     {
-      auto index = emitterDrawIndex.fetch_add(1);
-      emitterDrawCommands[index] = { &emitter, model.GetModel() };
+      emitterSubmissions.Push({ &emitter, model });
     }
 
     void RenderEmitters(std::span<RenderView*> renderViews)
@@ -718,7 +849,7 @@ namespace GFX
 #if LOG_PARTICLE_RENDER_TIME
       GFX::TimerQuery timerQuery;
 #endif
-      emitterDrawCommands.resize(emitterDrawIndex);
+      emitterSubmissions.MergeInto(emitterDrawCommands, ParallelForEach);
       if (emitterDrawCommands.empty())
       {
         return;
@@ -821,6 +952,7 @@ namespace GFX
 
     void CompileShaders()
     {
+      ShaderManager::BeginBatch();
       ShaderManager::AddShader("batched",
         {
           { "TexturedMeshBatched.vs.glsl", ShaderType::VERTEX },
@@ -834,6 +966,8 @@ namespace GFX
         });
       ShaderManager::AddShader("compact_batch",
         { { "compact_batch.cs.glsl", ShaderType::COMPUTE } });
+      ShaderManager::AddShader("cull_sectors",
+        { { "cull_sectors.cs.glsl", ShaderType::COMPUTE } });
       ShaderManager::AddShader("update_particle_emitter",
         { { "update_particle_emitter.cs.glsl", ShaderType::COMPUTE } });
       ShaderManager::AddShader("update_particle",
@@ -893,6 +1027,7 @@ namespace GFX
       FX::CompileBloomShaders();
       FX::CompileFogShader();
       FX::Volumetric::CompileShaders();
+      ShaderManager::EndBatch();
     }
 
     void DrawAxisIndicator(std::span<RenderView*> renderViews)
@@ -975,6 +1110,33 @@ namespace GFX
 
     void StartFrame()
     {
+      if (frameArena)
+      {
+        frameArena->NextFrame();
+      }
+
+      // faces that are not scheduled keep last frame's contents
+      probeData.scheduler.SetSettings(
+        {
+          .facesPerFrame = static_cast<uint32_t>(probeFacesPerFrameCvar.Get()),
+          .moveThreshold = static_cast<float>(probeMoveThresholdCvar.Get()),
+          .sceneChangeRadius = static_cast<float>(probeSceneRadiusCvar.Get()),
+          .maxStaleFrames = static_cast<uint32_t>(probeMaxStaleFramesCvar.Get()),
+        });
+      const auto probeFaces = probeData.scheduler.Schedule();
+      for (uint32_t i = 0; i < ProbeScheduler::FACE_COUNT; i++)
+      {
+        if (probeFaces & (1u << i))
+        {
+          probeData.cameras[i].viewInfo.position = probeData.scheduler.GetFacePosition(i);
+          probeData.renderViews[i].mask = probeData.renderMask;
+        }
+        else
+        {
+          probeData.renderViews[i].mask = RenderMaskBit::None;
+        }
+      }
+
       glClearColor(0, 0, 0, 0);
 
       reflect.fbo->Bind();
@@ -1014,6 +1176,10 @@ namespace GFX
 
       for (auto& renderView : renderViews)
       {
+        // views that render nothing this frame keep their previous contents
+        if (renderView->mask == RenderMaskBit::None)
+          continue;
+
         for (size_t i = 0; i < RenderInfo::maxColorAttachments; i++)
         {
           const auto& attachment = renderView->renderInfo.colorAttachments[i];
@@ -1316,31 +1482,23 @@ namespace GFX
 
     void SetProbePosition(glm::vec3 worldPos)
     {
-      for (size_t i = 0; i < 6; i++)
-      {
-        probeData.cameras[i].viewInfo.position = worldPos;
-      }
+      // cameras are moved when their face is scheduled
+      probeData.scheduler.SetPosition(worldPos);
     }
 
     void SetProbeRenderMask(RenderMask mask)
     {
-      for (size_t i = 0; i < 6; i++)
-      {
-        probeData.renderViews[i].mask = mask;
-      }
+      probeData.renderMask = mask;
     }
 
-    // TODO: this function
     void SetUpdateProbes(bool b)
     {
-      if (b)
-      {
-
-      }
-      else
-      {
+      probeData.scheduler.SetEnabled(b);
+    }
 
-      }
+    void NotifyProbeSceneChange(const AABB& box)
+    {
+      probeData.scheduler.NotifySceneChange(box);
     }
 
     void InitVertexBuffers()
@@ -1350,6 +1508,15 @@ namespace GFX
       vertexBufferAlloc = LinearBufferAllocator::Create(&vertexBuffer.value());
       indexBufferAlloc = LinearBufferAllocator::Create(&indexBuffer.value());
 
+      GLint alignment{};
+      glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+      ssboOffsetAlignment = static_cast<size_t>(alignment);
+      frameArena = FrameArena::Create(8'000'000);
+      if (!frameArena)
+      {
+        spdlog::error("Failed to create the frame arena, batched meshes will not be drawn");
+      }
+
       constexpr float indicatorVertices[] =
       {
         // positions      // colors
@@ -1370,13 +1537,24 @@ namespace GFX
       glEnableVertexArrayAttrib(batchVAO, 0); // pos
       glEnableVertexArrayAttrib(batchVAO, 1); // normal
       glEnableVertexArrayAttrib(batchVAO, 2); // uv
-      glVertexArrayAttribFormat(batchVAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
-      glVertexArrayAttribFormat(batchVAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
-      glVertexArrayAttribFormat(batchVAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoord));
+      // packed attributes are unpacked by the vertex fetch, so the shaders see the same inputs either way
+      packBatchVertices = packVerticesCvar.Get() != 0;
+      if (packBatchVertices)
+      {
+        glVertexArrayAttribFormat(batchVAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, position));
+        glVertexArrayAttribFormat(batchVAO, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertex, normal));
+        glVertexArrayAttribFormat(batchVAO, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texCoord));
+      }
+      else
+      {
+        glVertexArrayAttribFormat(batchVAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        glVertexArrayAttribFormat(batchVAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+        glVertexArrayAttribFormat(batchVAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoord));
+      }
       glVertexArrayAttribBinding(batchVAO, 0, 0);
       glVertexArrayAttribBinding(batchVAO, 1, 0);
       glVertexArrayAttribBinding(batchVAO, 2, 0);
-      glVertexArrayVertexBuffer(batchVAO, 0, vertexBuffer->GetAPIHandle(), 0, sizeof(Vertex));
+      glVertexArrayVertexBuffer(batchVAO, 0, vertexBuffer->GetAPIHandle(), 0, packBatchVertices ? sizeof(PackedVertex) : sizeof(Vertex));
       glVertexArrayElementBuffer(batchVAO, indexBuffer->GetAPIHandle());
 
       // empty VAO for bufferless drawing
@@ -1741,6 +1919,7 @@ namespace GFX
       InitVertexLayouts();
       CompileShaders();
       InitTextures();
+      SetUpdateProbes(reflectionsModeCvar.Get() >= REFLECTION_MODE_CUBE_THRESHOLD);
 
       // enable debugging stuff
       glEnable(GL_DEBUG_OUTPUT);
@@ -5,7 +5,6 @@
 
 namespace Component
 {
-  struct Transform;
   struct BatchedMesh;
   struct Material;
   struct ParticleEmitter;
@@ -13,6 +12,7 @@ namespace Component
 }
 
 struct GLFWwindow;
+struct AABB;
 
 namespace GFX
 {
@@ -26,12 +26,13 @@ namespace GFX
     GLFWwindow* const* Init();
 
     // big boy drawing functions
-    void BeginObjects(size_t maxDraws);
+    // Submit* may be called from any number of threads between Begin* and Render*
+    void BeginObjects();
     void SubmitObject(const Component::Model& model, const Component::BatchedMesh& mesh, const Component::Material& mat);
     void RenderObjects(std::span<RenderView*> renderViews);
 
-    void BeginEmitters(size_t maxDraws);
-    void SubmitEmitter(const Component::ParticleEmitter& emitter, const Component::Transform& model);
+    void BeginEmitters();
+    void SubmitEmitter(const Component::ParticleEmitter& emitter, const glm::mat4& model);
     void RenderEmitters(std::span<RenderView*> renderViews);
 
     void DrawFog(std::span<RenderView*> renderViews, bool earlyFogPass);
@@ -57,7 +58,9 @@ namespace GFX
 
     [[nodiscard]] bool GetIsFullscreen();
 
-    void AddBatchedMesh(MeshID id, const std::vector<Vertex>& vertices, const std::vector<Index>& indices);
+    // lods are ranges of indices, from the full mesh to the coarsest. bounds are in object space
+    void AddBatchedMesh(MeshID id, std::span<const Vertex> vertices, std::span<const Index> indices,
+      std::span<const MeshLod> lods, const AABB& bounds);
 
     void SetFramebufferSize(uint32_t width, uint32_t height);
     void SetRenderingScale(float scale);
@@ -71,7 +74,8 @@ namespace GFX
 
     void SetProbePosition(glm::vec3 worldPos);
     void SetProbeRenderMask(RenderMask mask);
-    void SetUpdateProbes(bool b); // if true, probes will be updated (expensive)
+    void SetUpdateProbes(bool b); // if true, probe faces will be updated when they are out of date (time-sliced)
+    void NotifyProbeSceneChange(const AABB& box); // call when geometry inside the box changes
 
     static inline constexpr float REFLECTION_MODE_PARALLAX_CUBE_THRESHOLD = 2.0f;
     static inline constexpr float REFLECTION_MODE_CUBE_THRESHOLD = 1.0f;
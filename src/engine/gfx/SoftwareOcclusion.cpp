@@ -0,0 +1,364 @@
+#include "../PCH.h"
+#include "SoftwareOcclusion.h"
+#include <engine/core/JobSystem.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#else
+#define OCCLUSION_SSE2 0
+#endif
+
+namespace GFX
+{
+  namespace
+  {
+    // occluders are clipped this close to the eye, as 1/w blows up at the eye
+    constexpr float NEAR_W = 0.05f;
+
+    // occluders are clipped to this many times the size of the screen, which keeps the edge functions
+    // precise without clipping most triangles
+    constexpr float GUARD_BAND = 2.0f;
+
+    constexpr uint32_t ROWS_PER_JOB = 8;
+
+    // near plane first, then the guard band
+    constexpr int CLIP_PLANES = 5;
+    float ClipDistance(const glm::vec4& v, int plane)
+    {
+      switch (plane)
+      {
+      case 0: return v.w - NEAR_W;
+      case 1: return GUARD_BAND * v.w - v.x;
+      case 2: return GUARD_BAND * v.w + v.x;
+      case 3: return GUARD_BAND * v.w - v.y;
+      default: return GUARD_BAND * v.w + v.y;
+      }
+    }
+
+    // Sutherland-Hodgman. each plane adds at most one vertex to a convex polygon
+    constexpr int MAX_CLIPPED_VERTICES = OcclusionBuffer::MAX_POLYGON_VERTICES;
+    static_assert(MAX_CLIPPED_VERTICES >= 4 + CLIP_PLANES);
+    int ClipPolygon(glm::vec4 (&polygon)[MAX_CLIPPED_VERTICES], int count)
+    {
+      glm::vec4 clipped[MAX_CLIPPED_VERTICES];
+      for (int plane = 0; plane < CLIP_PLANES && count > 0; plane++)
+      {
+        int clippedCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+          const glm::vec4& a = polygon[i];
+          const glm::vec4& b = polygon[(i + 1) % count];
+          const float da = ClipDistance(a, plane);
+          const float db = ClipDistance(b, plane);
+          if (da >= 0)
+          {
+            clipped[clippedCount++] = a;
+          }
+          if ((da >= 0) != (db >= 0))
+          {
+            clipped[clippedCount++] = a + (b - a) * (da / (da - db));
+          }
+        }
+        std::copy_n(clipped, clippedCount, polygon);
+        count = clippedCount;
+      }
+      return count;
+    }
+
+    // a*x + b*y + c
+    struct LinearFunction
+    {
+      float a, b, c;
+
+      // the smallest value over a pixel, given the value at its center
+      float HalfPixelExtent() const { return 0.5f * (std::abs(a) + std::abs(b)); }
+    };
+
+    // positive to the left of a->b
+    LinearFunction Edge(const glm::vec3& a, const glm::vec3& b)
+    {
+      return { a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x };
+    }
+
+    // twice the signed area, positive if counterclockwise
+    float Area(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+    {
+      return (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    }
+
+    // edges this short (in pixels) are dropped, as their direction is mostly rounding error
+    constexpr float MIN_EDGE_LENGTH = 1e-4f;
+  }
+
+  OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+    : width_((width + 3) & ~3u), height_(height), useSimd_(OCCLUSION_SSE2)
+  {
+    ASSERT(width_ > 0 && height_ > 0);
+    depth_.resize(width_ * height_);
+  }
+
+
+  void OcclusionBuffer::Begin(const glm::mat4& viewProj)
+  {
+    viewProj_ = viewProj;
+    std::fill(depth_.begin(), depth_.end(), 0.0f);
+  }
+
+
+  void OcclusionBuffer::RasterizeOccluders(std::span<const OccluderQuad> quads)
+  {
+    // transform, clip and project once, then share the polygons between bands
+    polygons_.clear();
+    for (const auto& quad : quads)
+    {
+      glm::vec4 clipped[MAX_CLIPPED_VERTICES];
+      for (int i = 0; i < 4; i++)
+      {
+        clipped[i] = viewProj_ * glm::vec4(quad.corners[i], 1.0f);
+      }
+
+      const int count = ClipPolygon(clipped, 4);
+      if (count < 3)
+      {
+        continue;
+      }
+
+      Polygon polygon{};
+      polygon.count = count;
+      for (int i = 0; i < count; i++)
+      {
+        const float invW = 1.0f / clipped[i].w;
+        polygon.v[i] =
+        {
+          (clipped[i].x * invW * 0.5f + 0.5f) * width_,
+          (clipped[i].y * invW * 0.5f + 0.5f) * height_,
+          invW
+        };
+      }
+
+      // wind counterclockwise, so that the inside is where every edge function is positive
+      float area = 0;
+      for (int i = 1; i + 1 < count; i++)
+      {
+        area += Area(polygon.v[0], polygon.v[i], polygon.v[i + 1]);
+      }
+      if (area < 0)
+      {
+        std::reverse(polygon.v, polygon.v + count);
+      }
+      if (std::abs(area) > 1e-6f)
+      {
+        polygons_.push_back(polygon);
+      }
+    }
+
+    std::vector<uint32_t> bands((height_ + ROWS_PER_JOB - 1) / ROWS_PER_JOB);
+    std::iota(bands.begin(), bands.end(), 0);
+    engine::Core::JobSystem::Get()->ForEach(bands.begin(), bands.end(), [this](uint32_t band)
+      {
+        rasterizeRows(polygons_, band * ROWS_PER_JOB, std::min(height_, (band + 1) * ROWS_PER_JOB));
+      }, 1);
+  }
+
+
+  void OcclusionBuffer::rasterizeRows(std::span<const Polygon> polygons, uint32_t firstRow, uint32_t endRow)
+  {
+    for (const auto& polygon : polygons)
+    {
+      // pixels whose centers are inside the polygon's bounds. the ones that are entirely inside are a subset
+      float minX = polygon.v[0].x, maxX = polygon.v[0].x;
+      float minY = polygon.v[0].y, maxY = polygon.v[0].y;
+      for (int i = 1; i < polygon.count; i++)
+      {
+        minX = std::min(minX, polygon.v[i].x);
+        maxX = std::max(maxX, polygon.v[i].x);
+        minY = std::min(minY, polygon.v[i].y);
+        maxY = std::max(maxY, polygon.v[i].y);
+      }
+      const int x0 = std::max(0, static_cast<int>(std::ceil(minX - 0.5f))) & ~3;
+      const int x1 = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+      const int y0 = std::max(static_cast<int>(firstRow), static_cast<int>(std::ceil(minY - 0.5f)));
+      const int y1 = std::min(static_cast<int>(endRow) - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+      if (x0 > x1 || y0 > y1)
+      {
+        continue;
+      }
+
+      // each edge is moved in by half a pixel's extent along it, so a pixel center passes only if the whole
+      // pixel is inside the edge
+      LinearFunction edges[MAX_POLYGON_VERTICES];
+      int edgeCount = 0;
+      for (int i = 0; i < polygon.count; i++)
+      {
+        LinearFunction edge = Edge(polygon.v[i], polygon.v[(i + 1) % polygon.count]);
+        if (std::abs(edge.a) + std::abs(edge.b) < MIN_EDGE_LENGTH)
+        {
+          continue;
+        }
+        edge.c -= edge.HalfPixelExtent();
+        edges[edgeCount++] = edge;
+      }
+
+      // 1/w is linear in screen space. the polygon is flat, so any three vertices that span it give its plane.
+      // the largest triangle of the fan is the least sensitive to rounding
+      int apex = 1;
+      float area = 0;
+      for (int i = 1; i + 1 < polygon.count; i++)
+      {
+        if (const float a = Area(polygon.v[0], polygon.v[i], polygon.v[i + 1]); a > area)
+        {
+          area = a;
+          apex = i;
+        }
+      }
+      const glm::vec3& v0 = polygon.v[0];
+      const glm::vec3& v1 = polygon.v[apex];
+      const glm::vec3& v2 = polygon.v[apex + 1];
+      const LinearFunction bary[3] = { Edge(v1, v2), Edge(v2, v0), Edge(v0, v1) };
+      const float invArea = 1.0f / area;
+      LinearFunction depth
+      {
+        (bary[0].a * v0.z + bary[1].a * v1.z + bary[2].a * v2.z) * invArea,
+        (bary[0].b * v0.z + bary[1].b * v1.z + bary[2].b * v2.z) * invArea,
+        (bary[0].c * v0.z + bary[1].c * v1.z + bary[2].c * v2.z) * invArea,
+      };
+
+      // the farthest depth over the pixel, so the occluder is never nearer than it really is
+      depth.c -= depth.HalfPixelExtent();
+
+      // x0 is aligned to 4 and the width is a multiple of 4, so groups of 4 never leave the row.
+      // lanes left of the polygon's bounds fail the edge tests
+      for (int y = y0; y <= y1; y++)
+      {
+        const float py = y + 0.5f;
+        float* row = &depth_[y * width_];
+#if OCCLUSION_SSE2
+        if (useSimd_)
+        {
+          const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+          const __m128 zero = _mm_setzero_ps();
+          __m128 edgeA[MAX_POLYGON_VERTICES], edgeRow[MAX_POLYGON_VERTICES];
+          for (int e = 0; e < edgeCount; e++)
+          {
+            edgeA[e] = _mm_set1_ps(edges[e].a);
+            edgeRow[e] = _mm_set1_ps(edges[e].b * py + edges[e].c);
+          }
+          const __m128 depthA = _mm_set1_ps(depth.a);
+          const __m128 depthRow = _mm_set1_ps(depth.b * py + depth.c);
+
+          for (int x = x0; x <= x1; x += 4)
+          {
+            const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int e = 0; e < edgeCount; e++)
+            {
+              inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[e], px), edgeRow[e]), zero));
+            }
+            const __m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), depthRow);
+
+            // the buffer is never negative, so masked out lanes (0) and negative depths never win
+            const __m128 old = _mm_loadu_ps(row + x);
+            _mm_storeu_ps(row + x, _mm_max_ps(old, _mm_and_ps(inside, z)));
+          }
+          continue;
+        }
+#endif
+        for (int x = x0; x <= x1; x++)
+        {
+          const float px = x + 0.5f;
+
+          // same order of operations as the SSE path
+          bool inside = true;
+          for (int e = 0; e < edgeCount; e++)
+          {
+            inside &= edges[e].a * px + (edges[e].b * py + edges[e].c) >= 0;
+          }
+          if (inside)
+          {
+            row[x] = std::max(row[x], depth.a * px + (depth.b * py + depth.c));
+          }
+        }
+      }
+    }
+  }
+
+
+  bool OcclusionBuffer::IsVisible(const AABB& box) const
+  {
+    glm::vec2 minScreen(std::numeric_limits<float>::max());
+    glm::vec2 maxScreen(std::numeric_limits<float>::lowest());
+    float nearestInvW = 0;
+    for (int i = 0; i < 8; i++)
+    {
+      const glm::vec3 corner
+      {
+        (i & 1) ? box.max.x : box.min.x,
+        (i & 2) ? box.max.y : box.min.y,
+        (i & 4) ? box.max.z : box.min.z,
+      };
+      const glm::vec4 clip = viewProj_ * glm::vec4(corner, 1.0f);
+      if (clip.w < NEAR_W)
+      {
+        return true;
+      }
+
+      // w is linear in world space, so the nearest point of the box is one of its corners
+      const float invW = 1.0f / clip.w;
+      const glm::vec2 screen = (glm::vec2(clip) * invW * 0.5f + 0.5f) * glm::vec2(width_, height_);
+      minScreen = glm::min(minScreen, screen);
+      maxScreen = glm::max(maxScreen, screen);
+      nearestInvW = std::max(nearestInvW, invW);
+    }
+
+    // every pixel the box's bounds touch. clamped as floats first, as they can be far outside of the screen
+    minScreen = glm::clamp(minScreen, glm::vec2(-1), glm::vec2(width_, height_));
+    maxScreen = glm::clamp(maxScreen, glm::vec2(-1), glm::vec2(width_, height_));
+    const int x0 = std::max(0, static_cast<int>(std::floor(minScreen.x)));
+    const int x1 = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::floor(maxScreen.x)));
+    const int y0 = std::max(0, static_cast<int>(std::floor(minScreen.y)));
+    const int y1 = std::min(static_cast<int>(height_) - 1, static_cast<int>(std::floor(maxScreen.y)));
+
+    for (int y = y0; y <= y1; y++)
+    {
+      const float* row = &depth_[y * width_];
+#if OCCLUSION_SSE2
+      if (useSimd_)
+      {
+        // lanes outside of the bounds are masked off, so the result is the same as without SSE
+        const __m128 boxDepth = _mm_set1_ps(nearestInvW);
+        for (int x = x0 & ~3; x <= x1; x += 4)
+        {
+          int lanes = 0xF;
+          if (x < x0)
+          {
+            lanes &= 0xF << (x0 - x);
+          }
+          if (x + 3 > x1)
+          {
+            lanes &= 0xF >> (x + 3 - x1);
+          }
+          if ((_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(row + x), boxDepth)) & lanes) != 0)
+          {
+            return true;
+          }
+        }
+        continue;
+      }
+#endif
+      for (int x = x0; x <= x1; x++)
+      {
+        if (row[x] < nearestInvW)
+        {
+          return true;
+        }
+      }
+    }
+
+    // also reached when the box is entirely off screen
+    return false;
+  }
+}
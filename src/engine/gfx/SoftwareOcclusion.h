@@ -0,0 +1,64 @@
+#pragma once
+#include <engine/Shapes.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace GFX
+{
+  // a flat, convex quad that is solid everywhere inside it, in world space. either winding
+  struct OccluderQuad
+  {
+    glm::vec3 corners[4];
+  };
+
+  // A small depth buffer that occluders are rasterized into on the CPU, so that boxes hidden behind them can
+  // be culled before anything is drawn. Doesn't touch GL, so its results only depend on what's passed to it.
+  // Occluders are rasterized inner-conservatively: a pixel is only written if an occluder covers all of it,
+  // with the occluder's farthest depth over the pixel, stored as 1/w. Gaps between occluders are never filled,
+  // however narrow. Only perspective views are supported, as orthographic ones have the same w everywhere.
+  // Rows are processed four pixels at a time with SSE2 where it's available.
+  class OcclusionBuffer
+  {
+  public:
+    // width is rounded up to a multiple of 4
+    OcclusionBuffer(uint32_t width, uint32_t height);
+
+    // clears the buffer and sets the view that occluders are rasterized from and boxes are tested in
+    void Begin(const glm::mat4& viewProj);
+
+    // rasterizes the occluders on the job system, each job filling a band of rows
+    // the result doesn't depend on how the work was split
+    void RasterizeOccluders(std::span<const OccluderQuad> quads);
+
+    // conservative: only false when the box is entirely behind occluders
+    // boxes that cross the near plane are always visible
+    bool IsVisible(const AABB& box) const;
+
+    uint32_t GetWidth() const { return width_; }
+    uint32_t GetHeight() const { return height_; }
+    std::span<const float> GetDepth() const { return depth_; } // 1/w per pixel, 0 where nothing was drawn, bottom row first
+
+    // for testing the SSE2 path against the scalar one, which give the same results. ignored without SSE2
+    void SetUseSimd(bool useSimd) { useSimd_ = useSimd; }
+
+    // a quad clipped by the near plane and the guard band
+    static constexpr int MAX_POLYGON_VERTICES = 9;
+
+  private:
+    struct Polygon
+    {
+      glm::vec3 v[MAX_POLYGON_VERTICES]; // screen x, screen y, 1/w. counterclockwise
+      int count;
+    };
+
+    void rasterizeRows(std::span<const Polygon> polygons, uint32_t firstRow, uint32_t endRow);
+
+    uint32_t width_{};
+    uint32_t height_{};
+    glm::mat4 viewProj_{};
+    bool useSimd_{};
+    std::vector<float> depth_;
+    std::vector<Polygon> polygons_;
+  };
+}
@@ -1,7 +1,15 @@
 #include "../PCH.h"
 #include "TextureLoader.h"
 #include <stb/stb_image.h>
+#include <engine/core/JobSystem.h>
+#include <utility/Defer.h>
+#include <utility/Hash.h>
+#include <utility/MappedFile.h>
+#include <array>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <numeric>
 #include <glad/glad.h>
 
 namespace GFX
@@ -76,6 +84,142 @@ namespace GFX
 
       return data;
     }
+
+    // bump when the container layout or the way mips are made changes
+    constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+    constexpr uint32_t TEXTURE_CACHE_MAGIC = 0x58545356; // "VSTX"
+    constexpr std::string_view TEXTURE_CACHE_DIR = "cache/textures/";
+
+    // followed by every mip level in turn, each holding all layers as tightly packed RGBA8
+    struct TextureCacheHeader
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint64_t key;
+      uint32_t width;
+      uint32_t height;
+      uint32_t layers;
+      uint32_t mipLevels;
+    };
+
+    uint32_t MipDim(uint32_t dim, uint32_t level)
+    {
+      return std::max(1u, dim >> level);
+    }
+
+    size_t LevelSize(uint32_t width, uint32_t height, uint32_t layers, uint32_t level)
+    {
+      return size_t(MipDim(width, level)) * MipDim(height, level) * layers * 4;
+    }
+
+    size_t PixelsSize(uint32_t width, uint32_t height, uint32_t layers, uint32_t mipLevels)
+    {
+      size_t size = 0;
+      for (uint32_t level = 0; level < mipLevels; level++)
+      {
+        size += LevelSize(width, height, layers, level);
+      }
+      return size;
+    }
+
+    // images are stored bottom row first, as GL expects
+    void FlipRows(uint8_t* pixels, uint32_t width, uint32_t height)
+    {
+      const size_t rowSize = size_t(width) * 4;
+      std::vector<uint8_t> row(rowSize);
+      for (uint32_t y = 0; y < height / 2; y++)
+      {
+        uint8_t* a = pixels + y * rowSize;
+        uint8_t* b = pixels + (height - 1 - y) * rowSize;
+        std::memcpy(row.data(), a, rowSize);
+        std::memcpy(a, b, rowSize);
+        std::memcpy(b, row.data(), rowSize);
+      }
+    }
+
+    bool IsSRGB(Format format)
+    {
+      return format == Format::R8G8B8_SRGB || format == Format::R8G8B8A8_SRGB;
+    }
+
+    float SRGBToLinear(uint8_t c)
+    {
+      static const auto table = []
+      {
+        std::array<float, 256> t{};
+        for (int i = 0; i < 256; i++)
+        {
+          const float s = i / 255.0f;
+          t[i] = s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+      }();
+      return table[c];
+    }
+
+    uint8_t LinearToSRGB(float l)
+    {
+      const float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+      return static_cast<uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+
+    // 2x2 box filter. an odd or unit dimension reuses its last texel
+    void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, bool srgb)
+    {
+      const uint32_t dstWidth = std::max(1u, srcWidth / 2);
+      const uint32_t dstHeight = std::max(1u, srcHeight / 2);
+      for (uint32_t y = 0; y < dstHeight; y++)
+      {
+        const uint32_t y0 = std::min(y * 2, srcHeight - 1);
+        const uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+          const uint32_t x0 = std::min(x * 2, srcWidth - 1);
+          const uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+          const uint8_t* texels[4] =
+          {
+            src + (size_t(y0) * srcWidth + x0) * 4,
+            src + (size_t(y0) * srcWidth + x1) * 4,
+            src + (size_t(y1) * srcWidth + x0) * 4,
+            src + (size_t(y1) * srcWidth + x1) * 4,
+          };
+          uint8_t* out = dst + (size_t(y) * dstWidth + x) * 4;
+          for (int c = 0; c < 4; c++)
+          {
+            // alpha is always linear
+            if (srgb && c < 3)
+            {
+              float sum = 0;
+              for (const auto* t : texels) sum += SRGBToLinear(t[c]);
+              out[c] = LinearToSRGB(sum / 4);
+            }
+            else
+            {
+              uint32_t sum = 2;
+              for (const auto* t : texels) sum += t[c];
+              out[c] = static_cast<uint8_t>(sum / 4);
+            }
+          }
+        }
+      }
+    }
+
+    uint64_t TextureCacheKey(std::span<const std::string> files, uint32_t xSize, uint32_t ySize, Format format)
+    {
+      Hasher64 hasher;
+      hasher.Add(&TEXTURE_CACHE_VERSION, sizeof(TEXTURE_CACHE_VERSION));
+      hasher.Add(&xSize, sizeof(xSize)).Add(&ySize, sizeof(ySize)).Add(&format, sizeof(format));
+      for (const auto& file : files)
+      {
+        // the size and write time stand in for the contents, so a hit doesn't read the sources at all
+        std::error_code ec;
+        const auto path = std::string(TextureDir) + file;
+        const uint64_t size = std::filesystem::file_size(path, ec);
+        const int64_t time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        hasher.Add(file).Add(&size, sizeof(size)).Add(&time, sizeof(time));
+      }
+      return hasher.hash;
+    }
   }
 
 
@@ -83,8 +227,6 @@ namespace GFX
     Format internalFormat,
     UploadType uploadType)
   {
-    stbi_set_flip_vertically_on_load(true);
-
     std::string texPath = std::string(TextureDir) + std::string(file);
     bool hasTex = std::filesystem::exists(texPath);
     if (hasTex == false)
@@ -99,6 +241,7 @@ namespace GFX
     {
       return std::nullopt;
     }
+    FlipRows(pixels, xDim, yDim);
 
     uint32_t numMips = 1 + std::floor(std::log2((float)std::max(xDim, yDim)));
 
@@ -138,87 +281,234 @@ namespace GFX
   }
 
 
-  std::optional<Texture> LoadTexture2DArray(std::span<const std::string_view> files,
-    uint32_t xSize, uint32_t ySize,
-    Format internalFormat,
-    [[maybe_unused]] UploadType uploadType)
+  struct TextureArrayLoadData
   {
-    if (files.empty())
+    engine::Core::JobCounter counter;
+
+    std::vector<std::string> files;
+    uint32_t xSize{};
+    uint32_t ySize{};
+    Format format{};
+
+    // written by the job, read once the counter is done
+    bool ok = false;
+    TextureCacheHeader header{};
+    std::optional<MappedFile> mapped; // set on a cache hit
+    std::vector<std::byte> decoded;   // set on a miss
+
+    std::span<const std::byte> Pixels() const
     {
-      return std::nullopt;
+      if (mapped)
+      {
+        return mapped->Data().subspan(sizeof(TextureCacheHeader));
+      }
+      return decoded;
     }
 
-    bool infer_x_size = xSize == 0;
-    bool infer_y_size = ySize == 0;
+    bool TryLoadCache(const std::string& path, uint64_t key)
+    {
+      auto file = MappedFile::Open(path);
+      if (!file || file->Data().size() < sizeof(TextureCacheHeader))
+      {
+        return false;
+      }
+
+      std::memcpy(&header, file->Data().data(), sizeof(header));
+      if (header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION || header.key != key ||
+        file->Data().size() != sizeof(TextureCacheHeader) + PixelsSize(header.width, header.height, header.layers, header.mipLevels))
+      {
+        return false;
+      }
 
-    stbi_set_flip_vertically_on_load(true);
+      mapped = std::move(file);
+      return true;
+    }
 
-    stbi_ldr_to_hdr_gamma(1.0f);
-    std::vector<float*> texturesCPU;
-    for (const auto& file : files)
+    bool Decode(uint64_t key)
     {
-      std::string texPath = std::string(TextureDir) + std::string(file);
-      bool hasTex = std::filesystem::exists(texPath);
-      if (hasTex == false)
+      const uint32_t layerCount = static_cast<uint32_t>(files.size());
+      std::vector<uint8_t*> layers(layerCount);
+      std::vector<glm::ivec2> dims(layerCount);
+      Defer freeLayers = [&layers]
       {
-        for (auto pixels : texturesCPU) stbi_image_free(pixels);
-        return std::nullopt;
+        for (auto* pixels : layers) stbi_image_free(pixels);
+      };
+
+      // stb's global flip setting is never touched, so decoding on several threads at once is safe
+      std::vector<uint32_t> indices(layerCount);
+      std::iota(indices.begin(), indices.end(), 0u);
+      engine::Core::JobSystem::Get()->ForEach(indices.begin(), indices.end(), [&](uint32_t i)
+        {
+          const std::string texPath = std::string(TextureDir) + files[i];
+          layers[i] = stbi_load(texPath.c_str(), &dims[i].x, &dims[i].y, nullptr, 4);
+          if (layers[i])
+          {
+            FlipRows(layers[i], dims[i].x, dims[i].y);
+          }
+        }, 1);
+
+      const uint32_t width = xSize ? xSize : static_cast<uint32_t>(dims[0].x);
+      const uint32_t height = ySize ? ySize : static_cast<uint32_t>(dims[0].y);
+      for (uint32_t i = 0; i < layerCount; i++)
+      {
+        if (!layers[i] || dims[i] != glm::ivec2(width, height))
+        {
+          spdlog::error("Failed to load texture {} into an array of {}x{} textures", files[i], width, height);
+          return false;
+        }
       }
 
-      int xDim{};
-      int yDim{};
-      auto* pixels = (float*)stbi_loadf(texPath.c_str(), &xDim, &yDim, nullptr, 4);
-      if (pixels == nullptr || (!infer_x_size && xDim != static_cast<int>(xSize)) || (!infer_y_size && yDim != static_cast<int>(ySize)))
+      header =
       {
-        for (auto pixelsLocal : texturesCPU) stbi_image_free(pixelsLocal);
-        return std::nullopt;
+        .magic = TEXTURE_CACHE_MAGIC,
+        .version = TEXTURE_CACHE_VERSION,
+        .key = key,
+        .width = width,
+        .height = height,
+        .layers = layerCount,
+        .mipLevels = 1 + static_cast<uint32_t>(std::floor(std::log2(static_cast<float>(std::max(width, height))))),
+      };
+      decoded.resize(PixelsSize(width, height, layerCount, header.mipLevels));
+
+      std::vector<size_t> levelOffsets(header.mipLevels);
+      for (uint32_t level = 1; level < header.mipLevels; level++)
+      {
+        levelOffsets[level] = levelOffsets[level - 1] + LevelSize(width, height, layerCount, level - 1);
       }
-      if (infer_x_size) xSize = static_cast<uint32_t>(xDim);
-      if (infer_y_size) ySize = static_cast<uint32_t>(yDim);
-      texturesCPU.push_back(pixels);
+
+      const bool srgb = IsSRGB(format);
+      auto* out = reinterpret_cast<uint8_t*>(decoded.data());
+      engine::Core::JobSystem::Get()->ForEach(indices.begin(), indices.end(), [&](uint32_t i)
+        {
+          std::memcpy(out + LevelSize(width, height, 1, 0) * i, layers[i], LevelSize(width, height, 1, 0));
+          for (uint32_t level = 1; level < header.mipLevels; level++)
+          {
+            const uint8_t* src = out + levelOffsets[level - 1] + LevelSize(width, height, 1, level - 1) * i;
+            uint8_t* dst = out + levelOffsets[level] + LevelSize(width, height, 1, level) * i;
+            Downsample(src, MipDim(width, level - 1), MipDim(height, level - 1), dst, srgb);
+          }
+        }, 1);
+
+      return true;
     }
-    stbi_ldr_to_hdr_gamma(2.2f);
 
-    uint32_t numMips = 1 + std::floor(std::log2((float)std::max(xSize, ySize)));
+    void StoreCache(const std::string& path)
+    {
+      // written to the side and renamed into place, so a reader never sees half a file
+      const std::string tempPath = path + ".tmp";
+      {
+        std::ofstream file(tempPath, std::ios::binary);
+        if (!file)
+        {
+          return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(decoded.data()), decoded.size());
+      }
+
+      std::error_code ec;
+      std::filesystem::rename(tempPath, path, ec);
+      if (ec)
+      {
+        std::filesystem::remove(tempPath, ec);
+      }
+    }
+
+    void Load()
+    {
+      const uint64_t key = TextureCacheKey(files, xSize, ySize, format);
+      const std::string path = fmt::format("{}{:016x}.bin", TEXTURE_CACHE_DIR, key);
+      if (TryLoadCache(path, key))
+      {
+        ok = true;
+        return;
+      }
+
+      ok = Decode(key);
+      if (ok)
+      {
+        std::error_code ec;
+        std::filesystem::create_directories(TEXTURE_CACHE_DIR, ec);
+        StoreCache(path);
+      }
+    }
+  };
 
+  TextureArrayLoad LoadTexture2DArrayAsync(std::span<const std::string_view> files,
+    uint32_t xSize, uint32_t ySize,
+    Format internalFormat)
+  {
+    TextureArrayLoad load;
+    load.data = std::make_shared<TextureArrayLoadData>();
+    load.data->files.assign(files.begin(), files.end());
+    load.data->xSize = xSize;
+    load.data->ySize = ySize;
+    load.data->format = internalFormat;
+    if (!files.empty())
+    {
+      engine::Core::JobSystem::Get()->Submit([data = load.data] { data->Load(); }, &load.data->counter,
+        engine::Core::JobPriority::NORMAL, "LoadTextureArray");
+    }
+    return load;
+  }
+
+  std::optional<Texture> TextureArrayLoad::Get()
+  {
+    ASSERT(data);
+    engine::Core::JobSystem::Get()->Wait(data->counter);
+    if (!data->ok)
+    {
+      return std::nullopt;
+    }
+
+    const auto& header = data->header;
     TextureCreateInfo createInfo
     {
       .imageType = ImageType::TEX_2D_ARRAY,
-      .format = internalFormat,
+      .format = data->format,
       .extent
       {
-        .width = xSize,
-        .height = ySize,
+        .width = header.width,
+        .height = header.height,
         .depth = 1
       },
-      .mipLevels = numMips,
-      .arrayLayers = static_cast<uint32_t>(files.size()),
+      .mipLevels = header.mipLevels,
+      .arrayLayers = header.layers,
       .sampleCount = SampleCount::ONE,
     };
-    auto texture = Texture::Create(createInfo, files[0]);
+    auto texture = Texture::Create(createInfo, data->files[0]);
 
-    for (uint32_t i = 0; auto pixels : texturesCPU)
+    // one upload per mip level, covering every layer
+    auto pixels = data->Pixels();
+    size_t offset = 0;
+    for (uint32_t level = 0; level < header.mipLevels; level++)
     {
       TextureUpdateInfo updateInfo
       {
         .dimension = UploadDimension::THREE,
-        .level = 0,
-        .offset{ 0, 0, i },
-        .size = createInfo.extent,
+        .level = level,
+        .offset{ 0, 0, 0 },
+        .size{ MipDim(header.width, level), MipDim(header.height, level), header.layers },
         .format = UploadFormat::RGBA,
-        .type = UploadType::FLOAT,
-        .pixels = pixels
+        .type = UploadType::UBYTE,
+        .pixels = const_cast<std::byte*>(pixels.data() + offset)
       };
       texture->SubImage(updateInfo);
-      stbi_image_free(pixels);
-      i++;
+      offset += LevelSize(header.width, header.height, header.layers, level);
     }
 
-    texture->GenMipmaps();
-
+    data.reset();
     return texture;
   }
 
+  std::optional<Texture> LoadTexture2DArray(std::span<const std::string_view> files,
+    uint32_t xSize, uint32_t ySize,
+    Format internalFormat,
+    [[maybe_unused]] UploadType uploadType)
+  {
+    return LoadTexture2DArrayAsync(files, xSize, ySize, internalFormat).Get();
+  }
+
 
   std::optional<Texture> LoadTextureCube(std::span<const std::string_view, 6> files,
     uint32_t xSize, uint32_t ySize, bool autoLevel,
@@ -228,8 +518,6 @@ namespace GFX
     bool infer_x_size = xSize == 0;
     bool infer_y_size = ySize == 0;
 
-    stbi_set_flip_vertically_on_load(false);
-
     std::vector<float*> texturesCPU;
     for (const auto& file : files)
     {
@@ -1,14 +1,34 @@
 #pragma once
 #include "api/Texture.h"
+#include <memory>
 
 namespace GFX
 {
+  // a 2D array texture that is being decoded on the job system
+  class TextureArrayLoad
+  {
+  public:
+    // waits for decoding to finish, then creates and uploads the texture. must be called on the main thread
+    [[nodiscard]] std::optional<Texture> Get();
+
+  private:
+    friend TextureArrayLoad LoadTexture2DArrayAsync(std::span<const std::string_view>, uint32_t, uint32_t, Format);
+    std::shared_ptr<struct TextureArrayLoadData> data;
+  };
+
   // loads a 2D texture from a file
   // has sane defaults, optimized for basic texture mapping
   [[nodiscard]] std::optional<Texture> LoadTexture2D(std::string_view file,
     Format internalFormat = Format::R8G8B8A8_SRGB,
     UploadType uploadType = UploadType::UBYTE);
 
+  // Decodes every layer to 8-bit RGBA on worker threads and builds the mip chain on the CPU (in linear
+  // space for sRGB formats). The result is cached in cache/textures/, which later runs map instead of decoding.
+  // Start several loads before getting any of them so that they decode together.
+  [[nodiscard]] TextureArrayLoad LoadTexture2DArrayAsync(std::span<const std::string_view> files,
+    uint32_t xSize = 0, uint32_t ySize = 0,
+    Format internalFormat = Format::R8G8B8A8_SRGB);
+
   [[nodiscard]] std::optional<Texture> LoadTexture2DArray(std::span<const std::string_view> files,
     uint32_t xSize = 0, uint32_t ySize = 0,
     Format internalFormat = Format::R8G8B8A8_SRGB,
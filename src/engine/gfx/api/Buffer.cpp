@@ -19,6 +19,7 @@ namespace GFX
       GL_DRAW_INDIRECT_BUFFER,
       GL_PARAMETER_BUFFER,
       GL_UNIFORM_BUFFER,
+      GL_DISPATCH_INDIRECT_BUFFER,
     };
 
     GLbitfield bufferFlags[]
@@ -41,6 +42,7 @@ namespace GFX
       glflags |= bufferFlags[getSetBit((uint32_t)flags, i)];
     Buffer buffer{};
     buffer.size_ = size;
+    buffer.flags_ = flags;
     glCreateBuffers(1, &buffer.id_);
     glNamedBufferStorage(buffer.id_, size, data, glflags);
     return buffer;
@@ -57,6 +59,7 @@ namespace GFX
     this->~Buffer();
     id_ = std::exchange(old.id_, 0);
     size_ = std::exchange(old.size_, 0);
+    flags_ = std::exchange(old.flags_, BufferFlag::NONE);
     isMapped_ = std::exchange(old.isMapped_, false);
     return *this;
   }
@@ -77,8 +80,12 @@ namespace GFX
 
   void* Buffer::GetMappedPointer()
   {
+    ASSERT_MSG(flags_ & (BufferFlag::MAP_READ | BufferFlag::MAP_WRITE), "Buffer must be created with MAP_READ and/or MAP_WRITE to be mapped");
+    GLbitfield access = 0;
+    for (int i = 3; i < _countof(bufferFlags); i++)
+      access |= bufferFlags[getSetBit((uint32_t)flags_, i)];
     isMapped_ = true;
-    return glMapNamedBuffer(id_, GL_READ_WRITE);
+    return glMapNamedBufferRange(id_, 0, size_, access);
   }
 
   void Buffer::UnmapPointer()
@@ -97,4 +104,9 @@ namespace GFX
   {
     glBindBufferBase(targets[target], slot, id_);
   }
+
+  void Buffer::BindBufferRange(uint32_t target, uint32_t slot, size_t offset, size_t size)
+  {
+    glBindBufferRange(targets[target], slot, id_, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+  }
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ namespace GFX
     DRAW_INDIRECT_BUFFER,
     PARAMETER_BUFFER,
     UNIFORM_BUFFER,
+    DISPATCH_INDIRECT_BUFFER,
   };
 
   enum class BufferFlag : uint32_t
@@ -67,13 +68,22 @@ namespace GFX
       BindBufferBase(static_cast<uint32_t>(T), index);
     }
 
+    // for binding a subrange of an SSBO or UBO
+    template<Target T>
+    void BindRange(uint32_t index, size_t offset, size_t size)
+    {
+      static_assert(T == Target::SHADER_STORAGE_BUFFER || T == Target::UNIFORM_BUFFER, "Only SSBO and UBO targets use an index.");
+      BindBufferRange(static_cast<uint32_t>(T), index, offset, size);
+    }
+
     template<typename T>
     void SubData(std::span<T> data, size_t destOffsetBytes)
     {
       SubData(data.data(), data.size_bytes(), destOffsetBytes);
     }
 
-    // returns persistently mapped read/write pointer
+    // returns a pointer to the whole data store
+    // the access (read/write/persistent/coherent) is derived from the flags the buffer was created with
     [[nodiscard]] void* GetMappedPointer();
 
     void UnmapPointer();
@@ -89,6 +99,7 @@ namespace GFX
     Buffer() {}
     void BindBuffer(uint32_t target);
     void BindBufferBase(uint32_t target, uint32_t slot);
+    void BindBufferRange(uint32_t target, uint32_t slot, size_t offset, size_t size);
     static std::optional<Buffer> CreateInternal(const void* data, size_t size, BufferFlags flags);
 
     // updates a subset of the buffer's data store
@@ -96,6 +107,7 @@ namespace GFX
 
     uint32_t id_{};
     uint32_t size_{};
+    BufferFlags flags_{};
     bool isMapped_{ false };
   };
 }
\ No newline at end of file
@@ -29,6 +29,11 @@ namespace GFX
     return elapsed;
   }
 
+  void Fence::Wait()
+  {
+    [[maybe_unused]] GLenum result = glClientWaitSync(sync_, GL_SYNC_FLUSH_COMMANDS_BIT, std::numeric_limits<GLuint64>::max());
+  }
+
 
   TimerQuery::TimerQuery()
   {
@@ -38,6 +38,9 @@ namespace GFX
     // returns how long (in ns) we were blocked for
     uint64_t Sync();
 
+    // same as Sync, but does not issue a timer query (which would stall the pipeline)
+    void Wait();
+
   private:
     GLsync sync_;
   };
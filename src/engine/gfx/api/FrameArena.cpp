@@ -0,0 +1,143 @@
+#include "../../PCH.h"
+#include "FrameArena.h"
+#include "Fence.h"
+#include <cstring>
+#include <vector>
+
+namespace GFX
+{
+  namespace
+  {
+    class GLFrameArenaBackend final : public FrameArenaBackend
+    {
+    public:
+      GLFrameArenaBackend(uint32_t framesInFlight)
+        : fences_(framesInFlight) {}
+
+      ~GLFrameArenaBackend()
+      {
+        if (buffer_ && buffer_->IsMapped())
+        {
+          buffer_->UnmapPointer();
+        }
+      }
+
+      std::byte* CreateStorage(size_t size) override
+      {
+        buffer_ = Buffer::Create(size, BufferFlag::MAP_WRITE | BufferFlag::MAP_PERSISTENT | BufferFlag::MAP_COHERENT);
+        return static_cast<std::byte*>(buffer_->GetMappedPointer());
+      }
+
+      void InsertFence(uint32_t region) override
+      {
+        fences_[region] = std::make_unique<Fence>();
+      }
+
+      void WaitFence(uint32_t region) override
+      {
+        if (fences_[region])
+        {
+          fences_[region]->Wait();
+          fences_[region].reset();
+        }
+      }
+
+      void Bind(Target target) override
+      {
+        switch (target)
+        {
+        case Target::VERTEX_BUFFER: buffer_->Bind<Target::VERTEX_BUFFER>(); break;
+        case Target::ATOMIC_BUFFER: buffer_->Bind<Target::ATOMIC_BUFFER>(); break;
+        case Target::DRAW_INDIRECT_BUFFER: buffer_->Bind<Target::DRAW_INDIRECT_BUFFER>(); break;
+        case Target::PARAMETER_BUFFER: buffer_->Bind<Target::PARAMETER_BUFFER>(); break;
+        case Target::DISPATCH_INDIRECT_BUFFER: buffer_->Bind<Target::DISPATCH_INDIRECT_BUFFER>(); break;
+        default: UNREACHABLE;
+        }
+      }
+
+      void BindRange(Target target, uint32_t index, size_t offset, size_t size) override
+      {
+        switch (target)
+        {
+        case Target::SHADER_STORAGE_BUFFER: buffer_->BindRange<Target::SHADER_STORAGE_BUFFER>(index, offset, size); break;
+        case Target::UNIFORM_BUFFER: buffer_->BindRange<Target::UNIFORM_BUFFER>(index, offset, size); break;
+        default: UNREACHABLE;
+        }
+      }
+
+    private:
+      std::optional<Buffer> buffer_;
+      std::vector<std::unique_ptr<Fence>> fences_;
+    };
+
+    // the largest alignment any binding point is likely to require
+    constexpr size_t REGION_ALIGNMENT = 256;
+  }
+
+  std::optional<FrameArena> FrameArena::Create(size_t regionSize, uint32_t framesInFlight)
+  {
+    return Create(std::make_unique<GLFrameArenaBackend>(framesInFlight), regionSize, framesInFlight);
+  }
+
+  std::optional<FrameArena> FrameArena::Create(std::unique_ptr<FrameArenaBackend> backend, size_t regionSize, uint32_t framesInFlight)
+  {
+    ASSERT(backend);
+    ASSERT(framesInFlight > 0);
+
+    // keep every region's base aligned so offsets aligned within a region are also aligned within the buffer
+    regionSize += (REGION_ALIGNMENT - (regionSize % REGION_ALIGNMENT)) % REGION_ALIGNMENT;
+
+    FrameArena arena;
+    arena.backend_ = std::move(backend);
+    arena.regionSize_ = regionSize;
+    arena.framesInFlight_ = framesInFlight;
+    arena.storage_ = arena.backend_->CreateStorage(regionSize * framesInFlight);
+    if (!arena.storage_)
+    {
+      return std::nullopt;
+    }
+    return arena;
+  }
+
+  void FrameArena::NextFrame()
+  {
+    if (firstFrame_)
+    {
+      firstFrame_ = false;
+      return;
+    }
+
+    backend_->InsertFence(region_);
+    region_ = (region_ + 1) % framesInFlight_;
+    backend_->WaitFence(region_);
+    nextAllocOffset_ = 0;
+  }
+
+  std::optional<FrameArena::Allocation> FrameArena::Allocate(size_t size, size_t alignment, const void* data)
+  {
+    ASSERT(alignment > 0 && alignment <= REGION_ALIGNMENT);
+    size_t offset = nextAllocOffset_ + (alignment - (nextAllocOffset_ % alignment)) % alignment;
+    if (offset + size > regionSize_)
+    {
+      // callers skip what doesn't fit, so only complain the first time instead of every batch
+      if (!warnedExhausted_)
+      {
+        spdlog::warn("Frame arena region of {} bytes is exhausted, some draws will be skipped", regionSize_);
+        warnedExhausted_ = true;
+      }
+      return std::nullopt;
+    }
+
+    Allocation alloc;
+    alloc.offset = region_ * regionSize_ + offset;
+    alloc.size = size;
+    alloc.data = storage_ + alloc.offset;
+    if (data)
+    {
+      std::memcpy(alloc.data, data, size);
+    }
+
+    nextAllocOffset_ = offset + size;
+    return alloc;
+  }
+}
\ No newline at end of file
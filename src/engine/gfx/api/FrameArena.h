@@ -0,0 +1,105 @@
+#pragma once
+#include "Buffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+/*
+  A ring of persistently mapped regions for data that only lives for one frame
+  (per-batch uniforms, draw commands, etc.).
+
+  Usage:
+  Call NextFrame() once at the start of every frame. This fences the region that
+  was written last frame and then waits on the fence of the region that is about
+  to be reused. With N frames in flight, this only blocks if the GPU is more than
+  N-1 frames behind.
+
+  Allocate() bump-allocates from the current frame's region and copies data into
+  it. The returned offset is relative to the start of the whole buffer, so it
+  can be used directly for binding or as an indirect offset.
+
+  The backend exists so the ring/fence logic can be driven without a GL context.
+*/
+namespace GFX
+{
+  class FrameArenaBackend
+  {
+  public:
+    virtual ~FrameArenaBackend() = default;
+
+    // creates the storage for all regions and returns a pointer to it that stays valid for the backend's lifetime
+    [[nodiscard]] virtual std::byte* CreateStorage(size_t size) = 0;
+
+    // marks the point after which no more commands will read from the region
+    virtual void InsertFence(uint32_t region) = 0;
+
+    // blocks until commands issued before the region's fence are complete. does nothing if there is no fence
+    virtual void WaitFence(uint32_t region) = 0;
+
+    virtual void Bind(Target target) = 0;
+    virtual void BindRange(Target target, uint32_t index, size_t offset, size_t size) = 0;
+  };
+
+  class FrameArena
+  {
+  public:
+    struct Allocation
+    {
+      size_t offset{}; // offset from the start of the buffer, NOT the region
+      size_t size{};
+      std::byte* data{};
+    };
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena(FrameArena&&) = default;
+    FrameArena& operator=(const FrameArena&) = delete;
+    FrameArena& operator=(FrameArena&&) = default;
+
+    // creates an arena backed by a persistently mapped GL buffer
+    [[nodiscard]] static std::optional<FrameArena> Create(size_t regionSize, uint32_t framesInFlight = 3);
+    [[nodiscard]] static std::optional<FrameArena> Create(std::unique_ptr<FrameArenaBackend> backend, size_t regionSize, uint32_t framesInFlight = 3);
+
+    void NextFrame();
+
+    // returns nullopt if the current region cannot fit the data
+    template<typename T>
+    [[nodiscard]] std::optional<Allocation> Allocate(std::span<T> data, size_t alignment)
+    {
+      return Allocate(data.size_bytes(), alignment, data.data());
+    }
+
+    // binds the whole buffer to a non-indexed target (e.g. the draw indirect buffer)
+    template<Target T>
+    void Bind()
+    {
+      static_assert(T != Target::SHADER_STORAGE_BUFFER && T != Target::UNIFORM_BUFFER, "SSBO and UBO targets require an index.");
+      backend_->Bind(T);
+    }
+
+    template<Target T>
+    void BindRange(uint32_t index, const Allocation& alloc)
+    {
+      static_assert(T == Target::SHADER_STORAGE_BUFFER || T == Target::UNIFORM_BUFFER, "Only SSBO and UBO targets use an index.");
+      backend_->BindRange(T, index, alloc.offset, alloc.size);
+    }
+
+    [[nodiscard]] uint32_t CurrentRegion() const { return region_; }
+    [[nodiscard]] size_t RegionSize() const { return regionSize_; }
+    [[nodiscard]] size_t BytesUsed() const { return nextAllocOffset_; }
+
+  private:
+    FrameArena() {};
+    std::optional<Allocation> Allocate(size_t size, size_t alignment, const void* data);
+
+    std::unique_ptr<FrameArenaBackend> backend_;
+    std::byte* storage_{};
+    size_t regionSize_{};
+    uint32_t framesInFlight_{};
+    uint32_t region_{};
+    size_t nextAllocOffset_{}; // relative to the current region
+    bool firstFrame_{ true };
+    bool warnedExhausted_{};
+  };
+}
\ No newline at end of file
@@ -1,8 +1,15 @@
 #include "../../PCH.h"
 #include "MeshManager.h"
+#include "MeshOptimizer.h"
 #include <engine/gfx/Renderer.h>
+#include <engine/Shapes.h>
+#include <utility/Hash.h>
+#include <utility/MappedFile.h>
 
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <vector>
 
@@ -24,6 +31,117 @@ namespace GFX::MeshManager
   {
     static Assimp::Importer importer;
     static std::unordered_map<hashed_string, MeshID> handleMap_;
+    static std::unordered_map<MeshID, AABB> boundsMap_;
+
+    // bump when the container layout, the import flags or the optimizer changes
+    constexpr uint32_t MESH_CACHE_VERSION = 2;
+    constexpr uint32_t MESH_CACHE_MAGIC = 0x534D5356; // "VSMS"
+    constexpr std::string_view MESH_CACHE_DIR = "cache/meshes/";
+
+    // each LOD aims for half the triangles of the one before it. LODs stop once they get this small,
+    // or once simplifying stops making much of a difference
+    constexpr uint32_t MIN_LOD_TRIANGLES = 32;
+    constexpr float MIN_LOD_REDUCTION = 0.8f;
+
+    // followed by the vertices, then the indices of every LOD, all ready to upload
+    struct MeshCacheHeader
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint64_t key;
+      uint32_t vertexCount;
+      uint32_t indexCount;
+      glm::vec3 boundsMin;
+      glm::vec3 boundsMax;
+      uint32_t lodCount;
+      MeshLod lods[MAX_MESH_LODS];
+    };
+    static_assert(sizeof(MeshCacheHeader) % alignof(Vertex) == 0, "vertices must be aligned when read in place");
+
+    // the data of a mesh, either read in place from the cache or freshly imported
+    struct MeshData
+    {
+      MeshCacheHeader header{};
+      std::optional<MappedFile> mapped;
+      std::vector<Vertex> vertices;
+      std::vector<Index> indices;
+
+      std::span<const Vertex> Vertices() const
+      {
+        if (mapped)
+        {
+          return { reinterpret_cast<const Vertex*>(mapped->Data().data() + sizeof(MeshCacheHeader)), header.vertexCount };
+        }
+        return vertices;
+      }
+
+      std::span<const Index> Indices() const
+      {
+        if (mapped)
+        {
+          const std::byte* indexData = mapped->Data().data() + sizeof(MeshCacheHeader) + header.vertexCount * sizeof(Vertex);
+          return { reinterpret_cast<const Index*>(indexData), header.indexCount };
+        }
+        return indices;
+      }
+    };
+
+    uint64_t MeshCacheKey(std::string_view filename)
+    {
+      // the size and write time stand in for the contents, so a hit doesn't read the source at all
+      std::error_code ec;
+      const uint64_t size = std::filesystem::file_size(filename, ec);
+      const int64_t time = std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+      Hasher64 hasher;
+      hasher.Add(&MESH_CACHE_VERSION, sizeof(MESH_CACHE_VERSION));
+      hasher.Add(filename).Add(&size, sizeof(size)).Add(&time, sizeof(time));
+      return hasher.hash;
+    }
+
+    bool TryLoadCache(const std::string& path, uint64_t key, MeshData& mesh)
+    {
+      auto file = MappedFile::Open(path);
+      if (!file || file->Data().size() < sizeof(MeshCacheHeader))
+      {
+        return false;
+      }
+
+      MeshCacheHeader header;
+      std::memcpy(&header, file->Data().data(), sizeof(header));
+      if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.key != key ||
+        header.lodCount == 0 || header.lodCount > MAX_MESH_LODS ||
+        file->Data().size() != sizeof(MeshCacheHeader) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(Index))
+      {
+        return false;
+      }
+
+      mesh.header = header;
+      mesh.mapped = std::move(file);
+      return true;
+    }
+
+    void StoreCache(const std::string& path, const MeshData& mesh)
+    {
+      // written to the side and renamed into place, so a reader never sees half a file
+      const std::string tempPath = path + ".tmp";
+      {
+        std::ofstream file(tempPath, std::ios::binary);
+        if (!file)
+        {
+          return;
+        }
+        file.write(reinterpret_cast<const char*>(&mesh.header), sizeof(mesh.header));
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(Index));
+      }
+
+      std::error_code ec;
+      std::filesystem::rename(tempPath, path, ec);
+      if (ec)
+      {
+        std::filesystem::remove(tempPath, ec);
+      }
+    }
 
     static glm::mat4 AssimpToGlm(aiMatrix4x4 mat)
     {
@@ -102,6 +220,12 @@ namespace GFX::MeshManager
     for (unsigned i = 0; i < mesh->mNumFaces; i++)
     {
       aiFace& face = mesh->mFaces[i];
+
+      // batched meshes are drawn as triangle lists, so stray points and lines are dropped
+      if (face.mNumIndices != 3)
+      {
+        continue;
+      }
       for (unsigned j = 0; j < face.mNumIndices; j++)
       {
         indices.push_back(face.mIndices[j]);
@@ -109,7 +233,7 @@ namespace GFX::MeshManager
     }
   }
 
-  MeshID CreateMeshBatched(std::string_view filename, hashed_string name)
+  bool ImportMesh(std::string_view filename, MeshData& mesh)
   {
     const aiScene* scene = importer.ReadFile(filename.data(), aiProcessPreset_TargetRealtime_Fast);
 
@@ -117,22 +241,21 @@ namespace GFX::MeshManager
     {
       std::string rre = importer.GetErrorString();
       std::cout << "ERROR::ASSIMP::" << rre << std::endl;
+      return false;
     }
 
     if (scene->HasAnimations())
     {
       printf("Animation loading not supported by this function.\n");
     }
-    if (scene->mMeshes[0]->HasBones())
-    {
-      printf("Bone loading not supported by this function.\n");
-    }
-
-    std::vector<MeshID> meshHandles;
-
     if (scene->mNumMeshes == 0)
     {
       printf("File does not contain a mesh.\n");
+      return false;
+    }
+    if (scene->mMeshes[0]->HasBones())
+    {
+      printf("Bone loading not supported by this function.\n");
     }
     if (scene->mNumMeshes > 1)
     {
@@ -140,11 +263,80 @@ namespace GFX::MeshManager
     }
 
     std::vector<Vertex> vertices;
-    std::vector<Index> indices;
-    LoadMesh(scene, scene->mMeshes[0], indices, vertices);
+    LoadMesh(scene, scene->mMeshes[0], mesh.indices, vertices);
+    importer.FreeScene();
+
+    const float acmrBefore = MeshOptimizer::ComputeACMR(mesh.indices, vertices.size());
+    MeshOptimizer::OptimizeVertexCache(mesh.indices, vertices.size());
+    MeshOptimizer::OptimizeOverdraw(mesh.indices, vertices);
+    mesh.vertices = MeshOptimizer::OptimizeVertexFetch(mesh.indices, vertices);
+    spdlog::info("Imported mesh {}: {} vertices, {} triangles, ACMR {:.3f} -> {:.3f}", filename, mesh.vertices.size(),
+      mesh.indices.size() / 3, acmrBefore, MeshOptimizer::ComputeACMR(mesh.indices, mesh.vertices.size()));
+
+    // LODs are simplified from the full mesh rather than from each other, so errors don't compound
+    const size_t baseIndexCount = mesh.indices.size();
+    mesh.header.lods[0] = { 0, static_cast<uint32_t>(baseIndexCount), 0 };
+    mesh.header.lodCount = 1;
+    while (mesh.header.lodCount < MAX_MESH_LODS)
+    {
+      const MeshLod& prev = mesh.header.lods[mesh.header.lodCount - 1];
+      const size_t target = (baseIndexCount >> mesh.header.lodCount) / 3 * 3;
+      if (target < MIN_LOD_TRIANGLES * 3)
+      {
+        break;
+      }
+
+      float error;
+      std::vector<Index> lodIndices = MeshOptimizer::Simplify(std::span(mesh.indices).first(baseIndexCount), mesh.vertices, target, error);
+      if (lodIndices.size() > prev.indexCount * MIN_LOD_REDUCTION)
+      {
+        break;
+      }
+      MeshOptimizer::OptimizeVertexCache(lodIndices, mesh.vertices.size());
+
+      mesh.header.lods[mesh.header.lodCount++] =
+      {
+        .firstIndex = static_cast<uint32_t>(mesh.indices.size()),
+        .indexCount = static_cast<uint32_t>(lodIndices.size()),
+        .error = std::max(error, prev.error),
+      };
+      mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+      spdlog::info("Mesh {} LOD {}: {} triangles, error {}", filename, mesh.header.lodCount - 1, lodIndices.size() / 3, error);
+    }
+
+    const AABB bounds = MeshOptimizer::ComputeBounds(mesh.vertices);
+    mesh.header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    mesh.header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    mesh.header.boundsMin = bounds.min;
+    mesh.header.boundsMax = bounds.max;
+    return true;
+  }
+
+  MeshID CreateMeshBatched(std::string_view filename, hashed_string name)
+  {
+    // imported meshes are stored optimized, so a cache hit only has to map the file and upload it
+    MeshData mesh;
+    const uint64_t key = MeshCacheKey(filename);
+    const std::string path = fmt::format("{}{:016x}.bin", MESH_CACHE_DIR, key);
+    if (!TryLoadCache(path, key, mesh))
+    {
+      if (!ImportMesh(filename, mesh))
+      {
+        return name;
+      }
+
+      mesh.header.magic = MESH_CACHE_MAGIC;
+      mesh.header.version = MESH_CACHE_VERSION;
+      mesh.header.key = key;
+      std::error_code ec;
+      std::filesystem::create_directories(MESH_CACHE_DIR, ec);
+      StoreCache(path, mesh);
+    }
 
     handleMap_[name] = name;
-    Renderer::AddBatchedMesh(GetMeshBatched(name), vertices, indices);
+    boundsMap_[name] = AABB(mesh.header.boundsMin, mesh.header.boundsMax);
+    Renderer::AddBatchedMesh(GetMeshBatched(name), mesh.Vertices(), mesh.Indices(),
+      std::span(mesh.header.lods, mesh.header.lodCount), boundsMap_[name]);
     return name;
   }
 
@@ -152,4 +344,11 @@ namespace GFX::MeshManager
   {
     return handleMap_[name];
   }
+
+  AABB GetMeshBatchedBounds(MeshID mesh)
+  {
+    auto it = boundsMap_.find(mesh);
+    ASSERT_MSG(it != boundsMap_.end(), "Mesh was not created by CreateMeshBatched");
+    return it->second;
+  }
 }
\ No newline at end of file
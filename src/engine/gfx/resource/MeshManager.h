@@ -3,6 +3,8 @@
 #include <utility/HashedString.h>
 #include "../Mesh.h"
 
+struct AABB;
+
 namespace GFX
 {
 	namespace MeshManager
@@ -10,6 +12,9 @@ namespace GFX
 		MeshID CreateMeshBatched(std::string_view filename, hashed_string name);
 		MeshID GetMeshBatched(hashed_string name);
 
+		// object space bounds of a mesh made by CreateMeshBatched
+		AABB GetMeshBatchedBounds(MeshID mesh);
+
 		// TODO: function(s) to load skeletal meshes
 	};
 }
\ No newline at end of file
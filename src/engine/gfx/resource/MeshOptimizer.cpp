@@ -0,0 +1,621 @@
+#include "../../PCH.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace GFX::MeshOptimizer
+{
+  namespace
+  {
+    // the LRU cache Forsyth's scoring models. it's bigger than any hardware cache, which only makes
+    // vertices that have just left the real cache a little more attractive
+    constexpr uint32_t SCORING_CACHE_SIZE = 32;
+    constexpr float CACHE_DECAY_POWER = 1.5f;
+    constexpr float LAST_TRI_SCORE = 0.75f;
+    constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    // soft cluster boundaries are only cut once a cluster has this many triangles
+    constexpr size_t MIN_CLUSTER_TRIANGLES = 64;
+
+    constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+    float VertexScore(int cachePosition, uint32_t liveTriangles)
+    {
+      if (liveTriangles == 0)
+      {
+        return -1.0f;
+      }
+
+      float score = 0;
+      if (cachePosition >= 0)
+      {
+        // the last triangle's vertices get a fixed score, so that strips don't keep turning back on themselves
+        if (cachePosition < 3)
+        {
+          score = LAST_TRI_SCORE;
+        }
+        else
+        {
+          const float scaler = 1.0f / (SCORING_CACHE_SIZE - 3);
+          score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+      }
+
+      // vertices with few triangles left are finished off first, so they don't get stranded
+      score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+      return score;
+    }
+
+    // simulates a FIFO cache and returns whether each vertex of a triangle missed
+    struct FifoCache
+    {
+      explicit FifoCache(size_t vertexCount) : timestamps(vertexCount, 0) {}
+
+      bool Access(Index vertex)
+      {
+        // a timestamp of 0 means never seen
+        if (timestamps[vertex] == 0 || time - timestamps[vertex] >= VERTEX_CACHE_SIZE)
+        {
+          timestamps[vertex] = ++time;
+          return true;
+        }
+        return false;
+      }
+
+      std::vector<uint32_t> timestamps;
+      uint32_t time = 0;
+    };
+
+    glm::vec3 Centroid(const Vertex& a, const Vertex& b, const Vertex& c)
+    {
+      return (a.position + b.position + c.position) / 3.0f;
+    }
+
+    // length is twice the triangle's area
+    glm::vec3 AreaNormal(const Vertex& a, const Vertex& b, const Vertex& c)
+    {
+      return glm::cross(b.position - a.position, c.position - a.position);
+    }
+
+    // sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+    struct Quadric
+    {
+      double a00{}, a01{}, a02{}, a11{}, a12{}, a22{};
+      double b0{}, b1{}, b2{};
+      double c{};
+
+      static Quadric FromPlane(glm::dvec3 n, double d)
+      {
+        return { n.x * n.x, n.x * n.y, n.x * n.z, n.y * n.y, n.y * n.z, n.z * n.z, n.x * d, n.y * d, n.z * d, d * d };
+      }
+
+      Quadric& operator+=(const Quadric& q)
+      {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        return *this;
+      }
+
+      double Error(glm::dvec3 p) const
+      {
+        const double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+        const double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+        const double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+        const double error = p.x * rx + p.y * ry + p.z * rz + 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return std::max(error, 0.0);
+      }
+    };
+
+    struct PositionHash
+    {
+      size_t operator()(const glm::vec3& p) const
+      {
+        return std::hash<float>()(p.x) ^ (std::hash<float>()(p.y) * 31) ^ (std::hash<float>()(p.z) * 131);
+      }
+    };
+
+    uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+      return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+  }
+
+  void OptimizeVertexCache(std::span<Index> indices, size_t vertexCount)
+  {
+    ASSERT(indices.size() % 3 == 0);
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+      return;
+    }
+
+    // triangles using each vertex, packed into one array. the first liveTriangles of a vertex's range are
+    // the ones that haven't been emitted yet
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (Index index : indices)
+    {
+      ASSERT(index < vertexCount);
+      liveTriangles[index]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+      std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+      for (size_t i = 0; i < indices.size(); i++)
+      {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+      vertexScores[v] = VertexScore(-1, liveTriangles[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    uint32_t bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+      if (triangleScores[t] > triangleScores[bestTriangle])
+      {
+        bestTriangle = static_cast<uint32_t>(t);
+      }
+    }
+
+    std::vector<Index> output;
+    output.reserve(indices.size());
+    std::vector<Index> cache;
+    std::vector<Index> newCache;
+    cache.reserve(SCORING_CACHE_SIZE + 3);
+    newCache.reserve(SCORING_CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+      if (bestTriangle == INVALID)
+      {
+        // nothing in the cache has triangles left, so start again from the next unused triangle in input order
+        while (emitted[scanCursor])
+        {
+          scanCursor++;
+        }
+        bestTriangle = static_cast<uint32_t>(scanCursor);
+      }
+
+      const Index* tri = &indices[bestTriangle * 3];
+      output.insert(output.end(), tri, tri + 3);
+      emitted[bestTriangle] = true;
+
+      for (int i = 0; i < 3; i++)
+      {
+        const Index v = tri[i];
+        uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+        uint32_t* end = begin + liveTriangles[v];
+        auto it = std::find(begin, end, bestTriangle);
+        ASSERT(it != end);
+        std::swap(*it, *(end - 1));
+        liveTriangles[v]--;
+      }
+
+      // the triangle's vertices move to the front, and everything else is pushed back
+      newCache.assign(tri, tri + 3);
+      for (Index v : cache)
+      {
+        if (v != tri[0] && v != tri[1] && v != tri[2])
+        {
+          newCache.push_back(v);
+        }
+      }
+      for (size_t i = 0; i < newCache.size(); i++)
+      {
+        const Index v = newCache[i];
+        cachePositions[v] = i < SCORING_CACHE_SIZE ? static_cast<int>(i) : -1;
+        vertexScores[v] = VertexScore(cachePositions[v], liveTriangles[v]);
+      }
+
+      // only triangles touching a vertex whose score changed can have a new score
+      bestTriangle = INVALID;
+      float bestScore = -std::numeric_limits<float>::infinity();
+      for (Index v : newCache)
+      {
+        for (uint32_t a = 0; a < liveTriangles[v]; a++)
+        {
+          const uint32_t t = adjacency[adjacencyOffsets[v] + a];
+          const float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+          triangleScores[t] = score;
+          if (score > bestScore)
+          {
+            bestScore = score;
+            bestTriangle = t;
+          }
+        }
+      }
+
+      if (newCache.size() > SCORING_CACHE_SIZE)
+      {
+        newCache.resize(SCORING_CACHE_SIZE);
+      }
+      std::swap(cache, newCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+  }
+
+  void OptimizeOverdraw(std::span<Index> indices, std::span<const Vertex> vertices)
+  {
+    ASSERT(indices.size() % 3 == 0);
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+      return;
+    }
+
+    // cut a new cluster wherever every vertex of a triangle misses the cache, as the cache is cold there
+    // anyway. big clusters are also cut where two vertices miss, which costs at most a vertex per cut
+    std::vector<size_t> clusterStarts{ 0 };
+    FifoCache fifo(vertices.size());
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      int misses = 0;
+      for (int i = 0; i < 3; i++)
+      {
+        misses += fifo.Access(indices[t * 3 + i]);
+      }
+
+      const size_t clusterSize = t - clusterStarts.back();
+      if (t > 0 && (misses == 3 || (misses == 2 && clusterSize >= MIN_CLUSTER_TRIANGLES)))
+      {
+        clusterStarts.push_back(t);
+      }
+    }
+    if (clusterStarts.size() == 1)
+    {
+      return;
+    }
+    clusterStarts.push_back(triangleCount);
+
+    glm::vec3 meshCentroid{ 0 };
+    float meshArea = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+      const Vertex& a = vertices[indices[t * 3]];
+      const Vertex& b = vertices[indices[t * 3 + 1]];
+      const Vertex& c = vertices[indices[t * 3 + 2]];
+      const float area = glm::length(AreaNormal(a, b, c));
+      meshCentroid += Centroid(a, b, c) * area;
+      meshArea += area;
+    }
+    meshCentroid /= std::max(meshArea, std::numeric_limits<float>::min());
+
+    // clusters whose average normal points away from the middle of the mesh tend to be in front of the rest
+    struct Cluster
+    {
+      size_t first;
+      size_t count;
+      float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    clusters.reserve(clusterStarts.size() - 1);
+    for (size_t i = 0; i + 1 < clusterStarts.size(); i++)
+    {
+      glm::vec3 centroid{ 0 };
+      glm::vec3 normal{ 0 };
+      float area = 0;
+      for (size_t t = clusterStarts[i]; t < clusterStarts[i + 1]; t++)
+      {
+        const Vertex& a = vertices[indices[t * 3]];
+        const Vertex& b = vertices[indices[t * 3 + 1]];
+        const Vertex& c = vertices[indices[t * 3 + 2]];
+        const glm::vec3 areaNormal = AreaNormal(a, b, c);
+        const float triArea = glm::length(areaNormal);
+        centroid += Centroid(a, b, c) * triArea;
+        normal += areaNormal;
+        area += triArea;
+      }
+
+      float sortKey = 0;
+      const float normalLength = glm::length(normal);
+      if (area > 0 && normalLength > 0)
+      {
+        sortKey = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+      }
+      clusters.push_back({ clusterStarts[i], clusterStarts[i + 1] - clusterStarts[i], sortKey });
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+      {
+        return a.sortKey > b.sortKey;
+      });
+
+    std::vector<Index> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+    {
+      const Index* first = &indices[cluster.first * 3];
+      output.insert(output.end(), first, first + cluster.count * 3);
+    }
+    std::copy(output.begin(), output.end(), indices.begin());
+  }
+
+  std::vector<Vertex> OptimizeVertexFetch(std::span<Index> indices, std::span<const Vertex> vertices)
+  {
+    std::vector<Index> remap(vertices.size(), INVALID);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+    for (Index& index : indices)
+    {
+      ASSERT(index < vertices.size());
+      if (remap[index] == INVALID)
+      {
+        remap[index] = static_cast<Index>(output.size());
+        output.push_back(vertices[index]);
+      }
+      index = remap[index];
+    }
+    return output;
+  }
+
+  float ComputeACMR(std::span<const Index> indices, size_t vertexCount)
+  {
+    if (indices.size() < 3)
+    {
+      return 0;
+    }
+
+    FifoCache fifo(vertexCount);
+    size_t misses = 0;
+    for (Index index : indices)
+    {
+      misses += fifo.Access(index);
+    }
+    return static_cast<float>(misses) / (indices.size() / 3);
+  }
+
+  std::vector<Index> Simplify(std::span<const Index> indices, std::span<const Vertex> vertices, size_t targetIndexCount, float& error)
+  {
+    ASSERT(indices.size() % 3 == 0);
+    error = 0;
+    std::vector<Index> result(indices.begin(), indices.end());
+    const size_t vertexCount = vertices.size();
+
+    // vertices split along a seam share a position. topology is worked out on the first vertex with each
+    // position, so that the two sides of a seam are seen as connected
+    std::vector<Index> canonical(vertexCount);
+    std::vector<uint32_t> wedges(vertexCount, 0);
+    {
+      std::unordered_map<glm::vec3, Index, PositionHash> firstWithPosition;
+      for (Index v = 0; v < vertexCount; v++)
+      {
+        canonical[v] = firstWithPosition.try_emplace(vertices[v].position, v).first->second;
+        wedges[canonical[v]]++;
+      }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+      const Index c[3] = { canonical[result[t]], canonical[result[t + 1]], canonical[result[t + 2]] };
+      const glm::dvec3 p0 = vertices[c[0]].position;
+      const glm::dvec3 normal = glm::cross(glm::dvec3(vertices[c[1]].position) - p0, glm::dvec3(vertices[c[2]].position) - p0);
+      const double length = glm::length(normal);
+      if (length > 0)
+      {
+        const glm::dvec3 n = normal / length;
+        const Quadric plane = Quadric::FromPlane(n, -glm::dot(n, p0));
+        for (Index v : c)
+        {
+          quadrics[v] += plane;
+        }
+      }
+      for (int i = 0; i < 3; i++)
+      {
+        edgeUses[EdgeKey(c[i], c[(i + 1) % 3])]++;
+      }
+    }
+
+    // an edge used by one triangle is on an open border
+    std::vector<bool> locked(vertexCount, false);
+    for (Index v = 0; v < vertexCount; v++)
+    {
+      locked[v] = wedges[canonical[v]] > 1;
+    }
+    for (const auto& [edge, uses] : edgeUses)
+    {
+      if (uses != 2)
+      {
+        locked[edge >> 32] = true;
+        locked[edge & 0xFFFFFFFF] = true;
+      }
+    }
+
+    struct Collapse
+    {
+      Index from;
+      Index to;
+      double cost;
+    };
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<Index> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<Index> neighbors;
+    double maxCost = 0;
+
+    // each pass collapses as many independent edges as it can, cheapest first
+    while (result.size() > targetIndexCount)
+    {
+      // triangles around each vertex. unlocked vertices are their own canonical vertex, so this is all that's needed
+      adjacencyOffsets.assign(vertexCount + 1, 0);
+      for (Index index : result)
+      {
+        adjacencyOffsets[canonical[index] + 1]++;
+      }
+      std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+      adjacency.resize(result.size());
+      {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+        {
+          adjacency[fill[canonical[result[i]]]++] = static_cast<uint32_t>(i / 3);
+        }
+      }
+
+      collapses.clear();
+      for (size_t t = 0; t < result.size(); t += 3)
+      {
+        for (int i = 0; i < 3; i++)
+        {
+          const Index from = result[t + i];
+          if (!locked[from])
+          {
+            for (int j : { (i + 1) % 3, (i + 2) % 3 })
+            {
+              const Index to = result[t + j];
+              collapses.push_back({ from, to, quadrics[from].Error(vertices[to].position) });
+            }
+          }
+        }
+      }
+      std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+      std::iota(remap.begin(), remap.end(), Index(0));
+      std::fill(touched.begin(), touched.end(), false);
+      const size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+      size_t removed = 0;
+      for (const Collapse& collapse : collapses)
+      {
+        const Index from = collapse.from;
+        const Index to = canonical[collapse.to];
+        if (touched[from] || touched[to] || removed >= trianglesToRemove)
+        {
+          continue;
+        }
+
+        // the edge must be shared by exactly two triangles whose other vertices are the only neighbors both
+        // ends have in common, or collapsing it would pinch the surface
+        neighbors.clear();
+        bool valid = true;
+        uint32_t sharedTriangles = 0;
+        Index opposite[2]{};
+        for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && valid; a++)
+        {
+          const Index* tri = &result[adjacency[a] * 3];
+          const Index c[3] = { canonical[tri[0]], canonical[tri[1]], canonical[tri[2]] };
+          if (c[0] == to || c[1] == to || c[2] == to)
+          {
+            if (sharedTriangles < 2)
+            {
+              opposite[sharedTriangles] = c[0] ^ c[1] ^ c[2] ^ from ^ to;
+            }
+            sharedTriangles++;
+            continue;
+          }
+          for (Index v : c)
+          {
+            if (v != from)
+            {
+              neighbors.push_back(v);
+            }
+          }
+
+          // the triangles that stay mustn't flip or fold over
+          glm::vec3 p[3];
+          for (int i = 0; i < 3; i++)
+          {
+            p[i] = c[i] == from ? vertices[to].position : vertices[c[i]].position;
+          }
+          const glm::vec3 before = AreaNormal(vertices[c[0]], vertices[c[1]], vertices[c[2]]);
+          const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+          valid = glm::dot(before, after) > 0.25f * glm::length(before) * glm::length(after);
+        }
+        if (!valid || sharedTriangles != 2)
+        {
+          continue;
+        }
+
+        uint32_t sharedNeighbors = 0;
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (uint32_t a = adjacencyOffsets[to]; a < adjacencyOffsets[to + 1]; a++)
+        {
+          const Index* tri = &result[adjacency[a] * 3];
+          for (int i = 0; i < 3; i++)
+          {
+            const Index c = canonical[tri[i]];
+            if (c != to && c != from && c != opposite[0] && c != opposite[1] &&
+              std::binary_search(neighbors.begin(), neighbors.end(), c))
+            {
+              sharedNeighbors++;
+            }
+          }
+        }
+        if (sharedNeighbors != 0)
+        {
+          continue;
+        }
+
+        remap[from] = collapse.to;
+        quadrics[to] += quadrics[from];
+        maxCost = std::max(maxCost, collapse.cost);
+        removed += sharedTriangles;
+
+        // nothing around this collapse can move again this pass, as the checks above read the old triangles
+        touched[from] = true;
+        touched[to] = true;
+        for (Index v : neighbors)
+        {
+          touched[v] = true;
+        }
+      }
+
+      if (removed == 0)
+      {
+        break;
+      }
+
+      size_t write = 0;
+      for (size_t t = 0; t < result.size(); t += 3)
+      {
+        const Index tri[3] = { remap[result[t]], remap[result[t + 1]], remap[result[t + 2]] };
+        if (canonical[tri[0]] != canonical[tri[1]] && canonical[tri[1]] != canonical[tri[2]] && canonical[tri[2]] != canonical[tri[0]])
+        {
+          result[write++] = tri[0];
+          result[write++] = tri[1];
+          result[write++] = tri[2];
+        }
+      }
+      result.resize(write);
+    }
+
+    error = static_cast<float>(std::sqrt(maxCost));
+    return result;
+  }
+
+  AABB ComputeBounds(std::span<const Vertex> vertices)
+  {
+    if (vertices.empty())
+    {
+      return AABB(glm::vec3(0), glm::vec3(0));
+    }
+
+    AABB bounds(vertices[0].position, vertices[0].position);
+    for (const Vertex& vertex : vertices)
+    {
+      bounds.min = glm::min(bounds.min, vertex.position);
+      bounds.max = glm::max(bounds.max, vertex.position);
+    }
+    return bounds;
+  }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <engine/Shapes.h>
+#include "../Mesh.h"
+
+namespace GFX
+{
+  // Import-time reordering of triangle lists, so that the GPU does less work drawing them. None of it
+  // changes what a mesh looks like, only the order its triangles and vertices are stored in.
+  namespace MeshOptimizer
+  {
+    // the post-transform cache the orderings are tuned for. real hardware varies, but is rarely smaller
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    // reorders triangles so that consecutive ones share vertices (Forsyth's linear-speed algorithm)
+    void OptimizeVertexCache(std::span<Index> indices, size_t vertexCount);
+
+    // reorders clusters of triangles so that ones facing outwards are drawn first, which lets early depth
+    // testing reject more of what's behind them. clusters are cut where the vertex cache would have missed
+    // anyway, so run this after OptimizeVertexCache
+    void OptimizeOverdraw(std::span<Index> indices, std::span<const Vertex> vertices);
+
+    // reorders vertices into the order they're first used in, dropping unused ones, and remaps the indices
+    // so that vertex fetches walk through memory. run this last
+    std::vector<Vertex> OptimizeVertexFetch(std::span<Index> indices, std::span<const Vertex> vertices);
+
+    // average cache misses per triangle with a FIFO cache of VERTEX_CACHE_SIZE (0.5 is ideal, 3 is the worst)
+    float ComputeACMR(std::span<const Index> indices, size_t vertexCount);
+
+    AABB ComputeBounds(std::span<const Vertex> vertices);
+
+    // Quadric edge collapse. Returns a simpler version of the mesh with at most targetIndexCount indices,
+    // or as close as it could get. The result indexes the same vertices, so LODs can share a vertex buffer.
+    // Vertices on open borders or attribute seams never move, so that the mesh doesn't crack or tear.
+    // error receives an upper bound on how far (in object units) the surface moved
+    std::vector<Index> Simplify(std::span<const Index> indices, std::span<const Vertex> vertices, size_t targetIndexCount, float& error);
+  }
+}
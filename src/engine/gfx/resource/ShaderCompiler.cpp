@@ -0,0 +1,449 @@
+#include "../../PCH.h"
+#include <shaderc/shaderc.hpp>
+#include "ShaderCompiler.h"
+#include <engine/core/JobSystem.h>
+#include <utility/Hash.h>
+#include <utility/Timer.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <regex>
+#include <thread>
+
+namespace GFX
+{
+  namespace
+  {
+    shaderc_shader_kind shaderTypeToShadercType[]
+    {
+      shaderc_glsl_infer_from_source,
+      shaderc_vertex_shader,
+      shaderc_tess_control_shader,
+      shaderc_tess_evaluation_shader,
+      shaderc_geometry_shader,
+      shaderc_fragment_shader,
+      shaderc_compute_shader,
+    };
+
+    // bump when the options below or the entry layout change, so old entries are ignored
+    constexpr uint32_t CACHE_VERSION = 1;
+    constexpr uint32_t CACHE_MAGIC = 0x43535356; // "VSSC"
+    constexpr std::string_view COMPILER_OPTIONS = "glsl;opengl450;werror";
+
+    std::mutex cacheDirectoryMutex;
+    std::string cacheDirectory = "cache/shaders/";
+
+    std::string GetCacheDirectory()
+    {
+      std::lock_guard lck(cacheDirectoryMutex);
+      return cacheDirectory;
+    }
+
+    std::string LoadFileA(std::string_view path)
+    {
+      std::string content;
+      try
+      {
+        std::string patha(path); // intellisense complains if I don't make this an explicit variable
+        std::ifstream ifs(patha);
+        content = std::string((std::istreambuf_iterator<char>(ifs)),
+          (std::istreambuf_iterator<char>()));
+      }
+      catch (std::ifstream::failure e)
+      {
+        std::cout << "Error reading shader file: " << path << '\n';
+        std::cout << "Message: " << e.what() << std::endl;
+      }
+      return content;
+    }
+
+    std::string LoadFile(std::string_view path)
+    {
+      std::string shaderpath = std::string(ShaderDir) + std::string(path);
+      return LoadFileA(shaderpath);
+    }
+
+    using IncludeList = std::vector<std::pair<std::string, uint64_t>>; // path and hash of the content that was used
+
+    // records every file it includes, which is what a cache entry depends on besides the stage's own source
+    // the content it hands to the compiler is what gets hashed, so an edit made while compiling can't be missed
+    class IncludeHandler : public shaderc::CompileOptions::IncluderInterface
+    {
+    public:
+      IncludeHandler(IncludeList& includes)
+        : includes_(includes)
+      {
+      }
+
+      shaderc_include_result* GetInclude(
+        const char* requested_source,
+        [[maybe_unused]] shaderc_include_type type,
+        [[maybe_unused]] const char* requesting_source,
+        [[maybe_unused]] size_t include_depth) final
+      {
+        auto* include = new Include;
+
+        std::filesystem::path requesting = std::string(ShaderDir) + std::string(requesting_source);
+        std::string includePath = requesting.parent_path().string() + "/" + requested_source;
+        include->content = LoadFileA(includePath);
+        include->sourceName = requested_source;
+        includes_.emplace_back(std::move(includePath), Hasher64().Add(include->content).hash);
+
+        include->result.content = include->content.c_str();
+        include->result.source_name = include->sourceName.c_str();
+        include->result.content_length = include->content.size();
+        include->result.source_name_length = include->sourceName.size();
+        include->result.user_data = include;
+
+        return &include->result;
+      }
+
+      void ReleaseInclude(shaderc_include_result* data) final
+      {
+        delete static_cast<Include*>(data->user_data);
+      }
+
+    private:
+      struct Include
+      {
+        shaderc_include_result result{};
+        std::string content;
+        std::string sourceName;
+      };
+
+      IncludeList& includes_;
+    };
+
+    shaderc::CompileOptions MakeOptions(IncludeList& includes)
+    {
+      shaderc::CompileOptions options;
+      options.SetSourceLanguage(shaderc_source_language_glsl);
+      options.SetTargetEnvironment(shaderc_target_env_opengl, 450);
+      options.SetIncluder(std::make_unique<IncludeHandler>(includes));
+      options.SetWarningsAsErrors();
+      //options.SetAutoMapLocations(true);
+      //options.SetAutoBindUniforms(true);
+      //options.SetGenerateDebugInfo();
+      return options;
+    }
+
+    bool PreprocessShader(
+      const shaderc::Compiler& compiler,
+      const shaderc::CompileOptions& options,
+      const std::string& rawSource,
+      const ShaderCreateInfo& createInfo,
+      std::string& preprocessed)
+    {
+      std::string src = rawSource;
+      for (const auto& [search, replacement] : createInfo.replace)
+      {
+        src = std::regex_replace(src, std::regex(search), replacement);
+      }
+
+      auto PreprocessResult = compiler.PreprocessGlsl(
+        src, shaderTypeToShadercType[(int)createInfo.type], createInfo.path.c_str(), options);
+      if (auto numErr = PreprocessResult.GetNumErrors(); numErr > 0)
+      {
+        spdlog::error("{} errors preprocessing {}!\n", numErr, createInfo.path);
+        spdlog::error("{}", PreprocessResult.GetErrorMessage());
+        return false;
+      }
+
+      preprocessed = std::regex_replace(std::string(PreprocessResult.begin(), PreprocessResult.end()),
+        std::regex(
+          R"((#extension\s+GL_GOOGLE_include_directive\s+:\s+\S+)|(#line\s+[0-9]+\s+"[_\/\\0-9a-zA-Z\.]+"))"),
+        "// line removed for compatibility");
+      return true;
+    }
+
+    bool CompileSpirv(
+      const shaderc::Compiler& compiler,
+      const shaderc::CompileOptions& options,
+      const std::string& preprocessed,
+      const ShaderCreateInfo& createInfo,
+      std::vector<uint32_t>& spirv)
+    {
+      auto CompileResult = compiler.CompileGlslToSpv(
+        preprocessed.c_str(), shaderTypeToShadercType[(int)createInfo.type], createInfo.path.c_str(), options);
+      if (auto numErr = CompileResult.GetNumErrors(); numErr > 0)
+      {
+        spdlog::error("{} shaderc errors compiling {}!", numErr, createInfo.path);
+        spdlog::error("{}", CompileResult.GetErrorMessage());
+        return false;
+      }
+
+      spirv.assign(CompileResult.begin(), CompileResult.end());
+      return true;
+    }
+
+    // shaderc has no version query, so the compiler is identified by what it makes of a fixed shader
+    // the SPIR-V header carries glslang's generator version, and the rest changes with its code generation
+    uint64_t CompilerFingerprint()
+    {
+      static const uint64_t fingerprint = []
+      {
+        constexpr std::string_view probe = "#version 450\nlayout(location = 0) out vec4 o_color;\nvoid main() { o_color = vec4(gl_FragCoord.xy, 0, 1); }\n";
+        shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+        options.SetTargetEnvironment(shaderc_target_env_opengl, 450);
+        auto result = compiler.CompileGlslToSpv(probe.data(), probe.size(), shaderc_fragment_shader, "probe", options);
+        Hasher64 hasher;
+        hasher.Add(result.cbegin(), (result.cend() - result.cbegin()) * sizeof(uint32_t));
+        return hasher.hash;
+      }();
+      return fingerprint;
+    }
+
+    uint64_t StageKey(const ShaderCreateInfo& createInfo, const std::string& rawSource)
+    {
+      Hasher64 hasher;
+      hasher.Add(&CACHE_VERSION, sizeof(CACHE_VERSION));
+      hasher.Add(COMPILER_OPTIONS);
+      const uint64_t compiler = CompilerFingerprint();
+      hasher.Add(&compiler, sizeof(compiler));
+      hasher.Add(&createInfo.type, sizeof(createInfo.type));
+      hasher.Add(createInfo.path);
+      hasher.Add(rawSource);
+      for (const auto& [search, replacement] : createInfo.replace)
+      {
+        hasher.Add(search).Add(replacement);
+      }
+      return hasher.hash;
+    }
+
+    uint64_t HashFile(const std::string& path)
+    {
+      return Hasher64().Add(LoadFileA(path)).hash;
+    }
+
+    // entry layout: magic, version, include count, {path, content hash} per include, glsl, spirv words
+    struct CacheEntry
+    {
+      IncludeList includes;
+      std::string glsl;
+      std::vector<uint32_t> spirv;
+    };
+
+    std::string EntryPath(const std::string& directory, uint64_t key)
+    {
+      return fmt::format("{}{:016x}.bin", directory, key);
+    }
+
+    template<typename T>
+    bool Read(std::istream& is, T& value)
+    {
+      return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    template<typename T>
+    bool ReadArray(std::istream& is, T& container)
+    {
+      uint64_t size{};
+      if (!Read(is, size) || size > (1ull << 28))
+      {
+        return false;
+      }
+      container.resize(size);
+      return static_cast<bool>(is.read(reinterpret_cast<char*>(container.data()), size * sizeof(container[0])));
+    }
+
+    template<typename T>
+    void Write(std::ostream& os, const T& value)
+    {
+      os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void WriteArray(std::ostream& os, const T& container)
+    {
+      const uint64_t size = container.size();
+      Write(os, size);
+      os.write(reinterpret_cast<const char*>(container.data()), size * sizeof(container[0]));
+    }
+
+    std::optional<CacheEntry> LoadEntry(const std::string& directory, uint64_t key)
+    {
+      std::ifstream file(EntryPath(directory, key), std::ios::binary);
+      if (!file)
+      {
+        return std::nullopt;
+      }
+
+      uint32_t magic{}, version{}, includeCount{};
+      if (!Read(file, magic) || magic != CACHE_MAGIC || !Read(file, version) || version != CACHE_VERSION || !Read(file, includeCount))
+      {
+        return std::nullopt;
+      }
+
+      CacheEntry entry;
+      entry.includes.resize(includeCount);
+      for (auto& [path, hash] : entry.includes)
+      {
+        if (!ReadArray(file, path) || !Read(file, hash))
+        {
+          return std::nullopt;
+        }
+      }
+      if (!ReadArray(file, entry.glsl) || !ReadArray(file, entry.spirv))
+      {
+        return std::nullopt;
+      }
+
+      // stale if any included file has changed since
+      for (const auto& [path, hash] : entry.includes)
+      {
+        if (HashFile(path) != hash)
+        {
+          return std::nullopt;
+        }
+      }
+      return entry;
+    }
+
+    void StoreEntry(const std::string& directory, uint64_t key, const CacheEntry& entry)
+    {
+      // written to the side and renamed into place, so a reader never sees half an entry
+      const std::string path = EntryPath(directory, key);
+      const std::string tempPath = fmt::format("{}.{}.tmp", path, std::hash<std::thread::id>{}(std::this_thread::get_id()));
+      {
+        std::ofstream file(tempPath, std::ios::binary);
+        if (!file)
+        {
+          return;
+        }
+        Write(file, CACHE_MAGIC);
+        Write(file, CACHE_VERSION);
+        Write(file, static_cast<uint32_t>(entry.includes.size()));
+        for (const auto& [includePath, hash] : entry.includes)
+        {
+          WriteArray(file, includePath);
+          Write(file, hash);
+        }
+        WriteArray(file, entry.glsl);
+        WriteArray(file, entry.spirv);
+      }
+
+      std::error_code ec;
+      std::filesystem::rename(tempPath, path, ec);
+      if (ec)
+      {
+        std::filesystem::remove(tempPath, ec);
+      }
+    }
+  }
+
+  namespace ShaderCompiler
+  {
+    void SetCacheDirectory(std::string directory)
+    {
+      if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+      {
+        directory += '/';
+      }
+      std::lock_guard lck(cacheDirectoryMutex);
+      cacheDirectory = std::move(directory);
+    }
+
+    CompiledShaderStage CompileStage(const ShaderCreateInfo& createInfo, bool spirv)
+    {
+      CompiledShaderStage stage;
+      const std::string directory = GetCacheDirectory();
+      const std::string rawSource = LoadFile(createInfo.path);
+      const uint64_t key = StageKey(createInfo, rawSource);
+
+      std::optional<CacheEntry> entry;
+      if (!directory.empty())
+      {
+        entry = LoadEntry(directory, key);
+      }
+
+      if (entry && (!spirv || !entry->spirv.empty()))
+      {
+        stage.ok = true;
+        stage.fromCache = true;
+        stage.glsl = std::move(entry->glsl);
+        stage.spirv = std::move(entry->spirv);
+        return stage;
+      }
+
+      shaderc::Compiler compiler;
+      ASSERT(compiler.IsValid());
+      IncludeList includes;
+      auto options = MakeOptions(includes);
+
+      // an entry without SPIR-V still saves preprocessing
+      if (entry)
+      {
+        includes = std::move(entry->includes);
+        stage.glsl = std::move(entry->glsl);
+      }
+      else if (!PreprocessShader(compiler, options, rawSource, createInfo, stage.glsl))
+      {
+        return stage;
+      }
+
+      // includes are resolved by now, so compiling doesn't add to them
+      if (spirv && !CompileSpirv(compiler, options, stage.glsl, createInfo, stage.spirv))
+      {
+        return stage;
+      }
+      stage.ok = true;
+
+      if (!directory.empty())
+      {
+        StoreEntry(directory, key, { .includes = std::move(includes), .glsl = stage.glsl, .spirv = stage.spirv });
+      }
+      return stage;
+    }
+
+    std::vector<CompiledShaderStage> CompileStages(std::span<const ShaderCreateInfo> createInfos, bool spirv)
+    {
+      Timer timer;
+      if (const auto directory = GetCacheDirectory(); !directory.empty())
+      {
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+      }
+
+      // stages shared by several programs (like fullscreen vertex shaders) are compiled once
+      std::vector<uint32_t> uniqueIndex(createInfos.size());
+      std::vector<uint32_t> unique;
+      for (uint32_t i = 0; i < createInfos.size(); i++)
+      {
+        auto it = std::find_if(unique.begin(), unique.end(), [&](uint32_t u) { return createInfos[u] == createInfos[i]; });
+        uniqueIndex[i] = static_cast<uint32_t>(it - unique.begin());
+        if (it == unique.end())
+        {
+          unique.push_back(i);
+        }
+      }
+
+      std::vector<CompiledShaderStage> compiled(unique.size());
+      std::atomic_uint32_t cached{ 0 };
+      std::vector<uint32_t> jobs(unique.size());
+      std::iota(jobs.begin(), jobs.end(), 0u);
+      engine::Core::JobSystem::Get()->ForEach(jobs.begin(), jobs.end(), [&](uint32_t u)
+        {
+          compiled[u] = CompileStage(createInfos[unique[u]], spirv);
+          if (compiled[u].fromCache)
+          {
+            cached.fetch_add(1, std::memory_order_relaxed);
+          }
+        }, 1);
+
+      std::vector<CompiledShaderStage> stages;
+      stages.reserve(createInfos.size());
+      for (uint32_t i = 0; i < createInfos.size(); i++)
+      {
+        stages.push_back(compiled[uniqueIndex[i]]);
+      }
+
+      spdlog::info("Compiled {} shader stages ({} cached) in {:.1f} ms", unique.size(), cached.load(), timer.Elapsed_ms());
+      return stages;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GFX
+{
+  enum class ShaderType
+  {
+    UNDEFINED,
+    VERTEX,
+    TESS_CONTROL,
+    TESS_EVAL,
+    GEOMETRY,
+    FRAGMENT,
+    COMPUTE,
+  };
+
+  struct ShaderCreateInfo
+  {
+    std::string path{};
+    ShaderType type{};
+    std::vector<std::pair<std::string, std::string>> replace{};
+
+    bool operator==(const ShaderCreateInfo&) const = default;
+  };
+
+  struct CompiledShaderStage
+  {
+    bool ok = false;
+    bool fromCache = false;
+    std::string glsl{};            // preprocessed, with every include resolved
+    std::vector<uint32_t> spirv{}; // only made when asked for
+  };
+
+  // The CPU half of building shaders: preprocessing and compiling GLSL to SPIR-V. Doesn't touch GL.
+  // Compiled stages are cached on disk, keyed by the source, the replacements applied to it, the stage
+  // and the compiler and its options. Each entry also remembers the files the stage included, and is only used
+  // while all of them are unchanged, so a cache hit skips preprocessing entirely.
+  namespace ShaderCompiler
+  {
+    // an empty directory disables the cache
+    void SetCacheDirectory(std::string directory);
+
+    CompiledShaderStage CompileStage(const ShaderCreateInfo& createInfo, bool spirv);
+
+    // compiles every stage on the job system, compiling stages that appear more than once only once
+    // returns one result per create info, in the same order
+    std::vector<CompiledShaderStage> CompileStages(std::span<const ShaderCreateInfo> createInfos, bool spirv);
+  }
+}
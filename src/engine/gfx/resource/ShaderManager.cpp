@@ -1,29 +1,14 @@
 #include "../../PCH.h"
 #include <glad/glad.h>
-#include <shaderc/shaderc.hpp>
 #include "ShaderManager.h"
 #include <unordered_map>
-#include <fstream>
 #include <iostream>
-#include <regex>
-#include <filesystem>
 #include <utility/Defer.h>
 
 namespace GFX
 {
   namespace
   {
-    shaderc_shader_kind shaderTypeToShadercType[]
-    {
-      shaderc_glsl_infer_from_source,
-      shaderc_vertex_shader,
-      shaderc_tess_control_shader,
-      shaderc_tess_evaluation_shader,
-      shaderc_geometry_shader,
-      shaderc_fragment_shader,
-      shaderc_compute_shader,
-    };
-
     GLenum shaderTypeToGLType[]
     {
       0,
@@ -44,30 +29,6 @@ namespace GFX
     std::vector<ShaderCreateInfo> createInfos;
   };
 
-  static std::string LoadFileA(std::string_view path)
-  {
-    std::string content;
-    try
-    {
-      std::string patha(path); // intellisense complains if I don't make this an explicit variable
-      std::ifstream ifs(patha);
-      content = std::string((std::istreambuf_iterator<char>(ifs)),
-        (std::istreambuf_iterator<char>()));
-    }
-    catch (std::ifstream::failure e)
-    {
-      std::cout << "Error reading shader file: " << path << '\n';
-      std::cout << "Message: " << e.what() << std::endl;
-    }
-    return content;
-  }
-
-  static std::string LoadFile(std::string_view path)
-  {
-    std::string shaderpath = std::string(ShaderDir) + std::string(path);
-    return LoadFileA(shaderpath);
-  }
-
   bool GetShaderCompilationStatus(GFX::ShaderType type, std::string_view path, GLuint shader)
   {
     GLchar infoLog[512];
@@ -101,142 +62,16 @@ namespace GFX
     return shader;
   }
 
-  GLuint CompileShaderSpirV(GFX::ShaderType type, const std::string& src, const std::string& path, const shaderc::Compiler& compiler, const shaderc::CompileOptions& options)
+  GLuint CompileShaderSpirV(GFX::ShaderType type, std::span<const uint32_t> spirv, std::string_view path)
   {
-    auto compileResult = compiler.CompileGlslToSpv(
-      src.c_str(), shaderTypeToShadercType[(int)type], path.c_str(), options);
-    if (auto numErr = compileResult.GetNumErrors(); numErr > 0)
-    {
-      printf("%llu shaderc errors compiling %s!\n", numErr, path.c_str());
-      printf("%s", compileResult.GetErrorMessage().c_str());
-      return 0;
-    }
-
     GLuint shader = glCreateShader(shaderTypeToGLType[(int)type]);
-    uintptr_t lengthBytes = reinterpret_cast<uintptr_t>(compileResult.end()) - reinterpret_cast<uintptr_t>(compileResult.begin());
-    glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, compileResult.begin(), lengthBytes);
+    glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, spirv.data(), static_cast<GLsizei>(spirv.size_bytes()));
     glSpecializeShader(shader, "main", 0, nullptr, nullptr);
 
     GetShaderCompilationStatus(type, path, shader);
     return shader;
   }
 
-  //std::string HandleIncludes([[maybe_unused]] std::string_view path, std::string_view rawSource)
-  //{
-  //  std::stringstream in{ std::string(rawSource) };
-  //  std::stringstream out;
-
-  //  enum class CommentType { None, CStyle, CppStyle };
-  //  CommentType inComment = CommentType::None;
-  //  for (std::string line; std::getline(in, line, '\n');)
-  //  {
-  //    if (inComment == CommentType::None)
-  //    {
-  //      auto findRes = line.find("#include ", 0);
-  //      if (findRes != std::string::npos)
-  //      {
-  //        auto includePath = line.substr(line.find_first_of, line.size() - 2);
-  //        return includePath;
-  //      }
-  //    }
-  //  }
-
-  //  return out.str();
-  //}
-
-  std::string PreprocessShader(
-    shaderc::Compiler& compiler,
-    const shaderc::CompileOptions options,
-    const std::vector<std::pair<std::string, std::string>>& replace,
-    std::string path,
-    shaderc_shader_kind shaderType)
-  {
-    std::string rawSrc = LoadFile(path);
-    for (const auto& [search, replacement] : replace)
-    {
-      rawSrc = std::regex_replace(rawSrc, std::regex(search), replacement);
-    }
-    
-    auto PreprocessResult = compiler.PreprocessGlsl(
-      rawSrc, shaderType, path.c_str(), options);
-    if (auto numErr = PreprocessResult.GetNumErrors(); numErr > 0)
-    {
-      PreprocessResult.GetCompilationStatus();
-      spdlog::error("{} errors preprocessing {}!\n", numErr, path);
-      spdlog::error("{}", PreprocessResult.GetErrorMessage());
-      return {};
-    }
-
-    //if (auto str = HandleIncludes(path, rawSrc); !str.empty())
-    //{
-    //  spdlog::debug("Include: {}", str);
-    //}
-
-    std::string preprocessed = PreprocessResult.begin();
-    preprocessed = std::regex_replace(preprocessed,
-      std::regex(
-        R"((#extension\s+GL_GOOGLE_include_directive\s+:\s+\S+)|(#line\s+[0-9]+\s+"[_\/\\0-9a-zA-Z\.]+"))"),
-      "// line removed for compatibility");
-
-    return preprocessed;
-  }
-
-  // returns compiled SPIR-V
-  std::vector<uint32_t>
-    PreprocessAndCompileSPIRV(
-      shaderc::Compiler& compiler,
-      const shaderc::CompileOptions options,
-      const std::vector<std::pair<std::string, std::string>>& replace,
-      std::string path,
-      shaderc_shader_kind shaderType)
-  {
-    std::string preprocessResult = PreprocessShader(compiler, options, replace, path, shaderType);
-
-    auto CompileResult = compiler.CompileGlslToSpv(
-      preprocessResult.c_str(), shaderType, path.c_str(), options);
-    if (auto numErr = CompileResult.GetNumErrors(); numErr > 0)
-    {
-      printf("%llu errors compiling %s!\n", numErr, path.c_str());
-      printf("%s", CompileResult.GetErrorMessage().c_str());
-      return {};
-    }
-
-    return { CompileResult.begin(), CompileResult.end() };
-  }
-
-  class IncludeHandler : public shaderc::CompileOptions::IncluderInterface
-  {
-  public:
-    shaderc_include_result* GetInclude(
-      const char* requested_source,
-      [[maybe_unused]] shaderc_include_type type,
-      [[maybe_unused]] const char* requesting_source,
-      [[maybe_unused]] size_t include_depth) final
-    {
-      auto* data = new shaderc_include_result;
-
-      std::filesystem::path requesting = std::string(ShaderDir) + std::string(requesting_source);
-      content = LoadFileA(requesting.parent_path().string() + "/" + requested_source);
-      source_name = requested_source;
-      
-      data->content = content.c_str();
-      data->source_name = source_name.c_str();
-      data->content_length = content.size();
-      data->source_name_length = source_name.size();
-      data->user_data = nullptr;
-
-      return data;
-    }
-
-    void ReleaseInclude([[maybe_unused]] shaderc_include_result* data) final
-    {
-    }
-
-  private:
-    std::string content{};
-    std::string source_name{};
-  };
-
   void InitUniforms(ShaderData& program)
   {
     GLint uniform_count = 0;
@@ -287,24 +122,25 @@ namespace GFX
     return true;
   }
 
-  ShaderData CompileProgram(hashed_string name, const std::vector<ShaderCreateInfo>& createInfos)
+  bool IsVendorNV()
   {
     std::string vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
     std::for_each(vendor.begin(), vendor.end(), [](char& c) { c = std::tolower(c); });
-    bool isVendorNV = vendor.find("nvidia") != std::string::npos;
+    return vendor.find("nvidia") != std::string::npos;
+  }
 
+  // stages holds the compiled result of each create info
+  ShaderData LinkProgram(hashed_string name, const std::vector<ShaderCreateInfo>& createInfos, std::span<const CompiledShaderStage> stages, bool isVendorNV)
+  {
     ShaderData shader;
-    shaderc::Compiler compiler;
-    ASSERT(compiler.IsValid());
-
-    shaderc::CompileOptions options;
-    options.SetSourceLanguage(shaderc_source_language_glsl);
-    options.SetTargetEnvironment(shaderc_target_env_opengl, 450);
-    options.SetIncluder(std::make_unique<IncludeHandler>());
-    options.SetWarningsAsErrors();
-    //options.SetAutoMapLocations(true);
-    //options.SetAutoBindUniforms(true);
-    //options.SetGenerateDebugInfo();
+    for (size_t i = 0; i < stages.size(); i++)
+    {
+      if (!stages[i].ok)
+      {
+        spdlog::error("Not linking {}, as {} failed to compile", name.data(), createInfos[i].path);
+        return shader;
+      }
+    }
 
     std::vector<GLuint> shaderIDs;
     Defer deleteShaders = [&shaderIDs]()
@@ -315,18 +151,17 @@ namespace GFX
       }
     };
 
-    for (auto& [shaderPath, shaderType, replace] : createInfos)
+    for (size_t i = 0; i < stages.size(); i++)
     {
-      std::string preprocessedSource = PreprocessShader(compiler, options, replace, shaderPath, shaderTypeToShadercType[(int)shaderType]);
-
+      const auto& [shaderPath, shaderType, replace] = createInfos[i];
       GLuint shaderID{};
       if (isVendorNV)
       {
-        shaderID = CompileShaderSpirV(shaderType, preprocessedSource, shaderPath, compiler, options);
+        shaderID = CompileShaderSpirV(shaderType, stages[i].spirv, shaderPath);
       }
       else
       {
-        shaderID = CompileShader(shaderType, preprocessedSource, shaderPath);
+        shaderID = CompileShader(shaderType, stages[i].glsl, shaderPath);
       }
 
       shaderIDs.push_back(shaderID);
@@ -382,17 +217,64 @@ namespace GFX
   {
     static std::unordered_map<uint32_t, ShaderData> shaders_;
 
-    std::optional<Shader> AddShader(hashed_string name, const std::vector<ShaderCreateInfo>& createInfos)
+    static bool batching_ = false;
+    static std::vector<std::pair<hashed_string, std::vector<ShaderCreateInfo>>> batch_;
+
+    static std::optional<Shader> addCompiledShader(hashed_string name, const std::vector<ShaderCreateInfo>& createInfos, std::span<const CompiledShaderStage> stages, bool isVendorNV)
     {
-      auto data = CompileProgram(name, createInfos);
+      auto data = LinkProgram(name, createInfos, stages, isVendorNV);
       if (data.id != 0 && !shaders_.contains(name))
       {
         auto it = shaders_.emplace(name, std::move(data));
         return Shader(it.first->second.uniformIDs, it.first->second.id);
       }
+      glDeleteProgram(data.id);
       return std::nullopt;
     }
 
+    std::optional<Shader> AddShader(hashed_string name, const std::vector<ShaderCreateInfo>& createInfos)
+    {
+      if (batching_)
+      {
+        batch_.emplace_back(name, createInfos);
+        return std::nullopt;
+      }
+
+      const bool isVendorNV = IsVendorNV();
+      auto stages = ShaderCompiler::CompileStages(createInfos, isVendorNV);
+      return addCompiledShader(name, createInfos, stages, isVendorNV);
+    }
+
+    void BeginBatch()
+    {
+      ASSERT(!batching_);
+      batching_ = true;
+    }
+
+    void EndBatch()
+    {
+      ASSERT(batching_);
+      batching_ = false;
+      auto programs = std::move(batch_);
+      batch_.clear();
+
+      std::vector<ShaderCreateInfo> createInfos;
+      for (const auto& [name, programInfos] : programs)
+      {
+        createInfos.insert(createInfos.end(), programInfos.begin(), programInfos.end());
+      }
+
+      // only linking touches GL, so it's the only part left on this thread
+      const bool isVendorNV = IsVendorNV();
+      auto stages = ShaderCompiler::CompileStages(createInfos, isVendorNV);
+      size_t first = 0;
+      for (const auto& [name, programInfos] : programs)
+      {
+        addCompiledShader(name, programInfos, std::span(stages).subspan(first, programInfos.size()), isVendorNV);
+        first += programInfos.size();
+      }
+    }
+
     std::optional<Shader> GetShader(hashed_string name)
     {
       if (auto it = shaders_.find(name); it != shaders_.end())
@@ -409,7 +291,9 @@ namespace GFX
         return std::nullopt;
       }
 
-      auto data = CompileProgram(name, it->second.createInfos);
+      const bool isVendorNV = IsVendorNV();
+      auto stages = ShaderCompiler::CompileStages(it->second.createInfos, isVendorNV);
+      auto data = LinkProgram(name, it->second.createInfos, stages, isVendorNV);
       if (data.id == 0) // compile failed
       {
         return std::nullopt;
@@ -2,30 +2,18 @@
 #include <utility/HashedString.h>
 #include <optional>
 #include "../api/Shader.h"
+#include "ShaderCompiler.h"
 
 namespace GFX
 {
-  enum class ShaderType
-  {
-    UNDEFINED,
-    VERTEX,
-    TESS_CONTROL,
-    TESS_EVAL,
-    GEOMETRY,
-    FRAGMENT,
-    COMPUTE,
-  };
-
-  struct ShaderCreateInfo
-  {
-    std::string path{};
-    ShaderType type{};
-    std::vector<std::pair<std::string, std::string>> replace{};
-  };
-
   namespace ShaderManager
   {
+    // returns nothing while a batch is open, as the program is only created once the batch ends
     std::optional<Shader> AddShader(hashed_string name, const std::vector<ShaderCreateInfo>& createInfos);
+
+    // programs added between these are compiled together across the job system when the batch ends
+    void BeginBatch();
+    void EndBatch();
     
     [[nodiscard]] std::optional<Shader> GetShader(hashed_string name);
 
@@ -0,0 +1,450 @@
+#include "gPCH.h"
+#include "Benchmark.h"
+#include "WorldGen.h"
+#include <engine/Application.h>
+#include <engine/Engine.h>
+#include <engine/Scene.h>
+#include <engine/ecs/Entity.h>
+#include <engine/ecs/component/Transform.h>
+#include <engine/ecs/component/Physics.h>
+#include <engine/core/JobSystem.h>
+#include <voxel/VoxelManager.h>
+#include <voxel/VoxelQuery.h>
+#include <voxel/prefab.h>
+#include <utility/Timer.h>
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+/*
+  usage: --benchmark [options]
+    --dim X Y Z       world size in chunks (default 8 4 8)
+    --edits N         random block edits (default 10000)
+    --rays N          random raycasts (default 100000)
+    --bodies N        physics bodies dropped onto the world (default 200)
+    --frames N        engine frames to simulate (default 600)
+    --seed N          seed for everything random (default 1)
+    --scenario NAME   only run this scenario after the world is built. can be repeated
+                      (edits, raycast, frames)
+    --out PATH        write results to this file instead of stdout
+
+  the world is always generated, lit and meshed first, and those steps are reported too.
+  latencies are in microseconds
+*/
+
+namespace
+{
+  struct BenchmarkOptions
+  {
+    glm::ivec3 dim{ 8, 4, 8 };
+    uint32_t edits = 10'000;
+    uint32_t rays = 100'000;
+    uint32_t bodies = 200;
+    uint32_t frames = 600;
+    uint32_t seed = 1;
+    std::vector<std::string> scenarios;
+    std::string outPath;
+
+    bool Wants(std::string_view name) const
+    {
+      return scenarios.empty() || std::find(scenarios.begin(), scenarios.end(), name) != scenarios.end();
+    }
+  };
+
+  // single ray latency is sampled from at most this many rays. the rest are only batched
+  constexpr uint32_t MAX_TIMED_RAYS = 10'000;
+  constexpr float RAY_DISTANCE = 64;
+  constexpr double FRAME_DT = 1.0 / 60.0;
+
+  BenchmarkOptions options;
+  std::unique_ptr<Voxels::VoxelManager> voxelManager;
+  std::mt19937 rng;
+  std::FILE* output = stdout;
+
+  // one line per scenario
+  class Report
+  {
+  public:
+    explicit Report(std::string_view scenario)
+      : line_(fmt::format("{{\"scenario\":\"{}\"", scenario))
+    {
+    }
+
+    ~Report()
+    {
+      std::fprintf(output, "%s}\n", line_.c_str());
+      std::fflush(output);
+    }
+
+    Report& Add(std::string_view key, double value)
+    {
+      line_ += fmt::format(",\"{}\":{:.3f}", key, value);
+      return *this;
+    }
+
+    Report& Add(std::string_view key, uint64_t value)
+    {
+      line_ += fmt::format(",\"{}\":{}", key, value);
+      return *this;
+    }
+
+    Report& AddLatency(std::vector<double>& samples)
+    {
+      if (samples.empty())
+      {
+        return *this;
+      }
+
+      // nearest rank
+      std::sort(samples.begin(), samples.end());
+      auto percentile = [&samples](double p)
+      {
+        size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+      };
+
+      double sum = 0;
+      for (double sample : samples)
+      {
+        sum += sample;
+      }
+
+      return Add("mean_us", sum / samples.size())
+        .Add("p50_us", percentile(.50))
+        .Add("p90_us", percentile(.90))
+        .Add("p99_us", percentile(.99))
+        .Add("max_us", samples.back());
+    }
+
+  private:
+    std::string line_;
+  };
+
+  double perSecond(uint64_t count, double ms)
+  {
+    return ms > 0 ? count / (ms / 1000.0) : 0;
+  }
+
+  // the blocks WorldGen fills, in world space
+  glm::ivec3 worldMin()
+  {
+    return glm::ivec3(Voxels::Chunk::CHUNK_SIZE);
+  }
+
+  glm::ivec3 worldMax()
+  {
+    return (options.dim + 1) * Voxels::Chunk::CHUNK_SIZE - 1;
+  }
+
+  glm::ivec3 randomBlock()
+  {
+    glm::ivec3 lo = worldMin(), hi = worldMax();
+    return {
+      std::uniform_int_distribution<int>(lo.x, hi.x)(rng),
+      std::uniform_int_distribution<int>(lo.y, hi.y)(rng),
+      std::uniform_int_distribution<int>(lo.z, hi.z)(rng) };
+  }
+
+  glm::vec3 randomDirection()
+  {
+    std::normal_distribution<float> normal;
+    glm::vec3 dir;
+    do
+    {
+      dir = { normal(rng), normal(rng), normal(rng) };
+    } while (glm::length2(dir) < 1e-6f);
+    return glm::normalize(dir);
+  }
+
+  void buildWorld(Scene* scene)
+  {
+    Voxels::PrefabManager::InitPrefabs();
+    voxelManager = std::make_unique<Voxels::VoxelManager>(scene);
+    WorldGen wg(*voxelManager);
+    const uint64_t chunkCount = static_cast<uint64_t>(options.dim.x) * options.dim.y * options.dim.z;
+
+    Timer timer;
+    wg.Init(options.dim);
+    wg.GenerateWorld();
+    double ms = timer.Elapsed_ms();
+    Report("generate")
+      .Add("chunks", chunkCount)
+      .Add("total_ms", ms)
+      .Add("chunks_per_s", perSecond(chunkCount, ms));
+
+    timer.Reset();
+    wg.InitializeSunlight();
+    ms = timer.Elapsed_ms();
+    Report("sunlight")
+      .Add("chunks", chunkCount)
+      .Add("total_ms", ms)
+      .Add("chunks_per_s", perSecond(chunkCount, ms));
+
+    std::vector<Voxels::Chunk*> chunks;
+    for (int z = 1; z <= options.dim.z; z++)
+    {
+      for (int y = 1; y <= options.dim.y; y++)
+      {
+        for (int x = 1; x <= options.dim.x; x++)
+        {
+          if (auto* chunk = voxelManager->GetChunk({ x, y, z }))
+          {
+            chunks.push_back(chunk);
+          }
+        }
+      }
+    }
+
+    // like WorldGen::InitMeshes, but each chunk is timed
+    std::vector<double> latencies(chunks.size());
+    timer.Reset();
+    engine::Core::JobSystem::Get()->ForEach(chunks.begin(), chunks.end(), [&](Voxels::Chunk* const& chunk)
+      {
+        Timer chunkTimer;
+        chunk->BuildMesh();
+        latencies[&chunk - chunks.data()] = chunkTimer.Elapsed() * 1e6;
+      });
+    wg.InitBuffers();
+    ms = timer.Elapsed_ms();
+    Report("mesh")
+      .Add("chunks", static_cast<uint64_t>(chunks.size()))
+      .Add("total_ms", ms)
+      .Add("chunks_per_s", perSecond(chunks.size(), ms))
+      .AddLatency(latencies);
+  }
+
+  // alternately places and removes blocks, which relights and remeshes the chunks around them
+  void runEdits()
+  {
+    std::vector<double> latencies;
+    latencies.reserve(options.edits);
+
+    Timer total;
+    for (uint32_t i = 0; i < options.edits; i++)
+    {
+      const glm::ivec3 wpos = randomBlock();
+      const Voxels::BlockType type = i % 2 ? Voxels::BlockType::bAir : Voxels::BlockType::bStone;
+
+      Timer timer;
+      voxelManager->UpdateBlock(wpos, Voxels::Block(type));
+      latencies.push_back(timer.Elapsed() * 1e6);
+    }
+    const double editMs = total.Elapsed_ms();
+    voxelManager->FinishMeshing();
+    const double ms = total.Elapsed_ms();
+
+    Report("edits")
+      .Add("edits", static_cast<uint64_t>(options.edits))
+      .Add("edit_ms", editMs)
+      .Add("total_ms", ms)
+      .Add("edits_per_s", perSecond(options.edits, ms))
+      .AddLatency(latencies);
+  }
+
+  void runRaycasts()
+  {
+    const glm::vec3 lo = worldMin(), hi = worldMax();
+    std::vector<Voxels::Query::Ray> rays(options.rays);
+    for (auto& ray : rays)
+    {
+      ray.origin = {
+        std::uniform_real_distribution<float>(lo.x, hi.x)(rng),
+        std::uniform_real_distribution<float>(lo.y, hi.y)(rng),
+        std::uniform_real_distribution<float>(lo.z, hi.z)(rng) };
+      ray.direction = randomDirection();
+      ray.distance = RAY_DISTANCE;
+    }
+
+    const uint32_t timedCount = std::min(options.rays, MAX_TIMED_RAYS);
+    std::vector<double> latencies;
+    latencies.reserve(timedCount);
+    uint64_t hitCount = 0;
+    Timer total;
+    for (uint32_t i = 0; i < timedCount; i++)
+    {
+      Timer timer;
+      auto hit = Voxels::Collision::Raycast(*voxelManager, rays[i].origin, rays[i].direction, rays[i].distance);
+      latencies.push_back(timer.Elapsed() * 1e6);
+      hitCount += hit.has_value();
+    }
+    double ms = total.Elapsed_ms();
+    Report("raycast")
+      .Add("rays", static_cast<uint64_t>(timedCount))
+      .Add("hits", hitCount)
+      .Add("total_ms", ms)
+      .Add("rays_per_s", perSecond(timedCount, ms))
+      .AddLatency(latencies);
+
+    std::vector<std::optional<Voxels::Collision::Hit>> hits(rays.size());
+    total.Reset();
+    Voxels::Query::RaycastBatch(*voxelManager, rays, hits);
+    ms = total.Elapsed_ms();
+    Report("raycast_batch")
+      .Add("rays", static_cast<uint64_t>(rays.size()))
+      .Add("hits", static_cast<uint64_t>(std::count_if(hits.begin(), hits.end(), [](const auto& hit) { return hit.has_value(); })))
+      .Add("total_ms", ms)
+      .Add("rays_per_s", perSecond(rays.size(), ms));
+  }
+
+  // drops boxes onto the world and runs the engine's systems at a fixed timestep
+  void runFrames(Scene* scene)
+  {
+    const glm::vec3 lo = worldMin(), hi = worldMax();
+    for (uint32_t i = 0; i < options.bodies; i++)
+    {
+      Entity entity = scene->CreateEntity("Benchmark Body");
+      entity.AddComponent<Component::Transform>().SetTranslation({
+        std::uniform_real_distribution<float>(lo.x, hi.x)(rng),
+        hi.y + std::uniform_real_distribution<float>(1, 32)(rng),
+        std::uniform_real_distribution<float>(lo.z, hi.z)(rng) });
+      entity.AddComponent<Component::Model>();
+      entity.AddComponent<Component::InterpolatedPhysics>();
+      Component::DynamicPhysics physics(entity, Physics::MaterialType::TERRAIN, Physics::BoxCollider(glm::vec3(.5f)));
+      entity.AddComponent<Component::DynamicPhysics>(std::move(physics));
+    }
+
+    Engine* engine = scene->GetEngine();
+    const Timestep timestep{ .dt_actual = FRAME_DT, .dt_effective = FRAME_DT };
+    std::vector<double> latencies;
+    latencies.reserve(options.frames);
+
+    Timer total;
+    for (uint32_t i = 0; i < options.frames; i++)
+    {
+      Timer timer;
+      voxelManager->Update();
+      engine->RunFrame(timestep);
+      latencies.push_back(timer.Elapsed() * 1e6);
+    }
+    const double ms = total.Elapsed_ms();
+
+    Report("frames")
+      .Add("frames", static_cast<uint64_t>(options.frames))
+      .Add("bodies", static_cast<uint64_t>(options.bodies))
+      .Add("total_ms", ms)
+      .Add("frames_per_s", perSecond(options.frames, ms))
+      .AddLatency(latencies);
+  }
+
+  void onStart(Scene* scene)
+  {
+    rng.seed(options.seed);
+    Report("config")
+      .Add("workers", static_cast<uint64_t>(engine::Core::JobSystem::Get()->GetWorkerCount()))
+      .Add("dim_x", static_cast<uint64_t>(options.dim.x))
+      .Add("dim_y", static_cast<uint64_t>(options.dim.y))
+      .Add("dim_z", static_cast<uint64_t>(options.dim.z))
+      .Add("seed", static_cast<uint64_t>(options.seed));
+
+    buildWorld(scene);
+    if (options.Wants("edits"))
+    {
+      runEdits();
+    }
+    if (options.Wants("raycast"))
+    {
+      runRaycasts();
+    }
+    if (options.Wants("frames"))
+    {
+      runFrames(scene);
+    }
+
+    // the engine returns from Run as soon as it starts
+    Application::Quit();
+  }
+
+  bool parseOptions(int argc, char** argv)
+  {
+    auto number = [&](int& i) -> std::optional<uint32_t>
+    {
+      if (++i >= argc)
+      {
+        return std::nullopt;
+      }
+      char* end{};
+      unsigned long value = std::strtoul(argv[i], &end, 10);
+      return *end == 0 ? std::optional<uint32_t>(static_cast<uint32_t>(value)) : std::nullopt;
+    };
+
+    for (int i = 0; i < argc; i++)
+    {
+      std::string_view arg = argv[i];
+      std::optional<uint32_t> value;
+      if (arg == "--dim")
+      {
+        for (int axis = 0; axis < 3; axis++)
+        {
+          if (!(value = number(i)) || *value == 0)
+          {
+            return false;
+          }
+          options.dim[axis] = static_cast<int>(*value);
+        }
+        continue;
+      }
+      if (arg == "--scenario")
+      {
+        if (++i >= argc)
+        {
+          return false;
+        }
+        options.scenarios.emplace_back(argv[i]);
+        continue;
+      }
+      if (arg == "--out")
+      {
+        if (++i >= argc)
+        {
+          return false;
+        }
+        options.outPath = argv[i];
+        continue;
+      }
+
+      uint32_t* target = arg == "--edits" ? &options.edits :
+        arg == "--rays" ? &options.rays :
+        arg == "--bodies" ? &options.bodies :
+        arg == "--frames" ? &options.frames :
+        arg == "--seed" ? &options.seed : nullptr;
+      if (!target || !(value = number(i)))
+      {
+        return false;
+      }
+      *target = *value;
+    }
+    return true;
+  }
+}
+
+int RunVoxelBenchmark(int argc, char** argv)
+{
+  if (!parseOptions(argc, argv))
+  {
+    std::fprintf(stderr, "usage: --benchmark [--dim X Y Z] [--edits N] [--rays N] [--bodies N] [--frames N] [--seed N] [--scenario NAME]... [--out PATH]\n");
+    return 1;
+  }
+
+  if (!options.outPath.empty() && !(output = std::fopen(options.outPath.c_str(), "w")))
+  {
+    std::fprintf(stderr, "could not open %s\n", options.outPath.c_str());
+    return 1;
+  }
+
+  // keep stdout to results
+  spdlog::set_level(spdlog::level::warn);
+
+  Application::SetHeadless(true);
+  Application::SetStartCallback(onStart);
+  Application::Start();
+  voxelManager.reset();
+  Application::Shutdown();
+
+  if (output != stdout)
+  {
+    std::fclose(output);
+  }
+  return 0;
+}
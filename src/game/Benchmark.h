@@ -0,0 +1,8 @@
+#pragma once
+
+// Runs scripted voxel scenarios on a headless engine and prints one JSON object per scenario to stdout,
+// or to the file passed with --out. Everything is seeded, so runs with the same arguments do the same work.
+// Headless only skips the window and GL, so this still builds as part of the Windows executable. There is no
+// Linux target, as the engine links PhysX, GLFW and GL.
+// returns the process's exit code
+int RunVoxelBenchmark(int argc, char** argv);
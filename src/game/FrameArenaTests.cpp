@@ -0,0 +1,99 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/gfx/api/FrameArena.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+  // plain memory and a log of fence calls instead of a GL buffer and sync objects
+  class FakeFrameArenaBackend final : public GFX::FrameArenaBackend
+  {
+  public:
+    struct Log
+    {
+      std::vector<uint32_t> inserted;
+      std::vector<uint32_t> waited;
+    };
+
+    FakeFrameArenaBackend(Log& log) : log_(log) {}
+
+    std::byte* CreateStorage(size_t size) override
+    {
+      storage_.resize(size);
+      return storage_.data();
+    }
+
+    void InsertFence(uint32_t region) override { log_.inserted.push_back(region); }
+    void WaitFence(uint32_t region) override { log_.waited.push_back(region); }
+    void Bind(GFX::Target) override {}
+    void BindRange(GFX::Target, uint32_t, size_t, size_t) override {}
+
+  private:
+    Log& log_;
+    std::vector<std::byte> storage_;
+  };
+
+  GFX::FrameArena MakeArena(FakeFrameArenaBackend::Log& log, size_t regionSize, uint32_t framesInFlight)
+  {
+    auto arena = GFX::FrameArena::Create(std::make_unique<FakeFrameArenaBackend>(log), regionSize, framesInFlight);
+    ASSERT(arena);
+    return std::move(*arena);
+  }
+}
+
+SELF_TEST(FrameArenaAlignsAndExhausts)
+{
+  FakeFrameArenaBackend::Log log;
+  auto arena = MakeArena(log, 1000, 2);
+  CHECK(arena.RegionSize() == 1024);
+
+  const std::vector<uint8_t> bytes = { 1, 2, 3 };
+  const auto first = arena.Allocate(std::span(bytes), 1);
+  CHECK(first && first->offset == 0 && first->size == 3);
+  CHECK(first && std::to_integer<uint8_t>(first->data[2]) == 3);
+
+  // padded up to the next multiple of the alignment
+  const std::vector<uint32_t> words(4);
+  const auto second = arena.Allocate(std::span(words), 64);
+  CHECK(second && second->offset == 64 && second->size == 16);
+  CHECK(arena.BytesUsed() == 80);
+
+  // fits exactly, then nothing more does
+  std::vector<std::byte> rest(arena.RegionSize() - 128);
+  CHECK(arena.Allocate(std::span(rest), 128).has_value());
+  CHECK(arena.BytesUsed() == arena.RegionSize());
+  CHECK(!arena.Allocate(std::span(bytes), 1).has_value());
+
+  // a failed allocation leaves the region untouched
+  CHECK(arena.BytesUsed() == arena.RegionSize());
+}
+
+SELF_TEST(FrameArenaRotatesRegions)
+{
+  FakeFrameArenaBackend::Log log;
+  auto arena = MakeArena(log, 256, 3);
+
+  // the first frame has nothing to fence
+  arena.NextFrame();
+  CHECK(arena.CurrentRegion() == 0);
+  CHECK(log.inserted.empty() && log.waited.empty());
+
+  for (uint32_t frame = 1; frame <= 7; frame++)
+  {
+    const uint32_t previous = arena.CurrentRegion();
+    CHECK(arena.Allocate(std::span(&frame, 1), 4).has_value());
+    arena.NextFrame();
+
+    // the region just written is fenced, then the region about to be reused is waited on
+    CHECK(log.inserted.size() == frame && log.inserted.back() == previous);
+    CHECK(log.waited.size() == frame && log.waited.back() == frame % 3);
+    CHECK(arena.CurrentRegion() == frame % 3);
+    CHECK(arena.BytesUsed() == 0);
+
+    // allocations land in the new region
+    const auto alloc = arena.Allocate(std::span(&frame, 1), 4);
+    CHECK(alloc && alloc->offset == arena.CurrentRegion() * arena.RegionSize());
+  }
+}
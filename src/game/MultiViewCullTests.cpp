@@ -0,0 +1,121 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/gfx/MultiViewCull.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <map>
+#include <random>
+#include <tuple>
+
+namespace
+{
+  GFX::CullView MakeView(const glm::vec3& position, const glm::vec3& forward, float minDistance = 0, float maxDistance = 1000)
+  {
+    const glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    const glm::vec3 up = std::abs(forward.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    const glm::mat4 view = glm::lookAt(position, position + forward, up);
+    return { GFX::Frustum(proj, view), position, minDistance, maxDistance };
+  }
+
+  AABB MakeBox(const glm::vec3& center, float halfExtent)
+  {
+    return { center - glm::vec3(halfExtent), center + glm::vec3(halfExtent) };
+  }
+
+  // chunk-sized boxes grouped into 4x4x4 chunk sectors, like ChunkRenderer does
+  void BuildSectors(std::span<const AABB> boxes, std::vector<GFX::CullSector>& sectors, std::vector<uint32_t>& sectorChunks)
+  {
+    std::map<std::tuple<int, int, int>, std::vector<uint32_t>> bySector;
+    for (uint32_t i = 0; i < boxes.size(); i++)
+    {
+      const glm::ivec3 sector(glm::floor((boxes[i].min + boxes[i].max) / 2.0f / 128.0f));
+      bySector[{ sector.x, sector.y, sector.z }].push_back(i);
+    }
+
+    for (const auto& [key, indices] : bySector)
+    {
+      GFX::CullSector sector{ boxes[indices[0]], static_cast<uint32_t>(sectorChunks.size()), static_cast<uint32_t>(indices.size()) };
+      for (auto index : indices)
+      {
+        sector.box.min = glm::min(sector.box.min, boxes[index].min);
+        sector.box.max = glm::max(sector.box.max, boxes[index].max);
+        sectorChunks.push_back(index);
+      }
+      sectors.push_back(sector);
+    }
+  }
+}
+
+SELF_TEST(CullMultiViewKnownAnswers)
+{
+  const GFX::CullView views[] =
+  {
+    MakeView({ 0, 0, 0 }, { 0, 0, -1 }),
+    MakeView({ 0, 0, 0 }, { 0, 0, 1 }),
+    MakeView({ 0, 0, 0 }, { 0, 0, -1 }, 20, 100),
+  };
+
+  const AABB boxes[] =
+  {
+    MakeBox({ 0, 0, -50 }, 1),  // in front of views 0 and 2
+    MakeBox({ 0, 0, 50 }, 1),   // in front of view 1
+    MakeBox({ 0, 0, -10 }, 1),  // closer than view 2's min distance
+    MakeBox({ 0, 0, -500 }, 1), // farther than view 2's max distance
+    MakeBox({ 500, 0, -1 }, 1), // off to the side of every view
+    MakeBox({ 0, 0, 0 }, 5),    // around the cameras, crossing the ignored near plane
+  };
+
+  GFX::ViewVisibilityMask masks[std::size(boxes)];
+  GFX::CullMultiView(boxes, views, masks);
+  CHECK(masks[0] == 0b101);
+  CHECK(masks[1] == 0b010);
+  CHECK(masks[2] == 0b001);
+  CHECK(masks[3] == 0b001);
+  CHECK(masks[4] == 0);
+  CHECK(masks[5] == 0b011);
+
+  // boxes that belong to no sector are never visible
+  const GFX::CullSector sector{ boxes[0], 0, 1 };
+  const uint32_t sectorChunks[] = { 0 };
+  GFX::CullMultiViewHierarchical(std::span(&sector, 1), sectorChunks, boxes, views, masks);
+  CHECK(masks[0] == 0b101);
+  CHECK(std::all_of(std::begin(masks) + 1, std::end(masks), [](auto mask) { return mask == 0; }));
+}
+
+SELF_TEST(CullMultiViewHierarchicalMatchesFlat)
+{
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> position(-600, 600);
+  std::uniform_real_distribution<float> direction(-1, 1);
+  std::uniform_real_distribution<float> distance(0, 400);
+  std::uniform_int_distribution<int> chunk(-16, 15);
+
+  for (int trial = 0; trial < 20; trial++)
+  {
+    std::vector<AABB> boxes;
+    for (int i = 0; i < 2000; i++)
+    {
+      const glm::vec3 min = glm::vec3(chunk(rng), chunk(rng), chunk(rng)) * 32.0f;
+      boxes.push_back({ min, min + glm::vec3(32) });
+    }
+
+    std::vector<GFX::CullView> views;
+    for (uint32_t v = 0; v < GFX::MAX_CULL_VIEWS; v++)
+    {
+      const glm::vec3 forward = glm::normalize(glm::vec3(direction(rng), direction(rng), direction(rng)) + glm::vec3(0, 0, 0.01f));
+      const float minDistance = v % 4 == 0 ? distance(rng) : 0;
+      views.push_back(MakeView({ position(rng), position(rng), position(rng) }, forward, minDistance, minDistance + distance(rng) * 2));
+    }
+
+    std::vector<GFX::CullSector> sectors;
+    std::vector<uint32_t> sectorChunks;
+    BuildSectors(boxes, sectors, sectorChunks);
+
+    std::vector<GFX::ViewVisibilityMask> flat(boxes.size());
+    std::vector<GFX::ViewVisibilityMask> hierarchical(boxes.size());
+    GFX::CullMultiView(boxes, views, flat);
+    GFX::CullMultiViewHierarchical(sectors, sectorChunks, boxes, views, hierarchical);
+    CHECK(flat == hierarchical);
+    CHECK(std::any_of(flat.begin(), flat.end(), [](auto mask) { return mask != 0; }));
+  }
+}
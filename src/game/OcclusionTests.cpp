@@ -0,0 +1,192 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/gfx/SoftwareOcclusion.h>
+#include <voxel/ChunkMesh.h>
+
+#include <random>
+
+namespace
+{
+  constexpr uint32_t WIDTH = 256;
+  constexpr uint32_t HEIGHT = 128;
+
+  // looks down +z with w = z, so a point at depth z lands on pixel ((x / z) * 0.5 + 0.5) * WIDTH
+  glm::mat4 MakeViewProj()
+  {
+    glm::mat4 viewProj(0);
+    viewProj[0][0] = 1;
+    viewProj[1][1] = 1;
+    viewProj[2][3] = 1;
+    return viewProj;
+  }
+
+  // x of the left edge of a pixel column at depth z
+  float ColumnX(float column, float z)
+  {
+    return (column / WIDTH * 2 - 1) * z;
+  }
+
+  GFX::OccluderQuad MakeQuad(float x0, float x1, float y0, float y1, float z)
+  {
+    return { { { x0, y0, z }, { x1, y0, z }, { x1, y1, z }, { x0, y1, z } } };
+  }
+
+  uint32_t RandomRowBits(std::mt19937& rng, float density)
+  {
+    std::bernoulli_distribution bit(density);
+    uint32_t row = 0;
+    for (int u = 0; u < 32; u++)
+    {
+      row |= bit(rng) ? 1u << u : 0;
+    }
+    return row;
+  }
+
+  // the largest all-ones rectangle, by trying every one
+  int BruteForceLargestArea(const uint32_t (&rows)[32])
+  {
+    int best = 0;
+    for (int v0 = 0; v0 < 32; v0++)
+    {
+      for (int u0 = 0; u0 < 32; u0++)
+      {
+        uint32_t columns = ~0u;
+        for (int v1 = v0; v1 < 32; v1++)
+        {
+          columns &= rows[v1];
+          for (int u1 = u0; u1 < 32 && (columns >> u1) & 1; u1++)
+          {
+            best = std::max(best, (u1 - u0 + 1) * (v1 - v0 + 1));
+          }
+        }
+      }
+    }
+    return best;
+  }
+}
+
+SELF_TEST(LargestRectangleMatchesBruteForce)
+{
+  std::mt19937 rng(1);
+  for (int trial = 0; trial < 200; trial++)
+  {
+    uint32_t rows[32];
+    const float density = 0.5f + 0.5f * (trial % 5) / 4.0f;
+    for (auto& row : rows)
+    {
+      row = RandomRowBits(rng, density);
+    }
+
+    const Voxels::detail::OccluderRect rect = Voxels::detail::LargestRectangle(rows);
+    CHECK(rect.Area() == BruteForceLargestArea(rows));
+
+    // and it really is all ones
+    for (int v = rect.v0; v < rect.v1; v++)
+    {
+      for (int u = rect.u0; u < rect.u1; u++)
+      {
+        CHECK((rows[v] >> u) & 1);
+      }
+    }
+  }
+
+  uint32_t full[32];
+  std::fill(std::begin(full), std::end(full), ~0u);
+  CHECK(Voxels::detail::LargestRectangle(full).Area() == 32 * 32);
+}
+
+SELF_TEST(OcclusionSimdMatchesScalar)
+{
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> coord(-60, 60);
+  std::uniform_real_distribution<float> depth(-5, 80);
+
+  std::vector<GFX::OccluderQuad> quads;
+  for (int i = 0; i < 300; i++)
+  {
+    GFX::OccluderQuad quad;
+    const glm::vec3 origin{ coord(rng), coord(rng), depth(rng) };
+    const glm::vec3 u{ coord(rng) * 0.2f, coord(rng) * 0.1f, coord(rng) * 0.1f };
+    const glm::vec3 v{ coord(rng) * 0.1f, coord(rng) * 0.2f, coord(rng) * 0.1f };
+    quad.corners[0] = origin;
+    quad.corners[1] = origin + u;
+    quad.corners[2] = origin + u + v;
+    quad.corners[3] = origin + v;
+    quads.push_back(quad);
+  }
+
+  GFX::OcclusionBuffer simd(WIDTH, HEIGHT);
+  GFX::OcclusionBuffer scalar(WIDTH, HEIGHT);
+  scalar.SetUseSimd(false);
+  for (auto* buffer : { &simd, &scalar })
+  {
+    buffer->Begin(MakeViewProj());
+    buffer->RasterizeOccluders(quads);
+  }
+
+  CHECK(std::equal(simd.GetDepth().begin(), simd.GetDepth().end(), scalar.GetDepth().begin()));
+  CHECK(std::any_of(scalar.GetDepth().begin(), scalar.GetDepth().end(), [](float d) { return d > 0; }));
+
+  for (int i = 0; i < 2000; i++)
+  {
+    const glm::vec3 min{ coord(rng), coord(rng), depth(rng) };
+    const AABB box(min, min + glm::vec3(std::abs(coord(rng)) * 0.1f));
+    CHECK(simd.IsVisible(box) == scalar.IsVisible(box));
+  }
+}
+
+SELF_TEST(OcclusionOnlyWritesCoveredPixels)
+{
+  // covers columns [10, 20) exactly at z = 1
+  GFX::OcclusionBuffer buffer(WIDTH, HEIGHT);
+  buffer.Begin(MakeViewProj());
+  const GFX::OccluderQuad quad = MakeQuad(ColumnX(10, 1), ColumnX(20, 1), -0.5f, 0.5f, 1);
+  buffer.RasterizeOccluders(std::span(&quad, 1));
+
+  const auto depth = buffer.GetDepth();
+  const uint32_t row = HEIGHT / 2;
+  CHECK(depth[row * WIDTH + 9] == 0);
+  CHECK(depth[row * WIDTH + 20] == 0);
+  for (int x = 11; x < 19; x++)
+  {
+    CHECK(depth[row * WIDTH + x] > 0);
+    CHECK(depth[row * WIDTH + x] <= 1.0f);
+  }
+
+  // a quad narrower than a pixel covers none
+  buffer.Begin(MakeViewProj());
+  const GFX::OccluderQuad thin = MakeQuad(ColumnX(30.2f, 1), ColumnX(30.8f, 1), -0.5f, 0.5f, 1);
+  buffer.RasterizeOccluders(std::span(&thin, 1));
+  CHECK(std::all_of(buffer.GetDepth().begin(), buffer.GetDepth().end(), [](float d) { return d == 0; }));
+}
+
+SELF_TEST(OcclusionKeepsGapsOpen)
+{
+  // two walls at z = 10 with a gap of a third of a pixel between them. the gap misses every pixel center,
+  // so sampling coverage at centers would fill it
+  const float z = 10;
+  const GFX::OccluderQuad walls[] =
+  {
+    MakeQuad(ColumnX(0, z), ColumnX(100.6f, z), -5, 5, z),
+    MakeQuad(ColumnX(100.9f, z), ColumnX(WIDTH, z), -5, 5, z),
+  };
+
+  GFX::OcclusionBuffer buffer(WIDTH, HEIGHT);
+  buffer.Begin(MakeViewProj());
+  buffer.RasterizeOccluders(walls);
+
+  // a box far behind the gap can be seen through it
+  const float farZ = 100;
+  const float gapX = ColumnX(100.75f, farZ);
+  CHECK(buffer.IsVisible(AABB({ gapX - 0.05f, -1, farZ }, { gapX + 0.05f, 1, farZ + 1 })));
+
+  // a box behind the left wall can't
+  const float wallX = ColumnX(50, farZ);
+  CHECK(!buffer.IsVisible(AABB({ wallX - 1, -1, farZ }, { wallX + 1, 1, farZ + 1 })));
+
+  // a box in front of the wall can
+  CHECK(buffer.IsVisible(AABB({ ColumnX(49, 5), -0.1f, 5 }, { ColumnX(51, 5), 0.1f, 6 })));
+
+  // a box crossing the near plane always can
+  CHECK(buffer.IsVisible(AABB({ -1, -1, -1 }, { 1, 1, 20 })));
+}
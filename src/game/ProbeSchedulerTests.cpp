@@ -0,0 +1,126 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/gfx/ProbeScheduler.h>
+
+#include <bit>
+#include <vector>
+
+namespace
+{
+  constexpr GFX::ProbeScheduler::FaceMask ALL_FACES = (1u << GFX::ProbeScheduler::FACE_COUNT) - 1;
+
+  GFX::ProbeScheduler MakeScheduler(const GFX::ProbeScheduler::Settings& settings)
+  {
+    GFX::ProbeScheduler scheduler;
+    scheduler.SetSettings(settings);
+    scheduler.SetEnabled(true);
+    return scheduler;
+  }
+
+  AABB MakeBox(const glm::vec3& center, float halfExtent)
+  {
+    return { center - glm::vec3(halfExtent), center + glm::vec3(halfExtent) };
+  }
+}
+
+SELF_TEST(ProbeSchedulerRespectsBudget)
+{
+  auto scheduler = MakeScheduler({ .facesPerFrame = 2 });
+
+  // enabling dirties every face, which then drain two per frame
+  GFX::ProbeScheduler::FaceMask rendered = 0;
+  for (int frame = 0; frame < 3; frame++)
+  {
+    const auto mask = scheduler.Schedule();
+    CHECK(std::popcount(mask) == 2);
+    CHECK((rendered & mask) == 0);
+    rendered |= mask;
+  }
+  CHECK(rendered == ALL_FACES);
+  CHECK(scheduler.Schedule() == 0);
+
+  // a larger budget than there are faces is clamped
+  auto unbounded = MakeScheduler({ .facesPerFrame = 100 });
+  CHECK(unbounded.Schedule() == ALL_FACES);
+
+  // disabled schedulers render nothing
+  unbounded.SetEnabled(false);
+  unbounded.NotifySceneChange(MakeBox({ 10, 0, 0 }, 1));
+  CHECK(unbounded.Schedule() == 0);
+}
+
+SELF_TEST(ProbeSchedulerForcesStaleFaces)
+{
+  auto scheduler = MakeScheduler({ .facesPerFrame = 6, .maxStaleFrames = 3 });
+  CHECK(scheduler.Schedule() == ALL_FACES);
+
+  // nothing changes, so faces only come back once they are maxStaleFrames old
+  CHECK(scheduler.Schedule() == 0);
+  CHECK(scheduler.Schedule() == 0);
+  CHECK(scheduler.Schedule() == ALL_FACES);
+  CHECK(scheduler.Schedule() == 0);
+
+  // without a limit, unchanged faces are never refreshed
+  auto unlimited = MakeScheduler({ .facesPerFrame = 6 });
+  CHECK(unlimited.Schedule() == ALL_FACES);
+  for (int frame = 0; frame < 10; frame++)
+  {
+    CHECK(unlimited.Schedule() == 0);
+  }
+}
+
+SELF_TEST(ProbeSchedulerSceneChangeRadius)
+{
+  auto scheduler = MakeScheduler({ .facesPerFrame = 6, .sceneChangeRadius = 100 });
+  scheduler.SetPosition({ 5, 5, 5 });
+  CHECK(scheduler.Schedule() == ALL_FACES);
+
+  // outside the radius is ignored
+  scheduler.NotifySceneChange(MakeBox({ 505, 5, 5 }, 1));
+  for (uint32_t face = 0; face < GFX::ProbeScheduler::FACE_COUNT; face++)
+  {
+    CHECK(scheduler.GetPriority(face) == 0);
+  }
+  CHECK(scheduler.Schedule() == 0);
+
+  // inside the radius, only the face looking at it (+x) is dirtied
+  scheduler.NotifySceneChange(MakeBox({ 55, 5, 5 }, 1));
+  CHECK(scheduler.GetPriority(0) > 0);
+  for (uint32_t face = 1; face < GFX::ProbeScheduler::FACE_COUNT; face++)
+  {
+    CHECK(scheduler.GetPriority(face) == 0);
+  }
+  CHECK(scheduler.Schedule() == 0b000001);
+
+  // a box around the probe is seen by every face
+  scheduler.NotifySceneChange(MakeBox({ 5, 5, 5 }, 2));
+  CHECK(scheduler.Schedule() == ALL_FACES);
+}
+
+SELF_TEST(ProbeSchedulerIsDeterministic)
+{
+  // equal priorities go to the stalest face, then the lowest index
+  auto scheduler = MakeScheduler({ .facesPerFrame = 1 });
+  for (uint32_t face = 0; face < GFX::ProbeScheduler::FACE_COUNT; face++)
+  {
+    CHECK(scheduler.Schedule() == 1u << face);
+  }
+
+  // the same inputs always give the same schedule
+  auto run = []
+  {
+    auto scheduler = MakeScheduler({ .facesPerFrame = 2, .moveThreshold = 1, .maxStaleFrames = 5 });
+    std::vector<GFX::ProbeScheduler::FaceMask> masks;
+    for (int frame = 0; frame < 40; frame++)
+    {
+      scheduler.SetPosition({ frame * 0.3f, 0, frame % 7 == 0 ? 2.0f : 0.0f });
+      if (frame % 3 == 0)
+      {
+        scheduler.NotifySceneChange(MakeBox({ 0, frame - 20.0f, 10 }, 4));
+      }
+      masks.push_back(scheduler.Schedule());
+    }
+    return masks;
+  };
+  CHECK(run() == run());
+}
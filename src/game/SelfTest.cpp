@@ -0,0 +1,67 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace SelfTest
+{
+  namespace
+  {
+    struct Test
+    {
+      std::string_view name;
+      TestFn fn;
+    };
+
+    // function-local, as tests register during static initialization
+    std::vector<Test>& GetTests()
+    {
+      static std::vector<Test> tests;
+      return tests;
+    }
+
+    int failures = 0;
+  }
+
+  Registrar::Registrar(std::string_view name, TestFn fn)
+  {
+    GetTests().push_back({ name, fn });
+  }
+
+  void ReportFailure(const char* expression, const char* file, int line)
+  {
+    std::fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", file, line, expression);
+    failures++;
+  }
+}
+
+int RunSelfTests(int argc, char** argv)
+{
+  using namespace SelfTest;
+
+  auto tests = GetTests();
+  std::sort(tests.begin(), tests.end(), [](const Test& a, const Test& b) { return a.name < b.name; });
+
+  int run = 0;
+  int failed = 0;
+  for (const auto& test : tests)
+  {
+    if (argc > 0 && std::none_of(argv, argv + argc, [&](const char* arg) { return test.name == arg; }))
+    {
+      continue;
+    }
+
+    const int failuresBefore = failures;
+    test.fn();
+    const bool passed = failures == failuresBefore;
+    std::printf("%s %.*s\n", passed ? "[pass]" : "[FAIL]", static_cast<int>(test.name.size()), test.name.data());
+    run++;
+    failed += !passed;
+  }
+
+  std::printf("%d of %d tests passed\n", run - failed, run);
+  return failed == 0 && run > 0 ? 0 : 1;
+}
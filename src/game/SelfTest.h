@@ -0,0 +1,28 @@
+#pragma once
+#include <string_view>
+
+// Checks of engine code that runs without a window or GL, run with --selftest [name...].
+// Tests register themselves with SELF_TEST, and fail through CHECK, which keeps going so that every failure
+// in a test is reported.
+namespace SelfTest
+{
+  using TestFn = void(*)();
+
+  struct Registrar
+  {
+    Registrar(std::string_view name, TestFn fn);
+  };
+
+  void ReportFailure(const char* expression, const char* file, int line);
+}
+
+#define SELF_TEST(name) \
+  static void SelfTest_##name(); \
+  static const SelfTest::Registrar selfTestRegistrar_##name(#name, SelfTest_##name); \
+  static void SelfTest_##name()
+
+#define CHECK(x) \
+  do { if (!(x)) SelfTest::ReportFailure(#x, __FILE__, __LINE__); } while (0)
+
+// runs every test, or only those named. returns the process's exit code
+int RunSelfTests(int argc, char** argv);
@@ -0,0 +1,74 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/Directories.h>
+#include <engine/gfx/resource/ShaderCompiler.h>
+#include <utility/Defer.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+  // stages are loaded relative to the shader directory, so the test shaders are written there
+  constexpr std::string_view TEST_SHADER_DIR = "selftest_tmp/";
+  constexpr std::string_view DEFAULT_CACHE_DIR = "cache/shaders/";
+
+  void WriteFile(const std::filesystem::path& path, std::string_view content)
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+  }
+}
+
+SELF_TEST(ShaderCacheTracksIncludes)
+{
+  const std::filesystem::path shaderDir = std::string(ShaderDir) + std::string(TEST_SHADER_DIR);
+  const std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "shader_cache_selftest";
+  std::filesystem::remove_all(cacheDir);
+  std::filesystem::create_directories(shaderDir);
+  std::filesystem::create_directories(cacheDir);
+  GFX::ShaderCompiler::SetCacheDirectory(cacheDir.string());
+  Defer cleanup = [&]
+  {
+    GFX::ShaderCompiler::SetCacheDirectory(std::string(DEFAULT_CACHE_DIR));
+    std::filesystem::remove_all(shaderDir);
+    std::filesystem::remove_all(cacheDir);
+  };
+
+  WriteFile(shaderDir / "value.h.glsl", "#define VALUE 1u\n");
+  WriteFile(shaderDir / "store.cs.glsl",
+    "#version 450 core\n"
+    "#include \"value.h.glsl\"\n"
+    "layout(std430, binding = 0) buffer ssbo_0 { uint outValue; };\n"
+    "layout(local_size_x = 1) in;\n"
+    "void main() { outValue = VALUE; }\n");
+  const GFX::ShaderCreateInfo createInfo{ .path = std::string(TEST_SHADER_DIR) + "store.cs.glsl", .type = GFX::ShaderType::COMPUTE };
+
+  const auto first = GFX::ShaderCompiler::CompileStage(createInfo, true);
+  CHECK(first.ok && !first.fromCache && !first.spirv.empty());
+
+  const auto cached = GFX::ShaderCompiler::CompileStage(createInfo, true);
+  CHECK(cached.ok && cached.fromCache);
+  CHECK(cached.glsl == first.glsl && cached.spirv == first.spirv);
+
+  // editing the include makes the entry stale
+  WriteFile(shaderDir / "value.h.glsl", "#define VALUE 2u\n");
+  const auto edited = GFX::ShaderCompiler::CompileStage(createInfo, true);
+  CHECK(edited.ok && !edited.fromCache);
+  CHECK(edited.glsl != first.glsl && edited.spirv != first.spirv);
+  CHECK(GFX::ShaderCompiler::CompileStage(createInfo, true).fromCache);
+
+  // replacements are part of the key
+  auto replaced = createInfo;
+  replaced.replace.emplace_back("VALUE", "3u");
+  const auto replacedStage = GFX::ShaderCompiler::CompileStage(replaced, false);
+  CHECK(replacedStage.ok && !replacedStage.fromCache && replacedStage.spirv.empty());
+  CHECK(replacedStage.glsl != edited.glsl);
+
+  // an entry without SPIR-V is only a hit when SPIR-V isn't needed
+  CHECK(GFX::ShaderCompiler::CompileStage(replaced, false).fromCache);
+  const auto upgraded = GFX::ShaderCompiler::CompileStage(replaced, true);
+  CHECK(upgraded.ok && !upgraded.fromCache && !upgraded.spirv.empty());
+  CHECK(upgraded.glsl == replacedStage.glsl);
+  CHECK(GFX::ShaderCompiler::CompileStage(replaced, true).fromCache);
+}
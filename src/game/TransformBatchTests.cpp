@@ -0,0 +1,79 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/ecs/TransformBatch.h>
+#include <engine/ecs/component/Transform.h>
+
+#include <random>
+#include <vector>
+
+namespace
+{
+  bool Near(const glm::mat4& a, const glm::mat4& b)
+  {
+    for (int column = 0; column < 4; column++)
+    {
+      if (glm::any(glm::greaterThan(glm::abs(a[column] - b[column]), glm::vec4(1e-4f))))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<Component::Transform> MakeTransforms(size_t count, uint32_t seed)
+  {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-100, 100);
+    std::uniform_real_distribution<float> unit(-1, 1);
+    std::uniform_real_distribution<float> scale(0.1f, 4);
+
+    std::vector<Component::Transform> transforms(count);
+    for (auto& transform : transforms)
+    {
+      transform.SetTranslation({ position(rng), position(rng), position(rng) });
+      transform.SetRotation(glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))));
+      transform.SetScale({ scale(rng), scale(rng), scale(rng) });
+    }
+    return transforms;
+  }
+}
+
+SELF_TEST(TransformBatchMatchesGetModel)
+{
+  // partial batches, an exact batch, and enough for the parallel path with a partial last task
+  for (size_t count : { 0, 1, 7, 8, 13, 3000 })
+  {
+    const auto transforms = MakeTransforms(count, static_cast<uint32_t>(count));
+    TransformBatch batch;
+    batch.Resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      batch.Set(i, transforms[i].GetTranslation(), transforms[i].GetRotation(), transforms[i].GetScale());
+    }
+
+    std::vector<glm::mat4> models(count);
+    batch.Compose(models);
+    bool matches = true;
+    for (size_t i = 0; i < count; i++)
+    {
+      matches &= Near(models[i], transforms[i].GetModel());
+    }
+    CHECK(matches);
+  }
+
+  // pushing after shrinking reuses the padding, which must not leak into the results
+  const auto transforms = MakeTransforms(20, 1);
+  TransformBatch batch;
+  for (const auto& transform : transforms)
+  {
+    batch.Push(transform.GetTranslation(), transform.GetRotation(), transform.GetScale());
+  }
+  batch.Resize(5);
+  batch.Push(transforms[19].GetTranslation(), transforms[19].GetRotation(), transforms[19].GetScale());
+  CHECK(batch.Size() == 6);
+
+  std::vector<glm::mat4> models(batch.Size());
+  batch.Compose(models);
+  CHECK(Near(models[4], transforms[4].GetModel()));
+  CHECK(Near(models[5], transforms[19].GetModel()));
+}
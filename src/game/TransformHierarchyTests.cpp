@@ -0,0 +1,96 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <engine/ecs/TransformHierarchy.h>
+#include <engine/ecs/component/Transform.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace
+{
+  bool Near(const glm::mat4& a, const glm::mat4& b)
+  {
+    for (int column = 0; column < 4; column++)
+    {
+      if (glm::any(glm::greaterThan(glm::abs(a[column] - b[column]), glm::vec4(1e-4f))))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  entt::entity MakeChild(entt::registry& registry, TransformHierarchy& hierarchy, entt::entity parent, const Component::Transform& local)
+  {
+    using namespace Component;
+    const auto entity = registry.create();
+    registry.emplace<Transform>(entity);
+    registry.emplace<LocalTransform>(entity, local);
+    registry.emplace<Parent>(entity, Entity(parent, nullptr));
+    registry.get_or_emplace<Children>(parent).AddChild(Entity(entity, nullptr));
+    hierarchy.SetParent(entity, parent);
+    return entity;
+  }
+
+  Component::Transform MakeTransform(const glm::vec3& translation, const glm::quat& rotation, float scale)
+  {
+    Component::Transform transform;
+    transform.SetTranslation(translation);
+    transform.SetRotation(rotation);
+    transform.SetScale(glm::vec3(scale));
+    return transform;
+  }
+
+  // the per-entity propagation the hierarchy replaced, applied serially from the root down
+  Component::Transform Propagate(const Component::Transform& parent, const Component::Transform& local)
+  {
+    Component::Transform world;
+    world.SetScale(local.GetScale() * parent.GetScale());
+    world.SetTranslation(parent.GetTranslation() + glm::mat3(glm::mat4_cast(parent.GetRotation())) * (local.GetTranslation() * parent.GetScale()));
+    world.SetRotation(local.GetRotation() * parent.GetRotation());
+    return world;
+  }
+
+  // what the physics system does after propagating, so the next update only sees new changes
+  void ClearDirty(entt::registry& registry)
+  {
+    registry.view<Component::Transform>().each([](auto& transform) { transform.SetModel(); });
+  }
+}
+
+SELF_TEST(TransformHierarchyMatchesSerial)
+{
+  using namespace Component;
+  entt::registry registry;
+  TransformHierarchy hierarchy(registry);
+
+  const auto root = registry.create();
+  registry.emplace<Transform>(root, MakeTransform({ 1, 2, 3 }, glm::angleAxis(0.5f, glm::vec3(0, 1, 0)), 2));
+  const auto childLocal = MakeTransform({ 0, 4, 0 }, glm::angleAxis(1.0f, glm::vec3(1, 0, 0)), 0.5f);
+  const auto grandchildLocal = MakeTransform({ 3, 0, -1 }, glm::angleAxis(-0.7f, glm::normalize(glm::vec3(1, 1, 0))), 3);
+  const auto child = MakeChild(registry, hierarchy, root, childLocal);
+  const auto grandchild = MakeChild(registry, hierarchy, child, grandchildLocal);
+  CHECK(hierarchy.GetDepth() == 2);
+
+  auto serialModel = [&]
+  {
+    return Propagate(Propagate(registry.get<Transform>(root), childLocal), grandchildLocal).GetModel();
+  };
+
+  hierarchy.Update();
+  CHECK(Near(registry.get<Transform>(grandchild).GetModel(), serialModel()));
+  ClearDirty(registry);
+
+  // moving only the root still reaches the grandchild
+  auto& rootTransform = registry.get<Transform>(root);
+  rootTransform.SetTranslation({ -5, 0, 10 });
+  rootTransform.SetRotation(glm::angleAxis(2.0f, glm::normalize(glm::vec3(0, 1, 1))));
+  hierarchy.Update();
+  CHECK(registry.get<Transform>(grandchild).IsDirty());
+  CHECK(Near(registry.get<Transform>(grandchild).GetModel(), serialModel()));
+  ClearDirty(registry);
+
+  // nothing changed, so nothing is recomputed
+  hierarchy.Update();
+  CHECK(!registry.get<Transform>(child).IsDirty());
+  CHECK(!registry.get<Transform>(grandchild).IsDirty());
+}
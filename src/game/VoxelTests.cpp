@@ -0,0 +1,355 @@
+#include "gPCH.h"
+#include "SelfTest.h"
+#include <voxel/VoxelManager.h>
+#include <voxel/VoxelCollision.h>
+#include <voxel/VoxelQuery.h>
+#include <voxel/Pathfinder.h>
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+  // a 2x2x2 chunk world without a scene. blocks span [32, 96) on every axis
+  std::unique_ptr<Voxels::VoxelManager> MakeWorld()
+  {
+    auto vm = std::make_unique<Voxels::VoxelManager>(nullptr);
+    vm->SetDim({ 2, 2, 2 });
+    return vm;
+  }
+
+  // min and max are inclusive
+  void Fill(Voxels::VoxelManager& vm, const glm::ivec3& min, const glm::ivec3& max, Voxels::BlockType type = Voxels::BlockType::bStone)
+  {
+    for (int z = min.z; z <= max.z; z++)
+    {
+      for (int y = min.y; y <= max.y; y++)
+      {
+        for (int x = min.x; x <= max.x; x++)
+        {
+          vm.SetBlockType({ x, y, z }, type);
+        }
+      }
+    }
+  }
+
+  bool Near(float a, float b, float tolerance = 1e-3f)
+  {
+    return glm::abs(a - b) <= tolerance;
+  }
+
+  bool Near(const glm::vec3& a, const glm::vec3& b, float tolerance = 1e-3f)
+  {
+    return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec3(tolerance)));
+  }
+
+  bool IsWalkableCell(Voxels::VoxelManager& vm, const glm::ivec3& p)
+  {
+    auto solid = [&](const glm::ivec3& q) { return Voxels::Collision::IsSolid(vm.GetBlock(q).GetType()); };
+    return solid(p - glm::ivec3(0, 1, 0)) && !solid(p) && !solid(p + glm::ivec3(0, 1, 0));
+  }
+
+  // every step moves one block horizontally, and either stays level, steps up one, or drops
+  bool IsValidPath(Voxels::VoxelManager& vm, const std::vector<glm::ivec3>& path)
+  {
+    for (size_t i = 0; i < path.size(); i++)
+    {
+      if (!IsWalkableCell(vm, path[i]))
+      {
+        return false;
+      }
+      if (i == 0)
+      {
+        continue;
+      }
+      const glm::ivec3 d = path[i] - path[i - 1];
+      if (glm::abs(d.x) + glm::abs(d.z) != 1 || d.y > 1 || d.y < -Voxels::Pathfinder::MAX_DROP)
+      {
+        return false;
+      }
+    }
+    return !path.empty();
+  }
+
+  bool HasStep(const std::vector<glm::ivec3>& path, int dy)
+  {
+    for (size_t i = 1; i < path.size(); i++)
+    {
+      if (path[i].y - path[i - 1].y == dy)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // the floor's top is at y = 41, and the wall's -x face is at x = 50
+  void BuildFloorAndWall(Voxels::VoxelManager& vm)
+  {
+    Fill(vm, { 32, 40, 32 }, { 63, 40, 63 });
+    Fill(vm, { 50, 41, 32 }, { 50, 45, 63 });
+  }
+}
+
+SELF_TEST(SweepIntoWall)
+{
+  using namespace Voxels::Collision;
+  auto vm = MakeWorld();
+  BuildFloorAndWall(*vm);
+
+  const auto box = SweepAABB(*vm, AABB({ 44.5f, 41, 40 }, { 45.5f, 43, 41 }), { 1, 0, 0 }, 10);
+  CHECK(box && Near(box->distance, 4.5f));
+  CHECK(box && box->normal == glm::vec3(-1, 0, 0));
+  CHECK(box && box->blockPos.x == 50);
+
+  // the wall is out of reach
+  CHECK(!SweepAABB(*vm, AABB({ 44.5f, 41, 40 }, { 45.5f, 43, 41 }), { 1, 0, 0 }, 4));
+
+  const auto capsule = SweepCapsule(*vm, { 45, 42, 40.5f }, { 45, 43, 40.5f }, 0.4f, { 1, 0, 0 }, 10);
+  CHECK(capsule && Near(capsule->distance, 4.6f));
+  CHECK(capsule && Near(capsule->normal, { -1, 0, 0 }));
+  CHECK(capsule && capsule->blockPos.x == 50);
+
+  // diagonal moves stop at the same face
+  const glm::vec3 diagonal = glm::normalize(glm::vec3(1, 0, 1));
+  const auto slanted = SweepAABB(*vm, AABB({ 44.5f, 41, 40 }, { 45.5f, 43, 41 }), diagonal, 20);
+  CHECK(slanted && Near(slanted->distance, 4.5f * glm::sqrt(2.0f)));
+  CHECK(slanted && slanted->normal == glm::vec3(-1, 0, 0));
+}
+
+SELF_TEST(SweepAlongFloor)
+{
+  using namespace Voxels::Collision;
+  auto vm = MakeWorld();
+  BuildFloorAndWall(*vm);
+
+  // resting on the floor and sliding along it hits nothing
+  CHECK(!SweepAABB(*vm, AABB({ 40.25f, 41, 35.25f }, { 40.75f, 42, 35.75f }), { 0, 0, 1 }, 20));
+  CHECK(!SweepCapsule(*vm, { 40.5f, 41.5f, 35.5f }, { 40.5f, 42.5f, 35.5f }, 0.5f, { 0, 0, 1 }, 20));
+
+  // falling onto it does
+  const auto box = SweepAABB(*vm, AABB({ 40.25f, 45, 35.25f }, { 40.75f, 46, 35.75f }), { 0, -1, 0 }, 10);
+  CHECK(box && Near(box->distance, 4));
+  CHECK(box && box->normal == glm::vec3(0, 1, 0));
+  CHECK(box && box->blockPos == glm::ivec3(40, 40, 35));
+
+  const auto capsule = SweepCapsule(*vm, { 40.5f, 45.5f, 35.5f }, { 40.5f, 46.5f, 35.5f }, 0.5f, { 0, -1, 0 }, 10);
+  CHECK(capsule && Near(capsule->distance, 4));
+  CHECK(capsule && Near(capsule->normal, { 0, 1, 0 }));
+  CHECK(capsule && capsule->blockPos == glm::ivec3(40, 40, 35));
+
+  // moving away from the floor ignores it
+  CHECK(!SweepAABB(*vm, AABB({ 40.25f, 41, 35.25f }, { 40.75f, 42, 35.75f }), { 0, 1, 0 }, 3));
+}
+
+SELF_TEST(SweepStartingInsideSolid)
+{
+  using namespace Voxels::Collision;
+  auto vm = MakeWorld();
+  BuildFloorAndWall(*vm);
+  Fill(*vm, { 46, 41, 50 }, { 46, 42, 50 });
+
+  // the wall block the shapes start in is ignored, but the pillar behind them is not
+  const AABB inWall({ 50.25f, 41.25f, 50.25f }, { 50.75f, 41.75f, 50.75f });
+  CHECK(OverlapAABB(*vm, inWall));
+
+  const auto box = SweepAABB(*vm, inWall, { -1, 0, 0 }, 10);
+  CHECK(box && Near(box->distance, 3.25f));
+  CHECK(box && box->normal == glm::vec3(1, 0, 0));
+  CHECK(box && box->blockPos == glm::ivec3(46, 41, 50));
+
+  const auto capsule = SweepCapsule(*vm, { 50.5f, 41.4f, 50.5f }, { 50.5f, 41.6f, 50.5f }, 0.2f, { -1, 0, 0 }, 10);
+  CHECK(capsule && Near(capsule->distance, 3.3f));
+  CHECK(capsule && Near(capsule->normal, { 1, 0, 0 }));
+  CHECK(capsule && capsule->blockPos == glm::ivec3(46, 41, 50));
+
+  // with nothing behind them, starting inside is not a hit
+  CHECK(!SweepAABB(*vm, inWall, { 1, 0, 0 }, 10));
+  CHECK(!SweepCapsule(*vm, { 50.5f, 41.4f, 50.5f }, { 50.5f, 41.6f, 50.5f }, 0.2f, { 1, 0, 0 }, 10));
+}
+
+SELF_TEST(QueryBatchesMatchSingleQueries)
+{
+  using namespace Voxels;
+  auto vm = MakeWorld();
+
+  // scattered blocks on both sides of the chunk borders at 64
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> coord(34, 93);
+  std::uniform_real_distribution<float> position(36, 92);
+  std::uniform_real_distribution<float> direction(-1, 1);
+  for (int i = 0; i < 3000; i++)
+  {
+    vm->SetBlockType({ coord(rng), coord(rng), coord(rng) }, BlockType::bStone);
+  }
+
+  std::vector<Query::Ray> rays;
+  std::vector<Query::Segment> segments;
+  std::vector<Query::Sphere> spheres;
+  std::vector<AABB> boxes;
+  for (int i = 0; i < 500; i++)
+  {
+    const glm::vec3 origin(position(rng), position(rng), position(rng));
+    const glm::vec3 dir = glm::normalize(glm::vec3(direction(rng), direction(rng), direction(rng)) + glm::vec3(0.01f));
+    rays.push_back({ origin, dir, 40 });
+    segments.push_back({ origin, glm::vec3(position(rng), position(rng), position(rng)) });
+    spheres.push_back({ origin, glm::abs(direction(rng)) * 2 });
+    boxes.emplace_back(origin, origin + glm::abs(glm::vec3(direction(rng), direction(rng), direction(rng))) * 3.0f);
+  }
+
+  std::vector<std::optional<Collision::Hit>> hits(rays.size());
+  std::vector<uint8_t> visible(segments.size());
+  std::vector<uint8_t> sphereOverlaps(spheres.size());
+  std::vector<uint8_t> boxOverlaps(boxes.size());
+  Query::RaycastBatch(*vm, rays, hits);
+  Query::LineOfSightBatch(*vm, segments, visible);
+  Query::OverlapSphereBatch(*vm, spheres, sphereOverlaps);
+  Query::OverlapBoxBatch(*vm, boxes, boxOverlaps);
+
+  int rayHits = 0;
+  int boxHits = 0;
+  for (size_t i = 0; i < rays.size(); i++)
+  {
+    const auto hit = Collision::Raycast(*vm, rays[i].origin, rays[i].direction, rays[i].distance);
+    CHECK(hit.has_value() == hits[i].has_value());
+    CHECK(!hit || (hit->blockPos == hits[i]->blockPos && hit->distance == hits[i]->distance && hit->normal == hits[i]->normal));
+    CHECK(!hit || Collision::IsSolid(vm->GetBlock(hit->blockPos).GetType()));
+    rayHits += hit.has_value();
+
+    CHECK(visible[i] == Query::LineOfSight(*vm, segments[i].from, segments[i].to));
+
+    bool sphereOverlap = false;
+    Query::OverlapSphere(*vm, spheres[i].center, spheres[i].radius, [&](const glm::ivec3&, Block)
+      {
+        sphereOverlap = true;
+        return true;
+      });
+    CHECK(sphereOverlaps[i] == sphereOverlap);
+
+    // every block in the box, read one at a time
+    bool boxOverlap = false;
+    const glm::ivec3 lo(glm::floor(boxes[i].min));
+    const glm::ivec3 hi = glm::ivec3(glm::ceil(boxes[i].max)) - 1;
+    for (int z = lo.z; z <= hi.z; z++)
+    {
+      for (int y = lo.y; y <= hi.y; y++)
+      {
+        for (int x = lo.x; x <= hi.x; x++)
+        {
+          boxOverlap |= Collision::IsSolid(vm->GetBlock({ x, y, z }).GetType());
+        }
+      }
+    }
+    CHECK(boxOverlaps[i] == boxOverlap);
+    boxHits += boxOverlap;
+  }
+
+  // both outcomes are exercised
+  CHECK(rayHits > 0 && rayHits < static_cast<int>(rays.size()));
+  CHECK(boxHits > 0 && boxHits < static_cast<int>(boxes.size()));
+}
+
+SELF_TEST(QueryVisitsBoxesAcrossChunks)
+{
+  using namespace Voxels;
+  auto vm = MakeWorld();
+
+  // one block in each of the eight chunks around the corner at (64, 64, 64)
+  std::vector<glm::ivec3> placed;
+  for (int i = 0; i < 8; i++)
+  {
+    placed.emplace_back(i & 1 ? 64 : 63, i & 2 ? 64 : 63, i & 4 ? 64 : 63);
+    vm->SetBlockType(placed.back(), BlockType::bStone);
+  }
+
+  std::vector<glm::ivec3> visited;
+  Query::OverlapBox(*vm, AABB(glm::vec3(62.5f), glm::vec3(65.5f)), [&](const glm::ivec3& p, Block)
+    {
+      visited.push_back(p);
+      return false;
+    });
+  std::sort(visited.begin(), visited.end(), [](const auto& a, const auto& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); });
+  std::sort(placed.begin(), placed.end(), [](const auto& a, const auto& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); });
+  CHECK(visited == placed);
+
+  // the query let go of every chunk, so editing and querying again sees the edit
+  vm->SetBlockType({ 64, 64, 64 }, BlockType::bAir);
+  CHECK(!Collision::OverlapAABB(*vm, AABB(glm::vec3(64.25f), glm::vec3(64.75f))));
+
+  const auto hit = Collision::Raycast(*vm, { 60.5f, 63.5f, 63.5f }, { 1, 0, 0 }, 10);
+  CHECK(hit && hit->blockPos == glm::ivec3(63, 63, 63) && Near(hit->distance, 2.5f));
+
+  // boxes that only touch a block's faces and boxes outside the world visit nothing
+  bool any = false;
+  Query::OverlapBox(*vm, AABB({ 65, 63, 63 }, { 66, 64, 64 }), [&](const glm::ivec3&, Block) { return any = true; });
+  Query::OverlapBox(*vm, AABB(glm::vec3(-100), glm::vec3(-90)), [&](const glm::ivec3&, Block) { return any = true; });
+  CHECK(!any);
+}
+
+SELF_TEST(PathfinderKnownLayouts)
+{
+  using namespace Voxels;
+  auto vm = MakeWorld();
+
+  // a floor crossing the chunk border at x = 64, so agents stand at y = 41
+  Fill(*vm, { 32, 40, 32 }, { 90, 40, 60 });
+
+  // a one block ridge across the whole floor, which is stepped onto and dropped off of
+  Fill(*vm, { 44, 41, 32 }, { 47, 41, 60 });
+
+  // a three block cliff, which can be dropped off of but not climbed
+  Fill(*vm, { 70, 41, 32 }, { 90, 43, 60 });
+
+  // a corridor along z = 45 that is closed at x = 62
+  Fill(*vm, { 52, 41, 44 }, { 62, 42, 44 });
+  Fill(*vm, { 52, 41, 46 }, { 62, 42, 46 });
+  Fill(*vm, { 62, 41, 45 }, { 62, 42, 45 });
+
+  auto& pathfinder = vm->GetPathfinder();
+
+  const auto ridge = pathfinder.FindPath({ .start = { 40, 41, 50 }, .goal = { 50, 41, 50 } });
+  CHECK(ridge.status == PathStatus::FOUND);
+  CHECK(IsValidPath(*vm, ridge.path));
+  CHECK(HasStep(ridge.path, 1) && HasStep(ridge.path, -1));
+  CHECK(ridge.path.front() == glm::ivec3(40, 41, 50) && ridge.path.back() == glm::ivec3(50, 41, 50));
+
+  const auto drop = pathfinder.FindPath({ .start = { 80, 44, 50 }, .goal = { 60, 41, 50 } });
+  CHECK(drop.status == PathStatus::FOUND);
+  CHECK(IsValidPath(*vm, drop.path));
+  CHECK(HasStep(drop.path, -3));
+  CHECK(pathfinder.FindPath({ .start = { 60, 41, 50 }, .goal = { 80, 44, 50 } }).status == PathStatus::NO_PATH);
+
+  // the goal is straight ahead of the corridor, so the path has to back out of it first
+  const auto deadEnd = pathfinder.FindPath({ .start = { 60, 41, 45 }, .goal = { 66, 41, 45 } });
+  CHECK(deadEnd.status == PathStatus::FOUND);
+  CHECK(IsValidPath(*vm, deadEnd.path));
+  CHECK(std::any_of(deadEnd.path.begin(), deadEnd.path.end(), [](const glm::ivec3& p) { return p.x < 52; }));
+
+  const auto budget = pathfinder.FindPath({ .start = { 40, 41, 50 }, .goal = { 66, 41, 50 }, .maxExpansions = 3 });
+  CHECK(budget.status == PathStatus::BUDGET_EXCEEDED);
+  CHECK(budget.path.empty());
+
+  // more than MAX_DROP above the floor
+  CHECK(pathfinder.FindPath({ .start = { 40, 50, 50 }, .goal = { 50, 41, 50 } }).status == PathStatus::INVALID_ENDPOINTS);
+
+  // sealing the corridor is seen once the pathfinder is told about it
+  for (int y = 41; y <= 42; y++)
+  {
+    vm->SetBlockType({ 52, y, 45 }, BlockType::bStone);
+    pathfinder.Invalidate({ 52, y, 45 });
+  }
+  CHECK(pathfinder.FindPath({ .start = { 60, 41, 45 }, .goal = { 66, 41, 45 } }).status == PathStatus::NO_PATH);
+
+  // wall off part of the border, but only rebuild the graph on its far side. the graph on the near side
+  // still has edges into the wall, which must be treated as missing
+  CHECK(pathfinder.FindPath({ .start = { 60, 41, 50 }, .goal = { 66, 41, 50 } }).status == PathStatus::FOUND);
+  Fill(*vm, { 64, 41, 48 }, { 64, 42, 60 });
+  pathfinder.Invalidate({ 80, 41, 50 });
+  const auto stale = pathfinder.FindPath({ .start = { 60, 41, 50 }, .goal = { 66, 41, 50 } });
+  CHECK(stale.status == PathStatus::FOUND);
+  CHECK(IsValidPath(*vm, stale.path));
+}
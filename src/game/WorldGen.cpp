@@ -4,6 +4,7 @@
 #include <voxel/ChunkHelpers.h>
 #include <execution>
 #include <utility/Timer.h>
+#include <engine/core/JobSystem.h>
 #include <voxel/VoxelManager.h>
 #include <voxel/prefab.h>
 #include <FastNoise2/include/FastNoise/FastNoise.h>
@@ -23,9 +24,14 @@ namespace
 
 // init chunks that we finna modify
 void WorldGen::Init()
+{
+  Init(worldDim);
+}
+
+void WorldGen::Init(const glm::ivec3& dim)
 {
   Timer timer;
-  voxels.SetDim(worldDim);
+  voxels.SetDim(dim);
   spdlog::info("Allocating chunks took {} seconds", timer.Elapsed());
 }
 
@@ -50,7 +56,7 @@ void WorldGen::GenerateWorld()
 
 
   auto& chunks = voxels.chunks_;
-  std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+  engine::Core::JobSystem::Get()->ForEach(chunks.begin(), chunks.end(),
     [&](Voxels::Chunk* chunk)
   {
     if (chunk)
@@ -186,7 +192,7 @@ void WorldGen::InitMeshes()
 {
   Timer timer;
   auto& chunks = voxels.chunks_;
-  std::for_each(std::execution::par,
+  engine::Core::JobSystem::Get()->ForEach(
     chunks.begin(), chunks.end(), [](auto& p)
     {
       if (p)
@@ -12,6 +12,7 @@ class WorldGen
 public:
   WorldGen(Voxels::VoxelManager& v) : voxels(v) {}
   void Init();
+  void Init(const glm::ivec3& dim); // dim is in chunks
   void GenerateWorld();
   void InitMeshes();
   void InitBuffers();
@@ -11,6 +11,8 @@
 #include <voxel/ChunkSerialize.h>
 #include <voxel/ChunkRenderer.h>
 #include "WorldGen.h"
+#include "Benchmark.h"
+#include "SelfTest.h"
 #include <engine/gfx/api/Texture.h>
 #include <engine/gfx/resource/TextureManager.h>
 #include <engine/gfx/TextureLoader.h>
@@ -444,10 +446,19 @@ void OnInterfaceDraw([[maybe_unused]] Scene* scene, [[maybe_unused]] Timestep ti
   voxelManager->DrawDebug();
 }
 
-int main()
+int main(int argc, char** argv)
 {
   engine::Core::InitLogging();
 
+  if (argc > 1 && std::string_view(argv[1]) == "--benchmark")
+  {
+    return RunVoxelBenchmark(argc - 2, argv + 2);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "--selftest")
+  {
+    return RunSelfTests(argc - 2, argv + 2);
+  }
+
   Application::SetStartCallback(OnStart);
   Application::SetUpdateCallback(OnUpdate);
   Application::SetDrawOpaqueCallback(OnDraw);
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// incremental 64-bit FNV-1a, for cache keys that shouldn't collide in practice
+struct Hasher64
+{
+  uint64_t hash = 14695981039346656037ull;
+
+  Hasher64& Add(const void* data, size_t size)
+  {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return *this;
+  }
+
+  // the length is hashed too, so that "ab" + "c" differs from "a" + "bc"
+  Hasher64& Add(std::string_view str)
+  {
+    const uint64_t size = str.size();
+    Add(&size, sizeof(size));
+    return Add(str.data(), str.size());
+  }
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+
+// read-only view of a whole file, paged in by the OS as it is read
+class MappedFile
+{
+public:
+  static std::optional<MappedFile> Open(const std::string& path);
+
+  std::span<const std::byte> Data() const { return { data_, size_ }; }
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+private:
+  MappedFile() = default;
+
+  const std::byte* data_{};
+  size_t size_{};
+  void* mapping_{}; // the file mapping object on Windows
+};
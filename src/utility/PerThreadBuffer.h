@@ -0,0 +1,180 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace detail
+{
+  inline constexpr size_t CACHE_LINE_SIZE = 64;
+  inline constexpr uint32_t MAX_BUFFER_THREADS = 128;
+
+  // hands out small, dense thread indices that are recycled when a thread exits
+  class ThreadIndexAllocator
+  {
+  public:
+    static uint32_t Acquire()
+    {
+      std::lock_guard lck(mutex_);
+      if (!freeList_.empty())
+      {
+        auto index = freeList_.back();
+        freeList_.pop_back();
+        return index;
+      }
+      return next_++;
+    }
+
+    static void Release(uint32_t index)
+    {
+      std::lock_guard lck(mutex_);
+      freeList_.push_back(index);
+    }
+
+  private:
+    static inline std::mutex mutex_;
+    static inline std::vector<uint32_t> freeList_;
+    static inline uint32_t next_{ 0 };
+  };
+
+  struct ThreadIndex
+  {
+    ThreadIndex() : value(ThreadIndexAllocator::Acquire()) {}
+    ~ThreadIndex() { ThreadIndexAllocator::Release(value); }
+    const uint32_t value;
+  };
+
+  inline uint32_t GetThreadIndex()
+  {
+    thread_local ThreadIndex index;
+    return index.value;
+  }
+}
+
+// Lets many threads append to what is logically one array without contending on a shared counter.
+// Each thread writes to its own list of cache-line-aligned chunks, which are kept between frames.
+// Threads beyond the first MAX_BUFFER_THREADS share one mutex-guarded buffer.
+// Push may be called concurrently. Clear, Size, and MergeInto must not overlap with Push.
+template<typename T, size_t ChunkSize = 256>
+class PerThreadBuffer
+{
+public:
+  PerThreadBuffer() = default;
+  PerThreadBuffer(const PerThreadBuffer&) = delete;
+  PerThreadBuffer& operator=(const PerThreadBuffer&) = delete;
+
+  void Push(const T& value)
+  {
+    auto index = detail::GetThreadIndex();
+    if (index >= detail::MAX_BUFFER_THREADS)
+    {
+      std::lock_guard lck(overflowMutex_);
+      overflow_.Push(value);
+      return;
+    }
+
+    auto& slot = slots_[index];
+    if (!slot)
+    {
+      slot = std::make_unique<ThreadBuffer>();
+    }
+    slot->Push(value);
+  }
+
+  // resets every thread's buffer without freeing its chunks
+  void Clear()
+  {
+    for (auto& slot : slots_)
+    {
+      if (slot)
+      {
+        slot->size = 0;
+      }
+    }
+    overflow_.size = 0;
+  }
+
+  [[nodiscard]] size_t Size() const
+  {
+    size_t size = overflow_.size;
+    for (const auto& slot : slots_)
+    {
+      if (slot)
+      {
+        size += slot->size;
+      }
+    }
+    return size;
+  }
+
+  // concatenates every thread's elements into out (replacing its contents). thread order is unspecified
+  void MergeInto(std::vector<T>& out) const
+  {
+    MergeInto(out, [](auto first, auto last, auto&& fn) { std::for_each(first, last, fn); });
+  }
+
+  // same, but copies each thread's elements with forEach(first, last, fn), which may run fn in parallel
+  template<typename ForEachFn>
+  void MergeInto(std::vector<T>& out, ForEachFn&& forEach) const
+  {
+    std::vector<std::pair<const ThreadBuffer*, size_t>> sources;
+    size_t total = 0;
+    for (const auto& slot : slots_)
+    {
+      if (slot && slot->size > 0)
+      {
+        sources.emplace_back(slot.get(), total);
+        total += slot->size;
+      }
+    }
+    if (overflow_.size > 0)
+    {
+      sources.emplace_back(&overflow_, total);
+      total += overflow_.size;
+    }
+
+    out.resize(total);
+    forEach(sources.begin(), sources.end(),
+      [&out](const auto& source)
+      {
+        auto [buffer, dstOffset] = source;
+        for (size_t i = 0; i < buffer->size; i += ChunkSize)
+        {
+          const auto& chunk = *buffer->chunks[i / ChunkSize];
+          auto count = std::min(ChunkSize, buffer->size - i);
+          std::copy_n(chunk.items, count, out.begin() + dstOffset + i);
+        }
+      });
+  }
+
+private:
+  struct alignas(detail::CACHE_LINE_SIZE) Chunk
+  {
+    T items[ChunkSize];
+  };
+
+  struct alignas(detail::CACHE_LINE_SIZE) ThreadBuffer
+  {
+    void Push(const T& value)
+    {
+      auto chunkIndex = size / ChunkSize;
+      if (chunkIndex == chunks.size())
+      {
+        chunks.push_back(std::make_unique<Chunk>());
+      }
+      chunks[chunkIndex]->items[size % ChunkSize] = value;
+      size++;
+    }
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    size_t size{ 0 };
+  };
+
+  std::array<std::unique_ptr<ThreadBuffer>, detail::MAX_BUFFER_THREADS> slots_;
+  std::mutex overflowMutex_;
+  ThreadBuffer overflow_;
+};
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "vPCH.h"
+#include <voxel/BlockTicker.h>
+#include <voxel/VoxelManager.h>
+#include <voxel/Chunk.h>
+#include <voxel/ChunkHelpers.h>
+
+#include <engine/CVar.h>
+#include <engine/core/JobSystem.h>
+
+#include <algorithm>
+#include <array>
+#include <optional>
+
+AutoCVar<cvar_float> tickRateCVar("v.tickRate", "- Block ticks per second. 0 disables block ticks", 10, 0, 100);
+
+namespace Voxels
+{
+  namespace
+  {
+    constexpr glm::ivec3 UP{ 0, 1, 0 };
+    constexpr glm::ivec3 FACES[] =
+    {
+      {-1, 0, 0 },
+      { 1, 0, 0 },
+      { 0,-1, 0 },
+      { 0, 1, 0 },
+      { 0, 0,-1 },
+      { 0, 0, 1 },
+    };
+    constexpr glm::ivec3 HORIZONTAL[] =
+    {
+      { 1, 0, 0 },
+      { 0, 0, 1 },
+      {-1, 0, 0 },
+      { 0, 0,-1 },
+    };
+
+    // a grass block that can spread does so on one tick out of this many
+    constexpr uint32_t GRASS_SPREAD_ODDS = 4;
+
+    // cheap, deterministic randomness for a block on a given tick
+    uint32_t Hash(const glm::ivec3& p, uint32_t tick)
+    {
+      uint32_t h = uint32_t(p.x) * 73856093u ^ uint32_t(p.y) * 19349663u ^ uint32_t(p.z) * 83492791u ^ tick * 2654435761u;
+      h ^= h >> 16;
+      h *= 0x7feb352du;
+      h ^= h >> 15;
+      return h;
+    }
+
+    // the blocks of one chunk to tick, and what ticking them did
+    struct ChunkTick
+    {
+      Chunk* chunk{};
+      std::vector<uint16_t> indices;
+      std::vector<glm::ivec3> woken;
+      std::vector<Chunk*> modified;
+    };
+
+    class TickContext
+    {
+    public:
+      TickContext(VoxelManager& vm, ChunkTick& job, uint32_t tick) : vm_(vm), job_(job), tick_(tick) {}
+
+      // empty for blocks in chunks that don't exist, which are treated as solid
+      std::optional<BlockType> Get(const glm::ivec3& wpos) const
+      {
+        auto p = ChunkHelpers::WorldPosToLocalPos(wpos);
+        const Chunk* chunk = vm_.GetChunk(p.chunk_pos);
+        if (!chunk)
+        {
+          return std::nullopt;
+        }
+        return chunk->BlockTypeAtNoLock(p.block_pos);
+      }
+
+      bool IsOpaque(const glm::ivec3& wpos) const
+      {
+        auto type = Get(wpos);
+        return !type || Block(*type).GetVisibility() == Visibility::Opaque;
+      }
+
+      // the chunk must exist
+      void Set(const glm::ivec3& wpos, BlockType type)
+      {
+        auto p = ChunkHelpers::WorldPosToLocalPos(wpos);
+        Chunk* chunk = vm_.GetChunk(p.chunk_pos);
+        ASSERT(chunk);
+        chunk->SetBlockTypeAt(p.block_pos, type);
+        job_.modified.push_back(chunk);
+
+        // neighbouring chunks must be remeshed too if a face between them changed
+        Wake(wpos);
+        for (const auto& dir : FACES)
+        {
+          Wake(wpos + dir);
+          auto n = ChunkHelpers::WorldPosToLocalPos(wpos + dir);
+          if (n.chunk_pos != p.chunk_pos)
+          {
+            if (Chunk* nchunk = vm_.GetChunk(n.chunk_pos))
+            {
+              job_.modified.push_back(nchunk);
+            }
+          }
+        }
+      }
+
+      void Wake(const glm::ivec3& wpos)
+      {
+        job_.woken.push_back(wpos);
+      }
+
+      uint32_t Random(const glm::ivec3& wpos) const
+      {
+        return Hash(wpos, tick_);
+      }
+
+    private:
+      VoxelManager& vm_;
+      ChunkTick& job_;
+      uint32_t tick_;
+    };
+
+    void TickSand(TickContext& ctx, const glm::ivec3& p)
+    {
+      auto below = ctx.Get(p - UP);
+      if (below == BlockType::bAir || below == BlockType::bWater)
+      {
+        ctx.Set(p, *below);
+        ctx.Set(p - UP, BlockType::bSand);
+      }
+    }
+
+    void TickWater(TickContext& ctx, const glm::ivec3& p)
+    {
+      if (ctx.Get(p - UP) == BlockType::bAir)
+      {
+        ctx.Set(p, BlockType::bAir);
+        ctx.Set(p - UP, BlockType::bWater);
+        return;
+      }
+
+      // run off ledges. the first direction tried changes every tick so water doesn't drift one way
+      uint32_t first = ctx.Random(p);
+      for (int i = 0; i < 4; i++)
+      {
+        glm::ivec3 side = p + HORIZONTAL[(first + i) % 4];
+        if (ctx.Get(side) == BlockType::bAir && ctx.Get(side - UP) == BlockType::bAir)
+        {
+          ctx.Set(p, BlockType::bAir);
+          ctx.Set(side, BlockType::bWater);
+          return;
+        }
+      }
+    }
+
+    // grass can spread to uncovered dirt up to one block away horizontally and vertically
+    int FindSpreadTargets(const TickContext& ctx, const glm::ivec3& p, std::array<glm::ivec3, 12>& targets)
+    {
+      int count = 0;
+      for (const auto& dir : HORIZONTAL)
+      {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+          glm::ivec3 q = p + dir + glm::ivec3(0, dy, 0);
+          if (ctx.Get(q) == BlockType::bDirt && !ctx.IsOpaque(q + UP))
+          {
+            targets[count++] = q;
+          }
+        }
+      }
+      return count;
+    }
+
+    void TickGrass(TickContext& ctx, const glm::ivec3& p)
+    {
+      if (ctx.IsOpaque(p + UP))
+      {
+        ctx.Set(p, BlockType::bDirt);
+        return;
+      }
+
+      std::array<glm::ivec3, 12> targets;
+      int count = FindSpreadTargets(ctx, p, targets);
+      if (count == 0)
+      {
+        return;
+      }
+
+      // stay awake until there is nowhere left to spread to
+      uint32_t r = ctx.Random(p);
+      if (r % GRASS_SPREAD_ODDS == 0)
+      {
+        ctx.Set(targets[(r / GRASS_SPREAD_ODDS) % count], BlockType::bGrass);
+      }
+      ctx.Wake(p);
+    }
+
+    // uncovered dirt wakes the grass that could spread to it, since uncovering it may not have woken that grass
+    void TickDirt(TickContext& ctx, const glm::ivec3& p)
+    {
+      if (ctx.IsOpaque(p + UP))
+      {
+        return;
+      }
+
+      for (const auto& dir : HORIZONTAL)
+      {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+          glm::ivec3 q = p + dir + glm::ivec3(0, dy, 0);
+          if (ctx.Get(q) == BlockType::bGrass)
+          {
+            ctx.Wake(q);
+          }
+        }
+      }
+    }
+
+    void TickChunk(VoxelManager& vm, ChunkTick& job, uint32_t tick)
+    {
+      // ascending index order visits lower blocks in a column first, so falling blocks move once per tick
+      std::sort(job.indices.begin(), job.indices.end());
+      job.indices.erase(std::unique(job.indices.begin(), job.indices.end()), job.indices.end());
+
+      TickContext ctx(vm, job, tick);
+      const glm::ivec3 cpos = job.chunk->GetPos();
+      for (uint16_t index : job.indices)
+      {
+        glm::ivec3 local
+        {
+          index % Chunk::CHUNK_SIZE,
+          (index / Chunk::CHUNK_SIZE) % Chunk::CHUNK_SIZE,
+          index / Chunk::CHUNK_SIZE_SQRED,
+        };
+        glm::ivec3 wpos = ChunkHelpers::LocalPosToWorldPos(local, cpos);
+
+        switch (job.chunk->BlockTypeAtNoLock(int(index)))
+        {
+        case BlockType::bSand: TickSand(ctx, wpos); break;
+        case BlockType::bWater: TickWater(ctx, wpos); break;
+        case BlockType::bGrass: TickGrass(ctx, wpos); break;
+        case BlockType::bDirt: TickDirt(ctx, wpos); break;
+        default: break;
+        }
+      }
+    }
+  }
+
+  BlockTicker::BlockTicker(VoxelManager& vm)
+    : voxelManager_(vm)
+  {
+  }
+
+  void BlockTicker::ScheduleTick(const glm::ivec3& wpos)
+  {
+    auto p = ChunkHelpers::WorldPosToLocalPos(wpos);
+    if (Chunk* chunk = voxelManager_.GetChunk(p.chunk_pos))
+    {
+      active_[chunk].push_back(static_cast<uint16_t>(
+        ChunkHelpers::IndexFrom3D(p.block_pos.x, p.block_pos.y, p.block_pos.z, Chunk::CHUNK_SIZE, Chunk::CHUNK_SIZE)));
+    }
+  }
+
+  void BlockTicker::ScheduleTickNear(const glm::ivec3& wpos)
+  {
+    ScheduleTick(wpos);
+    for (const auto& dir : FACES)
+    {
+      ScheduleTick(wpos + dir);
+    }
+  }
+
+  void BlockTicker::Update()
+  {
+    float rate = tickRateCVar.Get();
+    if (rate <= 0 || timer_.Elapsed() < 1.0 / rate)
+    {
+      return;
+    }
+    timer_.Reset();
+    Tick();
+  }
+
+  void BlockTicker::Tick()
+  {
+    if (active_.empty())
+    {
+      return;
+    }
+
+    // blocks woken during this tick are scheduled for the next one
+    std::array<std::vector<ChunkTick>, 8> colours;
+    for (auto& [chunk, indices] : active_)
+    {
+      glm::ivec3 parity = chunk->GetPos() & 1;
+      colours[parity.x | parity.y << 1 | parity.z << 2].push_back({ .chunk = chunk, .indices = std::move(indices) });
+    }
+    active_.clear();
+
+    const uint32_t tick = tickCount_++;
+    for (auto& jobs : colours)
+    {
+      engine::Core::JobSystem::Get()->ForEach(jobs.begin(), jobs.end(), [this, tick](ChunkTick& job)
+        {
+          TickChunk(voxelManager_, job, tick);
+        });
+    }
+
+    std::vector<Chunk*> modified;
+    for (auto& jobs : colours)
+    {
+      for (auto& job : jobs)
+      {
+        for (const auto& wpos : job.woken)
+        {
+          ScheduleTick(wpos);
+        }
+        modified.insert(modified.end(), job.modified.begin(), job.modified.end());
+      }
+    }
+
+    std::sort(modified.begin(), modified.end());
+    modified.erase(std::unique(modified.begin(), modified.end()), modified.end());
+    for (Chunk* chunk : modified)
+    {
+      voxelManager_.UpdateChunk(chunk);
+    }
+  }
+
+  void BlockTicker::Clear()
+  {
+    active_.clear();
+  }
+}
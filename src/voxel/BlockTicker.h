@@ -0,0 +1,48 @@
+#pragma once
+#include <utility/Timer.h>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Voxels
+{
+  class VoxelManager;
+  struct Chunk;
+
+  // Simulates blocks that change over time. Sand and water fall, water runs off ledges,
+  // and grass spreads onto uncovered dirt (and turns back into dirt when covered).
+  //
+  // Only scheduled blocks are ticked, so the cost scales with the number of active blocks
+  // rather than the size of the world. A chunk is in the active set while it has scheduled blocks.
+  // Each tick, active chunks are split into 8 colours by the parity of their position. Chunks of
+  // the same colour are a whole chunk apart and a block's tick reaches at most 2 blocks away, so
+  // the chunks of a colour are ticked in parallel without touching the same blocks.
+  //
+  // A block that changes wakes itself and its neighbours for the next tick. Chunks whose blocks
+  // changed are remeshed once at the end of the tick. Ticks don't propagate light.
+  class BlockTicker
+  {
+  public:
+    BlockTicker(VoxelManager& vm);
+
+    // main thread only
+    void ScheduleTick(const glm::ivec3& wpos);
+    void ScheduleTickNear(const glm::ivec3& wpos); // the block and its 6 neighbours
+
+    // ticks if enough time has passed since the last tick. call once per frame on the main thread
+    void Update();
+    void Tick();
+    void Clear();
+
+    size_t GetActiveChunkCount() const { return active_.size(); }
+
+  private:
+    VoxelManager& voxelManager_;
+
+    // local indices of the blocks scheduled for the next tick in each active chunk. may contain duplicates
+    std::unordered_map<Chunk*, std::vector<uint16_t>> active_;
+    uint32_t tickCount_{};
+    Timer timer_;
+  };
+}
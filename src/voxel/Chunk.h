@@ -64,6 +64,12 @@ namespace Voxels
       mutex_.unlock();
     }
 
+    // blocks can be read with the NoLock functions for as long as the returned lock is held
+    [[nodiscard]] inline std::shared_lock<std::shared_mutex> LockShared() const
+    {
+      return std::shared_lock(mutex_);
+    }
+
     void BuildMesh()
     {
       mesh.BuildMesh();
@@ -0,0 +1,625 @@
+#include "vPCH.h"
+#include "ChunkLod.h"
+#include <voxel/Chunk.h>
+#include <voxel/ChunkHelpers.h>
+#include <voxel/ChunkMesh.h>
+#include <voxel/ChunkRenderer.h>
+#include <voxel/VoxelManager.h>
+#include <voxel/block.h>
+
+#include <engine/Shapes.h>
+#include <engine/core/StatMacros.h>
+
+#include <algorithm>
+#include <shared_mutex>
+
+DECLARE_GAUGE_STAT(PendingLodNodes, Voxels)
+DECLARE_COUNTER_STAT(LodMeshBytesUploaded, Voxels)
+
+namespace Voxels
+{
+  namespace
+  {
+    // nodes have as many cells as chunks have blocks, so their meshes can use the same encoding
+    constexpr int LOD_GRID_SIZE = Chunk::CHUNK_SIZE;
+    constexpr int LOD_GRID_CELLS = Chunk::CHUNK_SIZE_CUBED;
+  }
+
+  namespace detail
+  {
+    // stands in for the 2^k blocks it covers along each axis
+    struct LodCell
+    {
+      BlockType type = BlockType::bAir;
+      Light light = Light({ 0, 0, 0, 15 }); // places with nothing built yet are open sky
+
+      bool operator==(const LodCell&) const = default;
+    };
+
+    struct LodNode
+    {
+      uint32_t level{};
+      glm::ivec3 pos{}; // in nodes of this level
+
+      // written by the node's own build job, read by the jobs of its neighbours and parent
+      mutable std::shared_mutex gridMutex;
+      std::vector<LodCell> cells; // empty when every cell is uniformCell
+      LodCell uniformCell{};
+
+      // main thread only
+      bool dirty = false;  // the grid is out of date, rather than just the mesh
+      bool queued = false;
+      bool building = false;
+      bool built = false;  // at least once
+      bool ready = false;  // this node and every node below it have been built, so it can stand in for them
+      uint64_t bufferHandle = 0;
+
+      // written by the build job, read once it has finished
+      bool gridChanged = false;
+      std::vector<uint32_t> mesh;
+
+      LodCell CellAt(const glm::ivec3& p) const
+      {
+        return cells.empty() ? uniformCell : cells[ChunkHelpers::IndexFrom3D(p.x, p.y, p.z, LOD_GRID_SIZE, LOD_GRID_SIZE)];
+      }
+    };
+  }
+
+  namespace
+  {
+    using namespace detail;
+
+    // how far (in cells) from open space the sides of border cells get skirts
+    // a neighbour one level coarser can move the surface two of our cells away
+    constexpr int SKIRT_REACH = 2;
+
+    // AO_MAX on all four corners. cells are too coarse for AO to look right
+    constexpr uint32_t UNOCCLUDED_AO = 0xFF;
+
+    Visibility VisibilityOf(BlockType type)
+    {
+      return Block::PropertiesTable[uint16_t(type)].visibility;
+    }
+
+    glm::ivec3 OctantOffset(int octant)
+    {
+      return { octant & 1, (octant >> 1) & 1, octant >> 2 };
+    }
+
+    // Decides what a cell looks like from the 8 cells (or blocks) it covers.
+    // It's solid if at least half of them are, so thin walls and floors survive, and takes the most common
+    // type among those, with ties going to the higher block priority.
+    // Its light is the brightest of those that let light through, as that's what faces next to it see.
+    LodCell Vote(const LodCell (&samples)[8])
+    {
+      int solidCount = 0;
+      glm::u8vec4 light{ 0 };
+      for (const auto& sample : samples)
+      {
+        const Visibility visibility = VisibilityOf(sample.type);
+        solidCount += visibility != Visibility::Invisible;
+        if (visibility != Visibility::Opaque)
+        {
+          light = glm::max(light, sample.light.Get());
+        }
+      }
+
+      const bool solid = solidCount >= 4;
+      LodCell result{};
+      int bestCount = 0;
+      int bestPriority = 0;
+      for (const auto& sample : samples)
+      {
+        if ((VisibilityOf(sample.type) != Visibility::Invisible) != solid)
+        {
+          continue;
+        }
+
+        int count = 0;
+        for (const auto& other : samples)
+        {
+          count += other.type == sample.type;
+        }
+
+        const int priority = Block::PropertiesTable[uint16_t(sample.type)].priority;
+        if (count > bestCount || (count == bestCount && priority > bestPriority))
+        {
+          result.type = sample.type;
+          bestCount = count;
+          bestPriority = priority;
+        }
+      }
+
+      result.light = Light(light);
+      return result;
+    }
+  }
+
+  ChunkLodManager::ChunkLodManager(VoxelManager& manager)
+    : voxelManager(manager)
+  {
+  }
+
+
+  ChunkLodManager::~ChunkLodManager()
+  {
+    if (!voxelManager.chunkRenderer_)
+    {
+      return;
+    }
+
+    for (const auto& level : levels_)
+    {
+      for (const auto& node : level)
+      {
+        voxelManager.chunkRenderer_->FreeChunkMesh(node->bufferHandle);
+      }
+    }
+  }
+
+
+  void ChunkLodManager::MarkChunkDirty(const glm::ivec3& cpos)
+  {
+    // headless, so there is nothing to draw the LODs with
+    if (!voxelManager.chunkRenderer_)
+    {
+      return;
+    }
+
+    std::lock_guard lock(dirtyMutex_);
+    dirtyChunks_.push_back(cpos);
+  }
+
+
+  void ChunkLodManager::Update()
+  {
+    if (!voxelManager.chunkRenderer_)
+    {
+      return;
+    }
+
+    // the world's size isn't known until it has chunks
+    if (levels_[1].empty())
+    {
+      if (voxelManager.chunks_.empty())
+      {
+        return;
+      }
+      init();
+    }
+
+    {
+      std::lock_guard lock(dirtyMutex_);
+      for (const auto& cpos : dirtyChunks_)
+      {
+        if (auto* node = getNode(1, cpos / 2))
+        {
+          markDirty(node, true);
+        }
+      }
+      dirtyChunks_.clear();
+    }
+
+    builtQueue_.ForEach([this](LodNode* node) { finish(*node); }, 0);
+
+    std::erase_if(queued_, [this](LodNode* node)
+      {
+        if (!canBuild(*node))
+        {
+          return false;
+        }
+        submit(node);
+        return true;
+      });
+
+    SET_GAUGE_STAT(PendingLodNodes, queued_.size());
+  }
+
+
+  void ChunkLodManager::Destroy()
+  {
+    destroying_ = true;
+    engine::Core::JobSystem::Get()->Wait(lodJobs_);
+  }
+
+
+  void ChunkLodManager::init()
+  {
+    for (uint32_t level = 1; level <= MAX_LOD_LEVEL; level++)
+    {
+      const glm::ivec3 dims = (voxelManager.actualWorldDim_ + (1 << level) - 1) >> int(level);
+      levelDims_[level] = dims;
+      levels_[level].resize(dims.x * dims.y * dims.z);
+      for (int i = 0; i < int(levels_[level].size()); i++)
+      {
+        auto node = std::make_unique<LodNode>();
+        node->level = level;
+        node->pos =
+        {
+          i % dims.x,
+          (i / dims.x) % dims.y,
+          i / (dims.y * dims.x),
+        };
+        levels_[level][i] = std::move(node);
+      }
+    }
+  }
+
+
+  LodNode* ChunkLodManager::getNode(uint32_t level, const glm::ivec3& pos) const
+  {
+    if (level == 0 || level > MAX_LOD_LEVEL)
+    {
+      return nullptr;
+    }
+
+    const glm::ivec3& dims = levelDims_[level];
+    if (glm::any(glm::lessThan(pos, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(pos, dims)))
+    {
+      return nullptr;
+    }
+    return levels_[level][ChunkHelpers::IndexFrom3D(pos.x, pos.y, pos.z, dims.x, dims.y)].get();
+  }
+
+
+  void ChunkLodManager::markDirty(LodNode* node, bool grid)
+  {
+    node->dirty |= grid;
+    if (!node->queued)
+    {
+      node->queued = true;
+      queued_.push_back(node);
+    }
+  }
+
+
+  bool ChunkLodManager::canBuild(const LodNode& node) const
+  {
+    if (node.building)
+    {
+      return false;
+    }
+
+    if (!node.dirty || node.level == 1)
+    {
+      return true;
+    }
+
+    // let the children settle first, so the grid is only voted once from their newest grids
+    for (int octant = 0; octant < 8; octant++)
+    {
+      const LodNode* child = getNode(node.level - 1, node.pos * 2 + OctantOffset(octant));
+      if (child && (child->dirty || child->building))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  void ChunkLodManager::submit(LodNode* node)
+  {
+    const bool rebuildGrid = node->dirty;
+    node->dirty = false;
+    node->queued = false;
+    node->building = true;
+
+    engine::Core::JobSystem::Get()->Submit([this, node, rebuildGrid]
+      {
+        if (!destroying_)
+        {
+          buildNode(*node, rebuildGrid);
+        }
+        builtQueue_.Push(node);
+      }, &lodJobs_, engine::Core::JobPriority::LOW, "BuildLodNode");
+  }
+
+
+  void ChunkLodManager::finish(LodNode& node)
+  {
+    node.building = false;
+
+    auto& renderer = *voxelManager.chunkRenderer_;
+    renderer.FreeChunkMesh(node.bufferHandle);
+    node.bufferHandle = 0;
+    if (!node.mesh.empty())
+    {
+      const float size = float(Chunk::CHUNK_SIZE << node.level);
+      const glm::vec3 origin = glm::vec3(node.pos) * size;
+      node.bufferHandle = renderer.AllocChunkMesh(node.mesh, AABB(origin, origin + size), node.level);
+      ADD_COUNTER_STAT(LodMeshBytesUploaded, node.mesh.size() * sizeof(uint32_t));
+    }
+    node.mesh = {};
+    node.built = true;
+    updateReady(node);
+
+    // the parent is voted from this grid, and the neighbours mesh their borders against it
+    if (node.gridChanged)
+    {
+      if (auto* parent = getNode(node.level + 1, node.pos / 2))
+      {
+        markDirty(parent, true);
+      }
+
+      for (const auto& face : faces)
+      {
+        if (auto* neighbour = getNode(node.level, node.pos + face))
+        {
+          markDirty(neighbour, false);
+        }
+      }
+    }
+  }
+
+
+  void ChunkLodManager::updateReady(LodNode& node)
+  {
+    if (node.ready || !node.built)
+    {
+      return;
+    }
+
+    // level 1's children are chunks, which draw as soon as they're meshed
+    if (node.level > 1)
+    {
+      for (int octant = 0; octant < 8; octant++)
+      {
+        const LodNode* child = getNode(node.level - 1, node.pos * 2 + OctantOffset(octant));
+        if (child && !child->ready)
+        {
+          return;
+        }
+      }
+    }
+
+    node.ready = true;
+    voxelManager.chunkRenderer_->SetLodNodeReady(node.level, node.pos);
+    if (auto* parent = getNode(node.level + 1, node.pos / 2))
+    {
+      updateReady(*parent);
+    }
+  }
+
+
+  void ChunkLodManager::buildNode(LodNode& node, bool rebuildGrid)
+  {
+    PROFILE_SCOPE("BuildLodNode");
+
+    node.gridChanged = false;
+    if (rebuildGrid)
+    {
+      std::vector<LodCell> cells(LOD_GRID_CELLS);
+      if (node.level == 1)
+      {
+        voteFromChunks(node, cells.data());
+      }
+      else
+      {
+        voteFromChildren(node, cells.data());
+      }
+
+      // most nodes are all sky or all rock
+      const LodCell uniformCell = cells[0];
+      if (std::all_of(cells.begin(), cells.end(), [&](const LodCell& cell) { return cell == uniformCell; }))
+      {
+        cells = {};
+      }
+
+      std::unique_lock lock(node.gridMutex);
+      node.gridChanged = cells.empty() ? !(node.cells.empty() && node.uniformCell == uniformCell) : cells != node.cells;
+      node.cells = std::move(cells);
+      node.uniformCell = uniformCell;
+    }
+
+    node.mesh = meshNode(node);
+  }
+
+
+  void ChunkLodManager::voteFromChunks(const LodNode& node, LodCell* cells) const
+  {
+    constexpr int half = LOD_GRID_SIZE / 2;
+    for (int octant = 0; octant < 8; octant++)
+    {
+      const glm::ivec3 cellBase = OctantOffset(octant) * half;
+      const Chunk* chunk = voxelManager.find(node.pos * 2 + OctantOffset(octant));
+      if (chunk)
+      {
+        chunk->Lock();
+      }
+
+      for (int z = 0; z < half; z++)
+      {
+        for (int y = 0; y < half; y++)
+        {
+          for (int x = 0; x < half; x++)
+          {
+            const glm::ivec3 cell = cellBase + glm::ivec3(x, y, z);
+            LodCell& out = cells[ChunkHelpers::IndexFrom3D(cell.x, cell.y, cell.z, LOD_GRID_SIZE, LOD_GRID_SIZE)];
+            if (!chunk)
+            {
+              out = {};
+              continue;
+            }
+
+            LodCell samples[8];
+            for (int s = 0; s < 8; s++)
+            {
+              const Block block = chunk->BlockAtNoLock(glm::ivec3(x, y, z) * 2 + OctantOffset(s));
+              samples[s] = { block.GetType(), block.GetLight() };
+            }
+            out = Vote(samples);
+          }
+        }
+      }
+
+      if (chunk)
+      {
+        chunk->Unlock();
+      }
+    }
+  }
+
+
+  void ChunkLodManager::voteFromChildren(const LodNode& node, LodCell* cells) const
+  {
+    constexpr int half = LOD_GRID_SIZE / 2;
+    for (int octant = 0; octant < 8; octant++)
+    {
+      const glm::ivec3 cellBase = OctantOffset(octant) * half;
+      const LodNode* child = getNode(node.level - 1, node.pos * 2 + OctantOffset(octant));
+      std::shared_lock<std::shared_mutex> lock;
+      if (child)
+      {
+        lock = std::shared_lock(child->gridMutex);
+      }
+
+      for (int z = 0; z < half; z++)
+      {
+        for (int y = 0; y < half; y++)
+        {
+          for (int x = 0; x < half; x++)
+          {
+            const glm::ivec3 cell = cellBase + glm::ivec3(x, y, z);
+            LodCell& out = cells[ChunkHelpers::IndexFrom3D(cell.x, cell.y, cell.z, LOD_GRID_SIZE, LOD_GRID_SIZE)];
+            if (!child)
+            {
+              out = {};
+              continue;
+            }
+
+            LodCell samples[8];
+            for (int s = 0; s < 8; s++)
+            {
+              samples[s] = child->CellAt(glm::ivec3(x, y, z) * 2 + OctantOffset(s));
+            }
+            out = Vote(samples);
+          }
+        }
+      }
+    }
+  }
+
+
+  std::vector<uint32_t> ChunkLodManager::meshNode(const LodNode& node) const
+  {
+    // the node's own grid is only written by this job, so it's read without locking
+    const LodNode* neighbours[fCount]{};
+    std::shared_lock<std::shared_mutex> locks[fCount];
+    for (int f = 0; f < fCount; f++)
+    {
+      neighbours[f] = getNode(node.level, node.pos + faces[f]);
+      if (neighbours[f])
+      {
+        locks[f] = std::shared_lock(neighbours[f]->gridMutex);
+      }
+    }
+
+    auto inside = [](const glm::ivec3& p)
+    {
+      return glm::all(glm::greaterThanEqual(p, glm::ivec3(0))) && glm::all(glm::lessThan(p, glm::ivec3(LOD_GRID_SIZE)));
+    };
+
+    // p is next to the node through face if it's outside
+    auto cellAt = [&](const glm::ivec3& p, int face)
+    {
+      if (inside(p))
+      {
+        return node.CellAt(p);
+      }
+      if (!neighbours[face])
+      {
+        return LodCell{};
+      }
+      return neighbours[face]->CellAt(p - faces[face] * LOD_GRID_SIZE);
+    };
+
+    // finds open space in the node near p, for the light of the skirts on p
+    auto openNear = [&](const glm::ivec3& p, Light& light)
+    {
+      const glm::ivec3 low = glm::max(p - SKIRT_REACH, glm::ivec3(0));
+      const glm::ivec3 high = glm::min(p + SKIRT_REACH, glm::ivec3(LOD_GRID_SIZE - 1));
+      for (int z = low.z; z <= high.z; z++)
+      {
+        for (int y = low.y; y <= high.y; y++)
+        {
+          for (int x = low.x; x <= high.x; x++)
+          {
+            const LodCell cell = node.CellAt({ x, y, z });
+            if (VisibilityOf(cell.type) != Visibility::Opaque)
+            {
+              light = cell.light;
+              return true;
+            }
+          }
+        }
+      }
+      return false;
+    };
+
+    std::vector<uint32_t> mesh;
+    auto addQuad = [&](const glm::ivec3& p, int face, BlockType type, Light light, uint32_t flags)
+    {
+      // same header as chunk meshes, with the level in place of padding
+      if (mesh.empty())
+      {
+        const glm::ivec3 origin = node.pos * (Chunk::CHUNK_SIZE << node.level);
+        mesh.push_back(origin.x);
+        mesh.push_back(origin.y);
+        mesh.push_back(origin.z);
+        mesh.push_back(node.level);
+      }
+      mesh.push_back(EncodeQuad(glm::uvec3(p), face, static_cast<uint32_t>(type)) | flags);
+      mesh.push_back(EncodeQuadLight(light.raw, UNOCCLUDED_AO));
+    };
+
+    for (int i = 0; i < LOD_GRID_CELLS; i++)
+    {
+      const glm::ivec3 p
+      {
+        i % LOD_GRID_SIZE,
+        (i / LOD_GRID_SIZE) % LOD_GRID_SIZE,
+        i / (LOD_GRID_SIZE * LOD_GRID_SIZE)
+      };
+      const LodCell cell = node.CellAt(p);
+      const bool visible = VisibilityOf(cell.type) != Visibility::Invisible;
+      const bool border = glm::any(glm::equal(p, glm::ivec3(0))) || glm::any(glm::equal(p, glm::ivec3(LOD_GRID_SIZE - 1)));
+      if (!visible && !border)
+      {
+        continue;
+      }
+
+      for (int f = 0; f < fCount; f++)
+      {
+        const glm::ivec3 q = p + faces[f];
+        const bool outside = !inside(q);
+        const LodCell near = cellAt(q, f);
+
+        if (visible)
+        {
+          Light skirtLight;
+          if (ShouldMeshFace(cell.type, near.type, f == Top))
+          {
+            addQuad(p, f, cell.type, near.light, 0);
+          }
+          // outward skirt: the side of a cell near the surface, for when the neighbour's surface is drawn lower
+          else if (outside && openNear(p, skirtLight))
+          {
+            addQuad(p, f, cell.type, skirtLight, 0);
+          }
+        }
+
+        // inward skirt: the neighbour's face on our border, for when the neighbour is drawn without it
+        // it's a face of our cell that's moved back onto the border, so that it faces into the node
+        const int opposite = f ^ 1;
+        if (outside && VisibilityOf(near.type) != Visibility::Invisible && ShouldMeshFace(near.type, cell.type, opposite == Top))
+        {
+          addQuad(p, opposite, near.type, cell.light, QUAD_SHIFT_BIT);
+        }
+      }
+    }
+
+    return mesh;
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <utility/AtomicQueue.h>
+#include <engine/core/JobSystem.h>
+#include <glm/vec3.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Voxels
+{
+  class VoxelManager;
+
+  namespace detail
+  {
+    struct LodNode;
+    struct LodCell;
+  }
+
+  // Coarse meshes for distant parts of the world, arranged as an octree over chunks.
+  // A node at level k covers 2^k chunks along each axis with a grid of 32^3 cells that are each
+  // 2^k blocks wide. Level 1 cells are voted from the blocks they cover, and higher levels from the
+  // cells of the level below, so changing a block only rereads the chunks of one level 1 node.
+  // The grids cost about a seventh of the memory of the chunks they summarize.
+  //
+  // Node meshes use the chunk mesh format with the level in the header, so ChunkRenderer draws them
+  // with chunks and picks one level for each part of the world on the GPU (see compact_batch.cs).
+  // A node only replaces the levels below it once it and every node under it have been built, so
+  // distant chunks keep drawing while the nodes over them are still being built.
+  // Where neighbours are drawn at different levels, their surfaces don't line up. Each node meshes
+  // skirts on its borders to cover the cracks that opens: the sides of its cells near a surface,
+  // and the faces its neighbour's cells would have on the border.
+  class ChunkLodManager
+  {
+  public:
+    static constexpr uint32_t MAX_LOD_LEVEL = 3;
+
+    ChunkLodManager(VoxelManager& manager);
+    ~ChunkLodManager();
+
+    // thread-safe. the nodes over the chunk are rebuilt on a later Update
+    void MarkChunkDirty(const glm::ivec3& cpos);
+
+    // schedules rebuilds and uploads the meshes of finished ones. main thread only
+    void Update();
+
+    // waits for rebuilds in flight and drops their results
+    void Destroy();
+
+  private:
+    void init();
+    detail::LodNode* getNode(uint32_t level, const glm::ivec3& pos) const; // null outside of the world
+    void markDirty(detail::LodNode* node, bool grid);
+    bool canBuild(const detail::LodNode& node) const;
+    void submit(detail::LodNode* node);
+    void finish(detail::LodNode& node);
+    void updateReady(detail::LodNode& node);
+
+    // job side
+    void buildNode(detail::LodNode& node, bool rebuildGrid);
+    void voteFromChunks(const detail::LodNode& node, detail::LodCell* cells) const;
+    void voteFromChildren(const detail::LodNode& node, detail::LodCell* cells) const;
+    std::vector<uint32_t> meshNode(const detail::LodNode& node) const;
+
+    VoxelManager& voxelManager;
+    std::vector<std::unique_ptr<detail::LodNode>> levels_[MAX_LOD_LEVEL + 1]; // level 0 is the chunks themselves
+    glm::ivec3 levelDims_[MAX_LOD_LEVEL + 1]{};
+
+    std::vector<detail::LodNode*> queued_; // waiting for their children or a previous build
+    std::mutex dirtyMutex_;
+    std::vector<glm::ivec3> dirtyChunks_;
+
+    engine::Core::JobCounter lodJobs_;
+    std::atomic_bool destroying_{ false };
+    AtomicQueue<detail::LodNode*> builtQueue_;
+  };
+}
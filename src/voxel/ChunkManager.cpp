@@ -4,6 +4,7 @@
 #include "ChunkManager.h"
 #include "ChunkHelpers.h"
 #include <engine/utilities.h>
+#include <engine/core/StatMacros.h>
 
 #include <utility/Timer.h>
 #include "VoxelManager.h"
@@ -12,28 +13,48 @@
 #include <execution>
 #include <mutex>
 
+DECLARE_GAUGE_STAT(PendingMeshes, Voxels)
+
 namespace Voxels
 {
   ChunkManager::ChunkManager(VoxelManager& manager)
-    : voxelManager(manager)
+    : blockTicker_(manager), lodManager_(manager), voxelManager(manager)
   {
   }
 
 
   void ChunkManager::Destroy()
   {
-    mesherThreadPool_.stop(false);
+    // meshes that haven't started are skipped
+    destroying_ = true;
+    engine::Core::JobSystem::Get()->Wait(meshJobs_);
+    lodManager_.Destroy();
+    colliderQueue_.Destroy();
+    blockTicker_.Clear();
   }
 
 
   void ChunkManager::Init()
   {
-    mesherThreadPool_.resize(8);
+    destroying_ = false;
   }
 
 
   void ChunkManager::Update()
   {
+    const uint32_t pendingMeshes = pendingMeshes_.load(std::memory_order_relaxed);
+    SET_GAUGE_STAT(PendingMeshes, pendingMeshes);
+    PROFILE_COUNTER("PendingMeshes", pendingMeshes);
+    blockTicker_.Update();
+    bufferQueueGood_.ForEach([](Chunk* chunk) { chunk->BuildBuffers(); }, 0);
+    lodManager_.Update();
+    colliderQueue_.Update();
+  }
+
+
+  void ChunkManager::FinishMeshing()
+  {
+    engine::Core::JobSystem::Get()->Wait(meshJobs_);
     bufferQueueGood_.ForEach([](Chunk* chunk) { chunk->BuildBuffers(); }, 0);
   }
 
@@ -41,11 +62,18 @@ namespace Voxels
   void ChunkManager::UpdateChunk(Chunk* chunk)
   {
     ASSERT(chunk != nullptr);
-    mesherThreadPool_.push([chunk, this](int)
+    pendingMeshes_.fetch_add(1, std::memory_order_relaxed);
+    engine::Core::JobSystem::Get()->Submit([chunk, this]
       {
-        chunk->BuildMesh();
-        bufferQueueGood_.Push(chunk);
-      });
+        if (!destroying_)
+        {
+          chunk->BuildMesh();
+          bufferQueueGood_.Push(chunk);
+        }
+        pendingMeshes_.fetch_sub(1, std::memory_order_relaxed);
+      }, &meshJobs_, engine::Core::JobPriority::LOW, "BuildMesh");
+    colliderQueue_.Request(chunk);
+    lodManager_.MarkChunkDirty(chunk->GetPos());
   }
 
 
@@ -62,6 +90,7 @@ namespace Voxels
 
   void ChunkManager::UpdateBlock(const glm::ivec3& wpos, Block bl)
   {
+    PROFILE_SCOPE("UpdateBlock");
     ChunkHelpers::localpos p = ChunkHelpers::WorldPosToLocalPos(wpos);
     //BlockPtr block = Chunk::AtWorld(wpos);
     Block remBlock = voxelManager.GetBlock(p); // store state of removed block to update lighting
@@ -105,12 +134,15 @@ namespace Voxels
 
     std::sort(std::begin(lightModifiedSet), std::end(lightModifiedSet));
     lightModifiedSet.erase(std::unique(std::begin(lightModifiedSet), std::end(lightModifiedSet)), std::end(lightModifiedSet));
-    printf("Updating %d chunks\n", (int)lightModifiedSet.size());
+    spdlog::trace("Updating {} chunks", lightModifiedSet.size());
     for (auto mchunk : lightModifiedSet)
     {
       UpdateChunk(mchunk);
     }
 
+    // the changed block may start moving, or let its neighbours move
+    blockTicker_.ScheduleTickNear(wpos);
+
     // check if adjacent to opaque blocks in nearby chunks, then update those chunks if it is
     constexpr glm::ivec3 dirs[] =
     {
@@ -139,6 +171,12 @@ namespace Voxels
   }
 
 
+  void ChunkManager::ScheduleBlockTick(const glm::ivec3& wpos)
+  {
+    blockTicker_.ScheduleTick(wpos);
+  }
+
+
   void ChunkManager::ReloadAllChunks()
   {
     for (const auto& p : voxelManager.chunks_)
@@ -1,8 +1,12 @@
 #pragma once
 #include <voxel/Chunk.h>
 #include <voxel/block.h>
+#include <voxel/ColliderQueue.h>
+#include <voxel/BlockTicker.h>
+#include <voxel/ChunkLod.h>
 #include <utility/AtomicQueue.h>
-#include <ctpl/ctpl_stl.h>
+#include <engine/core/JobSystem.h>
+#include <atomic>
 
 namespace Voxels
 {
@@ -23,10 +27,12 @@ namespace Voxels
 
     // interaction
     void Update();
+    void FinishMeshing();
     void UpdateChunk(Chunk* chunk);
     void UpdateChunk(const glm::ivec3& wpos); // update chunk at block position
     void UpdateBlock(const glm::ivec3& wpos, Block bl);
     void UpdateBlockCheap(const glm::ivec3& wpos, Block block);
+    void ScheduleBlockTick(const glm::ivec3& wpos);
     void ReloadAllChunks(); // for when big things change
 
 
@@ -39,8 +45,13 @@ namespace Voxels
     void checkUpdateChunkNearBlock(const glm::ivec3& pos, const glm::ivec3& near);
 
     //AtomicQueue<Chunk*> mesherQueueGood_;
-    ctpl::thread_pool mesherThreadPool_;
+    engine::Core::JobCounter meshJobs_;
+    std::atomic_bool destroying_{ false };
+    std::atomic_uint32_t pendingMeshes_{ 0 }; // submitted and not yet built
     AtomicQueue<Chunk*> bufferQueueGood_;
+    ColliderQueue colliderQueue_;
+    BlockTicker blockTicker_;
+    ChunkLodManager lodManager_;
 
     // new light intensity to add
     std::vector<Chunk*> lightPropagateAdd(const glm::ivec3& wpos, Light nLight);
@@ -8,8 +8,9 @@
 
 #include <engine/gfx/Vertices.h>
 #include <engine/gfx/api/DynamicBuffer.h>
-#include <engine/Physics.h>
+#include <engine/gfx/SoftwareOcclusion.h>
 #include <engine/CVar.h>
+#include <engine/core/StatMacros.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -20,6 +21,8 @@
 
 #define DEBUG_ENCODING 1
 
+DECLARE_COUNTER_STAT(ChunkMeshBytesUploaded, Voxels)
+
 namespace Voxels
 {
   namespace detail
@@ -36,16 +39,22 @@ namespace Voxels
       std::vector<uint32_t> interleavedArr;
       uint32_t curIndex{};
 
-      Physics::MeshCollider tCollider{};
-      physx::PxRigidActor* tActor = nullptr;
+      // for CPU occlusion culling (held until buffers are sent to GPU)
+      std::vector<GFX::OccluderQuad> occluders;
+      ChunkConnectivity connectivity;
+      bool hasConnectivity = false; // whether the renderer has it. chunk copies made for meshing never do
+
 
       int64_t quadCount_ = 0;
       uint64_t bufferHandle = 0;
+      uint64_t occluderHandle = 0;
 
       std::shared_mutex mtx;
 
       void BuildBuffers();
       void BuildMesh();
+      void buildOccluders();
+      void buildConnectivity();
 
       void buildBlockFace(
         int face,
@@ -55,18 +64,6 @@ namespace Voxels
       int vertexFaceAO(const glm::vec3& lpos, const glm::vec3& cornerDir, const glm::vec3& norm);
     };
 
-    enum
-    {
-      Far,
-      Near,
-      Left,
-      Right,
-      Top,
-      Bottom,
-
-      fCount
-    };
-
     enum AOStrength
     {
       AO_0,
@@ -78,6 +75,48 @@ namespace Voxels
       AO_MAX = AO_3,
     };
 
+    // occluders smaller than this (in blocks) aren't worth rasterizing
+    constexpr int MIN_OCCLUDER_AREA = 64;
+
+    // blocks that can't be seen through. water is opaque, but drawn translucent
+    bool IsOccluder(BlockType type)
+    {
+      return type != BlockType::bWater && Block::PropertiesTable[uint16_t(type)].visibility == Visibility::Opaque;
+    }
+
+    // each row is added to a histogram of column heights, whose largest rectangle is found with a stack
+    static_assert(Chunk::CHUNK_SIZE == 32, "rows are 32 bit masks");
+    OccluderRect LargestRectangle(const uint32_t (&rows)[32])
+    {
+      OccluderRect best{};
+      int heights[Chunk::CHUNK_SIZE]{};
+      for (int v = 0; v < Chunk::CHUNK_SIZE; v++)
+      {
+        for (int u = 0; u < Chunk::CHUNK_SIZE; u++)
+        {
+          heights[u] = (rows[v] >> u) & 1 ? heights[u] + 1 : 0;
+        }
+
+        int stack[Chunk::CHUNK_SIZE + 1];
+        int top = 0;
+        for (int u = 0; u <= Chunk::CHUNK_SIZE; u++)
+        {
+          const int height = u < Chunk::CHUNK_SIZE ? heights[u] : 0;
+          while (top > 0 && heights[stack[top - 1]] >= height)
+          {
+            const int barHeight = heights[stack[--top]];
+            const int left = top > 0 ? stack[top - 1] + 1 : 0;
+            if (barHeight * (u - left) > best.Area())
+            {
+              best = { left, u, v - barHeight + 1, v + 1 };
+            }
+          }
+          stack[top++] = u;
+        }
+      }
+      return best;
+    }
+
     // counterclockwise from bottom right texture coordinates
     inline const glm::vec2 tex_corners[] =
     {
@@ -87,16 +126,6 @@ namespace Voxels
       { 0, 0 },
     };
 
-    inline const glm::ivec3 faces[6] =
-    {
-      { 0, 0, 1 }, // 'far' face    (+z direction)
-      { 0, 0,-1 }, // 'near' face   (-z direction)
-      {-1, 0, 0 }, // 'left' face   (-x direction)
-      { 1, 0, 0 }, // 'right' face  (+x direction)
-      { 0, 1, 0 }, // 'top' face    (+y direction)
-      { 0,-1, 0 }, // 'bottom' face (-y direction)
-    };
-
     void DecodeQuad(uint32_t encoded, glm::uvec3& blockPos, uint32_t& face, uint32_t& texIdx)
     {
       // decode vertex position
@@ -163,6 +192,27 @@ namespace Voxels
 
       return encoded;
     }
+
+
+    bool ShouldMeshFace(BlockType block, BlockType neighbor, bool neighborAbove)
+    {
+      // this block is water and other block isn't water and is above this block
+      if ((neighbor != BlockType::bWater && block == BlockType::bWater && neighborAbove) ||
+        Block::PropertiesTable[uint16_t(neighbor)].visibility > Visibility::Opaque)
+        return true;
+      // other block isn't air or water - don't add mesh
+      if (neighbor != BlockType::bAir && neighbor != BlockType::bWater)
+        return false;
+      // both blocks are water - don't add mesh
+      if (neighbor == BlockType::bWater && block == BlockType::bWater)
+        return false;
+      // this block is invisible - don't add mesh
+      if (Block::PropertiesTable[uint16_t(block)].visibility == Visibility::Invisible)
+        return false;
+
+      // if all tests are passed, generate this face of the block
+      return true;
+    }
   }
 
 
@@ -178,9 +228,29 @@ namespace Voxels
     }
     needsBuffering_ = false;
 
+    // headless, so there is nowhere to put the mesh
+    if (!voxelManager_->chunkRenderer_)
+    {
+      interleavedArr.clear();
+      interleavedArr.shrink_to_fit();
+      occluders.clear();
+      return;
+    }
+
     voxelManager_->chunkRenderer_->FreeChunkMesh(bufferHandle);
     bufferHandle = 0;
 
+    // solid chunks have no mesh, but are the best occluders
+    voxelManager_->chunkRenderer_->RemoveOccluders(occluderHandle);
+    occluderHandle = 0;
+    if (!occluders.empty())
+    {
+      occluderHandle = voxelManager_->chunkRenderer_->AddOccluders(occluders, parentChunk->GetAABB());
+      occluders.clear();
+    }
+    voxelManager_->chunkRenderer_->SetChunkConnectivity(parentChunk->GetPos(), connectivity);
+    hasConnectivity = true;
+
     // nothing emitted, don't try to make buffers
     if (quadCount_ == 0)
     {
@@ -188,14 +258,10 @@ namespace Voxels
     }
 
     bufferHandle = voxelManager_->chunkRenderer_->AllocChunkMesh(interleavedArr, parentChunk->GetAABB());
+    ADD_COUNTER_STAT(ChunkMeshBytesUploaded, interleavedArr.size() * sizeof(interleavedArr[0]));
 
     interleavedArr.clear();
-    tCollider.vertices.clear();
-    tCollider.indices.clear();
-
     interleavedArr.shrink_to_fit();
-    tCollider.vertices.shrink_to_fit();
-    tCollider.indices.shrink_to_fit();
   }
 
   void detail::ChunkMeshData::BuildMesh()
@@ -206,8 +272,6 @@ namespace Voxels
     // clear everything in case this function is called twice in a row
     quadCount_ = 0;
     interleavedArr.clear();
-    tCollider.vertices.clear();
-    tCollider.indices.clear();
 
     // make a copy of each of the parent and neighboring chunks so that they can be read without being updating while we mesh
     parentChunk->Lock();
@@ -229,7 +293,7 @@ namespace Voxels
     interleavedArr.push_back(ap.x);
     interleavedArr.push_back(ap.y);
     interleavedArr.push_back(ap.z);
-    interleavedArr.push_back(0xDEADBEEF); // necessary padding
+    interleavedArr.push_back(0); // LOD level (see ChunkLod.h)
 
     for (size_t i = 0; i < Chunk::CHUNK_SIZE_CUBED; i++)
     {
@@ -252,13 +316,9 @@ namespace Voxels
       }
     }
 
+    buildOccluders();
+    buildConnectivity();
 
-    Physics::PhysicsManager::RemoveActorGeneric(tActor);
-
-    tActor = reinterpret_cast<physx::PxRigidActor*>(
-      Physics::PhysicsManager::AddStaticActorGeneric(
-        Physics::MaterialType::TERRAIN, tCollider,
-        glm::translate(glm::mat4(1), glm::vec3(parentCopy->GetPos() * Chunk::CHUNK_SIZE))));
 
     for (int i = 0; i < fCount; i++)
     {
@@ -270,6 +330,133 @@ namespace Voxels
   }
 
 
+  // Finds the largest solid rectangle in any cross-section of the chunk along each axis.
+  // Quads are put in the middle of their layer of blocks, so they're inside solid space from every side.
+  void detail::ChunkMeshData::buildOccluders()
+  {
+    occluders.clear();
+    const glm::vec3 origin = glm::vec3(parentCopy->GetPos() * Chunk::CHUNK_SIZE);
+    for (int axis = 0; axis < 3; axis++)
+    {
+      const int uAxis = (axis + 1) % 3;
+      const int vAxis = (axis + 2) % 3;
+      OccluderRect best{};
+      int bestSlice = 0;
+      for (int slice = 0; slice < Chunk::CHUNK_SIZE; slice++)
+      {
+        uint32_t rows[Chunk::CHUNK_SIZE]{};
+        glm::ivec3 p{};
+        p[axis] = slice;
+        for (p[vAxis] = 0; p[vAxis] < Chunk::CHUNK_SIZE; p[vAxis]++)
+        {
+          for (p[uAxis] = 0; p[uAxis] < Chunk::CHUNK_SIZE; p[uAxis]++)
+          {
+            if (IsOccluder(parentCopy->BlockTypeAtNoLock(p)))
+            {
+              rows[p[vAxis]] |= 1u << p[uAxis];
+            }
+          }
+        }
+
+        if (const OccluderRect rect = LargestRectangle(rows); rect.Area() > best.Area())
+        {
+          best = rect;
+          bestSlice = slice;
+        }
+      }
+
+      if (best.Area() < MIN_OCCLUDER_AREA)
+      {
+        continue;
+      }
+
+      GFX::OccluderQuad quad;
+      const int us[4] = { best.u0, best.u1, best.u1, best.u0 };
+      const int vs[4] = { best.v0, best.v0, best.v1, best.v1 };
+      for (int i = 0; i < 4; i++)
+      {
+        glm::vec3 corner{};
+        corner[axis] = bestSlice + 0.5f;
+        corner[uAxis] = static_cast<float>(us[i]);
+        corner[vAxis] = static_cast<float>(vs[i]);
+        quad.corners[i] = origin + corner;
+      }
+      occluders.push_back(quad);
+    }
+  }
+
+
+  // Flood fills the blocks that can be seen through, and connects every pair of faces that one region touches.
+  void detail::ChunkMeshData::buildConnectivity()
+  {
+    constexpr int SIZE = Chunk::CHUNK_SIZE;
+    connectivity = {};
+
+    std::vector<bool> open(Chunk::CHUNK_SIZE_CUBED);
+    int openCount = 0;
+    for (int i = 0; i < Chunk::CHUNK_SIZE_CUBED; i++)
+    {
+      open[i] = !IsOccluder(parentCopy->BlockTypeAtNoLock(i));
+      openCount += open[i];
+    }
+
+    if (openCount == 0)
+    {
+      return;
+    }
+    if (openCount == Chunk::CHUNK_SIZE_CUBED)
+    {
+      connectivity = ChunkConnectivity::Open();
+      return;
+    }
+
+    // blocks are cleared from open as they're visited
+    std::vector<int> stack;
+    for (int start = 0; start < Chunk::CHUNK_SIZE_CUBED; start++)
+    {
+      if (!open[start])
+      {
+        continue;
+      }
+
+      uint8_t touched = 0;
+      open[start] = false;
+      stack.push_back(start);
+      while (!stack.empty())
+      {
+        const int index = stack.back();
+        stack.pop_back();
+        const glm::ivec3 p{ index % SIZE, (index / SIZE) % SIZE, index / (SIZE * SIZE) };
+
+        for (int face = 0; face < fCount; face++)
+        {
+          const glm::ivec3 next = p + faces[face];
+          if (glm::any(glm::lessThan(next, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(next, glm::ivec3(SIZE))))
+          {
+            touched |= 1 << face;
+            continue;
+          }
+
+          const int nextIndex = ChunkHelpers::IndexFrom3D(next.x, next.y, next.z, SIZE, SIZE);
+          if (open[nextIndex])
+          {
+            open[nextIndex] = false;
+            stack.push_back(nextIndex);
+          }
+        }
+      }
+
+      for (int face = 0; face < fCount; face++)
+      {
+        if ((touched >> face) & 1)
+        {
+          connectivity.faces[face] |= touched;
+        }
+      }
+    }
+  }
+
+
   void detail::ChunkMeshData::buildBlockFace(
     int face,
     const glm::ivec3& blockPos,  // position of current block
@@ -304,25 +491,10 @@ namespace Voxels
     Light light = block2.GetLight();
     //Light light = nearChunk->LightAtCheap(nearblock.block_pos);
 
-    // this block is water and other block isn't water and is above this block
-    if ((block2.GetType() != BlockType::bWater && block == BlockType::bWater && (nearblock.block_pos - blockPos).y > 0) ||
-      Block::PropertiesTable[block2.GetTypei()].visibility > Visibility::Opaque)
+    if (ShouldMeshFace(block, block2.GetType(), (nearblock.block_pos - blockPos).y > 0))
     {
       addQuad(blockPos, block, face, nearChunk, light);
-      return;
     }
-    // other block isn't air or water - don't add mesh
-    if (block2.GetType() != BlockType::bAir && block2.GetType() != BlockType::bWater)
-      return;
-    // both blocks are water - don't add mesh
-    if (block2.GetType() == BlockType::bWater && block == BlockType::bWater)
-      return;
-    // this block is invisible - don't add mesh
-    if (Block::PropertiesTable[uint16_t(block)].visibility == Visibility::Invisible)
-      return;
-
-    // if all tests are passed, generate this face of the block
-    addQuad(blockPos, block, face, nearChunk, light);
   }
 
   void detail::ChunkMeshData::addQuad(const glm::ivec3& lpos, BlockType block, int face, [[maybe_unused]] const Chunk* nearChunk, Light light)
@@ -336,12 +508,8 @@ namespace Voxels
     uint32_t endQuad = (face + 1) * 12;
     for (uint32_t i = face * 12, vertexIndex = 0; i < endQuad; i += 3, vertexIndex++) // cindex = corner index
     {
-      // transform vertices relative to chunk
+      // corner of the face relative to the block
       glm::vec3 vert(data[i + 0], data[i + 1], data[i + 2]);
-      glm::uvec3 finalVert = glm::ceil(vert) + glm::vec3(lpos);// +0.5f;
-
-      tCollider.vertices.push_back(glm::vec3(finalVert));
-
       uint32_t vertexAO = AO_MIN;
       if (true) // TODO: make this an option in the future
       {
@@ -350,25 +518,9 @@ namespace Voxels
       aoValues |= vertexAO << (2 * vertexIndex);
     }
 
-    constexpr uint32_t indicesA[6] = { 0, 1, 3, 3, 1, 2 }; // normal indices
-    //constexpr uint32_t indicesB[6] = { 0, 1, 2, 2, 3, 0 }; // anisotropy fix (flip tris)
-    //const uint32_t* indicesC = indicesA;
-    // partially solve anisotropy issue
-    // UPDATED: no need, as we now do bilinear interpolation
-    //if (aoValues[0] + aoValues[2] > aoValues[1] + aoValues[3])
-    //{
-    //  indicesC = indicesB;
-    //}
-    
     // compress attributes into 32 bits
     interleavedArr.push_back(detail::EncodeQuad(lpos, normalIdx, texIdx));
     interleavedArr.push_back(detail::EncodeQuadLight(light.raw, aoValues));
-    for (int i = 0; i < 6; i++)
-    {
-      //tCollider.indices.push_back(curIndex + indicesA[i]);
-      //indices.push_back(curIndex + indicesA[i]);
-      tCollider.indices.push_back(indicesA[i] + tCollider.vertices.size() - (tCollider.vertices.size() % 4) - 4);
-    }
   }
 
 
@@ -415,10 +567,14 @@ namespace Voxels
 
   ChunkMesh::~ChunkMesh()
   {
-    data->voxelManager_->chunkRenderer_->FreeChunkMesh(data->bufferHandle);
-    if (data->tActor)
+    if (data->voxelManager_->chunkRenderer_)
     {
-      Physics::PhysicsManager::RemoveActorGeneric(data->tActor);
+      data->voxelManager_->chunkRenderer_->FreeChunkMesh(data->bufferHandle);
+      data->voxelManager_->chunkRenderer_->RemoveOccluders(data->occluderHandle);
+      if (data->hasConnectivity)
+      {
+        data->voxelManager_->chunkRenderer_->RemoveChunkConnectivity(data->parentChunk->GetPos());
+      }
     }
     delete data;
   }
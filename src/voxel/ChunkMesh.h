@@ -1,14 +1,81 @@
 #pragma once
+#include <glm/vec3.hpp>
+#include <cstdint>
 
 namespace Voxels
 {
   struct Chunk;
   class VoxelManager;
+  enum class BlockType : uint16_t;
+
   namespace detail
   {
     struct ChunkMeshData;
+
+    enum
+    {
+      Far,
+      Near,
+      Left,
+      Right,
+      Top,
+      Bottom,
+
+      fCount
+    };
+
+    inline const glm::ivec3 faces[6] =
+    {
+      { 0, 0, 1 }, // 'far' face    (+z direction)
+      { 0, 0,-1 }, // 'near' face   (-z direction)
+      {-1, 0, 0 }, // 'left' face   (-x direction)
+      { 1, 0, 0 }, // 'right' face  (+x direction)
+      { 0, 1, 0 }, // 'top' face    (+y direction)
+      { 0,-1, 0 }, // 'bottom' face (-y direction)
+    };
+
+    // set on a quad to draw it one cell further along -normal (see chunk_optimized.vs)
+    // LOD meshes use this to place faces of a neighbour's cells on their own border
+    constexpr uint32_t QUAD_SHIFT_BIT = 1u << 28;
+
+    // shared by chunk and LOD meshing
+    uint32_t EncodeQuad(const glm::uvec3& blockPos, uint32_t normalIdx, uint32_t texIdx);
+    uint32_t EncodeQuadLight(uint32_t lightEncoding, uint32_t ao);
+
+    // whether block has a visible face towards neighbor
+    bool ShouldMeshFace(BlockType block, BlockType neighbor, bool neighborAbove);
+
+    // a rectangle of blocks in a cross-section of a chunk, [u0, u1) x [v0, v1)
+    struct OccluderRect
+    {
+      int u0{}, u1{}, v0{}, v1{};
+
+      int Area() const { return (u1 - u0) * (v1 - v0); }
+    };
+
+    // largest rectangle of set bits, where bit u of rows[v] is the block at (u, v). used to pick occluders
+    OccluderRect LargestRectangle(const uint32_t (&rows)[32]);
   }
 
+  // which faces of a chunk can see each other through the blocks inside it, for connectivity culling (see ChunkRenderer)
+  struct ChunkConnectivity
+  {
+    uint8_t faces[detail::fCount]{}; // bit b of faces[a] is set if face a is connected to face b
+
+    bool Connected(int a, int b) const { return (faces[a] >> b) & 1; }
+
+    // what's assumed of chunks that haven't been meshed
+    static ChunkConnectivity Open()
+    {
+      ChunkConnectivity open;
+      for (auto& face : open.faces)
+      {
+        face = (1 << detail::fCount) - 1;
+      }
+      return open;
+    }
+  };
+
   class ChunkMesh
   {
   public:
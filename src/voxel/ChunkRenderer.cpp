@@ -3,6 +3,8 @@
 #include "ChunkRenderer.h"
 
 #include <engine/gfx/Frustum.h>
+#include <engine/gfx/MultiViewCull.h>
+#include <engine/gfx/SoftwareOcclusion.h>
 #include <engine/gfx/resource/ShaderManager.h>
 #include <engine/gfx/resource/TextureManager.h>
 #include <engine/gfx/TextureLoader.h>
@@ -18,8 +20,14 @@
 #include <engine/CVar.h>
 #include <engine/Shapes.h>
 #include <engine/core/Statistics.h>
+#include <engine/core/JobSystem.h>
+#include <engine/utilities.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <map>
+#include <numeric>
+#include <tuple>
 #include <imgui/imgui.h>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -32,8 +40,18 @@ AutoCVar<cvar_float> drawOcclusionVolumesCVar("v.drawOcclusionVolumes", "- If en
 AutoCVar<cvar_float> anisotropyCVar("v.anisotropy", "- Level of anisotropic filtering to apply to voxels", 16, 1, 16);
 AutoCVar<cvar_float> lowQualityCullDistance("v.lowQualityCullDistance", "- Maximum distance at which chunks for low quality cameras should render", 100);
 AutoCVar<cvar_float> sampleWithAA("v.sampleWithAA", "- Use AA'd texture filtering", 0, 0, 1);
+AutoCVar<cvar_float> lodDistanceCVar("v.lodDistance", "- Distance at which chunks are replaced by 2x downsampled meshes. Each coarser level starts twice as far. 0 disables LODs, and anything else is at least 56", 256, 0, 10000);
+AutoCVar<cvar_float> softwareOcclusionCVar("v.softwareOcclusion", "- If enabled, chunks are occlusion culled on the CPU before drawing, rather than against the previous frame's depth", 1, 0, 1);
+AutoCVar<cvar_float> occluderDistanceCVar("v.occluderDistance", "- Distance within which chunks are rasterized as occluders for CPU occlusion culling", 192, 0, 2000);
+AutoCVar<cvar_float> connectivityCullingCVar("v.connectivityCulling", "- If enabled, chunks that can't be seen through the chunks between them and the camera are culled", 1, 0, 1);
+AutoCVar<cvar_float> validateCullingCVar("v.validateCulling", "- If enabled, reads back the GPU's chunk draw lists every frame and logs where they differ from culling on the CPU", 0, 0, 1, CVarFlag::CHEAT);
+AutoCVar<cvar_float> lodLevelsCVar("v.lodLevels", "- Number of LOD levels to draw beyond full detail chunks", 3, 0, 3);
 
 DECLARE_FLOAT_STAT(DrawVoxelsAll, GPU)
+DECLARE_FLOAT_STAT(DrawVisibleChunks, GPU)
+DECLARE_FLOAT_STAT(GenerateDIB, GPU)
+DECLARE_FLOAT_STAT(CullConnectivity, CPU)
+DECLARE_FLOAT_STAT(CullOcclusionSoftware, CPU)
 
 static GFX::Anisotropy getAnisotropy(cvar_float val)
 {
@@ -64,6 +82,155 @@ static std::vector<std::string> GetBlockTexturePaths(std::string_view type, std:
 
 namespace Voxels
 {
+  namespace
+  {
+    // matches CullView in cull.h.glsl
+    struct GPUCullView
+    {
+      glm::vec4 planes[5];
+      glm::vec4 position;
+      float minDistance;
+      float maxDistance;
+      uint32_t disableOcclusionCulling;
+      uint32_t softwareOcclusion;
+      uint32_t cpuVisibility;
+      uint32_t _pad01;
+      uint32_t _pad02;
+      uint32_t _pad03;
+    };
+
+    // matches Sector in cull.h.glsl
+    struct GPUSector
+    {
+      AABB16 box;
+      uint32_t firstChunk;
+      uint32_t chunkCount;
+      uint32_t _pad00;
+      uint32_t _pad01;
+    };
+
+    // sectors are cubes of SECTOR_SIZE^3 chunks
+    // SECTOR_SIZE^3 must not exceed the workgroup size of compact_batch.cs (64), as each workgroup handles one sector
+    constexpr int SECTOR_SIZE = 4;
+    constexpr uint32_t MAX_SECTOR_CHUNKS = 64;
+
+    // resolution of the CPU occlusion buffer. it's stretched over the view, whatever its aspect ratio
+    constexpr uint32_t OCCLUSION_BUFFER_WIDTH = 256;
+    constexpr uint32_t OCCLUSION_BUFFER_HEIGHT = 128;
+
+    // nearest occluders first, up to this many quads
+    constexpr size_t MAX_OCCLUDER_QUADS = 4096;
+
+    // see compact_batch.cs
+    constexpr uint32_t QUAD_SIZE = sizeof(uint32_t) * 2;
+    constexpr uint32_t RESERVED_BYTES = 16;
+    constexpr uint32_t LOD_SELF_READY = 1;
+    constexpr uint32_t LOD_PARENT_READY = 2;
+
+    // closer than the half diagonal of a level 1 node, one could be drawn around the camera
+    // coarser levels are twice as big and start twice as far, so they're fine when level 1 is
+    constexpr float MIN_LOD_DISTANCE = Chunk::CHUNK_SIZE * 1.7320508f; // sqrt(3)
+
+    float GetLodDistance()
+    {
+      const float lodDistance = lodDistanceCVar.Get();
+      return lodDistance > 0 ? std::max(lodDistance, MIN_LOD_DISTANCE) : 0;
+    }
+
+    // LOD nodes that can be drawn, by level
+    using LodNodeSet = std::unordered_set<glm::ivec3, Utils::ivec3Hash>;
+
+    // which of the nodes a mesh belongs to and its parent are ready. compact_batch.cs reads this from max.w
+    uint32_t GetLodReadyFlags(const AABB16& box, std::span<const LodNodeSet> readyNodes)
+    {
+      auto isReady = [readyNodes](uint32_t level, const glm::ivec3& nodePos)
+      {
+        return level == 0 || (level < readyNodes.size() && readyNodes[level].contains(nodePos));
+      };
+
+      const auto lod = static_cast<uint32_t>(box.min.w);
+      const glm::ivec3 nodePos(glm::floor(glm::vec3(box.min) / float(Chunk::CHUNK_SIZE << lod)));
+      const glm::ivec3 parentPos(glm::floor(glm::vec3(nodePos) / 2.0f));
+      return (isReady(lod, nodePos) ? LOD_SELF_READY : 0) | (isReady(lod + 1, parentPos) ? LOD_PARENT_READY : 0);
+    }
+
+    // same test as compact_batch.cs, which ignores the near plane
+    bool IntersectsFrustum(const GFX::Frustum& frustum, const AABB& box)
+    {
+      for (int p = 0; p < 5; p++)
+      {
+        const glm::vec4 plane = frustum.GetPlane(static_cast<GFX::Frustum::Plane>(p));
+        const glm::vec3 farthest = glm::mix(box.min, box.max, glm::greaterThan(glm::vec3(plane), glm::vec3(0)));
+        if (glm::dot(glm::vec3(plane), farthest) + plane.w <= 0)
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // same as SelectLod in compact_batch.cs
+    bool SelectLod(const AABB16& box, const glm::vec3& viewPos, float lodDistance, uint32_t maxLod)
+    {
+      const auto lod = static_cast<uint32_t>(box.min.w);
+      const auto ready = static_cast<uint32_t>(box.max.w);
+      if (lodDistance <= 0)
+        return lod == 0;
+      if (!(ready & LOD_SELF_READY))
+        return false;
+
+      auto lodStart = [lodDistance](uint32_t level) { return lodDistance * float(1u << (level - 1)); };
+      const float nodeSize = float(Chunk::CHUNK_SIZE << lod);
+      const bool farEnough = lod == 0 || glm::distance(glm::vec3(box.min) + nodeSize / 2.0f, viewPos) >= lodStart(lod);
+      if (lod >= maxLod)
+        return lod == maxLod && farEnough;
+
+      const glm::vec3 parentMin = glm::floor(glm::vec3(box.min) / (nodeSize * 2.0f)) * (nodeSize * 2.0f);
+      const bool parentTooClose = glm::distance(parentMin + nodeSize, viewPos) < lodStart(lod + 1);
+      return farEnough && (parentTooClose || !(ready & LOD_PARENT_READY));
+    }
+
+    // groups live allocations by the sector containing their center
+    template<typename Allocs>
+    void BuildSectors(const Allocs& allocs, std::vector<GPUSector>& sectors, std::vector<uint32_t>& sectorChunks)
+    {
+      sectors.clear();
+      sectorChunks.clear();
+
+      std::map<std::tuple<int, int, int>, std::vector<uint32_t>> chunksBySector;
+      for (uint32_t i = 0; i < allocs.size(); i++)
+      {
+        if (allocs[i].handle == 0)
+          continue;
+
+        const glm::vec3 center = (glm::vec3(allocs[i].userdata.min) + glm::vec3(allocs[i].userdata.max)) / 2.0f;
+        const glm::ivec3 sector(glm::floor(center / float(Chunk::CHUNK_SIZE * SECTOR_SIZE)));
+        chunksBySector[{ sector.x, sector.y, sector.z }].push_back(i);
+      }
+
+      for (const auto& [key, chunks] : chunksBySector)
+      {
+        // overlapping allocations can overfill a sector, so split it
+        for (size_t first = 0; first < chunks.size(); first += MAX_SECTOR_CHUNKS)
+        {
+          const size_t count = std::min<size_t>(MAX_SECTOR_CHUNKS, chunks.size() - first);
+          GPUSector sector{};
+          sector.box.min = glm::vec4(std::numeric_limits<float>::max());
+          sector.box.max = glm::vec4(std::numeric_limits<float>::lowest());
+          sector.firstChunk = static_cast<uint32_t>(sectorChunks.size());
+          sector.chunkCount = static_cast<uint32_t>(count);
+          for (size_t c = first; c < first + count; c++)
+          {
+            sector.box.min = glm::min(sector.box.min, allocs[chunks[c]].userdata.min);
+            sector.box.max = glm::max(sector.box.max, allocs[chunks[c]].userdata.max);
+            sectorChunks.push_back(chunks[c]);
+          }
+          sectors.push_back(sector);
+        }
+      }
+    }
+  }
+
   struct ChunkRendererStorage
   {
     std::unique_ptr<GFX::DebugDrawableBuffer<AABB16>> verticesAllocator;
@@ -71,16 +238,45 @@ namespace Voxels
 
     GLuint chunkVao{};
 
-    struct ViewData
+    // views with the same render mask are culled together and share these buffers
+    struct ViewGroupData
     {
-      std::optional<GFX::Buffer> drawIndirectBuffer;
-      std::optional<GFX::Buffer> drawCountParameterBuffer;
+      std::optional<GFX::Buffer> drawIndirectBuffer; // viewCapacity draw lists, each commandsPerView long
+      std::optional<GFX::Buffer> drawCountParameterBuffer; // one draw count per view
+      std::optional<GFX::Buffer> cullViewBuffer;
+      std::optional<GFX::Buffer> visibleSectorBuffer; // indirect dispatch args followed by the sectors that passed culling
+      std::optional<GFX::Buffer> cpuVisibilityBuffer; // a mask of views per allocation, from the CPU visibility passes
+      uint32_t viewCapacity{};
+      uint32_t commandsPerView{};
+      uint32_t sectorCapacity{};
+      uint32_t cpuVisibilityCapacity{};
     };
+    std::vector<ViewGroupData> viewGroups;
 
-    std::unordered_map<GFX::RenderView*, ViewData> perViewData;
+    // where each view's draw list lives
+    struct ViewSlot
+    {
+      uint32_t group{};
+      uint32_t index{};
+    };
+    std::unordered_map<GFX::RenderView*, ViewSlot> viewSlots;
+
+    // chunks grouped into sectors for hierarchical culling, rebuilt when the allocator changes
+    std::optional<GFX::Buffer> sectorBuffer;
+    std::optional<GFX::Buffer> sectorChunkBuffer;
+    uint32_t sectorCount{};
+    std::vector<GPUSector> sectors; // CPU copies, for validating culling
+    std::vector<uint32_t> sectorChunks;
+
+    // the allocations as uploaded, with LOD ready flags filled in
+    std::vector<GFX::DynamicBuffer<AABB16>::allocationData<AABB16>> drawAllocs;
+    std::vector<LodNodeSet> readyLodNodes;
+
+    // padding draw lists to this many commands keeps each one's offset valid for SSBO binding
+    const uint32_t commandAlignment = 256 / sizeof(DrawArraysIndirectCommand);
 
     // size of compute shader workgroup
-    const int workGroupSize = 64; // defined in compact_batch.cs
+    const int workGroupSize = 64; // defined in compact_batch.cs and cull_sectors.cs
 
     GLuint occlusionVao{};
     std::optional<GFX::Buffer> occlusionDib;
@@ -90,6 +286,21 @@ namespace Voxels
     bool dirtyAlloc = true;
     std::optional<GFX::Buffer> vertexAllocBuffer;
 
+    // CPU occlusion culling
+    struct OccluderSet
+    {
+      AABB box;
+      std::vector<GFX::OccluderQuad> quads;
+    };
+    std::unordered_map<uint64_t, OccluderSet> occluderSets;
+    uint64_t nextOccluderHandle = 1;
+    GFX::OcclusionBuffer occlusionBuffer{ OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT };
+
+    // connectivity culling. the bounds only grow
+    std::unordered_map<glm::ivec3, ChunkConnectivity, Utils::ivec3Hash> connectivity;
+    glm::ivec3 connectivityMin{ std::numeric_limits<int>::max() };
+    glm::ivec3 connectivityMax{ std::numeric_limits<int>::lowest() };
+
     // resources
     std::optional<GFX::Texture> blockDiffuseTextures;
     std::optional<GFX::Texture> blockNormalTextures;
@@ -125,11 +336,14 @@ namespace Voxels
         :::::::::::BUFFER FORMAT:::::::::::*/
     glCreateVertexArrays(1, &data->chunkVao);
     glEnableVertexArrayAttrib(data->chunkVao, 0); // chunk position (one per instance)
+    glEnableVertexArrayAttrib(data->chunkVao, 1); // LOD level, in the chunk position's padding
     
     // stride is sizeof(vertex) so baseinstance can be set to cmd.first and work (hopefully)
     glVertexArrayAttribIFormat(data->chunkVao, 0, 3, GL_INT, 0);
+    glVertexArrayAttribIFormat(data->chunkVao, 1, 1, GL_UNSIGNED_INT, 3 * sizeof(uint32_t));
 
     glVertexArrayAttribBinding(data->chunkVao, 0, 0);
+    glVertexArrayAttribBinding(data->chunkVao, 1, 0);
     glVertexArrayBindingDivisor(data->chunkVao, 0, 1);
 
     glVertexArrayVertexBuffer(data->chunkVao, 0, data->verticesAllocator->GetID(), 0, 2 * sizeof(uint32_t));
@@ -158,10 +372,15 @@ namespace Voxels
     std::vector<std::string_view> texsNormalView(texsNormal.begin(), texsNormal.end());
     std::vector<std::string_view> texsPBRView(texsPBR.begin(), texsPBR.end());
     std::vector<std::string_view> texsEmissiveView(texsEmissive.begin(), texsEmissive.end());
-    data->blockDiffuseTextures = GFX::LoadTexture2DArray(texsDiffuseView);
-    data->blockNormalTextures = GFX::LoadTexture2DArray(texsNormalView, 0, 0, GFX::Format::R8G8B8_UNORM);
-    data->blockPBRTextures = GFX::LoadTexture2DArray(texsPBRView, 0, 0, GFX::Format::R8G8B8A8_UNORM);
-    data->blockEmissiveTextures = GFX::LoadTexture2DArray(texsEmissiveView, 0, 0, GFX::Format::R8G8B8_SRGB);
+    // all four decode at once
+    auto diffuseLoad = GFX::LoadTexture2DArrayAsync(texsDiffuseView);
+    auto normalLoad = GFX::LoadTexture2DArrayAsync(texsNormalView, 0, 0, GFX::Format::R8G8B8_UNORM);
+    auto pbrLoad = GFX::LoadTexture2DArrayAsync(texsPBRView, 0, 0, GFX::Format::R8G8B8A8_UNORM);
+    auto emissiveLoad = GFX::LoadTexture2DArrayAsync(texsEmissiveView, 0, 0, GFX::Format::R8G8B8_SRGB);
+    data->blockDiffuseTextures = diffuseLoad.Get();
+    data->blockNormalTextures = normalLoad.Get();
+    data->blockPBRTextures = pbrLoad.Get();
+    data->blockEmissiveTextures = emissiveLoad.Get();
     data->blockDiffuseTexturesView = GFX::TextureView::Create(*data->blockDiffuseTextures);
     data->blockNormalTexturesView = GFX::TextureView::Create(*data->blockNormalTextures);
     data->blockPBRTexturesView = GFX::TextureView::Create(*data->blockPBRTextures);
@@ -182,10 +401,6 @@ namespace Voxels
 
     ss.asBitField.magFilter = GFX::Filter::NEAREST;
     data->isotropicNearestSampler = GFX::TextureSampler::Create(ss);
-
-    //engine::Core::StatisticsManager::Get()->RegisterFloatStat("DrawVoxelsAll", "GPU");
-    engine::Core::StatisticsManager::Get()->RegisterFloatStat("DrawVisibleChunks", "GPU");
-    engine::Core::StatisticsManager::Get()->RegisterFloatStat("GenerateDIB", "GPU");
   }
 
   ChunkRenderer::~ChunkRenderer()
@@ -229,22 +444,19 @@ namespace Voxels
     GFX::DebugMarker marker("Draw voxels");
     MEASURE_GPU_TIMER_STAT(DrawVoxelsAll);
 
-    // init data for newly-created cameras
-    for (auto& renderView : renderViews)
+    if (softwareOcclusionCVar.Get() != 0)
     {
-      if (!(renderView->mask & GFX::RenderMaskBit::RenderVoxels))
-        continue;
-
-      if (!data->perViewData.contains(renderView))
-      {
-        data->perViewData[renderView].drawCountParameterBuffer = GFX::Buffer::Create(sizeof(uint32_t), GFX::BufferFlag::NONE);
-      }
+      // visibility is known before anything is drawn, so this frame's draw lists can be used right away
+      GenerateDrawIndirectBuffer(renderViews);
+      RenderVisibleChunks(renderViews);
+    }
+    else
+    {
+      RenderVisibleChunks(renderViews);
+      GenerateDrawIndirectBuffer(renderViews);
+      RenderOcclusion(renderViews);
+      //RenderDisoccludedThisFrame(renderViews);
     }
-
-    RenderVisibleChunks(renderViews);
-    GenerateDrawIndirectBuffer(renderViews);
-    RenderOcclusion(renderViews);
-    //RenderDisoccludedThisFrame(renderViews);
   }
 
   void ChunkRenderer::RenderVisibleChunks(std::span<GFX::RenderView*> renderViews)
@@ -294,9 +506,10 @@ namespace Voxels
       if (!(renderView->mask & GFX::RenderMaskBit::RenderVoxels))
         continue;
       
-      auto& [drawIndirectBuffer, parameterBuffer] = data->perViewData[renderView];
-      if (!drawIndirectBuffer)
+      auto slot = data->viewSlots.find(renderView);
+      if (slot == data->viewSlots.end())
         continue;
+      const auto& group = data->viewGroups[slot->second.group];
 
       // we don't need as much quality for probe views
       //if (renderView->mask & GFX::RenderMaskBit::RenderVoxelsNear)
@@ -322,9 +535,11 @@ namespace Voxels
       currShader->SetVec3("u_viewpos", renderView->camera->viewInfo.position);
       currShader->SetMat4("u_viewProj", renderView->camera->GetViewProj());
 
-      drawIndirectBuffer->Bind<GFX::Target::DRAW_INDIRECT_BUFFER>();
-      parameterBuffer->Bind<GFX::Target::PARAMETER_BUFFER>();
-      glMultiDrawArraysIndirectCount(GL_TRIANGLES, 0, 0, data->activeAllocs, 0);
+      const size_t commandsOffset = slot->second.index * group.commandsPerView * sizeof(DrawArraysIndirectCommand);
+      group.drawIndirectBuffer->Bind<GFX::Target::DRAW_INDIRECT_BUFFER>();
+      group.drawCountParameterBuffer->Bind<GFX::Target::PARAMETER_BUFFER>();
+      glMultiDrawArraysIndirectCount(GL_TRIANGLES, reinterpret_cast<void*>(commandsOffset), slot->second.index * sizeof(uint32_t),
+        std::min<GLsizei>(data->activeAllocs, group.commandsPerView), 0);
       glTextureBarrier();
     }
 
@@ -346,65 +561,153 @@ namespace Voxels
     if (freezeCullingCVar.Get())
       return;
 
-    auto sdr = GFX::ShaderManager::GetShader("compact_batch");
-    sdr->Bind();
-    sdr->SetFloat("u_cullMinDist", cullDistanceMinCVar.Get());
-    sdr->SetFloat("u_cullMaxDist", cullDistanceMaxCVar.Get());
-    sdr->SetUInt("u_reservedBytes", 16);
-    sdr->SetUInt("u_quadSize", sizeof(uint32_t) * 2);
+    auto sectorShader = GFX::ShaderManager::GetShader("cull_sectors");
+    auto chunkShader = GFX::ShaderManager::GetShader("compact_batch");
+    chunkShader->SetUInt("u_reservedBytes", RESERVED_BYTES);
+    chunkShader->SetUInt("u_quadSize", QUAD_SIZE);
+    chunkShader->SetFloat("u_lodDistance", GetLodDistance());
+    chunkShader->SetUInt("u_maxLod", static_cast<uint32_t>(lodLevelsCVar.Get()));
+    chunkShader->SetUInt("u_chunkSize", Chunk::CHUNK_SIZE);
     const auto& vertexAllocs = data->verticesAllocator->GetAllocs();
-    uint32_t numWorkGroups = (vertexAllocs.size() + data->workGroupSize - 1) / data->workGroupSize;
 
     if (data->dirtyAlloc)
     {
-      data->vertexAllocBuffer = GFX::Buffer::Create(std::span(vertexAllocs), GFX::BufferFlag::NONE);
+      data->drawAllocs.assign(vertexAllocs.begin(), vertexAllocs.end());
+      for (auto& alloc : data->drawAllocs)
+      {
+        alloc.userdata.max.w = static_cast<float>(GetLodReadyFlags(alloc.userdata, data->readyLodNodes));
+      }
+      data->vertexAllocBuffer = GFX::Buffer::Create(std::span(data->drawAllocs), GFX::BufferFlag::NONE);
       data->verticesAllocator->GenDrawData();
-    }
 
-    data->vertexAllocBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(0);
+      BuildSectors(vertexAllocs, data->sectors, data->sectorChunks);
+      data->sectorBuffer = GFX::Buffer::Create(std::span(data->sectors), GFX::BufferFlag::NONE);
+      data->sectorChunkBuffer = GFX::Buffer::Create(std::span(data->sectorChunks), GFX::BufferFlag::NONE);
+      data->sectorCount = static_cast<uint32_t>(data->sectors.size());
+    }
 
-    for (auto& renderView : renderViews)
+    const uint32_t activeAllocs = std::max<uint32_t>(data->verticesAllocator->ActiveAllocs(), 1);
+    const uint32_t commandsPerView = (activeAllocs + data->commandAlignment - 1) / data->commandAlignment * data->commandAlignment;
+    chunkShader->SetUInt("u_commandsPerView", commandsPerView);
+    sectorShader->SetUInt("u_sectorCount", data->sectorCount);
+
+    const bool softwareOcclusion = softwareOcclusionCVar.Get() != 0;
+    const bool connectivityCulling = connectivityCullingCVar.Get() != 0;
+    const bool cpuVisibility = softwareOcclusion || connectivityCulling;
+    const bool validateCulling = validateCullingCVar.Get() != 0;
+    std::vector<uint32_t> cpuVisibleMasks;
+
+    // cull every chunk against all views in a group at once
+    // whole sectors are culled first, then only chunks in visible sectors are tested
+    auto groups = GFX::GroupViewsByMask(renderViews, GFX::RenderMaskBit::RenderVoxels);
+    data->viewGroups.resize(std::max(data->viewGroups.size(), groups.size()));
+    data->viewSlots.clear();
+    for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++)
     {
-      if (!(renderView->mask & GFX::RenderMaskBit::RenderVoxels))
-        continue;
+      const auto& views = groups[groupIndex].views;
+      const auto viewCount = static_cast<uint32_t>(views.size());
+      auto& group = data->viewGroups[groupIndex];
 
-      if (renderView->mask & GFX::RenderMaskBit::RenderVoxelsNear)
+      // only re-construct if the allocator has changed or the group has outgrown its buffers
+      if (!group.drawIndirectBuffer || group.viewCapacity < viewCount || group.commandsPerView != commandsPerView)
       {
-        sdr->SetBool("u_disableOcclusionCulling", true);
-        sdr->SetFloat("u_lowQualityCullDistance", lowQualityCullDistance.Get());
+        group.viewCapacity = std::max(group.viewCapacity, viewCount);
+        group.commandsPerView = commandsPerView;
+        group.drawIndirectBuffer = GFX::Buffer::Create(group.viewCapacity * commandsPerView * sizeof(DrawArraysIndirectCommand));
+        group.drawCountParameterBuffer = GFX::Buffer::Create(group.viewCapacity * sizeof(uint32_t));
+        group.cullViewBuffer = GFX::Buffer::Create(group.viewCapacity * sizeof(GPUCullView), GFX::BufferFlag::DYNAMIC_STORAGE);
       }
-      else
+      if (!group.visibleSectorBuffer || group.sectorCapacity < data->sectorCount)
       {
-        sdr->SetBool("u_disableOcclusionCulling", false);
+        group.sectorCapacity = data->sectorCount;
+        group.visibleSectorBuffer = GFX::Buffer::Create((group.sectorCapacity + 1) * sizeof(glm::uvec4), GFX::BufferFlag::DYNAMIC_STORAGE);
       }
 
-      auto& [drawIndirectBuffer, parameterBuffer] = data->perViewData[renderView];
+      std::vector<GPUCullView> cullViews(viewCount);
+      std::vector<GFX::CullView> referenceViews;
+      for (uint32_t i = 0; i < viewCount; i++)
+      {
+        auto* renderView = views[i];
+        auto& cullView = cullViews[i];
+        GFX::Frustum fr(renderView->camera->projInfo.GetProjMatrix(), renderView->camera->viewInfo.GetViewMatrix());
+        for (int p = 0; p < 5; p++) // ignore near plane
+        {
+          cullView.planes[p] = fr.GetPlane(static_cast<GFX::Frustum::Plane>(p));
+        }
+        cullView.position = glm::vec4(renderView->camera->viewInfo.position, 0);
+        cullView.minDistance = cullDistanceMinCVar.Get();
+        cullView.maxDistance = cullDistanceMaxCVar.Get();
+        cullView.disableOcclusionCulling = false;
+        if (renderView->mask & GFX::RenderMaskBit::RenderVoxelsNear)
+        {
+          cullView.maxDistance = std::min<float>(cullView.maxDistance, lowQualityCullDistance.Get());
+          cullView.disableOcclusionCulling = true;
+        }
+        cullView.softwareOcclusion = softwareOcclusion && !cullView.disableOcclusionCulling;
+        cullView.cpuVisibility = cpuVisibility;
+        if (validateCulling)
+        {
+          referenceViews.push_back({ fr, glm::vec3(cullView.position), cullView.minDistance, cullView.maxDistance });
+        }
+
+        data->viewSlots[renderView] = { .group = groupIndex, .index = i };
+      }
+      group.cullViewBuffer->SubData(std::span(cullViews), 0);
 
-      // set uniforms for chunk rendering
-      sdr->SetVec3("u_viewpos", renderView->camera->viewInfo.position);
-      GFX::Frustum fr(renderView->camera->projInfo.GetProjMatrix(), renderView->camera->viewInfo.GetViewMatrix());
-      for (int i = 0; i < 5; i++) // ignore near plane
+      if (cpuVisibility)
       {
-        std::string uname = "u_viewfrustum.data_[" + std::to_string(i) + "][0]";
-        sdr->Set1FloatArray(hashed_string(uname.c_str()), std::span<float, 4>(fr.GetData()[i]));
+        // connectivity first, so that occlusion only tests what's left
+        cpuVisibleMasks.assign(std::max<size_t>(vertexAllocs.size(), 1), ~0u);
+        if (connectivityCulling)
+        {
+          CullConnectivity(views, cpuVisibleMasks);
+        }
+        if (softwareOcclusion)
+        {
+          CullOcclusionSoftware(views, cpuVisibleMasks);
+        }
+
+        if (!group.cpuVisibilityBuffer || group.cpuVisibilityCapacity < cpuVisibleMasks.size())
+        {
+          group.cpuVisibilityCapacity = static_cast<uint32_t>(cpuVisibleMasks.size());
+          group.cpuVisibilityBuffer = GFX::Buffer::Create(group.cpuVisibilityCapacity * sizeof(uint32_t), GFX::BufferFlag::DYNAMIC_STORAGE);
+        }
+        group.cpuVisibilityBuffer->SubData(std::span(cpuVisibleMasks), 0);
       }
 
-      //constexpr uint32_t zero = 0;
-      //parameterBuffer->SubData(std::span(&zero, 1), 0);
       uint32_t zero{ 0 };
-      glClearNamedBufferSubData(parameterBuffer->GetAPIHandle(), GL_R32UI, 0,
-        sizeof(GLuint), GL_RED, GL_UNSIGNED_INT, &zero);
-
-      // only re-construct if allocator has been modified
-      if (data->dirtyAlloc)
+      glClearNamedBufferSubData(group.drawCountParameterBuffer->GetAPIHandle(), GL_R32UI, 0,
+        viewCount * sizeof(GLuint), GL_RED, GL_UNSIGNED_INT, &zero);
+      const glm::uvec4 dispatchArgs{ 0, 1, 1, 0 };
+      group.visibleSectorBuffer->SubData(std::span(&dispatchArgs, 1), 0);
+
+      group.cullViewBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(3);
+      data->sectorBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(4);
+      group.visibleSectorBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(5);
+
+      // phase 1: sectors
+      sectorShader->Bind();
+      sectorShader->SetUInt("u_viewCount", viewCount);
+      glDispatchCompute((data->sectorCount + data->workGroupSize - 1) / data->workGroupSize, 1, 1);
+      glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+      // phase 2: chunks in visible sectors, one workgroup per sector
+      chunkShader->Bind();
+      data->vertexAllocBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(0);
+      group.drawIndirectBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(1);
+      group.drawCountParameterBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(2);
+      data->sectorChunkBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(6);
+      if (cpuVisibility)
       {
-        drawIndirectBuffer = GFX::Buffer::Create(data->verticesAllocator->ActiveAllocs() * sizeof(DrawArraysIndirectCommand));
+        group.cpuVisibilityBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(7);
       }
+      group.visibleSectorBuffer->Bind<GFX::Target::DISPATCH_INDIRECT_BUFFER>();
+      glDispatchComputeIndirect(0);
 
-      drawIndirectBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(1);
-      parameterBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(2);
-
-      glDispatchCompute(numWorkGroups, 1, 1);
+      if (validateCulling)
+      {
+        ValidateCulling(groupIndex, referenceViews, cpuVisibility ? std::span<const uint32_t>(cpuVisibleMasks) : std::span<const uint32_t>());
+      }
     }
 
     if (data->dirtyAlloc)
@@ -417,6 +720,235 @@ namespace Voxels
     data->activeAllocs = data->verticesAllocator->ActiveAllocs();
   }
 
+  void ChunkRenderer::CullConnectivity(std::span<GFX::RenderView* const> views, std::vector<uint32_t>& visibleMasks)
+  {
+    PROFILE_SCOPE("CullConnectivity");
+    MEASURE_CPU_TIMER_STAT(CullConnectivity);
+
+    if (data->connectivity.empty())
+    {
+      return;
+    }
+
+    const auto& allocs = data->verticesAllocator->GetAllocs();
+    for (uint32_t v = 0; v < views.size(); v++)
+    {
+      // these views only draw what's nearby, so they're cheap enough without it
+      if (views[v]->mask & GFX::RenderMaskBit::RenderVoxelsNear)
+      {
+        continue;
+      }
+
+      const GFX::Camera& camera = *views[v]->camera;
+      const GFX::Frustum frustum(camera.projInfo.GetProjMatrix(), camera.viewInfo.GetViewMatrix());
+      const glm::ivec3 cameraChunk(glm::floor(camera.viewInfo.position / static_cast<float>(Chunk::CHUNK_SIZE)));
+
+      // paths never turn back along an axis, so a path from the camera to a meshed chunk stays in the box around both
+      const int radius = static_cast<int>(cullDistanceMaxCVar.Get() / Chunk::CHUNK_SIZE) + 1;
+      const glm::ivec3 low = glm::max(glm::min(data->connectivityMin, cameraChunk), cameraChunk - radius);
+      const glm::ivec3 high = glm::min(glm::max(data->connectivityMax, cameraChunk), cameraChunk + radius);
+      const glm::ivec3 dims = high - low + 1;
+      if (glm::any(glm::lessThanEqual(dims, glm::ivec3(0))))
+      {
+        continue;
+      }
+
+      // a chunk can be entered once through each of its faces, as that changes where it leads
+      // bit fCount marks the camera's chunk, which is entered from everywhere
+      std::vector<uint8_t> entered(dims.x * dims.y * dims.z);
+      auto index = [&](const glm::ivec3& cpos)
+      {
+        const glm::ivec3 p = cpos - low;
+        return ChunkHelpers::IndexFrom3D(p.x, p.y, p.z, dims.x, dims.y);
+      };
+
+      struct Step
+      {
+        glm::ivec3 cpos;
+        int entryFace;
+        uint8_t directions; // faces passed through since leaving the camera's chunk
+      };
+      std::vector<Step> queue;
+      queue.push_back({ cameraChunk, detail::fCount, 0 });
+      entered[index(cameraChunk)] = 1 << detail::fCount;
+
+      for (size_t head = 0; head < queue.size(); head++)
+      {
+        const Step step = queue[head];
+        auto it = data->connectivity.find(step.cpos);
+        const ChunkConnectivity connectivity = it != data->connectivity.end() ? it->second : ChunkConnectivity::Open();
+
+        for (int face = 0; face < detail::fCount; face++)
+        {
+          // faces come in opposing pairs
+          const int opposite = face ^ 1;
+          if ((step.directions >> opposite) & 1)
+          {
+            continue;
+          }
+          if (step.entryFace != detail::fCount && !connectivity.Connected(step.entryFace, face))
+          {
+            continue;
+          }
+
+          const glm::ivec3 next = step.cpos + detail::faces[face];
+          if (glm::any(glm::lessThan(next, low)) || glm::any(glm::greaterThan(next, high)))
+          {
+            continue;
+          }
+          uint8_t& nextEntered = entered[index(next)];
+          if ((nextEntered >> opposite) & 1)
+          {
+            continue;
+          }
+          const AABB box(glm::vec3(next * Chunk::CHUNK_SIZE), glm::vec3((next + 1) * Chunk::CHUNK_SIZE));
+          if (!IntersectsFrustum(frustum, box))
+          {
+            continue;
+          }
+
+          nextEntered |= 1 << opposite;
+          queue.push_back({ next, opposite, static_cast<uint8_t>(step.directions | (1 << face)) });
+        }
+      }
+
+      const uint32_t viewBit = 1u << v;
+      for (size_t i = 0; i < allocs.size(); i++)
+      {
+        // LOD meshes are left visible. they're far enough away that there's little to save
+        const AABB16& box = allocs[i].userdata;
+        if (allocs[i].handle == 0 || box.min.w != 0)
+        {
+          continue;
+        }
+
+        const glm::ivec3 cpos(glm::floor(glm::vec3(box.min) / static_cast<float>(Chunk::CHUNK_SIZE)));
+        const bool inBounds = glm::all(glm::greaterThanEqual(cpos, low)) && glm::all(glm::lessThanEqual(cpos, high));
+        if (!inBounds || entered[index(cpos)] == 0)
+        {
+          visibleMasks[i] &= ~viewBit;
+        }
+      }
+    }
+  }
+
+  void ChunkRenderer::CullOcclusionSoftware(std::span<GFX::RenderView* const> views, std::vector<uint32_t>& visibleMasks)
+  {
+    PROFILE_SCOPE("CullOcclusionSoftware");
+    MEASURE_CPU_TIMER_STAT(CullOcclusionSoftware);
+
+    const auto& allocs = data->verticesAllocator->GetAllocs();
+    std::vector<uint32_t> allocIndices(allocs.size());
+    std::iota(allocIndices.begin(), allocIndices.end(), 0);
+
+    for (uint32_t v = 0; v < views.size(); v++)
+    {
+      const uint32_t viewBit = 1u << v;
+
+      // same as compact_batch.cs, these views skip occlusion culling
+      if (views[v]->mask & GFX::RenderMaskBit::RenderVoxelsNear)
+      {
+        continue;
+      }
+
+      // nearby occluders hide the most, so they go first if there are too many
+      const GFX::Camera& camera = *views[v]->camera;
+      const float occluderDistance = occluderDistanceCVar.Get();
+      std::vector<std::pair<float, uint64_t>> nearbySets;
+      for (const auto& [handle, set] : data->occluderSets)
+      {
+        const float dist = glm::distance((set.box.min + set.box.max) / 2.0f, camera.viewInfo.position);
+        if (dist < occluderDistance)
+        {
+          nearbySets.emplace_back(dist, handle);
+        }
+      }
+      std::sort(nearbySets.begin(), nearbySets.end());
+
+      std::vector<GFX::OccluderQuad> quads;
+      for (const auto& [dist, handle] : nearbySets)
+      {
+        const auto& setQuads = data->occluderSets[handle].quads;
+        if (quads.size() + setQuads.size() > MAX_OCCLUDER_QUADS)
+        {
+          break;
+        }
+        quads.insert(quads.end(), setQuads.begin(), setQuads.end());
+      }
+
+      auto& buffer = data->occlusionBuffer;
+      buffer.Begin(camera.GetViewProj());
+      buffer.RasterizeOccluders(quads);
+
+      engine::Core::JobSystem::Get()->ForEach(allocIndices.begin(), allocIndices.end(), [&](uint32_t i)
+        {
+          // allocations that were already culled aren't worth testing
+          if (allocs[i].handle != 0 && (visibleMasks[i] & viewBit) && !buffer.IsVisible(AABB(allocs[i].userdata)))
+          {
+            visibleMasks[i] &= ~viewBit;
+          }
+        });
+    }
+  }
+
+  void ChunkRenderer::ValidateCulling(uint32_t groupIndex, std::span<const GFX::CullView> views, std::span<const uint32_t> visibleMasks)
+  {
+    const auto& group = data->viewGroups[groupIndex];
+    const auto& allocs = data->drawAllocs;
+    const auto viewCount = static_cast<uint32_t>(views.size());
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    std::vector<uint32_t> drawCounts(viewCount);
+    glGetNamedBufferSubData(group.drawCountParameterBuffer->GetAPIHandle(), 0, viewCount * sizeof(uint32_t), drawCounts.data());
+    std::vector<DrawArraysIndirectCommand> commands(viewCount * group.commandsPerView);
+    glGetNamedBufferSubData(group.drawIndirectBuffer->GetAPIHandle(), 0, commands.size() * sizeof(DrawArraysIndirectCommand), commands.data());
+
+    std::vector<AABB> boxes(allocs.size());
+    for (size_t i = 0; i < allocs.size(); i++)
+    {
+      boxes[i] = AABB(allocs[i].userdata);
+    }
+    std::vector<GFX::CullSector> sectors;
+    for (const auto& sector : data->sectors)
+    {
+      sectors.push_back({ AABB(sector.box), sector.firstChunk, sector.chunkCount });
+    }
+    std::vector<GFX::ViewVisibilityMask> masks(allocs.size());
+    GFX::CullMultiViewHierarchical(sectors, data->sectorChunks, boxes, views, masks);
+
+    const float lodDistance = GetLodDistance();
+    const auto maxLod = static_cast<uint32_t>(lodLevelsCVar.Get());
+    for (uint32_t v = 0; v < viewCount; v++)
+    {
+      // draws are identified by their base instance, which is unique to each allocation
+      std::unordered_set<uint32_t> expected;
+      for (size_t i = 0; i < allocs.size(); i++)
+      {
+        // same filters as compact_batch.cs
+        if (!(masks[i] & (1u << v)) || allocs[i].handle == 0 || allocs[i].size <= QUAD_SIZE * RESERVED_BYTES)
+          continue;
+        if (!visibleMasks.empty() && !(visibleMasks[i] & (1u << v)))
+          continue;
+        if (!SelectLod(allocs[i].userdata, views[v].position, lodDistance, maxLod))
+          continue;
+        expected.insert(static_cast<uint32_t>(allocs[i].offset / QUAD_SIZE));
+      }
+
+      size_t extra = 0;
+      const uint32_t drawCount = std::min(drawCounts[v], group.commandsPerView);
+      for (uint32_t c = 0; c < drawCount; c++)
+      {
+        extra += expected.erase(commands[v * group.commandsPerView + c].baseInstance) == 0;
+      }
+
+      if (!expected.empty() || extra != 0)
+      {
+        spdlog::warn("Culling mismatch in view {} of group {}: {} chunks missing from the GPU's draw list, {} extra",
+          v, groupIndex, expected.size(), extra);
+      }
+    }
+  }
+
   void ChunkRenderer::RenderOcclusion(std::span<GFX::RenderView*> renderViews)
   {
     GFX::DebugMarker marker("Draw occlusion volumes");
@@ -450,7 +982,11 @@ namespace Voxels
         continue;
       }
 
-      auto& [drawIndirectBuffer, parameterBuffer] = data->perViewData[renderView];
+      auto slot = data->viewSlots.find(renderView);
+      if (slot == data->viewSlots.end())
+        continue;
+      const auto& group = data->viewGroups[slot->second.group];
+      const size_t commandsSize = group.commandsPerView * sizeof(DrawArraysIndirectCommand);
 
       GFX::SetViewport(renderView->renderInfo);
       ASSERT(renderView->renderInfo.depthAttachment.has_value());
@@ -468,14 +1004,15 @@ namespace Voxels
       glBindBuffer(GL_SHADER_STORAGE_BUFFER, data->verticesAllocator->GetID());
       glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, data->verticesAllocator->GetID());
 
-      drawIndirectBuffer->Bind<GFX::Target::SHADER_STORAGE_BUFFER>(1);
+      group.drawIndirectBuffer->BindRange<GFX::Target::SHADER_STORAGE_BUFFER>(1, slot->second.index * commandsSize, commandsSize);
 
       // copy # of chunks being drawn (parameter buffer) to instance count (DIB)
       data->occlusionDib->Bind<GFX::Target::DRAW_INDIRECT_BUFFER>();
       //glBindBuffer(GL_DRAW_INDIRECT_BUFFER, data->occlusionDib);
       glBindVertexArray(data->occlusionVao);
       constexpr GLint offset = offsetof(DrawArraysIndirectCommand, instanceCount);
-      glCopyNamedBufferSubData(parameterBuffer->GetAPIHandle(), data->occlusionDib->GetAPIHandle(), 0, offset, sizeof(uint32_t));
+      glCopyNamedBufferSubData(group.drawCountParameterBuffer->GetAPIHandle(), data->occlusionDib->GetAPIHandle(),
+        slot->second.index * sizeof(uint32_t), offset, sizeof(uint32_t));
       //glCopyNamedBufferSubData(parameterBuffer->GetAPIHandle(), data->occlusionDib, 0, offset, sizeof(uint32_t));
       glDrawArraysIndirect(GL_TRIANGLE_STRIP, 0);
     }
@@ -505,8 +1042,12 @@ namespace Voxels
     ASSERT(0); // not implemented
   }
 
-  uint64_t ChunkRenderer::AllocChunkMesh(std::span<uint32_t> vertices, const AABB& aabb)
+  uint64_t ChunkRenderer::AllocChunkMesh(std::span<uint32_t> vertices, const AABB& aabb, uint32_t lodLevel)
   {
+    // compact_batch.cs reads the level from min.w, and the ready flags from max.w, which are filled in on upload
+    AABB16 box(aabb);
+    box.min.w = static_cast<float>(lodLevel);
+
     uint64_t vertexBufferHandle{};
 
     // free oldest allocations until there is enough space to allocate this buffer
@@ -517,7 +1058,7 @@ namespace Voxels
     //{
     //  data->verticesAllocator->FreeOldest();
     //}
-    vertexBufferHandle = data->verticesAllocator->Allocate(vertices.data(), vertices.size() * sizeof(GLint), aabb);
+    vertexBufferHandle = data->verticesAllocator->Allocate(vertices.data(), vertices.size() * sizeof(GLint), box);
     if (!vertexBufferHandle)
     {
       data->verticesAllocator->Free(vertexBufferHandle);
@@ -526,10 +1067,35 @@ namespace Voxels
 
     data->vertexAllocHandles.emplace(vertexBufferHandle);
     data->dirtyAlloc = true;
+    GFX::Renderer::NotifyProbeSceneChange(aabb);
 
     return vertexBufferHandle;
   }
 
+  uint64_t ChunkRenderer::AddOccluders(std::span<const GFX::OccluderQuad> quads, const AABB& aabb)
+  {
+    const uint64_t handle = data->nextOccluderHandle++;
+    data->occluderSets[handle] = { aabb, { quads.begin(), quads.end() } };
+    return handle;
+  }
+
+  void ChunkRenderer::RemoveOccluders(uint64_t handle)
+  {
+    data->occluderSets.erase(handle);
+  }
+
+  void ChunkRenderer::SetChunkConnectivity(const glm::ivec3& cpos, const ChunkConnectivity& connectivity)
+  {
+    data->connectivity[cpos] = connectivity;
+    data->connectivityMin = glm::min(data->connectivityMin, cpos);
+    data->connectivityMax = glm::max(data->connectivityMax, cpos);
+  }
+
+  void ChunkRenderer::RemoveChunkConnectivity(const glm::ivec3& cpos)
+  {
+    data->connectivity.erase(cpos);
+  }
+
   void ChunkRenderer::FreeChunkMesh(uint64_t allocHandle)
   {
     auto it = data->vertexAllocHandles.find(allocHandle);
@@ -540,6 +1106,19 @@ namespace Voxels
     data->vertexAllocHandles.erase(it);
     data->dirtyAlloc = true;
   }
+
+  void ChunkRenderer::SetLodNodeReady(uint32_t lodLevel, const glm::ivec3& nodePos)
+  {
+    if (data->readyLodNodes.size() <= lodLevel)
+    {
+      data->readyLodNodes.resize(lodLevel + 1);
+    }
+    if (data->readyLodNodes[lodLevel].insert(nodePos).second)
+    {
+      // the ready flags are filled in when the allocations are uploaded
+      data->dirtyAlloc = true;
+    }
+  }
 }
 
 
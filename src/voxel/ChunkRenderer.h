@@ -1,18 +1,24 @@
 #pragma once
+#include <glm/vec3.hpp>
 #include <cstdint>
 #include <span>
+#include <vector>
 
 namespace GFX
 {
   class TextureArray;
   class Texture2D;
   struct RenderView;
+  struct OccluderQuad;
+  struct CullView;
 }
 
 struct AABB;
 
 namespace Voxels
 {
+  struct ChunkConnectivity;
+
   class ChunkRenderer
   {
   public:
@@ -23,9 +29,22 @@ namespace Voxels
     void DrawBuffers(std::span<GFX::RenderView*> renderViews);
     void Draw(std::span<GFX::RenderView*> renderViews);
 
-    uint64_t AllocChunkMesh(std::span<uint32_t> vertices, const AABB& aabb);
+    // lodLevel is 0 for chunks, and the level of the node for LOD meshes (see ChunkLod.h)
+    uint64_t AllocChunkMesh(std::span<uint32_t> vertices, const AABB& aabb, uint32_t lodLevel = 0);
     void FreeChunkMesh(uint64_t allocHandle);
 
+    // call once a LOD node and every node below it have been built. until then, the level below draws in its place
+    // nodePos is in nodes of that level
+    void SetLodNodeReady(uint32_t lodLevel, const glm::ivec3& nodePos);
+
+    // occluders for CPU occlusion culling. kept apart from meshes, as solid chunks have none
+    uint64_t AddOccluders(std::span<const GFX::OccluderQuad> quads, const AABB& aabb);
+    void RemoveOccluders(uint64_t handle);
+
+    // for connectivity culling. chunks without any are assumed to connect every face
+    void SetChunkConnectivity(const glm::ivec3& cpos, const ChunkConnectivity& connectivity);
+    void RemoveChunkConnectivity(const glm::ivec3& cpos);
+
     /* $$$$$$$$$$$$$$$   Culling pipeline stuff   $$$$$$$$$$$$$$$$
 
         phase 1:
@@ -48,6 +67,19 @@ namespace Voxels
     void RenderOcclusion(std::span<GFX::RenderView*> renderViews); // phase 3
     void RenderDisoccludedThisFrame(std::span<GFX::RenderView*> renderViews);      // phase 4
 
+    // CPU visibility passes before phase 2. each clears the bits of the views an allocation is hidden in
+
+    // chunks reachable from the camera's chunk through the faces each one connects, without turning back
+    void CullConnectivity(std::span<GFX::RenderView* const> views, std::vector<uint32_t>& visibleMasks);
+
+    // replaces phases 3 and 4 when enabled: occluders are rasterized on the CPU and every allocation is tested
+    // against them before phase 2, which then runs before phase 1, so visibility is never a frame late
+    void CullOcclusionSoftware(std::span<GFX::RenderView* const> views, std::vector<uint32_t>& visibleMasks);
+
+    // debug: reads back a group's draw lists after phase 2 and compares them with the CPU reference (see MultiViewCull.h)
+    // visibleMasks is empty if the CPU visibility passes didn't run
+    void ValidateCulling(uint32_t groupIndex, std::span<const GFX::CullView> views, std::span<const uint32_t> visibleMasks);
+
     // PIMPL
     struct ChunkRendererStorage* data{};
   };
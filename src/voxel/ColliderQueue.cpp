@@ -0,0 +1,201 @@
+#include "vPCH.h"
+#include <voxel/ColliderQueue.h>
+#include <voxel/Chunk.h>
+#include <voxel/VoxelCollision.h>
+
+#include <engine/Physics.h>
+#include <engine/CVar.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <limits>
+
+AutoCVar<cvar_float> physxCollisionCVar("v.physxCollision", "- If enabled, chunks get a PhysX collider made of merged boxes for use by PhysX actors", 1, 0, 1);
+AutoCVar<cvar_float> colliderMaxJobsCVar("v.colliderMaxJobs", "- Maximum number of chunk collider rebuilds that can run at once", 4, 1, 64);
+
+namespace Voxels
+{
+  namespace
+  {
+    // FNV-1a over a bitmask of which blocks are solid
+    uint64_t HashSolidity(const Chunk& chunk)
+    {
+      uint64_t hash = 14695981039346656037ull;
+      for (int i = 0; i < Chunk::CHUNK_SIZE_CUBED; i += 64)
+      {
+        uint64_t bits = 0;
+        for (int j = 0; j < 64; j++)
+        {
+          bits |= uint64_t(Collision::IsSolid(chunk.BlockTypeAtNoLock(i + j))) << j;
+        }
+        hash = (hash ^ bits) * 1099511628211ull;
+      }
+      return hash;
+    }
+
+    float DistanceSq(const AABB& a, const AABB& b)
+    {
+      glm::vec3 d = glm::max(glm::vec3(0), glm::max(a.min - b.max, b.min - a.max));
+      return glm::dot(d, d);
+    }
+  }
+
+  ColliderQueue::ColliderQueue() = default;
+
+  ColliderQueue::~ColliderQueue()
+  {
+    Destroy();
+  }
+
+  void ColliderQueue::Request(Chunk* chunk)
+  {
+    ASSERT(chunk != nullptr);
+    if (!physxCollisionCVar.Get())
+    {
+      return;
+    }
+
+    std::lock_guard lck(pendingMutex_);
+    pending_.insert(chunk);
+  }
+
+  void ColliderQueue::Update()
+  {
+    finished_.ForEach([this](const Result& result) { finish(result); });
+
+    size_t maxJobs = static_cast<size_t>(colliderMaxJobsCVar.Get());
+    if (inFlight_.size() >= maxJobs)
+    {
+      return;
+    }
+
+    // chunks that are already being rebuilt stay pending so their latest state is picked up afterwards
+    std::vector<std::pair<float, Chunk*>> candidates;
+    {
+      std::lock_guard lck(pendingMutex_);
+      candidates.reserve(pending_.size());
+      for (Chunk* chunk : pending_)
+      {
+        if (!inFlight_.contains(chunk))
+        {
+          candidates.emplace_back(0.0f, chunk);
+        }
+      }
+    }
+    if (candidates.empty())
+    {
+      return;
+    }
+
+    // a chunk's priority is its distance to the nearest thing that can collide with it
+    dynamicBounds_.clear();
+    Physics::PhysicsManager::GetDynamicBounds(dynamicBounds_);
+    if (!dynamicBounds_.empty())
+    {
+      for (auto& [distance, chunk] : candidates)
+      {
+        AABB box = chunk->GetAABB();
+        distance = std::numeric_limits<float>::max();
+        for (const auto& bounds : dynamicBounds_)
+        {
+          distance = std::min(distance, DistanceSq(box, bounds));
+        }
+      }
+    }
+
+    size_t count = std::min(maxJobs - inFlight_.size(), candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    {
+      std::lock_guard lck(pendingMutex_);
+      for (size_t i = 0; i < count; i++)
+      {
+        pending_.erase(candidates[i].second);
+      }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+      dispatch(candidates[i].second);
+    }
+  }
+
+  void ColliderQueue::Destroy()
+  {
+    engine::Core::JobSystem::Get()->Wait(jobs_);
+    finished_.ForEach([this](const Result& result) { finish(result); });
+
+    for (auto& [chunk, collider] : colliders_)
+    {
+      Physics::PhysicsManager::RemoveActorGeneric(collider.actor);
+    }
+    colliders_.clear();
+    inFlight_.clear();
+
+    std::lock_guard lck(pendingMutex_);
+    pending_.clear();
+  }
+
+  void ColliderQueue::dispatch(Chunk* chunk)
+  {
+    inFlight_.insert(chunk);
+
+    std::optional<uint64_t> previousHash;
+    if (auto it = colliders_.find(chunk); it != colliders_.end() && it->second.built)
+    {
+      previousHash = it->second.solidHash;
+    }
+
+    engine::Core::JobSystem::Get()->Submit([this, chunk, previousHash]
+      {
+        thread_local std::vector<Collision::BlockBox> blockBoxes;
+        blockBoxes.clear();
+
+        chunk->Lock();
+        uint64_t hash = HashSolidity(*chunk);
+        bool changed = hash != previousHash;
+        if (changed)
+        {
+          Collision::BuildChunkBoxes(*chunk, blockBoxes);
+        }
+        chunk->Unlock();
+
+        if (!changed)
+        {
+          finished_.Push({ .chunk = chunk, .changed = false });
+          return;
+        }
+
+        Physics::BoxCompoundCollider collider;
+        collider.boxes.reserve(blockBoxes.size());
+        for (const auto& box : blockBoxes)
+        {
+          glm::vec3 halfExtents = glm::vec3(box.max - box.min) * 0.5f;
+          collider.boxes.push_back({ glm::vec3(box.min) + halfExtents, halfExtents });
+        }
+
+        auto* actor = reinterpret_cast<physx::PxRigidActor*>(
+          Physics::PhysicsManager::AddStaticActorGeneric(
+            Physics::MaterialType::TERRAIN, collider,
+            glm::translate(glm::mat4(1), glm::vec3(chunk->GetPos() * Chunk::CHUNK_SIZE))));
+
+        finished_.Push({ .chunk = chunk, .actor = actor, .solidHash = hash, .changed = true });
+      }, &jobs_, engine::Core::JobPriority::LOW, "BuildCollider");
+  }
+
+  void ColliderQueue::finish(const Result& result)
+  {
+    inFlight_.erase(result.chunk);
+    if (!result.changed)
+    {
+      return;
+    }
+
+    // the new actor is already in the scene, so there is no gap where the chunk has no collision
+    auto& collider = colliders_[result.chunk];
+    Physics::PhysicsManager::RemoveActorGeneric(collider.actor);
+    collider = { .actor = result.actor, .solidHash = result.solidHash, .built = true };
+  }
+}
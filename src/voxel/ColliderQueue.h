@@ -0,0 +1,70 @@
+#pragma once
+#include <engine/Shapes.h>
+#include <utility/AtomicQueue.h>
+#include <engine/core/JobSystem.h>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace physx
+{
+  class PxRigidActor;
+}
+
+namespace Voxels
+{
+  struct Chunk;
+
+  // Rebuilds the PhysX colliders of chunks in background jobs so they never hold up meshing.
+  // Requests for a chunk that is already waiting are merged into one rebuild, and a rebuild is
+  // skipped entirely if the chunk's solid blocks haven't changed (e.g. a lighting-only remesh).
+  // Chunks near dynamic actors and character controllers are rebuilt first.
+  // A chunk's old collider stays in the scene until its replacement is ready.
+  class ColliderQueue
+  {
+  public:
+    ColliderQueue();
+    ~ColliderQueue();
+
+    // thread-safe
+    void Request(Chunk* chunk);
+
+    // swaps in finished colliders and dispatches the most urgent requests. call once per frame on the main thread
+    void Update();
+
+    // waits for running jobs, then removes every collider from the scene
+    void Destroy();
+
+  private:
+    struct Result
+    {
+      Chunk* chunk{};
+      physx::PxRigidActor* actor{};
+      uint64_t solidHash{};
+      bool changed{};
+    };
+
+    struct ChunkCollider
+    {
+      physx::PxRigidActor* actor{};
+      uint64_t solidHash{};
+      bool built{};
+    };
+
+    void dispatch(Chunk* chunk);
+    void finish(const Result& result);
+
+    engine::Core::JobCounter jobs_;
+    AtomicQueue<Result> finished_;
+
+    std::mutex pendingMutex_;
+    std::unordered_set<Chunk*> pending_;
+
+    // only touched on the main thread
+    std::unordered_set<Chunk*> inFlight_;
+    std::unordered_map<Chunk*, ChunkCollider> colliders_;
+    std::vector<AABB> dynamicBounds_;
+  };
+}
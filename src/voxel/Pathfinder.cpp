@@ -0,0 +1,595 @@
+#include "vPCH.h"
+#include <voxel/Pathfinder.h>
+#include <voxel/VoxelManager.h>
+#include <voxel/VoxelQuery.h>
+#include <voxel/Chunk.h>
+
+#include <glm/gtc/type_precision.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <unordered_set>
+
+namespace Voxels
+{
+  namespace
+  {
+    constexpr int S = Chunk::CHUNK_SIZE;
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    constexpr glm::ivec3 UP{ 0, 1, 0 };
+    constexpr glm::ivec3 HORIZONTAL[] =
+    {
+      { 1, 0, 0 },
+      {-1, 0, 0 },
+      { 0, 0, 1 },
+      { 0, 0,-1 },
+    };
+
+    bool IsSolid(Query::BlockCursor& cursor, const glm::ivec3& p)
+    {
+      return Collision::IsSolid(cursor.GetType(p));
+    }
+
+    bool IsClear(Query::BlockCursor& cursor, const glm::ivec3& p, int height)
+    {
+      for (int h = 0; h < height; h++)
+      {
+        if (IsSolid(cursor, p + UP * h))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool IsWalkable(Query::BlockCursor& cursor, const glm::ivec3& p)
+    {
+      return IsSolid(cursor, p - UP) && IsClear(cursor, p, Pathfinder::AGENT_HEIGHT);
+    }
+
+    float EdgeCost(const glm::ivec3& offset)
+    {
+      return offset.y > 0 ? 1.5f : 1.0f + 0.25f * -offset.y;
+    }
+
+    // every edge moves exactly one block horizontally and costs at least 1
+    float CellHeuristic(const glm::ivec3& a, const glm::ivec3& b)
+    {
+      return float(glm::abs(a.x - b.x) + glm::abs(a.z - b.z));
+    }
+
+    glm::ivec3 ChunkOf(const glm::ivec3& wpos)
+    {
+      return ChunkHelpers::WorldPosToLocalPos(wpos).chunk_pos;
+    }
+
+    glm::ivec3 LocalFromIndex(int index)
+    {
+      return { index % S, (index / S) % S, index / (S * S) };
+    }
+
+    bool LessIvec3(const glm::ivec3& a, const glm::ivec3& b)
+    {
+      return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+    }
+  }
+
+  namespace detail
+  {
+    struct ChunkNav
+    {
+      struct Region
+      {
+        glm::vec3 centroid{};
+        std::vector<glm::ivec3> exits; // cells in other chunks that this region has edges to
+      };
+
+      // returns the index of the walkable cell, or -1
+      int Find(const glm::ivec3& local) const
+      {
+        auto index = static_cast<uint16_t>(ChunkHelpers::IndexFrom3D(local.x, local.y, local.z, S, S));
+        auto it = std::lower_bound(cells.begin(), cells.end(), index);
+        if (it == cells.end() || *it != index)
+        {
+          return -1;
+        }
+        return static_cast<int>(it - cells.begin());
+      }
+
+      glm::ivec3 origin{};
+      std::vector<uint16_t> cells; // sorted chunk-local indices of walkable cells
+      std::vector<uint32_t> firstEdge; // the edges of cell i are [firstEdge[i], firstEdge[i + 1])
+      std::vector<glm::i8vec3> edges; // offset from a cell to its neighbor
+      std::vector<uint16_t> cellRegion;
+      std::vector<Region> regions;
+    };
+
+    std::shared_ptr<ChunkNav> BuildChunkNav(const VoxelManager& vm, const glm::ivec3& cpos)
+    {
+      auto nav = std::make_shared<ChunkNav>();
+      nav->origin = cpos * S;
+      Query::BlockCursor cursor(vm);
+
+      // visiting cells in index order keeps the cell list sorted
+      for (int i = 0; i < Chunk::CHUNK_SIZE_CUBED; i++)
+      {
+        if (IsWalkable(cursor, nav->origin + LocalFromIndex(i)))
+        {
+          nav->cells.push_back(static_cast<uint16_t>(i));
+        }
+      }
+
+      nav->firstEdge.reserve(nav->cells.size() + 1);
+      for (uint16_t cell : nav->cells)
+      {
+        nav->firstEdge.push_back(static_cast<uint32_t>(nav->edges.size()));
+        glm::ivec3 p = nav->origin + LocalFromIndex(cell);
+        for (const auto& dir : HORIZONTAL)
+        {
+          glm::ivec3 q = p + dir;
+          if (IsWalkable(cursor, q))
+          {
+            nav->edges.emplace_back(dir);
+          }
+          else if (IsSolid(cursor, q))
+          {
+            // step up, which needs headroom above the agent
+            if (IsClear(cursor, p + UP * Pathfinder::AGENT_HEIGHT, 1) && IsWalkable(cursor, q + UP))
+            {
+              nav->edges.emplace_back(dir + UP);
+            }
+          }
+          else if (IsClear(cursor, q, Pathfinder::AGENT_HEIGHT))
+          {
+            // walk off the edge and fall until landing
+            for (int k = 1; k <= Pathfinder::MAX_DROP; k++)
+            {
+              glm::ivec3 r = q - UP * k;
+              if (IsWalkable(cursor, r))
+              {
+                nav->edges.emplace_back(dir - UP * k);
+                break;
+              }
+              if (IsSolid(cursor, r))
+              {
+                break;
+              }
+            }
+          }
+        }
+      }
+      nav->firstEdge.push_back(static_cast<uint32_t>(nav->edges.size()));
+
+      // regions are the weakly connected components of the cells, using edges that stay within the chunk.
+      // blocks are read one chunk lock at a time, so an edit can land between reading a cell and reading
+      // its neighbor. an edge whose target is no longer a cell is treated as no edge
+      std::vector<uint32_t> parent(nav->cells.size());
+      std::iota(parent.begin(), parent.end(), 0);
+      auto findRoot = [&parent](uint32_t i)
+      {
+        while (parent[i] != i)
+        {
+          parent[i] = parent[parent[i]];
+          i = parent[i];
+        }
+        return i;
+      };
+
+      for (uint32_t i = 0; i < nav->cells.size(); i++)
+      {
+        glm::ivec3 local = LocalFromIndex(nav->cells[i]);
+        for (uint32_t e = nav->firstEdge[i]; e < nav->firstEdge[i + 1]; e++)
+        {
+          glm::ivec3 target = local + glm::ivec3(nav->edges[e]);
+          if (glm::all(glm::greaterThanEqual(target, glm::ivec3(0))) && glm::all(glm::lessThan(target, glm::ivec3(S))))
+          {
+            if (int j = nav->Find(target); j >= 0)
+            {
+              parent[findRoot(i)] = findRoot(static_cast<uint32_t>(j));
+            }
+          }
+        }
+      }
+
+      std::unordered_map<uint32_t, uint16_t> rootRegion;
+      std::vector<uint32_t> regionCellCount;
+      nav->cellRegion.resize(nav->cells.size());
+      for (uint32_t i = 0; i < nav->cells.size(); i++)
+      {
+        auto [it, inserted] = rootRegion.try_emplace(findRoot(i), static_cast<uint16_t>(nav->regions.size()));
+        if (inserted)
+        {
+          nav->regions.emplace_back();
+          regionCellCount.push_back(0);
+        }
+
+        uint16_t region = it->second;
+        nav->cellRegion[i] = region;
+        glm::ivec3 p = nav->origin + LocalFromIndex(nav->cells[i]);
+        nav->regions[region].centroid += glm::vec3(p);
+        regionCellCount[region]++;
+
+        for (uint32_t e = nav->firstEdge[i]; e < nav->firstEdge[i + 1]; e++)
+        {
+          glm::ivec3 target = p + glm::ivec3(nav->edges[e]);
+          if (ChunkOf(target) != cpos)
+          {
+            nav->regions[region].exits.push_back(target);
+          }
+        }
+      }
+
+      for (size_t r = 0; r < nav->regions.size(); r++)
+      {
+        auto& region = nav->regions[r];
+        region.centroid /= float(regionCellCount[r]);
+        std::sort(region.exits.begin(), region.exits.end(), LessIvec3);
+        region.exits.erase(std::unique(region.exits.begin(), region.exits.end()), region.exits.end());
+      }
+
+      return nav;
+    }
+
+    // state for one path request. holds on to every graph it has used, so edits made
+    // while it runs cannot change the graph out from under it
+    class PathQuery
+    {
+    public:
+      using ChunkSet = std::unordered_set<glm::ivec3, Utils::ivec3Hash>;
+
+      PathQuery(Pathfinder& pathfinder, uint32_t budget) : pathfinder_(pathfinder), budget_(budget) {}
+
+      std::optional<glm::ivec3> Snap(const glm::ivec3& wpos)
+      {
+        for (int k = 0; k <= Pathfinder::MAX_DROP; k++)
+        {
+          glm::ivec3 p = wpos - UP * k;
+          if (locate(p).first)
+          {
+            return p;
+          }
+        }
+        return std::nullopt;
+      }
+
+      // A* over regions. on success, corridor holds every chunk the route passes through
+      PathStatus FindCorridor(const glm::ivec3& start, const glm::ivec3& goal, ChunkSet& corridor)
+      {
+        auto startKey = *regionOf(start);
+        auto goalKey = *regionOf(goal);
+        if (startKey == goalKey)
+        {
+          corridor.insert(startKey.cpos);
+          return PathStatus::FOUND;
+        }
+
+        struct Record
+        {
+          float g = INF;
+          RegionKey parent{};
+          bool closed = false;
+        };
+        std::unordered_map<RegionKey, Record, RegionKeyHash> records;
+        std::priority_queue<std::pair<float, RegionKey>, std::vector<std::pair<float, RegionKey>>, CompareFirst> open;
+
+        const glm::vec3 goalCentroid = centroidOf(goalKey);
+        records[startKey] = { .g = 0, .parent = startKey };
+        open.push({ glm::distance(centroidOf(startKey), goalCentroid), startKey });
+
+        while (!open.empty())
+        {
+          RegionKey key = open.top().second;
+          open.pop();
+          Record& record = records[key];
+          if (record.closed)
+          {
+            continue;
+          }
+          record.closed = true;
+
+          if (key == goalKey)
+          {
+            for (RegionKey k = goalKey; ; k = records[k].parent)
+            {
+              corridor.insert(k.cpos);
+              if (k == startKey)
+              {
+                break;
+              }
+            }
+            return PathStatus::FOUND;
+          }
+
+          if (++expansions > budget_)
+          {
+            return PathStatus::BUDGET_EXCEEDED;
+          }
+
+          const glm::vec3 centroid = centroidOf(key);
+          for (const auto& exit : nav(key.cpos)->regions[key.region].exits)
+          {
+            auto next = regionOf(exit);
+            if (!next)
+            {
+              continue;
+            }
+
+            const glm::vec3 nextCentroid = centroidOf(*next);
+            float g = record.g + glm::distance(centroid, nextCentroid);
+            auto& nextRecord = records[*next];
+            if (!nextRecord.closed && g < nextRecord.g)
+            {
+              nextRecord.g = g;
+              nextRecord.parent = key;
+              open.push({ g + glm::distance(nextCentroid, goalCentroid), *next });
+            }
+          }
+        }
+
+        return PathStatus::NO_PATH;
+      }
+
+      // A* over cells, optionally restricted to a set of chunks
+      PathStatus FindCells(const glm::ivec3& start, const glm::ivec3& goal, const ChunkSet* corridor, std::vector<glm::ivec3>& path)
+      {
+        struct Record
+        {
+          float g = INF;
+          glm::ivec3 parent{};
+          bool closed = false;
+        };
+        std::unordered_map<glm::ivec3, Record, Utils::ivec3Hash> records;
+        std::priority_queue<std::pair<float, glm::ivec3>, std::vector<std::pair<float, glm::ivec3>>, CompareFirst> open;
+
+        records[start] = { .g = 0, .parent = start };
+        open.push({ CellHeuristic(start, goal), start });
+
+        while (!open.empty())
+        {
+          glm::ivec3 p = open.top().second;
+          open.pop();
+          Record& record = records[p];
+          if (record.closed)
+          {
+            continue;
+          }
+          record.closed = true;
+
+          if (p == goal)
+          {
+            path.clear();
+            for (glm::ivec3 c = goal; c != start; c = records[c].parent)
+            {
+              path.push_back(c);
+            }
+            path.push_back(start);
+            std::reverse(path.begin(), path.end());
+            return PathStatus::FOUND;
+          }
+
+          if (++expansions > budget_)
+          {
+            return PathStatus::BUDGET_EXCEEDED;
+          }
+
+          // cells are only opened after locate finds them, so this can't fail
+          auto [chunkNav, cell] = locate(p);
+          ASSERT(chunkNav);
+          for (uint32_t e = chunkNav->firstEdge[cell]; e < chunkNav->firstEdge[cell + 1]; e++)
+          {
+            glm::ivec3 offset(chunkNav->edges[e]);
+            glm::ivec3 next = p + offset;
+            if (corridor && !corridor->contains(ChunkOf(next)))
+            {
+              continue;
+            }
+
+            // the target's graph may have been rebuilt after an edit that this cell's graph predates
+            if (!locate(next).first)
+            {
+              continue;
+            }
+
+            float g = record.g + EdgeCost(offset);
+            auto& nextRecord = records[next];
+            if (!nextRecord.closed && g < nextRecord.g)
+            {
+              nextRecord.g = g;
+              nextRecord.parent = p;
+              open.push({ g + CellHeuristic(next, goal), next });
+            }
+          }
+        }
+
+        return PathStatus::NO_PATH;
+      }
+
+      uint32_t expansions = 0;
+
+    private:
+      struct RegionKey
+      {
+        glm::ivec3 cpos{};
+        uint16_t region{};
+        bool operator==(const RegionKey&) const = default;
+      };
+
+      struct RegionKeyHash
+      {
+        size_t operator()(const RegionKey& key) const
+        {
+          return Utils::ivec3Hash{}(key.cpos) * 31 + key.region;
+        }
+      };
+
+      struct CompareFirst
+      {
+        template<typename T>
+        bool operator()(const T& a, const T& b) const
+        {
+          return a.first > b.first;
+        }
+      };
+
+      const ChunkNav* nav(const glm::ivec3& cpos)
+      {
+        auto [it, inserted] = navs_.try_emplace(cpos);
+        if (inserted)
+        {
+          it->second = pathfinder_.getChunkNav(cpos);
+        }
+        return it->second.get();
+      }
+
+      std::pair<const ChunkNav*, int> locate(const glm::ivec3& wpos)
+      {
+        auto local = ChunkHelpers::WorldPosToLocalPos(wpos);
+        const ChunkNav* chunkNav = nav(local.chunk_pos);
+        if (!chunkNav)
+        {
+          return { nullptr, -1 };
+        }
+        int cell = chunkNav->Find(local.block_pos);
+        return { cell >= 0 ? chunkNav : nullptr, cell };
+      }
+
+      std::optional<RegionKey> regionOf(const glm::ivec3& wpos)
+      {
+        auto [chunkNav, cell] = locate(wpos);
+        if (!chunkNav)
+        {
+          return std::nullopt;
+        }
+        return RegionKey{ .cpos = ChunkOf(wpos), .region = chunkNav->cellRegion[cell] };
+      }
+
+      glm::vec3 centroidOf(const RegionKey& key)
+      {
+        return nav(key.cpos)->regions[key.region].centroid;
+      }
+
+      Pathfinder& pathfinder_;
+      uint32_t budget_;
+      std::unordered_map<glm::ivec3, std::shared_ptr<const ChunkNav>, Utils::ivec3Hash> navs_;
+    };
+  }
+
+  Pathfinder::Pathfinder(const VoxelManager& vm)
+    : voxelManager_(vm)
+  {
+  }
+
+  Pathfinder::~Pathfinder()
+  {
+    engine::Core::JobSystem::Get()->Wait(jobs_);
+  }
+
+  PathResult Pathfinder::FindPath(const PathRequest& request)
+  {
+    detail::PathQuery query(*this, request.maxExpansions);
+    PathResult result;
+
+    auto start = query.Snap(request.start);
+    auto goal = query.Snap(request.goal);
+    if (!start || !goal)
+    {
+      result.status = PathStatus::INVALID_ENDPOINTS;
+      return result;
+    }
+
+    detail::PathQuery::ChunkSet corridor;
+    result.status = query.FindCorridor(*start, *goal, corridor);
+    if (result.status == PathStatus::FOUND)
+    {
+      result.status = query.FindCells(*start, *goal, &corridor, result.path);
+
+      // regions only approximate which cells can reach each other, so the corridor
+      // can be a dead end. search without it before giving up
+      if (result.status == PathStatus::NO_PATH)
+      {
+        result.status = query.FindCells(*start, *goal, nullptr, result.path);
+      }
+    }
+
+    result.expansions = query.expansions;
+    return result;
+  }
+
+  std::future<PathResult> Pathfinder::FindPathAsync(const PathRequest& request)
+  {
+    auto promise = std::make_shared<std::promise<PathResult>>();
+    auto future = promise->get_future();
+    engine::Core::JobSystem::Get()->Submit([this, request, promise]
+      {
+        promise->set_value(FindPath(request));
+      }, &jobs_, engine::Core::JobPriority::LOW, "FindPath");
+    return future;
+  }
+
+  void Pathfinder::Invalidate(const glm::ivec3& wpos)
+  {
+    // a cell's walkability and edges depend on blocks up to one step away horizontally,
+    // AGENT_HEIGHT + 1 blocks above it, and MAX_DROP + 1 blocks below it
+    invalidateChunks(
+      ChunkOf(wpos - glm::ivec3(1, AGENT_HEIGHT + 1, 1)),
+      ChunkOf(wpos + glm::ivec3(1, MAX_DROP + 1, 1)));
+  }
+
+  void Pathfinder::InvalidateChunk(const glm::ivec3& cpos)
+  {
+    invalidateChunks(cpos - 1, cpos + 1);
+  }
+
+  std::shared_ptr<const detail::ChunkNav> Pathfinder::getChunkNav(const glm::ivec3& cpos)
+  {
+    uint64_t generation = 0;
+    {
+      std::shared_lock lck(cacheMutex_);
+      if (auto it = cache_.find(cpos); it != cache_.end())
+      {
+        return it->second;
+      }
+      if (auto it = generations_.find(cpos); it != generations_.end())
+      {
+        generation = it->second;
+      }
+    }
+
+    if (!voxelManager_.GetChunk(cpos))
+    {
+      return nullptr;
+    }
+
+    // built outside the lock. if the chunk was invalidated in the meantime, the graph is
+    // still used by the query that asked for it, but it isn't cached
+    std::shared_ptr<const detail::ChunkNav> nav = detail::BuildChunkNav(voxelManager_, cpos);
+
+    std::unique_lock lck(cacheMutex_);
+    auto it = generations_.find(cpos);
+    if ((it == generations_.end() ? 0 : it->second) == generation)
+    {
+      return cache_.try_emplace(cpos, std::move(nav)).first->second;
+    }
+    return nav;
+  }
+
+  void Pathfinder::invalidateChunks(const glm::ivec3& lowCpos, const glm::ivec3& highCpos)
+  {
+    std::unique_lock lck(cacheMutex_);
+    for (int z = lowCpos.z; z <= highCpos.z; z++)
+    {
+      for (int y = lowCpos.y; y <= highCpos.y; y++)
+      {
+        for (int x = lowCpos.x; x <= highCpos.x; x++)
+        {
+          glm::ivec3 cpos(x, y, z);
+          cache_.erase(cpos);
+          generations_[cpos]++;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <engine/utilities.h>
+#include <engine/core/JobSystem.h>
+#include <glm/vec3.hpp>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+  Pathfinding for agents that are one block wide and AGENT_HEIGHT blocks tall.
+
+  A walkable cell is a non-solid block with a solid block below it and enough
+  headroom above it. From a cell, agents can walk to an adjacent cell, step
+  up one block, or drop up to MAX_DROP blocks.
+
+  Each chunk gets a navigation graph, built the first time a query needs it.
+  The graph holds the chunk's walkable cells and their edges, with the cells
+  grouped into regions. A query first runs A* over the regions of the chunks
+  it crosses (the portal graph). It then runs A* over cells, restricted to
+  the chunks on that route. Queries never read blocks directly.
+
+  Graphs are immutable once built and are shared between queries. Changing
+  a block throws away the graphs it could affect. Each one is rebuilt the
+  next time a query needs it.
+
+  Graphs of neighboring chunks can be built from different states of the
+  world, so an edge may lead to a cell the neighbor's graph doesn't have.
+  Queries treat such edges as missing.
+
+  FindPath is thread-safe. FindPathAsync submits the query to the JobSystem
+  as a LOW priority job.
+*/
+namespace Voxels
+{
+  class VoxelManager;
+
+  namespace detail
+  {
+    struct ChunkNav;
+    class PathQuery;
+  }
+
+  enum class PathStatus
+  {
+    FOUND,
+    NO_PATH,
+    BUDGET_EXCEEDED, // the query gave up after expanding maxExpansions nodes
+    INVALID_ENDPOINTS, // no walkable cell at or shortly below the start or goal
+  };
+
+  struct PathRequest
+  {
+    glm::ivec3 start; // the block the agent's feet are in
+    glm::ivec3 goal;
+    uint32_t maxExpansions = 20000; // shared by both levels of the search
+  };
+
+  struct PathResult
+  {
+    PathStatus status{};
+    std::vector<glm::ivec3> path; // walkable cells from start to goal, inclusive
+    uint32_t expansions{};
+  };
+
+  class Pathfinder
+  {
+  public:
+    static constexpr int AGENT_HEIGHT = 2;
+    static constexpr int MAX_DROP = 3;
+
+    Pathfinder(const VoxelManager& vm);
+    ~Pathfinder();
+
+    Pathfinder(const Pathfinder&) = delete;
+    Pathfinder& operator=(const Pathfinder&) = delete;
+
+    [[nodiscard]] PathResult FindPath(const PathRequest& request);
+    [[nodiscard]] std::future<PathResult> FindPathAsync(const PathRequest& request);
+
+    // call when the block at wpos changes
+    void Invalidate(const glm::ivec3& wpos);
+
+    // call when an arbitrary number of blocks in a chunk change
+    void InvalidateChunk(const glm::ivec3& cpos);
+
+  private:
+    friend class detail::PathQuery;
+
+    std::shared_ptr<const detail::ChunkNav> getChunkNav(const glm::ivec3& cpos);
+    void invalidateChunks(const glm::ivec3& lowCpos, const glm::ivec3& highCpos);
+
+    const VoxelManager& voxelManager_;
+    engine::Core::JobCounter jobs_;
+
+    std::shared_mutex cacheMutex_;
+    std::unordered_map<glm::ivec3, std::shared_ptr<const detail::ChunkNav>, Utils::ivec3Hash> cache_;
+
+    // bumped whenever a chunk is invalidated so graphs that were being built at the time are not cached
+    std::unordered_map<glm::ivec3, uint64_t, Utils::ivec3Hash> generations_;
+  };
+}
@@ -0,0 +1,272 @@
+#include "vPCH.h"
+#include <voxel/VoxelCollision.h>
+#include <voxel/VoxelQuery.h>
+#include <voxel/VoxelManager.h>
+#include <voxel/Chunk.h>
+#include <voxel/ChunkHelpers.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <limits>
+
+namespace Voxels::Collision
+{
+  namespace
+  {
+    constexpr float EPSILON = 1e-4f;
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    constexpr int MAX_ADVANCE_ITERATIONS = 32;
+    constexpr int SEGMENT_SEARCH_ITERATIONS = 20;
+
+    // the box covering a shape's bounds at both ends of a sweep
+    AABB SweptBounds(const glm::vec3& min, const glm::vec3& max, const glm::vec3& offset)
+    {
+      return AABB(glm::min(min, min + offset), glm::max(max, max + offset));
+    }
+
+    // squared distance between a segment and a box. the distance to a convex set is convex
+    // along the segment, so a golden section search is enough to find the closest point
+    float SegmentBoxDistanceSq(const glm::vec3& a, const glm::vec3& b, const glm::vec3& boxMin, const glm::vec3& boxMax,
+      glm::vec3& segPoint, glm::vec3& boxPoint)
+    {
+      auto distanceAt = [&](float s, glm::vec3& p, glm::vec3& q)
+      {
+        p = glm::mix(a, b, s);
+        q = glm::clamp(p, boxMin, boxMax);
+        return glm::dot(p - q, p - q);
+      };
+
+      constexpr float invPhi = 0.618033988f;
+      float lo = 0, hi = 1;
+      glm::vec3 p, q;
+      for (int i = 0; i < SEGMENT_SEARCH_ITERATIONS; i++)
+      {
+        float s1 = hi - (hi - lo) * invPhi;
+        float s2 = lo + (hi - lo) * invPhi;
+        if (distanceAt(s1, p, q) < distanceAt(s2, p, q))
+        {
+          hi = s2;
+        }
+        else
+        {
+          lo = s1;
+        }
+      }
+      return distanceAt((lo + hi) * 0.5f, segPoint, boxPoint);
+    }
+  }
+
+  std::optional<Hit> Raycast(const VoxelManager& vm, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+  {
+    std::optional<Hit> hit;
+    Query::TraverseRay(vm, origin, direction, maxDistance, [&](const glm::ivec3& p, Block block, const glm::vec3& face, float t)
+      {
+        if (!IsSolid(block.GetType()))
+        {
+          return false;
+        }
+        hit = Hit{ .distance = t, .normal = face, .blockPos = p };
+        return true;
+      });
+    return hit;
+  }
+
+  std::optional<Hit> SweepAABB(const VoxelManager& vm, const AABB& box, const glm::vec3& direction, float maxDistance)
+  {
+    glm::vec3 half = (box.max - box.min) * 0.5f;
+    glm::vec3 center = box.min + half;
+
+    std::optional<Hit> best;
+    Query::OverlapBox(vm, SweptBounds(box.min, box.max, direction * maxDistance), [&](const glm::ivec3& p, Block)
+      {
+        // sweep the box's center against the block grown by the box's half extents
+        glm::vec3 blockMin = glm::vec3(p) - half;
+        glm::vec3 blockMax = glm::vec3(p) + 1.0f + half;
+        float tEnter = -INF;
+        float tExit = INF;
+        int axis = -1;
+        for (int i = 0; i < 3; i++)
+        {
+          if (direction[i] == 0)
+          {
+            // not moving on this axis, so it must already be strictly inside the slab
+            if (center[i] <= blockMin[i] || center[i] >= blockMax[i])
+            {
+              return false;
+            }
+            continue;
+          }
+
+          float t0 = (blockMin[i] - center[i]) / direction[i];
+          float t1 = (blockMax[i] - center[i]) / direction[i];
+          if (t0 > t1)
+          {
+            std::swap(t0, t1);
+          }
+          if (t0 > tEnter)
+          {
+            tEnter = t0;
+            axis = i;
+          }
+          tExit = glm::min(tExit, t1);
+        }
+
+        // tEnter < 0 means the box started inside the block
+        if (axis == -1 || tEnter >= tExit || tExit <= 0 || tEnter < -EPSILON)
+        {
+          return false;
+        }
+
+        float t = glm::max(tEnter, 0.0f);
+        if (t <= maxDistance && (!best || t < best->distance))
+        {
+          glm::vec3 normal(0);
+          normal[axis] = -glm::sign(direction[axis]);
+          best = Hit{ .distance = t, .normal = normal, .blockPos = p };
+        }
+        return false;
+      });
+
+    return best;
+  }
+
+  std::optional<Hit> SweepCapsule(const VoxelManager& vm, const glm::vec3& a, const glm::vec3& b, float radius,
+    const glm::vec3& direction, float maxDistance)
+  {
+    glm::vec3 capsuleMin = glm::min(a, b) - radius;
+    glm::vec3 capsuleMax = glm::max(a, b) + radius;
+
+    std::optional<Hit> best;
+    Query::OverlapBox(vm, SweptBounds(capsuleMin, capsuleMax, direction * maxDistance), [&](const glm::ivec3& p, Block)
+      {
+        glm::vec3 blockMin(p);
+        glm::vec3 blockMax = blockMin + 1.0f;
+        float limit = best ? best->distance : maxDistance;
+
+        // conservative advancement: the capsule can safely move as far as its distance
+        // to the block, since the block is static and direction has unit length
+        float t = 0;
+        for (int i = 0; i < MAX_ADVANCE_ITERATIONS; i++)
+        {
+          glm::vec3 segPoint, boxPoint;
+          float distSq = SegmentBoxDistanceSq(a + direction * t, b + direction * t, blockMin, blockMax, segPoint, boxPoint);
+          float dist = glm::sqrt(distSq) - radius;
+          if (dist <= EPSILON)
+          {
+            glm::vec3 normal = distSq > 0 ? (segPoint - boxPoint) / glm::sqrt(distSq) : -direction;
+            if (t == 0 && (dist < -EPSILON || glm::dot(normal, direction) >= 0))
+            {
+              // started inside the block, or touching it while moving away
+              return false;
+            }
+            best = Hit{ .distance = t, .normal = normal, .blockPos = p };
+            return false;
+          }
+
+          t += dist;
+          if (t > limit)
+          {
+            return false;
+          }
+        }
+
+        // only reachable when grazing the block, which we treat as a miss
+        return false;
+      });
+
+    return best;
+  }
+
+  bool OverlapAABB(const VoxelManager& vm, const AABB& box)
+  {
+    bool overlaps = false;
+    Query::OverlapBox(vm, box, [&](const glm::ivec3&, Block)
+      {
+        overlaps = true;
+        return true;
+      });
+    return overlaps;
+  }
+
+  void BuildChunkBoxes(const Chunk& chunk, std::vector<BlockBox>& boxes)
+  {
+    constexpr int S = Chunk::CHUNK_SIZE;
+
+    // solid blocks not yet covered by a box
+    std::vector<uint8_t> open(Chunk::CHUNK_SIZE_CUBED);
+    for (int i = 0; i < Chunk::CHUNK_SIZE_CUBED; i++)
+    {
+      open[i] = IsSolid(chunk.BlockTypeAtNoLock(i));
+    }
+
+    auto at = [&](int x, int y, int z) -> uint8_t&
+    {
+      return open[ChunkHelpers::IndexFrom3D(x, y, z, S, S)];
+    };
+
+    auto rowOpen = [&](int x0, int x1, int y, int z)
+    {
+      for (int x = x0; x < x1; x++)
+      {
+        if (!at(x, y, z))
+        {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    for (int z = 0; z < S; z++)
+    {
+      for (int y = 0; y < S; y++)
+      {
+        for (int x = 0; x < S; x++)
+        {
+          if (!at(x, y, z))
+          {
+            continue;
+          }
+
+          // grow along x, then y, then z for as long as every block in the new slice is open
+          int x1 = x + 1;
+          while (x1 < S && at(x1, y, z))
+          {
+            x1++;
+          }
+
+          int y1 = y + 1;
+          while (y1 < S && rowOpen(x, x1, y1, z))
+          {
+            y1++;
+          }
+
+          int z1 = z + 1;
+          for (; z1 < S; z1++)
+          {
+            bool sliceOpen = true;
+            for (int yy = y; yy < y1 && sliceOpen; yy++)
+            {
+              sliceOpen = rowOpen(x, x1, yy, z1);
+            }
+            if (!sliceOpen)
+            {
+              break;
+            }
+          }
+
+          for (int zz = z; zz < z1; zz++)
+          {
+            for (int yy = y; yy < y1; yy++)
+            {
+              for (int xx = x; xx < x1; xx++)
+              {
+                at(xx, yy, zz) = 0;
+              }
+            }
+          }
+
+          boxes.push_back({ { x, y, z }, { x1, y1, z1 } });
+        }
+      }
+    }
+  }
+}
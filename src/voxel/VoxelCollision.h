@@ -0,0 +1,63 @@
+#pragma once
+#include <engine/Shapes.h>
+#include <voxel/block.h>
+#include <glm/vec3.hpp>
+#include <optional>
+#include <vector>
+
+/*
+  Collision queries that are answered directly from chunk block data.
+  Every block is treated as a unit cube. Nothing here touches PhysX, so
+  remeshing a chunk no longer needs to produce or cook collision geometry.
+  PhysX actors, like the character controller, collide with the merged boxes
+  made by BuildChunkBoxes instead (see ColliderQueue.h).
+
+  Sweeps ignore blocks that the shape already penetrates at its starting position
+  and blocks that it only touches while moving away, so a shape resting on the
+  ground can still slide along it. Use OverlapAABB to detect starting penetration.
+
+  Blocks are read the same way as in VoxelQuery.h. Chunks that do not exist
+  are treated as empty.
+*/
+namespace Voxels
+{
+  class VoxelManager;
+  struct Chunk;
+
+  namespace Collision
+  {
+    struct Hit
+    {
+      float distance{}; // how far the query traveled along its direction before hitting
+      glm::vec3 normal{}; // surface normal at the point of contact
+      glm::ivec3 blockPos{}; // world position of the block that was hit
+    };
+
+    // blocks with any visible faces have always been collidable
+    inline bool IsSolid(BlockType type)
+    {
+      return Block::PropertiesTable[uint16_t(type)].visibility != Visibility::Invisible;
+    }
+
+    // direction must be normalized for every query
+    [[nodiscard]] std::optional<Hit> Raycast(const VoxelManager& vm, const glm::vec3& origin, const glm::vec3& direction, float maxDistance);
+    [[nodiscard]] std::optional<Hit> SweepAABB(const VoxelManager& vm, const AABB& box, const glm::vec3& direction, float maxDistance);
+
+    // the capsule is the set of points within radius of the segment [a, b]
+    [[nodiscard]] std::optional<Hit> SweepCapsule(const VoxelManager& vm, const glm::vec3& a, const glm::vec3& b, float radius,
+      const glm::vec3& direction, float maxDistance);
+
+    [[nodiscard]] bool OverlapAABB(const VoxelManager& vm, const AABB& box);
+
+    // a box of blocks in chunk-local coordinates. max is exclusive
+    struct BlockBox
+    {
+      glm::ivec3 min;
+      glm::ivec3 max;
+    };
+
+    // greedily merges the solid blocks of a chunk into as few boxes as it can
+    // reads without locking, so the chunk must not be modified while this runs
+    void BuildChunkBoxes(const Chunk& chunk, std::vector<BlockBox>& boxes);
+  }
+}
@@ -12,12 +12,15 @@ class WorldGen;
 
 namespace Voxels
 {
+  class Pathfinder;
+
   //class ChunkManager;
   //class ChunkRenderer;
 
   class VoxelManager
   {
   public:
+    // without a scene, the world only holds block data and is never drawn (e.g. in self-tests)
     VoxelManager(Scene* scene);
     ~VoxelManager();
 
@@ -30,6 +33,9 @@ namespace Voxels
 
     // Should be called regularly to ensure chunks are continuously meshed
     void Update();
+
+    // Blocks until every chunk waiting to be meshed has been meshed and buffered
+    void FinishMeshing();
     void Draw();
     void DrawDebug();
 
@@ -49,6 +55,10 @@ namespace Voxels
     void UpdateBlock(const glm::ivec3& wpos, Block block);
     void UpdateBlockCheap(const glm::ivec3& wpos, Block block);
 
+    // Wakes a block so it is simulated on the next block tick (e.g. sand that should fall).
+    // UpdateBlock does this automatically for the changed block and its neighbours.
+    void ScheduleBlockTick(const glm::ivec3& wpos);
+
     // Change the state of the voxel world. These functions are cheap to call as 
     // they only modify the block data, but do not cause the chunk to be remeshed.
     // Call these functions for data-heavy work such as world generation.
@@ -60,14 +70,19 @@ namespace Voxels
     void UpdateChunk(const glm::ivec3& cpos);
     void UpdateChunk(Chunk* chunk);
 
+    // Thread-safe navigation queries. Kept up to date by UpdateBlock and UpdateChunk
+    Pathfinder& GetPathfinder() { return *pathfinder_; }
+
     // Utility functions
-    void Raycast(glm::vec3 origin, glm::vec3 direction, float distance, std::function<bool(glm::vec3, Block, glm::vec3)> callback);
+    void Raycast(glm::vec3 origin, glm::vec3 direction, float distance, std::function<bool(glm::vec3, Block, glm::vec3)> callback) const;
 
     // TODO: privatize once a way to set settings is added
+    // null when headless
     std::unique_ptr<ChunkRenderer> chunkRenderer_{};
 
   private:
     friend class ChunkManager;
+    friend class ChunkLodManager;
     friend class WorldGen;
     friend class ChunkMesh;
     friend class Editor;
@@ -100,6 +115,7 @@ namespace Voxels
     glm::ivec3 chunksPerDim_{};
 
     std::unique_ptr<Editor> editor_{};
+    std::unique_ptr<Pathfinder> pathfinder_{};
     Scene* scene_;
   };
 
@@ -0,0 +1,71 @@
+#include "vPCH.h"
+#include <voxel/VoxelQuery.h>
+
+#include <engine/core/JobSystem.h>
+
+namespace Voxels::Query
+{
+  bool LineOfSight(const VoxelManager& vm, const glm::vec3& from, const glm::vec3& to)
+  {
+    glm::vec3 diff = to - from;
+    float distance = glm::length(diff);
+    if (distance == 0)
+    {
+      return true;
+    }
+
+    bool visible = true;
+    TraverseRay(vm, from, diff / distance, distance, [&](const glm::ivec3&, Block block, const glm::vec3&, float)
+      {
+        visible = !Collision::IsSolid(block.GetType());
+        return !visible;
+      });
+    return visible;
+  }
+
+  void RaycastBatch(const VoxelManager& vm, std::span<const Ray> rays, std::span<std::optional<Collision::Hit>> hits)
+  {
+    ASSERT(rays.size() == hits.size());
+    engine::Core::JobSystem::Get()->ForEach(rays.begin(), rays.end(),
+      [&vm, rays, hits](const Ray& ray)
+      {
+        hits[&ray - rays.data()] = Collision::Raycast(vm, ray.origin, ray.direction, ray.distance);
+      });
+  }
+
+  void LineOfSightBatch(const VoxelManager& vm, std::span<const Segment> segments, std::span<uint8_t> visible)
+  {
+    ASSERT(segments.size() == visible.size());
+    engine::Core::JobSystem::Get()->ForEach(segments.begin(), segments.end(),
+      [&vm, segments, visible](const Segment& segment)
+      {
+        visible[&segment - segments.data()] = static_cast<uint8_t>(LineOfSight(vm, segment.from, segment.to));
+      });
+  }
+
+  void OverlapSphereBatch(const VoxelManager& vm, std::span<const Sphere> spheres, std::span<uint8_t> overlaps)
+  {
+    ASSERT(spheres.size() == overlaps.size());
+    engine::Core::JobSystem::Get()->ForEach(spheres.begin(), spheres.end(),
+      [&vm, spheres, overlaps](const Sphere& sphere)
+      {
+        uint8_t overlap = 0;
+        OverlapSphere(vm, sphere.center, sphere.radius, [&](const glm::ivec3&, Block)
+          {
+            overlap = 1;
+            return true;
+          });
+        overlaps[&sphere - spheres.data()] = overlap;
+      });
+  }
+
+  void OverlapBoxBatch(const VoxelManager& vm, std::span<const AABB> boxes, std::span<uint8_t> overlaps)
+  {
+    ASSERT(boxes.size() == overlaps.size());
+    engine::Core::JobSystem::Get()->ForEach(boxes.begin(), boxes.end(),
+      [&vm, boxes, overlaps](const AABB& box)
+      {
+        overlaps[&box - boxes.data()] = static_cast<uint8_t>(Collision::OverlapAABB(vm, box));
+      });
+  }
+}
@@ -0,0 +1,237 @@
+#pragma once
+#include <voxel/VoxelManager.h>
+#include <voxel/VoxelCollision.h>
+#include <engine/Shapes.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+
+/*
+  Traversal and query primitives over the block grid.
+
+  Callbacks are template parameters, so they are inlined into the traversal
+  instead of being called through a std::function.
+
+  A query holds the shared lock of the chunk it is reading from until it moves on
+  to another chunk, so every block it reads from one chunk comes from the same
+  state of that chunk. At most one chunk lock is held at a time.
+
+  Callbacks run while that lock is held, so they must not edit blocks or read
+  them through the VoxelManager. VoxelManager::Raycast is the exception, as it
+  releases the lock before each call to its callback.
+
+  The batched functions split their inputs across threads. Their output spans
+  must be the same size as their input spans.
+*/
+namespace Voxels::Query
+{
+  // reads blocks by world position, holding the shared lock of the last chunk it looked in
+  class BlockCursor
+  {
+  public:
+    explicit BlockCursor(const VoxelManager& vm) : vm_(vm) {}
+
+    // returns air for blocks in chunks that don't exist
+    Block Get(const glm::ivec3& wpos)
+    {
+      const Chunk* chunk = seek(wpos);
+      return chunk ? chunk->BlockAtNoLock(local_.block_pos) : Block{};
+    }
+
+    BlockType GetType(const glm::ivec3& wpos)
+    {
+      const Chunk* chunk = seek(wpos);
+      return chunk ? chunk->BlockTypeAtNoLock(local_.block_pos) : BlockType::bAir;
+    }
+
+    // lets the chunk be edited again. the next read takes the lock again
+    void Release()
+    {
+      lock_ = {};
+      cached_ = false;
+    }
+
+  private:
+    const Chunk* seek(const glm::ivec3& wpos)
+    {
+      ChunkHelpers::WorldPosToLocalPosFast(wpos, local_);
+      if (!cached_ || local_.chunk_pos != chunkPos_)
+      {
+        // released first, so that only one chunk is ever locked
+        lock_ = {};
+        chunk_ = vm_.GetChunk(local_.chunk_pos);
+        if (chunk_)
+        {
+          lock_ = chunk_->LockShared();
+        }
+        chunkPos_ = local_.chunk_pos;
+        cached_ = true;
+      }
+      return chunk_;
+    }
+
+    const VoxelManager& vm_;
+    const Chunk* chunk_{};
+    std::shared_lock<std::shared_mutex> lock_;
+    glm::ivec3 chunkPos_{};
+    ChunkHelpers::localpos local_;
+    bool cached_ = false;
+  };
+
+  // Visits every block along the segment from origin in direction, up to distance (in world units).
+  // From "A Fast Voxel Traversal Algorithm for Ray Tracing" by John Amanatides and Andrew Woo, 1987
+  // <http://www.cse.yorku.ca/~amana/research/grid.pdf>
+  // fn(const glm::ivec3& blockPos, Block block, const glm::vec3& face, float t) -> bool
+  // face is the normal of the face that was entered (zero for the first block), and t is the
+  // distance traveled to reach it. return true to stop
+  template<typename Fn>
+  void TraverseRay(BlockCursor& cursor, const glm::vec3& origin, const glm::vec3& direction, float distance, Fn&& fn)
+  {
+    ASSERT_MSG(direction != glm::vec3(0), "Raycast in zero direction!");
+
+    // tMax is the t at which the ray crosses the next block boundary on each axis, and tDelta is
+    // how much t changes between boundaries. t is in units of direction's length
+    glm::ivec3 p(glm::floor(origin));
+    glm::ivec3 step(glm::sign(direction));
+    glm::vec3 tMax, tDelta;
+    for (int i = 0; i < 3; i++)
+    {
+      if (step[i] == 0)
+      {
+        tMax[i] = std::numeric_limits<float>::infinity();
+        tDelta[i] = std::numeric_limits<float>::infinity();
+        continue;
+      }
+      float boundary = step[i] > 0 ? glm::floor(origin[i]) + 1 : glm::floor(origin[i]);
+      tMax[i] = (boundary - origin[i]) / direction[i];
+      tDelta[i] = step[i] / direction[i];
+    }
+
+    const float length = glm::length(direction);
+    const float tEnd = distance / length;
+    float t = 0;
+    glm::vec3 face(0);
+    while (true)
+    {
+      if (fn(p, cursor.Get(p), face, t * length))
+      {
+        return;
+      }
+
+      int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+      if (tMax[axis] > tEnd)
+      {
+        return;
+      }
+      t = tMax[axis];
+      p[axis] += step[axis];
+      tMax[axis] += tDelta[axis];
+      face = glm::vec3(0);
+      face[axis] = float(-step[axis]);
+    }
+  }
+
+  template<typename Fn>
+  void TraverseRay(const VoxelManager& vm, const glm::vec3& origin, const glm::vec3& direction, float distance, Fn&& fn)
+  {
+    BlockCursor cursor(vm);
+    TraverseRay(cursor, origin, direction, distance, std::forward<Fn>(fn));
+  }
+
+  // visits every solid block that overlaps the open box, one chunk at a time
+  // fn(const glm::ivec3& blockPos, Block block) -> bool. return true to stop
+  template<typename Fn>
+  void OverlapBox(const VoxelManager& vm, const AABB& box, Fn&& fn)
+  {
+    BlockCursor cursor(vm);
+    const glm::ivec3 lo(glm::floor(box.min));
+    const glm::ivec3 hi = glm::ivec3(glm::ceil(box.max)) - 1;
+    if (glm::any(glm::lessThan(hi, lo)))
+    {
+      return;
+    }
+
+    const glm::ivec3 chunkLo = ChunkHelpers::WorldPosToLocalPos(lo).chunk_pos;
+    const glm::ivec3 chunkHi = ChunkHelpers::WorldPosToLocalPos(hi).chunk_pos;
+    for (int cz = chunkLo.z; cz <= chunkHi.z; cz++)
+    {
+      for (int cy = chunkLo.y; cy <= chunkHi.y; cy++)
+      {
+        for (int cx = chunkLo.x; cx <= chunkHi.x; cx++)
+        {
+          // the part of the box inside this chunk
+          const glm::ivec3 chunkMin = glm::ivec3(cx, cy, cz) * Chunk::CHUNK_SIZE;
+          const glm::ivec3 first = glm::max(lo, chunkMin);
+          const glm::ivec3 last = glm::min(hi, chunkMin + Chunk::CHUNK_SIZE - 1);
+          for (int z = first.z; z <= last.z; z++)
+          {
+            for (int y = first.y; y <= last.y; y++)
+            {
+              for (int x = first.x; x <= last.x; x++)
+              {
+                glm::ivec3 p(x, y, z);
+                Block block = cursor.Get(p);
+                if (Collision::IsSolid(block.GetType()) && fn(p, block))
+                {
+                  return;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // visits every solid block that overlaps the sphere
+  // fn(const glm::ivec3& blockPos, Block block) -> bool. return true to stop
+  template<typename Fn>
+  void OverlapSphere(const VoxelManager& vm, const glm::vec3& center, float radius, Fn&& fn)
+  {
+    OverlapBox(vm, AABB(center - radius, center + radius), [&](const glm::ivec3& p, Block block)
+      {
+        glm::vec3 closest = glm::clamp(center, glm::vec3(p), glm::vec3(p) + 1.0f);
+        if (glm::dot(closest - center, closest - center) >= radius * radius)
+        {
+          return false;
+        }
+        return fn(p, block);
+      });
+  }
+
+  struct Ray
+  {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float distance;
+  };
+
+  struct Segment
+  {
+    glm::vec3 from;
+    glm::vec3 to;
+  };
+
+  struct Sphere
+  {
+    glm::vec3 center;
+    float radius;
+  };
+
+  [[nodiscard]] bool LineOfSight(const VoxelManager& vm, const glm::vec3& from, const glm::vec3& to);
+
+  // finds the first solid block hit by each ray
+  void RaycastBatch(const VoxelManager& vm, std::span<const Ray> rays, std::span<std::optional<Collision::Hit>> hits);
+
+  // visible[i] is 1 if no solid block lies between segments[i].from and segments[i].to
+  void LineOfSightBatch(const VoxelManager& vm, std::span<const Segment> segments, std::span<uint8_t> visible);
+
+  // overlaps[i] is 1 if the shape overlaps any solid block
+  void OverlapSphereBatch(const VoxelManager& vm, std::span<const Sphere> spheres, std::span<uint8_t> overlaps);
+  void OverlapBoxBatch(const VoxelManager& vm, std::span<const AABB> boxes, std::span<uint8_t> overlaps);
+}